@@ -37,6 +37,7 @@
 #include <circle/devicenameservice.h>
 #include <circle/util.h>
 #include <circle/stdarg.h>
+#include <circle/tracepoint.h>
 #include <assert.h>
 #ifndef USE_SDHOST
 	#include <circle/bcm2835.h>
@@ -590,6 +591,8 @@ int CEMMCDevice::Read (void *pBuffer, size_t nCount)
 	}
 	u32 nBlock = m_ullOffset / SD_BLOCK_SIZE;
 
+	TRACEPOINT (TracepointBlockRead, (u32) (uintptr) this, nBlock, nCount);
+
 	if (m_pActLED != 0)
 	{
 		m_pActLED->On ();
@@ -627,6 +630,8 @@ int CEMMCDevice::Write (const void *pBuffer, size_t nCount)
 	}
 	u32 nBlock = m_ullOffset / SD_BLOCK_SIZE;
 
+	TRACEPOINT (TracepointBlockWrite, (u32) (uintptr) this, nBlock, nCount);
+
 	if (m_pActLED != 0)
 	{
 		m_pActLED->On ();
@@ -9,7 +9,8 @@ class CKThread : public CTask
 {
 public:
 	CKThread (int (*threadfn) (void *data), void *data, const char *pName)
-	:	m_threadfn (threadfn),
+	:	CTask (TASK_STACK_SIZE, TRUE),
+		m_threadfn (threadfn),
 		m_data (data)
 	{
 		SetName (pName);
@@ -49,6 +50,8 @@ struct task_struct *kthread_create (int (*threadfn)(void *data),
 	ctask->SetUserData (task, TASK_USER_DATA_KTHREAD);
 	task->taskobj = (void *) ctask;
 
+	ctask->Start ();
+
 	return task;
 }
 
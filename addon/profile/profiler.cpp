@@ -17,16 +17,16 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
+#include <circle/sysconfig.h>
+
+// multi-core programs can use CSamplingProfiler from this library only
+#ifndef ARM_ALLOW_MULTI_CORE
+
 #include <profile/profiler.h>
 #include <profile/gmon.h>
 #include <circle/devicenameservice.h>
-#include <circle/sysconfig.h>
 #include <circle/logger.h>
 
-#ifdef ARM_ALLOW_MULTI_CORE
-	#error Multi-core programs are not supported by this profile library!
-#endif
-
 static const char From[] = "prof";
 
 CProfiler::CProfiler (uintptr nTextStart, uintptr nTextEnd)
@@ -78,3 +78,5 @@ void CProfiler::SaveResults (FATFS *pFileSystem, const char *pDriveName)
 
 	CLogger::Get ()->Write (From, LogDebug, "Profiling results saved");
 }
+
+#endif
@@ -21,9 +21,14 @@
 #define _profile_profiler_h
 
 #include <circle/fs/fat/fatfs.h>
+#include <circle/sysconfig.h>
 #include <circle/types.h>
 #include <fatfs/ff.h>
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	#error Multi-core programs are not supported by CProfiler, use CSamplingProfiler!
+#endif
+
 extern u8 _start, _etext;
 
 class CProfiler		/// A software profiler
@@ -0,0 +1,401 @@
+//
+// sampler.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <profile/sampler.h>
+#include <circle/sched/scheduler.h>
+#include <circle/exceptionstub.h>
+#include <circle/multicore.h>
+#include <circle/memory.h>
+#include <circle/string.h>
+#include <circle/util.h>
+#include <assert.h>
+
+CSamplingProfiler::CSamplingProfiler (unsigned nSampleRateHZ, unsigned nMaxStacks,
+				      unsigned nMaxDepth, uintptr nTextStart, uintptr nTextEnd)
+:	m_nMaxStacks (nMaxStacks),
+	m_nMaxDepth (nMaxDepth),
+	m_nTextStart (nTextStart),
+	m_nTextEnd (nTextEnd),
+	m_nMemEnd (CMemorySystem::Get ()->GetMemSize ()),
+	m_bActive (FALSE)
+{
+	assert (0 < nSampleRateHZ && nSampleRateHZ <= 100000);
+	m_nSampleDelay = 1000000 / nSampleRateHZ;
+
+	assert (m_nMaxStacks >= 16);
+	assert ((m_nMaxStacks & (m_nMaxStacks-1)) == 0);
+	assert (1 <= m_nMaxDepth && m_nMaxDepth <= SAMPLER_MAX_DEPTH);
+	assert (m_nTextStart < m_nTextEnd);
+
+	for (unsigned i = 0; i < SAMPLER_CORES; i++)
+	{
+		TCoreData *pCore = &m_Core[i];
+
+		pCore->pStack = new TStack[m_nMaxStacks];
+		pCore->pPC = new uintptr[m_nMaxStacks * m_nMaxDepth];
+		assert (pCore->pStack != 0);
+		assert (pCore->pPC != 0);
+
+		for (unsigned j = 0; j < m_nMaxStacks; j++)
+		{
+			pCore->pStack[j].pPC = &pCore->pPC[j * m_nMaxDepth];
+		}
+
+		pCore->nUsed = 0;
+		pCore->nSamples = 0;
+		pCore->nDropped = 0;
+	}
+}
+
+CSamplingProfiler::~CSamplingProfiler (void)
+{
+	Stop ();
+
+	for (unsigned i = 0; i < SAMPLER_CORES; i++)
+	{
+		delete [] m_Core[i].pStack;
+		m_Core[i].pStack = 0;
+
+		delete [] m_Core[i].pPC;
+		m_Core[i].pPC = 0;
+	}
+}
+
+void CSamplingProfiler::Start (void)
+{
+	assert (!m_bActive);
+
+	for (unsigned i = 0; i < SAMPLER_CORES; i++)
+	{
+		TCoreData *pCore = &m_Core[i];
+
+		for (unsigned j = 0; j < m_nMaxStacks; j++)
+		{
+			pCore->pStack[j].nHash = 0;
+		}
+
+		pCore->nUsed = 0;
+		pCore->nSamples = 0;
+		pCore->nDropped = 0;
+	}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	CMultiCoreSupport::ConnectIPI (IPI_PROFILE, IPIHandler, this);
+#endif
+
+	m_bActive = TRUE;
+
+	CTimer::Get ()->StartHighResTimer (m_nSampleDelay, TimerHandler, this);
+}
+
+void CSamplingProfiler::Stop (void)
+{
+	if (!m_bActive)
+	{
+		return;
+	}
+
+	m_bActive = FALSE;
+
+	// the timer is not restarted any more, wait until it has elapsed
+	// (it may be rounded up to the next tick) and pending IPIs are handled
+	CTimer::Get ()->MsDelay (m_nSampleDelay / 1000 + 2 * 1000 / HZ);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	CMultiCoreSupport::DisconnectIPI (IPI_PROFILE);
+#endif
+}
+
+boolean CSamplingProfiler::WriteFoldedStacks (CDevice *pDevice)
+{
+	assert (pDevice != 0);
+
+	return Write (WriteDevice, pDevice);
+}
+
+boolean CSamplingProfiler::SaveFoldedStacks (const char *pFileName)
+{
+	assert (pFileName != 0);
+
+	FIL File;
+	if (f_open (&File, pFileName, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+	{
+		return FALSE;
+	}
+
+	boolean bOK = Write (WriteFile, &File);
+
+	if (f_close (&File) != FR_OK)
+	{
+		bOK = FALSE;
+	}
+
+	return bOK;
+}
+
+unsigned CSamplingProfiler::GetSamples (void) const
+{
+	unsigned nSamples = 0;
+	for (unsigned i = 0; i < SAMPLER_CORES; i++)
+	{
+		nSamples += m_Core[i].nSamples;
+	}
+
+	return nSamples;
+}
+
+unsigned CSamplingProfiler::GetDropped (void) const
+{
+	unsigned nDropped = 0;
+	for (unsigned i = 0; i < SAMPLER_CORES; i++)
+	{
+		nDropped += m_Core[i].nDropped;
+	}
+
+	return nDropped;
+}
+
+void CSamplingProfiler::TakeSample (void)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	unsigned nCore = CMultiCoreSupport::ThisCore ();
+#else
+	unsigned nCore = 0;
+#endif
+	TCoreData *pCore = &m_Core[nCore];
+
+	pCore->nSamples++;
+
+	// the IRQ stub has saved the interrupted context of this core
+	uintptr PC[SAMPLER_MAX_DEPTH];
+	unsigned nDepth = Unwind (IRQContext[nCore].nReturnAddress,
+				  IRQContext[nCore].nFramePointer, PC);
+
+	CTask *pTask = 0;
+	if (CScheduler::IsActive ())
+	{
+		pTask = CScheduler::Get ()->GetCurrentTask ();
+	}
+
+	// FNV-1a hash over task and call stack
+	u32 nHash = 2166136261U;
+	nHash = (nHash ^ (u32) (uintptr) pTask) * 16777619U;
+	for (unsigned i = 0; i < nDepth; i++)
+	{
+		nHash = (nHash ^ (u32) PC[i]) * 16777619U;
+	}
+
+	if (nHash == 0)
+	{
+		nHash = 1;
+	}
+
+	unsigned nMask = m_nMaxStacks-1;
+	unsigned nIndex = nHash & nMask;
+	for (unsigned i = 0; i < m_nMaxStacks; i++, nIndex = (nIndex+1) & nMask)
+	{
+		TStack *pStack = &pCore->pStack[nIndex];
+
+		if (pStack->nHash == 0)
+		{
+			// keep the hash table sparse, so that the search remains short
+			if (pCore->nUsed >= m_nMaxStacks - m_nMaxStacks/4)
+			{
+				break;
+			}
+
+			pStack->nCount = 1;
+			pStack->pTask = pTask;
+			pStack->TaskName[0] = '\0';
+			if (pTask != 0)
+			{
+				strncpy (pStack->TaskName, pTask->GetName (), SAMPLER_TASK_NAME_LEN-1);
+				pStack->TaskName[SAMPLER_TASK_NAME_LEN-1] = '\0';
+			}
+
+			pStack->nDepth = nDepth;
+			memcpy (pStack->pPC, PC, nDepth * sizeof PC[0]);
+
+			pStack->nHash = nHash;
+			pCore->nUsed++;
+
+			return;
+		}
+
+		if (   pStack->nHash == nHash
+		    && pStack->pTask == pTask
+		    && pStack->nDepth == nDepth
+		    && memcmp (pStack->pPC, PC, nDepth * sizeof PC[0]) == 0)
+		{
+			pStack->nCount++;
+
+			return;
+		}
+	}
+
+	pCore->nDropped++;
+}
+
+unsigned CSamplingProfiler::Unwind (uintptr nPC, uintptr nFP, uintptr *pPC)
+{
+	assert (pPC != 0);
+
+	unsigned nDepth = 0;
+	pPC[nDepth++] = nPC;
+
+	// frame records are validated, because code without frame pointer
+	// may use the frame pointer register for other purposes
+	while (   nDepth < m_nMaxDepth
+	       && nFP != 0
+	       && (nFP & (sizeof (uintptr)-1)) == 0
+	       && nFP >= sizeof (uintptr)
+	       && nFP < m_nMemEnd - 2*sizeof (uintptr))
+	{
+#if AARCH == 32
+		// GCC (ARM mode): FP points to the saved LR, the saved FP is below
+		uintptr nLR = ((uintptr *) nFP)[0];
+		uintptr nNextFP = ((uintptr *) nFP)[-1];
+#else
+		// AAPCS64 frame record: saved FP, saved LR
+		uintptr nNextFP = ((uintptr *) nFP)[0];
+		uintptr nLR = ((uintptr *) nFP)[1];
+#endif
+		if (!IsText (nLR))
+		{
+			break;
+		}
+
+		pPC[nDepth++] = nLR;
+
+		// the stack grows down, the caller's frame is above
+		if (nNextFP <= nFP)
+		{
+			break;
+		}
+
+		nFP = nNextFP;
+	}
+
+	return nDepth;
+}
+
+boolean CSamplingProfiler::Write (TWriteFunction *pWriteFunction, void *pParam)
+{
+	assert (pWriteFunction != 0);
+	assert (!m_bActive);
+
+	for (unsigned nCore = 0; nCore < SAMPLER_CORES; nCore++)
+	{
+		TCoreData *pCore = &m_Core[nCore];
+
+		for (unsigned i = 0; i < m_nMaxStacks; i++)
+		{
+			TStack *pStack = &pCore->pStack[i];
+			if (pStack->nHash == 0)
+			{
+				continue;
+			}
+
+			CString Line;
+			Line.Format ("core%u;%s", nCore,
+				     pStack->TaskName[0] != '\0' ? pStack->TaskName : "-");
+
+			for (unsigned j = pStack->nDepth; j > 0; j--)
+			{
+				CString Frame;
+				Frame.Format (";0x%lX", (unsigned long) pStack->pPC[j-1]);
+				Line.Append (Frame);
+			}
+
+			CString Count;
+			Count.Format (" %u\n", pStack->nCount);
+			Line.Append (Count);
+
+			if (!(*pWriteFunction) (Line, pParam))
+			{
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+boolean CSamplingProfiler::WriteDevice (const char *pString, void *pParam)
+{
+	CDevice *pDevice = (CDevice *) pParam;
+	assert (pDevice != 0);
+
+	assert (pString != 0);
+	size_t nLength = strlen (pString);
+
+	return pDevice->Write (pString, nLength) == (int) nLength;
+}
+
+boolean CSamplingProfiler::WriteFile (const char *pString, void *pParam)
+{
+	FIL *pFile = (FIL *) pParam;
+	assert (pFile != 0);
+
+	assert (pString != 0);
+	UINT nLength = strlen (pString);
+
+	UINT nWritten;
+	return    f_write (pFile, pString, nLength, &nWritten) == FR_OK
+	       && nWritten == nLength;
+}
+
+void CSamplingProfiler::TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CSamplingProfiler *pThis = (CSamplingProfiler *) pParam;
+	assert (pThis != 0);
+
+	if (!pThis->m_bActive)
+	{
+		return;
+	}
+
+	CTimer::Get ()->StartHighResTimer (pThis->m_nSampleDelay, TimerHandler, pThis);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	for (unsigned nCore = 1; nCore < SAMPLER_CORES; nCore++)
+	{
+		CMultiCoreSupport::SendIPI (nCore, IPI_PROFILE);
+	}
+#endif
+
+	pThis->TakeSample ();
+}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+void CSamplingProfiler::IPIHandler (unsigned nIPI, void *pParam)
+{
+	CSamplingProfiler *pThis = (CSamplingProfiler *) pParam;
+	assert (pThis != 0);
+
+	assert (nIPI == IPI_PROFILE);
+
+	if (pThis->m_bActive)
+	{
+		pThis->TakeSample ();
+	}
+}
+
+#endif
@@ -0,0 +1,133 @@
+//
+// sampler.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _profile_sampler_h
+#define _profile_sampler_h
+
+#include <circle/device.h>
+#include <circle/timer.h>
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+#include <fatfs/ff.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#include <circle/memorymap.h>
+
+	#define SAMPLER_CORES		CORES
+#else
+	#define SAMPLER_CORES		1
+#endif
+
+#define SAMPLER_MAX_DEPTH	32		// maximum number of frames per call stack
+#define SAMPLER_TASK_NAME_LEN	16
+
+extern u8 _start, _etext;
+
+class CSamplingProfiler		/// Statistical profiler, which samples the call stacks on all cores
+{
+public:
+	/// \param nSampleRateHZ Samples per second and core (the overhead is proportional)
+	/// \param nMaxStacks Maximum number of different call stacks per core (power of 2)
+	/// \param nMaxDepth Maximum number of frames per call stack (<= SAMPLER_MAX_DEPTH)
+	/// \param nTextStart Start address of the code to be profiled
+	/// \param nTextEnd End address of the code to be profiled
+	/// \note The program has to be compiled with -fno-omit-frame-pointer\n
+	///	  to get complete call stacks.
+	CSamplingProfiler (unsigned nSampleRateHZ = 1000,
+			   unsigned nMaxStacks = 2048, unsigned nMaxDepth = 16,
+			   uintptr nTextStart = (uintptr) &_start,
+			   uintptr nTextEnd = (uintptr) &_etext);
+
+	~CSamplingProfiler (void);
+
+	/// \brief Clear the results and start sampling
+	void Start (void);
+	/// \brief Stop sampling
+	void Stop (void);
+
+	/// \brief Write the results in the folded stacks format (for flame graphs)
+	/// \param pDevice Target device (e.g. CQEMUHostFile)
+	/// \return Operation successful?
+	/// \note Each line contains the core, the task name and the code addresses\n
+	///	  of the call stack (outermost first), followed by the number of samples.\n
+	///	  The addresses can be converted to function names with symbolize.py.
+	boolean WriteFoldedStacks (CDevice *pDevice);
+
+	/// \brief Save the results in the folded stacks format to a file
+	/// \param pFileName Path of the file (FatFs, the drive must be mounted)
+	/// \return Operation successful?
+	boolean SaveFoldedStacks (const char *pFileName = "SD:/stacks.txt");
+
+	/// \return Number of samples taken on all cores
+	unsigned GetSamples (void) const;
+	/// \return Number of samples, which were dropped, because a stack table was full
+	unsigned GetDropped (void) const;
+
+private:
+	void TakeSample (void);
+
+	unsigned Unwind (uintptr nPC, uintptr nFP, uintptr *pPC);
+	boolean IsText (uintptr nAddress) const
+	{
+		return m_nTextStart <= nAddress && nAddress < m_nTextEnd;
+	}
+
+	typedef boolean TWriteFunction (const char *pString, void *pParam);
+	boolean Write (TWriteFunction *pWriteFunction, void *pParam);
+	static boolean WriteDevice (const char *pString, void *pParam);
+	static boolean WriteFile (const char *pString, void *pParam);
+
+	static void TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
+#ifdef ARM_ALLOW_MULTI_CORE
+	static void IPIHandler (unsigned nIPI, void *pParam);
+#endif
+
+private:
+	unsigned m_nSampleDelay;		// microseconds
+	unsigned m_nMaxStacks;
+	unsigned m_nMaxDepth;
+	uintptr m_nTextStart;
+	uintptr m_nTextEnd;
+	uintptr m_nMemEnd;
+
+	volatile boolean m_bActive;
+
+	struct TStack
+	{
+		u32	 nHash;			// 0 for unused entry
+		unsigned nCount;		// number of samples
+		void	*pTask;
+		char	 TaskName[SAMPLER_TASK_NAME_LEN];
+		unsigned nDepth;
+		uintptr	*pPC;			// pPC[0] is the innermost frame
+	};
+
+	struct TCoreData			// written by its own core only
+	{
+		TStack	*pStack;		// hash table
+		uintptr	*pPC;			// m_nMaxDepth entries per stack
+		unsigned nUsed;
+		volatile unsigned nSamples;
+		volatile unsigned nDropped;
+	};
+
+	TCoreData m_Core[SAMPLER_CORES];
+};
+
+#endif
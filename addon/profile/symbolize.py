@@ -0,0 +1,41 @@
+#!/usr/bin/env python3
+#
+# symbolize.py
+#
+# Converts the code addresses in the output of CSamplingProfiler
+# (folded stacks) to function names, using addr2line
+#
+# Usage: python3 symbolize.py KERNEL.ELF STACKS.TXT [ADDR2LINE] > STACKS.FOLDED
+#
+
+import subprocess
+import sys
+
+if len(sys.argv) < 3:
+	print("Usage: python3 symbolize.py KERNEL.ELF STACKS.TXT [ADDR2LINE]", file=sys.stderr)
+	sys.exit(1)
+
+elffile = sys.argv[1]
+stacksfile = sys.argv[2]
+addr2line = sys.argv[3] if len(sys.argv) > 3 else "aarch64-none-elf-addr2line"
+
+lines = []
+addresses = set()
+with open(stacksfile) as f:
+	for line in f:
+		line = line.strip()
+		if not line:
+			continue
+		stack, count = line.rsplit(" ", 1)
+		frames = stack.split(";")
+		lines.append((frames, count))
+		addresses.update(frame for frame in frames if frame.startswith("0x"))
+
+addresses = sorted(addresses)
+result = subprocess.run([addr2line, "-f", "-C", "-e", elffile] + addresses,
+			capture_output=True, text=True, check=True)
+names = result.stdout.splitlines()[0::2]	# function name, then file:line
+symbols = dict(zip(addresses, names))
+
+for frames, count in lines:
+	print(";".join(symbols.get(frame, frame) for frame in frames) + " " + count)
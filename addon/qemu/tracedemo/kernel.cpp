@@ -0,0 +1,122 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2014-2020  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/sched/task.h>
+#include <assert.h>
+
+#define WORKER_TASKS		4
+#define WORKER_ROUNDS		50
+
+static const char FromKernel[] = "kernel";
+
+class CWorkerTask : public CTask		// sleeps and emits a user tracepoint
+{
+public:
+	CWorkerTask (unsigned nID)
+	:	CTask (TASK_STACK_SIZE, TRUE),
+		m_nID (nID)
+	{
+		Start ();
+	}
+
+	void Run (void)
+	{
+		for (unsigned i = 0; i < WORKER_ROUNDS; i++)
+		{
+			TRACEPOINT (TracepointUser, m_nID, i);
+
+			CScheduler::Get ()->MsSleep (5 + m_nID);
+		}
+	}
+
+private:
+	unsigned m_nID;
+};
+
+CKernel::CKernel (void)
+:	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer)
+{
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Logger.Initialize (&m_LogFile);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+#ifndef TRACEPOINTS
+	m_Logger.Write (FromKernel, LogWarning, "TRACEPOINTS is not defined, no events will be recorded");
+#endif
+
+	m_Tracepoints.Start ();
+
+	CTask *pTask[WORKER_TASKS];
+	for (unsigned i = 0; i < WORKER_TASKS; i++)
+	{
+		pTask[i] = new CWorkerTask (i);
+		assert (pTask[i] != 0);
+	}
+
+	for (unsigned i = 0; i < WORKER_TASKS; i++)
+	{
+		pTask[i]->WaitForTermination ();
+	}
+
+	m_Tracepoints.Stop ();
+
+	CQEMUHostFile TraceFile ("trace.json");
+	if (   !TraceFile.IsOpen ()
+	    || !m_Tracepoints.ExportChromeTrace (&TraceFile))
+	{
+		m_Logger.Write (FromKernel, LogError, "Cannot write trace.json");
+
+		return ShutdownHalt;
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "Trace written to trace.json (%u events lost)",
+			m_Tracepoints.GetLost ());
+
+	return ShutdownHalt;
+}
@@ -164,10 +164,13 @@ class CKProc : public CTask
 {
 public:
 	CKProc (void (*procfn) (void *param), void *param, const char *name)
-	:	m_procfn (procfn),
+	:	CTask (TASK_STACK_SIZE, TRUE),
+		m_procfn (procfn),
 		m_param (param)
 	{
 		SetName (name);
+
+		Start ();
 	}
 
 	void Run (void)
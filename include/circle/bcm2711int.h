@@ -50,6 +50,7 @@
 #define ARM_IRQ_GPIO1		GIC_SPI (114)
 #define ARM_IRQ_GPIO2		GIC_SPI (115)
 #define ARM_IRQ_GPIO3		GIC_SPI (116)
+#define ARM_IRQ_I2C		GIC_SPI (117)
 #define ARM_IRQ_UART		GIC_SPI (121)
 #define ARM_IRQ_ARASANSDIO	GIC_SPI (126)
 #define ARM_IRQ_PCIE_HOST_INTA	GIC_SPI (143)
@@ -21,6 +21,7 @@
 #define _circle_bcmpropertytags_h
 
 #include <circle/bcmmailbox.h>
+#include <circle/spinlock.h>
 #include <circle/macros.h>
 #include <circle/types.h>
 
@@ -277,6 +278,14 @@ struct TPropertyTagCommandLine
 }
 PACKED;
 
+#define PROPTAG_BATCH_MAX		16		// max. number of tags in a batch
+
+#define PROPTAG_CACHE_ENTRIES		16
+#define PROPTAG_CACHE_VALUE_SIZE	8		// bytes
+
+// Immutable values (e.g. board revision, MAC address, memory split, min./max. clock rates)
+// are cached, so that only the first request goes to the VideoCore.
+
 class CBcmPropertyTags
 {
 public:
@@ -291,8 +300,49 @@ public:
 	boolean GetTags (void	 *pTags,			// pointer to tags struct
 			 unsigned nTagsSize);			// size of tags struct
 
+	// Batched requests: add the tags with AddTag() (same parameters as GetTag()),
+	// then process them with one mailbox transaction with SubmitTags().
+	// The tag structs must be valid until SubmitTags() returns.
+	boolean AddTag (u32	  nTagId,			// returns FALSE, if batch is full
+			void	 *pTag,
+			unsigned  nTagSize,
+			unsigned  nRequestParmSize = 0);
+
+	// returns TRUE, if all tags have been processed successfully,
+	// otherwise a failed tag has (pTag->nValueLength == 0)
+	boolean SubmitTags (void);
+
+private:
+	static boolean IsCacheable (u32 nTagId);
+
+	// returns TRUE, if the tag has been filled from the cache
+	boolean LookupCache (TPropertyTag *pTag, unsigned nRequestParmSize);
+	void UpdateCache (const TPropertyTag *pTag, unsigned nRequestParmSize);
+
 private:
 	CBcmMailBox m_MailBox;
+	boolean m_bEarlyUse;
+
+	unsigned m_nBatchTags;
+	struct
+	{
+		TPropertyTag	*pTag;
+		unsigned	 nTagSize;
+		unsigned	 nRequestParmSize;
+	}
+	m_Batch[PROPTAG_BATCH_MAX];
+
+	struct TCacheEntry
+	{
+		u32		nTagId;
+		u32		nKey;			// first request parameter (if any)
+		unsigned	nValueLength;
+		u8		Value[PROPTAG_CACHE_VALUE_SIZE];
+	};
+
+	static TCacheEntry s_Cache[PROPTAG_CACHE_ENTRIES];
+	static volatile unsigned s_nCacheEntries;
+	static CSpinLock s_CacheSpinLock;
 };
 
 #endif
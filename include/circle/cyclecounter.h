@@ -0,0 +1,81 @@
+//
+/// \file cyclecounter.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_cyclecounter_h
+#define _circle_cyclecounter_h
+
+#include <circle/types.h>
+
+class CCycleCounter	/// Access to the CPU cycle counter of the Performance Monitors Unit
+{
+public:
+	/// \brief Start the cycle counter on this core, if it is not running yet
+	/// \note The cycle counter has to be enabled on each core, where it is used.
+	static void Enable (void)
+	{
+#if AARCH == 32
+#if RASPPI == 1
+		u32 nPMNC;
+		asm volatile ("mrc p15, 0, %0, c15, c12, 0" : "=r" (nPMNC));
+		if (!(nPMNC & 1))
+		{
+			asm volatile ("mcr p15, 0, %0, c15, c12, 0" : : "r" (nPMNC | 1));
+		}
+#else
+		u32 nPMCR;
+		asm volatile ("mrc p15, 0, %0, c9, c12, 0" : "=r" (nPMCR));
+		if (!(nPMCR & 1))
+		{
+			asm volatile ("mcr p15, 0, %0, c9, c12, 0" : : "r" (nPMCR | 1));
+			asm volatile ("mcr p15, 0, %0, c9, c12, 1" : : "r" (1U << 31));	// PMCNTENSET
+		}
+#endif
+#else
+		u64 nPMCR;
+		asm volatile ("mrs %0, pmcr_el0" : "=r" (nPMCR));
+		if (!(nPMCR & 1))
+		{
+			asm volatile ("msr pmcr_el0, %0" : : "r" (nPMCR | 1));
+			asm volatile ("msr pmcntenset_el0, %0" : : "r" (1UL << 31));
+		}
+#endif
+	}
+
+	/// \return Current value of the cycle counter of this core (wraps)
+	static u32 Read (void)
+	{
+		u32 nCycles;
+
+#if AARCH == 32
+#if RASPPI == 1
+		asm volatile ("mrc p15, 0, %0, c15, c12, 1" : "=r" (nCycles));
+#else
+		asm volatile ("mrc p15, 0, %0, c9, c13, 0" : "=r" (nCycles));
+#endif
+#else
+		u64 nPMCCNTR;
+		asm volatile ("mrs %0, pmccntr_el0" : "=r" (nPMCCNTR));
+		nCycles = (u32) nPMCCNTR;
+#endif
+
+		return nCycles;
+	}
+};
+
+#endif
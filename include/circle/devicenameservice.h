@@ -21,7 +21,7 @@
 #define _circle_devicenameservice_h
 
 #include <circle/device.h>
-#include <circle/spinlock.h>
+#include <circle/rwspinlock.h>
 #include <circle/types.h>
 
 struct TDeviceInfo
@@ -76,7 +76,7 @@ public:
 private:
 	TDeviceInfo *m_pList;
 
-	CSpinLock m_SpinLock;
+	CRWSpinLock m_SpinLock;
 
 	static CDeviceNameService *s_This;
 };
@@ -47,6 +47,8 @@ PACKED;
 /// \note Do not explicitly use this class! Use the class CDMAChannel instead
 ///       with nChannel set to DMA_CHANNEL_EXTENDED!
 
+class CDMAChain;
+
 class CDMA4Channel	/// Platform DMA4 "large address" controller support
 {
 public:
@@ -68,6 +70,9 @@ public:
 			     size_t nBlockLength, unsigned nBlockCount, size_t nBlockStride,
 			     unsigned nBurstLength = 0);
 
+	// run a chain of control blocks, which has been built using CDMAChain
+	void SetupChain (CDMAChain *pChain);
+
 	void SetCompletionRoutine (TDMACompletionRoutine *pRoutine, void *pParam);
 
 	void Start (void);
@@ -83,6 +88,7 @@ private:
 
 	u8 *m_pControlBlockBuffer;
 	TDMA4ControlBlock *m_pControlBlock;
+	CDMAChain *m_pChain;
 
 	CInterruptSystem *m_pInterruptSystem;
 	boolean m_bIRQConnected;
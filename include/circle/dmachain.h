@@ -0,0 +1,174 @@
+//
+/// \file dmachain.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_dmachain_h
+#define _circle_dmachain_h
+
+#include <circle/dmachannel.h>
+#include <circle/dmacommon.h>
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+#define DMA_CHAIN_ENTRY_SIZE	64		///< Size of a chain entry, aligned to a cache line
+
+/// \note Internal, the control block is followed by CPU-only data in the same cache line.
+
+struct TDMAChainEntry
+{
+	union
+	{
+		TDMAControlBlock	ControlBlock;
+#if RASPPI >= 4
+		TDMA4ControlBlock	ControlBlock4;
+#endif
+	};
+
+	TDMAChainEntry	*pNext;
+	uintptr		 nDestinationAddress;	///< To be invalidated on completion (or 0)
+	size_t		 nDestinationLength;
+	boolean		 bInterrupt;
+
+	u8		 Padding[DMA_CHAIN_ENTRY_SIZE - sizeof (TDMAControlBlock)
+				 - sizeof (TDMAChainEntry *) - sizeof (uintptr)
+				 - sizeof (size_t) - sizeof (boolean)];
+};
+
+class CDMAControlBlockPool	/// Pool of cache-aligned DMA control blocks for CDMAChain
+{
+public:
+	/// \param nEntries Number of control blocks in the pool
+	CDMAControlBlockPool (unsigned nEntries);
+
+	~CDMAControlBlockPool (void);
+
+	/// \return Pointer to a free entry (or 0, if the pool is exhausted)
+	/// \note Can be called from interrupt context.
+	TDMAChainEntry *Allocate (void);
+
+	/// \param pEntry Entry to be returned to the pool
+	void Free (TDMAChainEntry *pEntry);
+
+	/// \return Number of free entries in the pool
+	unsigned GetFreeCount (void) const;
+
+private:
+	u8 *m_pBuffer;
+	TDMAChainEntry *m_pFreeList;
+	unsigned m_nFreeCount;
+
+	CSpinLock m_SpinLock;
+};
+
+/// \note A chain is built with the Add*() methods and started with\n
+///	  CDMAChannel::SetupChain() and CDMAChannel::Start(). The completion routine of\n
+///	  the channel is called, when the last step has been executed, or for a cyclic\n
+///	  chain after each step, which has been marked with SetInterrupt().
+
+class CDMAChain		/// Chain of DMA control blocks (scatter-gather list)
+{
+public:
+	/// \param pChannel DMA channel, on which the chain will run (determines the format)
+	/// \param pPool Pool, from which the control blocks are allocated
+	CDMAChain (CDMAChannel *pChannel, CDMAControlBlockPool *pPool);
+
+	~CDMAChain (void);
+
+	/// \brief Append a memory copy step
+	/// \param pDestination Pointer to the destination buffer
+	/// \param pSource	Pointer to the source buffer
+	/// \param nLength	Number of bytes to be transferred
+	/// \param nBurstLength Number of words to be transferred at once (0 = single transfer)
+	/// \return FALSE, if the pool is exhausted
+	boolean AddMemCopy (void *pDestination, const void *pSource, size_t nLength,
+			    unsigned nBurstLength = 0);
+
+	/// \brief Append an I/O read step
+	/// \param pDestination Pointer to the destination buffer
+	/// \param nIOAddress	I/O address to be read from (ARM-side or bus address)
+	/// \param nLength	Number of bytes to be transferred
+	/// \param DREQ		DREQ line for pacing the transfer (DREQSourceNone for none)
+	/// \return FALSE, if the pool is exhausted
+	boolean AddIORead (void *pDestination, u32 nIOAddress, size_t nLength, TDREQ DREQ);
+
+	/// \brief Append an I/O write step
+	/// \param nIOAddress	I/O address to be written (ARM-side or bus address)
+	/// \param pSource	Pointer to the source buffer
+	/// \param nLength	Number of bytes to be transferred
+	/// \param DREQ		DREQ line for pacing the transfer (DREQSourceNone for none)
+	/// \return FALSE, if the pool is exhausted
+	/// \note With DREQSourceNone this can be used to write peripheral registers.
+	boolean AddIOWrite (u32 nIOAddress, const void *pSource, size_t nLength, TDREQ DREQ);
+
+	/// \brief Append a step, which writes the same word multiple times to an I/O address
+	/// \param nIOAddress	I/O address to be written (ARM-side or bus address)
+	/// \param pWord	Pointer to the word to be written (in DMA-able memory)
+	/// \param nCount	Number of writes
+	/// \param DREQ		DREQ line for pacing the transfer
+	/// \return FALSE, if the pool is exhausted
+	/// \note Writing to a FIFO, which is consumed at a known rate, implements a delay.
+	boolean AddIOFill (u32 nIOAddress, const u32 *pWord, unsigned nCount, TDREQ DREQ);
+
+	/// \brief The last appended step raises the completion interrupt
+	void SetInterrupt (void);
+
+	/// \brief Link the last step to the first one, so that the chain runs forever
+	/// \note Use CDMAChannel::Cancel() to stop it.
+	/// \note This is not supported with DMA_CHANNEL_EXTENDED.
+	void SetCyclic (void);
+
+	/// \brief Remove all steps and return the control blocks to the pool
+	/// \note Must not be called, while the chain is running.
+	void Clear (void);
+
+	/// \return Number of steps in the chain
+	unsigned GetLength (void) const;
+
+	/// \return Is this a cyclic chain?
+	boolean IsCyclic (void) const;
+
+	/// \return Total number of bytes transferred by all steps
+	size_t GetTransferLength (void) const;
+
+	/// \return Has SetInterrupt() been called for another step than the last one?
+	boolean HasInnerInterrupt (void) const;
+
+	/// \brief Link the control blocks and do the cache maintenance, called on start
+	/// \param bInterruptAtEnd Set the completion interrupt in the last step
+	/// \return Pointer to the first control block
+	const void *Prepare (boolean bInterruptAtEnd);
+
+	/// \brief Invalidate the data cache for the destination buffers, called on completion
+	void InvalidateDestinations (void);
+
+private:
+	TDMAChainEntry *Append (void);
+
+private:
+	CDMAControlBlockPool *m_pPool;
+	boolean m_bDMA4;
+	size_t m_nMaxLength;
+
+	TDMAChainEntry *m_pFirst;
+	TDMAChainEntry *m_pLast;
+	unsigned m_nLength;
+
+	boolean m_bCyclic;
+};
+
+#endif
@@ -30,6 +30,8 @@
 	#include <circle/dma4channel.h>
 #endif
 
+class CDMAChain;
+
 struct TDMAControlBlock
 {
 	u32	nTransferInformation;
@@ -55,7 +57,10 @@ public:
 	/// \param nChannel DMA_CHANNEL_NORMAL, _LITE, _EXTENDED or an explicit channel number
 	/// \param pInterruptSystem Pointer to the interrupt system object\n
 	///	   (or 0, if SetCompletionRoutine() is not used)
-	CDMAChannel (unsigned nChannel, CInterruptSystem *pInterruptSystem = 0);
+	/// \param bAllocated Has the explicit channel number already been allocated\n
+	///	   with CMachineInfo::AllocateDMAChannel()? (it is freed on destruction)
+	CDMAChannel (unsigned nChannel, CInterruptSystem *pInterruptSystem = 0,
+		     boolean bAllocated = FALSE);
 
 	~CDMAChannel (void);
 
@@ -97,6 +102,20 @@ public:
 			     size_t nBlockLength, unsigned nBlockCount, size_t nBlockStride,
 			     unsigned nBurstLength = 0);
 
+	/// \brief Prepare a transfer with a chain of control blocks, which has been set up by the caller
+	/// \param pControlBlock Pointer to the first control block (32-byte aligned)
+	/// \note The caller is responsible for the cache maintenance of the control blocks\n
+	///	  and buffers, and has to set TI_INTEN in the last control block, if a\n
+	///	  completion routine is used.
+	/// \note This method is not supported with DMA_CHANNEL_EXTENDED.
+	void SetupChain (const TDMAControlBlock *pControlBlock);
+
+	/// \brief Prepare a transfer with a chain of control blocks, which has been built using CDMAChain
+	/// \param pChain Pointer to the chain (must have been created for this channel)
+	/// \note The control blocks are linked and the cache maintenance is done in Start().\n
+	///	  The chain must not be modified, while it is running.
+	void SetupChain (CDMAChain *pChain);
+
 	/// \brief Set completion routine to be called, when the transfer is finished
 	/// \param pRoutine Pointer to the completion routine
 	/// \param pParam   User parameter
@@ -114,6 +133,27 @@ public:
 	/// \return Has the transfer been successful?
 	boolean GetStatus (void);
 
+	/// \return Number of bytes, which have not been transferred yet
+	/// \note Can be called, while the transfer is active.
+	/// \note This method is not supported with DMA_CHANNEL_EXTENDED.
+	size_t GetRemaining (void);
+
+	/// \brief Stop an active DMA transfer
+	/// \return Number of bytes, which have not been transferred
+	/// \note The completion routine is not called for the cancelled transfer.
+	/// \note This method is not supported with DMA_CHANNEL_EXTENDED.
+	size_t Cancel (void);
+
+	/// \return Number of the allocated DMA channel
+	/// \note Can be used to control this channel from a control block of another channel.
+	unsigned GetChannel (void) const;
+
+	/// \return Is this a channel of the DMA4 "large address" controller?
+	boolean IsExtended (void) const;
+
+	/// \return Is this a lite channel (max. 64 KByte per control block, no 2D mode)?
+	boolean IsLite (void) const;
+
 private:
 	void InterruptHandler (void);
 	static void InterruptStub (void *pParam);
@@ -123,6 +163,8 @@ private:
 
 	u8 *m_pControlBlockBuffer;
 	TDMAControlBlock *m_pControlBlock;
+	const TDMAControlBlock *m_pChainControlBlock;	// first control block of chain (or 0)
+	CDMAChain *m_pChain;
 
 	CInterruptSystem *m_pInterruptSystem;
 	boolean m_bIRQConnected;
@@ -94,4 +94,78 @@ typedef void TDMACompletionRoutine (unsigned nChannel, boolean bStatus, void *pP
 #define ARM_DMA_INT_STATUS		(ARM_DMA_BASE + 0xFE0)
 #define ARM_DMA_ENABLE			(ARM_DMA_BASE + 0xFF0)
 
+#if RASPPI >= 4
+
+//
+// DMA4 "large address" controller
+//
+#define ARM_DMA4CHAN_CS(chan)		(ARM_DMA_BASE + ((chan) * 0x100) + 0x00)
+	#define CS4_HALT			(1 << 31)
+	#define CS4_ABORT			(1 << 30)
+	#define CS4_WAIT_FOR_OUTSTANDING_WRITES	(1 << 28)
+	#define CS4_PANIC_QOS_SHIFT		20
+		#define DEFAULT_PANIC_QOS4		15
+	#define CS4_QOS_SHIFT			16
+		#define DEFAULT_QOS4			1
+	#define CS4_ERROR			(1 << 10)
+	#define CS4_INT				(1 << 2)
+	#define CS4_END				(1 << 1)
+	#define CS4_ACTIVE			(1 << 0)
+#define ARM_DMA4CHAN_CONBLK_AD(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x04)
+	#define CONBLK_AD4_ADDR_SHIFT		5
+#define ARM_DMA4CHAN_DEBUG(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x0C)
+	#define DEBUG4_VERSION_SHIFT		28
+	#define DEBUG4_VERSION_MASK		(0xF << 28)
+		#define DMA4_VERSION			1
+	#define DEBUG4_RESET			(1 << 23)
+#define ARM_DMA4CHAN_TI(chan)		(ARM_DMA_BASE + ((chan) * 0x100) + 0x10)
+	#define TI4_DEST_DREQ			(1 << 15)
+	#define TI4_SRC_DREQ			(1 << 14)
+	#define TI4_PERMAP_SHIFT		9
+	#define TI4_WAIT_RD_RESP		(1 << 3)
+	#define TI4_WAIT_RESP			(1 << 2)
+	#define TI4_TDMODE			(1 << 1)
+	#define TI4_INTEN			(1 << 0)
+#define ARM_DMA4CHAN_SOURCE_AD(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x14)	// [31:0]
+#define ARM_DMA4CHAN_SOURCE_INFO(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x18)
+	#define SOURCE4_STRIDE_SHIFT		16
+		#define SOURCE4_STRIDE_MAX		0xFFFF
+	#define SOURCE4_IGNORE			(1 << 15)
+	#define SOURCE4_SIZE_SHIFT		13
+		#define SIZE4_128			2
+		#define SIZE4_64			1
+		#define SIZE4_32			0
+	#define SOURCE4_INC			(1 << 12)
+	#define SOURCE4_BURST_LEN_SHIFT		8
+		#define BURST4_DEFAULT			0
+		#define BURST4_MAX			15
+	#define SOURCE4_ADDR_SHIFT		0					// [39:32]
+		#define FULL35_ADDR_OFFSET		4	// for "large address" masters
+#define ARM_DMA4CHAN_DEST_AD(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x1C)	// [31:0]
+#define ARM_DMA4CHAN_DEST_INFO(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x20)
+	#define DEST4_STRIDE_SHIFT		16
+		#define DEST4_STRIDE_MAX		0xFFFF
+	#define DEST4_IGNORE			(1 << 15)
+	#define DEST4_SIZE_SHIFT		13
+	#define DEST4_INC			(1 << 12)
+	#define DEST4_BURST_LEN_SHIFT		8
+	#define DEST4_ADDR_SHIFT		0					// [39:32]
+#define ARM_DMA4CHAN_LEN(chan)		(ARM_DMA_BASE + ((chan) * 0x100) + 0x24)
+	#define LEN4_YLENGTH_SHIFT		16
+		#define LEN4_YLENGTH_MAX		0x3FFF
+	#define LEN4_XLENGTH_SHIFT		0
+		#define LEN4_XLENGTH_MAX		0x3FFFFFFF
+		#define LEN4_XLENGTH_2D_MAX		0xFFFF
+#define ARM_DMA4CHAN_NEXTCONBK(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x28)
+
+#if AARCH == 32
+	#define ADDRESS4_LOW(ptr)	((uintptr) (ptr))
+	#define ADDRESS4_HIGH(ptr)	(0)
+#else
+	#define ADDRESS4_LOW(ptr)	((uintptr) (ptr) & 0xFFFFFFFFUL)
+	#define ADDRESS4_HIGH(ptr)	((((uintptr) (ptr) >> 32) & 0xFF))
+#endif
+
+#endif
+
 #endif
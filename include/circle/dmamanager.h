@@ -0,0 +1,185 @@
+//
+/// \file dmamanager.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_dmamanager_h
+#define _circle_dmamanager_h
+
+#include <circle/dmachannel.h>
+#include <circle/dmachain.h>
+#include <circle/dmacommon.h>
+#include <circle/interrupt.h>
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+#define DMA_MANAGER_CHANNELS		15	///< Number of channel numbers (0-14)
+#define DMA_MANAGER_MAX_CLIENTS		8	///< Max. number of clients of shared channels
+
+enum TDMAChannelClass
+{
+	DMAClassLite,		///< Lite channel (or normal, if no lite channel is free)
+	DMAClassNormal,		///< Normal channel (2D mode, transfers up to 1 GByte)
+	DMAClassExtended,	///< DMA4 "large address" channel on Raspberry Pi 4 and newer\n
+				///< (or normal, if not available)
+	DMAClassUnknown
+};
+
+enum TDMARequestType
+{
+	DMARequestMemCopy,
+	DMARequestIORead,
+	DMARequestIOWrite,
+	DMARequestChain,
+	DMARequestUnknown
+};
+
+struct TDMARequest;
+
+/// \param pRequest Pointer to the completed request
+/// \param pParam User parameter
+/// \note Is called from interrupt context.
+typedef void TDMARequestCompletionRoutine (TDMARequest *pRequest, void *pParam);
+
+struct TDMARequest		/// Transfer request for a shared DMA channel
+{
+	TDMARequestType	 Type;
+	void		*pDestination;		///< for MemCopy and IORead
+	const void	*pSource;		///< for MemCopy and IOWrite
+	u32		 nIOAddress;		///< for IORead and IOWrite
+	size_t		 nLength;		///< must not exceed the limit of the channel
+	TDREQ		 DREQ;			///< for IORead and IOWrite
+	unsigned	 nBurstLength;		///< for MemCopy
+	CDMAChain	*pChain;		///< for Chain (built for GetSharedChannel())
+
+	TDMARequestCompletionRoutine *pCompletionRoutine;	///< (or 0)
+	void		*pCompletionParam;
+
+	// set by CDMAManager
+	volatile boolean bCompleted;
+	volatile boolean bStatus;		///< Has the transfer been successful?
+	TDMARequest	*pNext;
+};
+
+/// \note There are two ways to get DMA:\n
+///	  1. A dedicated channel for a driver, which needs exclusive access (e.g. cyclic
+///	     transfers), is allocated by its capability with AllocateChannel().\n
+///	  2. Clients with short, independent transfers submit requests to the shared
+///	     channel of a class. The requests are queued per client and the clients are
+///	     served round-robin, so that a client with many requests cannot starve others.
+
+/// \note The busy time of shared channels is recorded and can be displayed with Dump().
+
+class CDMAManager	/// Allocates DMA channels by capability and multiplexes requests
+{
+public:
+	/// \param pInterruptSystem Pointer to the interrupt system object (for shared channels)
+	CDMAManager (CInterruptSystem *pInterruptSystem);
+
+	~CDMAManager (void);
+
+	/// \brief Allocate a dedicated channel
+	/// \param Class Requested capability
+	/// \param pOwner Name of the owner (for Dump())
+	/// \return Pointer to the channel object (or 0, if no channel is available)
+	CDMAChannel *AllocateChannel (TDMAChannelClass Class, const char *pOwner);
+
+	/// \param pChannel Channel returned by AllocateChannel()
+	void FreeChannel (CDMAChannel *pChannel);
+
+	/// \return Client ID for Submit()
+	unsigned RegisterClient (void);
+
+	/// \param Class Capability of the shared channel
+	/// \return Shared channel of this class (to be used for building a CDMAChain)
+	/// \note The shared channel is allocated on the first call for a class.
+	CDMAChannel *GetSharedChannel (TDMAChannelClass Class);
+
+	/// \brief Queue a request for the shared channel of a class
+	/// \param nClient Client ID from RegisterClient()
+	/// \param Class Capability of the shared channel
+	/// \param pRequest Request to be executed (must stay valid until completion)
+	/// \return FALSE, if no channel of this class is available, or if a chain\n
+	///	    raises an interrupt before its last step (see CDMAChain::SetInterrupt())
+	/// \note Can be called from interrupt context (e.g. a completion routine).
+	boolean Submit (unsigned nClient, TDMAChannelClass Class, TDMARequest *pRequest);
+
+	/// \brief Wait for the completion of a submitted request
+	/// \param pRequest Submitted request
+	/// \return Has the transfer been successful?
+	boolean Wait (TDMARequest *pRequest);
+
+	/// \brief Write the allocation and utilization of all channels to the logger
+	void Dump (void);
+
+	/// \brief Reset the utilization statistics
+	void ResetStatistics (void);
+
+	/// \return Pointer to the only CDMAManager object in the system (or 0)
+	static CDMAManager *Get (void);
+
+private:
+	CDMAChannel *CreateChannel (TDMAChannelClass Class, const char *pOwner); // spin lock must be held
+
+	void Dispatch (unsigned nClass);		// spin lock must be held
+
+	void CompletionHandler (unsigned nChannel, boolean bStatus);
+	static void CompletionStub (unsigned nChannel, boolean bStatus, void *pParam);
+
+	static const char *GetClassName (TDMAChannelClass Class);
+
+private:
+	CInterruptSystem *m_pInterruptSystem;
+
+	struct TChannelInfo
+	{
+		CDMAChannel		*pChannel;	// 0 if not allocated by the manager
+		TDMAChannelClass	 Class;		// actual class of the channel
+		const char		*pOwner;
+		int			 nSharedClass;	// class of shared channel (or -1)
+
+		unsigned		 nRequests;
+		u64			 ullBytes;
+		u64			 ullBusyTicks;
+		unsigned		 nStartTicks;	// of the active request
+		unsigned		 nMaxQueued;
+	};
+
+	TChannelInfo m_Channel[DMA_MANAGER_CHANNELS];
+
+	struct TSharedChannel
+	{
+		unsigned	 nChannel;		// DMA_CHANNEL_NONE if not allocated
+		TDMARequest	*pActive;
+		TDMARequest	*pHead[DMA_MANAGER_MAX_CLIENTS];
+		TDMARequest	*pTail[DMA_MANAGER_MAX_CLIENTS];
+		unsigned	 nNextClient;		// round-robin
+		unsigned	 nQueued;
+	};
+
+	TSharedChannel m_Shared[DMAClassUnknown];
+
+	unsigned m_nClients;
+
+	unsigned m_nStatisticsStart;
+
+	CSpinLock m_SpinLock;
+
+	static CDMAManager *s_pThis;
+};
+
+#endif
@@ -0,0 +1,59 @@
+//
+// doorbell.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_doorbell_h
+#define _circle_doorbell_h
+
+#include <circle/sysconfig.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+#include <circle/types.h>
+
+class CDoorbell		/// Wakes a core with an IPI, when something has been put into its inbox
+{
+public:
+	/// \param nCore Core, which waits for the doorbell
+	CDoorbell (unsigned nCore);
+
+	~CDoorbell (void);
+
+	/// \brief Ring the doorbell (from any core or interrupt context)
+	/// \note The IPI is sent only, if the doorbell is not already ringing.
+	void Ring (void);
+
+	/// \brief Wait until the doorbell rings and stop ringing (on the target core only)
+	/// \note The core sleeps (WFI) in the meantime.
+	void Wait (void);
+
+	/// \brief Stop ringing without waiting (on the target core only)
+	/// \return Was the doorbell ringing?
+	boolean Check (void);
+
+private:
+	unsigned m_nCore;
+
+	volatile int m_nRinging;
+
+	static boolean s_bIPIConnected;
+};
+
+#endif
+
+#endif
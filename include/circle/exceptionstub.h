@@ -149,6 +149,15 @@ extern TFIQData FIQData;
 
 extern uintptr IRQReturnAddress;		// for profiling
 
+// interrupted context of the last IRQ on each core (for profiling)
+struct TIRQContext
+{
+	uintptr nReturnAddress;
+	uintptr nFramePointer;
+};
+
+extern TIRQContext IRQContext[4];
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,140 @@
+//
+/// \file gpiocapture.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_gpiocapture_h
+#define _circle_gpiocapture_h
+
+#include <circle/dmachannel.h>
+#include <circle/dmachain.h>
+#include <circle/pwmpacer.h>
+#include <circle/types.h>
+
+#define GPIO_CAPTURE_SAMPLES		4096	///< Default size of the ring buffer in samples
+#define GPIO_CAPTURE_BLOCK_SIZE		64	///< Samples per block (granularity of Read())
+
+enum TGPIOCaptureTrigger
+{
+	GPIOCaptureTriggerNone,			///< Start immediately
+	GPIOCaptureTriggerLevel,		///< (Sample & Mask) == Value
+	GPIOCaptureTriggerRisingEdge,		///< One of the masked pins goes high
+	GPIOCaptureTriggerFallingEdge,		///< One of the masked pins goes low
+	GPIOCaptureTriggerAnyEdge,		///< One of the masked pins changes
+	GPIOCaptureTriggerUnknown
+};
+
+/// \note The levels of GPIO0-31 (bank 0, all pins on the header) are sampled at a fixed rate\n
+///	  into a ring buffer by a cyclic DMA chain, which is paced by the PWM device (see\n
+///	  CPWMPacer). The CPU is not involved in sampling. Each sample is a 32-bit word with\n
+///	  bit N representing GPIO N.
+///
+/// \note The ring buffer is organized in blocks. The DMA controller writes a timestamp after\n
+///	  each block, which is used by Read() to find the completed blocks and to detect\n
+///	  overruns, if the application does not read fast enough. The trigger condition is\n
+///	  evaluated in software by Read(), the samples before the trigger are discarded, except\n
+///	  the requested number of pre-trigger samples.
+///
+/// \note For streaming to a file or socket, call Read() periodically and write the returned\n
+///	  samples to the sink. The ring buffer holds nSamples * nSampleMicros microseconds.
+///
+/// \note To capture data lines at higher rates (in the MHz range) for a limited time,\n
+///	  CSMIMaster::ReadDMA() can be used instead.
+
+class CGPIOCapture	/// DMA-paced GPIO sampling into a ring buffer (logic analyzer)
+{
+public:
+	/// \param nSampleMicros Sample period in microseconds
+	/// \param nSamples Size of the ring buffer in samples (multiple of GPIO_CAPTURE_BLOCK_SIZE)
+	CGPIOCapture (unsigned nSampleMicros = 2, unsigned nSamples = GPIO_CAPTURE_SAMPLES);
+
+	~CGPIOCapture (void);
+
+	/// \brief Starts the PWM device and builds the DMA chain
+	/// \return Operation successful?
+	boolean Initialize (void);
+
+	/// \param Trigger Trigger condition
+	/// \param nMask Pins (bit mask), which are tested for the condition
+	/// \param nValue Pin levels to compare with (for GPIOCaptureTriggerLevel only)
+	/// \param nPreTriggerSamples Number of samples returned before the trigger sample\n
+	///	   (max. half the size of the ring buffer)
+	/// \note Must be called before Start().
+	void SetTrigger (TGPIOCaptureTrigger Trigger, u32 nMask = 0, u32 nValue = 0,
+			 unsigned nPreTriggerSamples = 0);
+
+	/// \brief Start sampling
+	void Start (void);
+
+	/// \brief Stop sampling
+	void Stop (void);
+
+	/// \brief Get the captured samples after the trigger
+	/// \param pBuffer Samples will be copied to here
+	/// \param nMaxSamples Size of the buffer in samples
+	/// \return Number of samples returned (0 if nothing available or not triggered yet)
+	/// \note Has to be called often enough (at least once per half ring buffer duration).
+	unsigned Read (u32 *pBuffer, unsigned nMaxSamples);
+
+	/// \return Has the trigger condition been met?
+	boolean IsTriggered (void) const;
+
+	/// \return Number of overruns (lost samples) since Start()
+	unsigned GetOverrunCount (void) const;
+
+	/// \return Sample period in microseconds
+	unsigned GetSampleMicros (void) const;
+
+private:
+	void UpdateAvailable (void);
+	void CheckTrigger (void);
+
+	boolean IsTriggerSample (u32 nSample) const;
+
+private:
+	unsigned m_nSampleMicros;
+	unsigned m_nSamples;
+	unsigned m_nBlocks;
+
+	CPWMPacer m_Pacer;
+
+	CDMAChannel m_DMA;
+	CDMAControlBlockPool m_Pool;
+	CDMAChain m_Chain;
+
+	u32 *m_pRing;			// in DMA-able memory
+	u32 *m_pBlockTime;		// system timer value after each block
+	boolean m_bRunning;
+
+	TGPIOCaptureTrigger m_Trigger;
+	u32 m_nTriggerMask;
+	u32 m_nTriggerValue;
+	unsigned m_nPreTriggerSamples;
+
+	boolean m_bTriggered;
+	u32 m_nPrevSample;
+	boolean m_bPrevValid;
+	unsigned m_nHistory;		// samples, which can be used as pre-trigger samples
+
+	unsigned m_nNextBlock;		// next block, which is checked for completion
+	u32 m_nLastBlockTime;
+	unsigned m_nReadPos;		// index into m_pRing
+	unsigned m_nAvailable;		// completed samples from m_nReadPos on
+	unsigned m_nOverruns;
+};
+
+#endif
@@ -130,6 +130,14 @@ public:
 	/// \return Level of GPIO0-31 in the respective bits
 	static u32 ReadAll (void);
 
+	/// \param nValue Level of GPIO0-53 in the respective bits to be written (masked by nMask)
+	/// \param nMask  Bit mask for the written value (only those GPIOs are affected, for which
+	///		  the respective bit is set in nMask, the others are not touched)
+	/// \note All GPIOs of both banks are cleared first and are set afterwards.
+	static void WriteAll64 (u64 nValue, u64 nMask);
+	/// \return Level of GPIO0-53 in the respective bits
+	static u64 ReadAll64 (void);
+
 private:
 	void SetAlternateFunction (unsigned nFunction);
 
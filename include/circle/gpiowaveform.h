@@ -0,0 +1,132 @@
+//
+/// \file gpiowaveform.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_gpiowaveform_h
+#define _circle_gpiowaveform_h
+
+#include <circle/dmachannel.h>
+#include <circle/dmachain.h>
+#include <circle/interrupt.h>
+#include <circle/pwmpacer.h>
+#include <circle/types.h>
+
+#define GPIO_WAVE_MAX_STEPS	256		///< Default max. number of steps of a waveform
+
+struct TGPIOWaveStep		/// One step of a waveform
+{
+	unsigned	nTime;		///< Time from the start of the waveform in ticks (ascending)
+	u64		nSetMask;	///< GPIO0-53 to be set at this time
+	u64		nClearMask;	///< GPIO0-53 to be cleared at this time (before setting)
+};
+
+struct TGPIOWaveTrace		/// Recorded execution of a step
+{
+	u32	nTimestamp;		///< System timer (CLO) value, when the step was executed
+	u32	nClearMask[2];		///< Written to the simulated GPCLR0/1 (GPIOWaveModeSimulate)
+	u32	nSetMask[2];		///< Written to the simulated GPSET0/1 (GPIOWaveModeSimulate)
+	u32	nReserved[3];
+};
+
+enum TGPIOWaveMode
+{
+	GPIOWaveModeOutput,		///< Write to the GPIO registers
+	GPIOWaveModeTrace,		///< Write to the GPIO registers and record timestamps
+	GPIOWaveModeSimulate,		///< Write to the trace buffer only (GPIOs are not touched)
+	GPIOWaveModeUnknown
+};
+
+/// \note The waveform is played by a chain of DMA control blocks, which write the set and\n
+///	  clear masks of each step to the GPSET/GPCLR registers. The time between two steps\n
+///	  is generated by writing one word per tick to the FIFO of the PWM device, which is\n
+///	  consumed at the tick rate. Therefore the timing does not depend on the CPU.
+
+/// \note The PWM device cannot be used for other purposes (e.g. PWM sound or CPWMOutput)\n
+///	  at the same time. The PWM output pins are not used.
+
+/// \note The pins have to be set to output mode (e.g. with CGPIOPin) before the start.
+
+class CGPIOWaveform	/// DMA-driven GPIO waveform generator with PWM pacing
+{
+public:
+	/// \param nTickMicros Duration of a tick in microseconds (time base of the steps)
+	/// \param pInterruptSystem Pointer to the interrupt system object\n
+	///	   (or 0, if SetCompletionRoutine() is not used)
+	/// \param nMaxSteps Max. number of steps of a waveform
+	CGPIOWaveform (unsigned nTickMicros = 1, CInterruptSystem *pInterruptSystem = 0,
+		       unsigned nMaxSteps = GPIO_WAVE_MAX_STEPS);
+
+	~CGPIOWaveform (void);
+
+	/// \brief Starts the PWM device, which paces the waveform
+	/// \return Operation successful?
+	boolean Initialize (void);
+
+	/// \brief Prepare a waveform for playback
+	/// \param pSteps Pointer to the steps, sorted by time
+	/// \param nSteps Number of steps
+	/// \param nPeriod Period in ticks for repeated playback (0 for single playback)
+	/// \param Mode Output mode
+	/// \return FALSE, if the waveform has too many steps
+	/// \note Must not be called, while a waveform is running.
+	boolean Create (const TGPIOWaveStep *pSteps, unsigned nSteps, unsigned nPeriod = 0,
+			TGPIOWaveMode Mode = GPIOWaveModeOutput);
+
+	/// \param pRoutine Pointer to the routine, which is called after a single playback
+	/// \param pParam User parameter
+	void SetCompletionRoutine (TDMACompletionRoutine *pRoutine, void *pParam);
+
+	/// \brief Start the playback of the waveform
+	void Start (void);
+
+	/// \brief Wait for the completion of a single playback
+	/// \return Operation successful?
+	/// \note This is for synchronous calls without completion routine.
+	boolean Wait (void);
+
+	/// \brief Stop a running (e.g. repeated) playback
+	void Stop (void);
+
+	/// \return Pointer to the trace with one entry per step
+	/// \note Valid after the playback with GPIOWaveModeTrace or GPIOWaveModeSimulate.
+	const TGPIOWaveTrace *GetTrace (void) const;
+
+	/// \return Duration of a tick in microseconds
+	unsigned GetTickMicros (void) const;
+
+private:
+	unsigned m_nTickMicros;
+	unsigned m_nMaxSteps;
+
+	CPWMPacer m_Pacer;
+
+	CDMAChannel m_DMA;
+	CDMAControlBlockPool m_Pool;
+	CDMAChain m_Chain;
+
+	struct TStepData		// same layout as the masks in TGPIOWaveTrace
+	{
+		u32	nClearMask[2];
+		u32	nSetMask[2];
+	};
+
+	TStepData *m_pStepData;		// in DMA-able memory
+	TGPIOWaveTrace *m_pTrace;
+};
+
+#endif
@@ -20,6 +20,7 @@
 #ifndef _circle_i2cmaster_h
 #define _circle_i2cmaster_h
 
+#include <circle/interrupt.h>
 #include <circle/gpiopin.h>
 #include <circle/spinlock.h>
 #include <circle/types.h>
@@ -38,6 +39,12 @@
 /// 4         | GPIO6  GPIO7  | GPIO8  GPIO9  | Raspberry Pi 4 only
 /// 5         | GPIO10 GPIO11 | GPIO12 GPIO13 | Raspberry Pi 4 only
 /// 6         | GPIO22 GPIO23 |               | Raspberry Pi 4 only
+///
+/// \details With an interrupt system the driver is interrupt driven. Transactions\n
+/// are queued then and processed one after the other in the background. A\n
+/// transaction writes and/or reads data. If both is requested, the read follows\n
+/// the write with a repeated start condition. The BSC controllers do not have\n
+/// DREQ lines, so the FIFO is serviced by the interrupt handler, not by DMA.
 
 // returned by Read/Write as negative value
 #define I2C_MASTER_INALID_PARM	1	///< Invalid parameter
@@ -45,15 +52,43 @@
 #define I2C_MASTER_ERROR_CLKT	3	///< Received clock stretch timeout
 #define I2C_MASTER_DATA_LEFT	4	///< Not all data has been sent/received
 
+#define I2C_MASTER_QUEUE_SIZE	32	///< Default number of queued transactions (power of 2)
+
+struct TI2CTransaction;
+
+/// \param pTransaction Pointer to the completed transaction
+/// \param pParam User parameter from the transaction
+/// \note Called from interrupt context
+typedef void TI2CCompletionRoutine (TI2CTransaction *pTransaction, void *pParam);
+
+struct TI2CTransaction		/// Transaction for CI2CMaster::SubmitTransaction()
+{
+	u8			 ucAddress;		///< I2C slave address of target device
+	const void		*pWriteBuffer;		///< Data to be written first
+	unsigned		 nWriteCount;		///< Number of bytes to be written (or 0)
+	void			*pReadBuffer;		///< Read data will be stored here
+	unsigned		 nReadCount;		///< Number of bytes to be read (or 0)
+	TI2CCompletionRoutine	*pCompletionRoutine;	///< Called on completion (or 0)
+	void			*pParam;		///< User parameter for the completion routine
+
+	// set by the driver
+	volatile int		 nResult;		///< Number of bytes read (written) or < 0
+	volatile boolean	 bCompleted;		///< Transaction has been completed?
+};
+
 class CI2CMaster
 {
 public:
 	/// \param nDevice   Device number (see: GPIO pin mapping)
 	/// \param bFastMode Use I2C fast mode (400 KHz) or standard mode (100 KHz) otherwise
 	/// \param nConfig   GPIO mapping configuration (see: GPIO pin mapping)
-	CI2CMaster (unsigned nDevice, boolean bFastMode = FALSE, unsigned nConfig = 0);
+	/// \param pInterruptSystem Pointer to interrupt system object (or 0 for polling driver)
+	/// \param nQueueSize Maximum number of queued transactions (power of 2)
+	CI2CMaster (unsigned nDevice, boolean bFastMode = FALSE, unsigned nConfig = 0,
+		    CInterruptSystem *pInterruptSystem = 0,
+		    unsigned nQueueSize = I2C_MASTER_QUEUE_SIZE);
 
-	~CI2CMaster (void);
+	virtual ~CI2CMaster (void);
 
 	/// \return Initialization successful?
 	boolean Initialize (void);
@@ -74,6 +109,47 @@ public:
 	/// \return Number of written bytes or < 0 on failure
 	int Write (u8 ucAddress, const void *pBuffer, unsigned nCount);
 
+	/// \brief Write data, then read data with a repeated start condition
+	/// \param ucAddress I2C slave address of target device
+	/// \param pWriteBuffer Write data will be taken from here
+	/// \param nWriteCount Number of bytes to be written (max. 16, if nReadCount > 0)
+	/// \param pReadBuffer Read data will be stored here
+	/// \param nReadCount Number of bytes to be read
+	/// \return Number of read bytes or < 0 on failure
+	/// \note With interrupt driver the calling task yields while waiting,\n
+	///	  if the system option NO_BUSY_WAIT is defined.
+	int WriteRead (u8 ucAddress, const void *pWriteBuffer, unsigned nWriteCount,
+		       void *pReadBuffer, unsigned nReadCount);
+
+	/// \brief Queue a transaction for asynchronous processing (interrupt driver only)
+	/// \param pTransaction Pointer to the transaction (must be valid until completion)
+	/// \return FALSE, if the queue is full or the transaction is invalid
+	/// \note If the transaction writes and reads, nWriteCount must be <= 16.
+	/// \note Can be called from interrupt context (e.g. from a completion routine).
+	boolean SubmitTransaction (TI2CTransaction *pTransaction);
+
+protected:
+	/// \brief Read a BSC register (can be overwritten by a simulation)
+	/// \param nOffset Register offset (ARM_BSC_*__OFFSET)
+	virtual u32 ReadReg (unsigned nOffset);
+	/// \brief Write a BSC register (can be overwritten by a simulation)
+	/// \param nOffset Register offset (ARM_BSC_*__OFFSET)
+	/// \param nValue Value to be written
+	virtual void WriteReg (unsigned nOffset, u32 nValue);
+
+	/// \brief Service the controller, called on interrupt
+	void InterruptHandler (void);
+
+private:
+	static boolean IsValid (const TI2CTransaction *pTransaction);
+
+	void StartNextTransaction (void);		// m_SpinLock must be held
+	void StartTransfer (TI2CTransaction *pTransaction);
+	void StartReadPhase (void);
+	boolean ServiceTransfer (int *pResult);		// returns TRUE, if finished
+
+	static void InterruptStub (void *pParam);
+
 private:
 	unsigned m_nDevice;
 	uintptr  m_nBaseAddress;
@@ -86,7 +162,26 @@ private:
 
 	unsigned m_nCoreClockRate;
 
+	CInterruptSystem *m_pInterruptSystem;
+
 	CSpinLock m_SpinLock;
+
+	TI2CTransaction **m_ppQueue;
+	unsigned m_nQueueMask;
+	unsigned m_nQueueIn;
+	unsigned m_nQueueOut;
+
+	// state of the active transfer
+	TI2CTransaction *m_pActive;
+	boolean m_bReadPhase;
+	boolean m_bWriteDataInFIFO;		// write phase of combined transfer may be active
+	const u8 *m_pWritePtr;
+	unsigned m_nWriteLeft;
+	u8 *m_pReadPtr;
+	unsigned m_nReadLeft;
+
+	static unsigned s_nInterruptUseCount;
+	static CI2CMaster *s_pThis[];
 };
 
 #endif
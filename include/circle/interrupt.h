@@ -22,10 +22,25 @@
 
 #include <circle/bcm2835int.h>
 #include <circle/exceptionstub.h>
+#include <circle/device.h>
+#include <circle/sysconfig.h>
 #include <circle/types.h>
 
 typedef void TIRQHandler (void *pParam);
 
+#ifdef IRQ_STATISTICS
+
+struct TIRQStatistics
+{
+	unsigned	nCount;
+	u64		ullCycles;		// total CPU cycles spent in the handler
+	u32		nMaxCycles;
+	u64		ullLatency;		// total CPU cycles from IRQ entry to handler call
+	u32		nMaxLatency;
+};
+
+#endif
+
 class CInterruptSystem
 {
 public:
@@ -48,6 +63,15 @@ public:
 
 	static CInterruptSystem *Get (void);
 
+	/// \brief Generate listing of the connected IRQs (with statistics, if IRQ_STATISTICS is defined)
+	/// \param pTarget Device to be used for output
+	void ListInterrupts (CDevice *pTarget);
+
+#ifdef IRQ_STATISTICS
+	/// \brief Clear the statistics of all IRQs
+	void ResetStatistics (void);
+#endif
+
 	static void InterruptHandler (void);
 
 #if RASPPI >= 4
@@ -55,17 +79,27 @@ public:
 
 	static void SendIPI (unsigned nCore, unsigned nIPI);
 
+	// route a shared peripheral interrupt (SPI) to the given core (default core 0)
+	static void SetIRQTargetCore (unsigned nIRQ, unsigned nCore);
+
 	static void CallSecureMonitor (u32 nFunction, u32 nParam);
 	static void SecureMonitorHandler (u32 nFunction, u32 nParam);
 #endif
 
 private:
-	boolean CallIRQHandler (unsigned nIRQ);
+	boolean CallIRQHandler (unsigned nIRQ, u32 nEntryCycles);
+#ifdef IRQ_STATISTICS
+	void UpdateStatistics (unsigned nIRQ, u32 nEntryCycles, u32 nStartCycles);
+#endif
 
 private:
 	TIRQHandler	*m_apIRQHandler[IRQ_LINES];
 	void		*m_pParam[IRQ_LINES];
 
+#ifdef IRQ_STATISTICS
+	TIRQStatistics	 m_Statistics[IRQ_LINES];
+#endif
+
 	static CInterruptSystem *s_pThis;
 };
 
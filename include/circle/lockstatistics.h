@@ -0,0 +1,90 @@
+//
+// lockstatistics.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_lockstatistics_h
+#define _circle_lockstatistics_h
+
+#include <circle/sysconfig.h>
+
+#if defined (ARM_ALLOW_MULTI_CORE) && defined (LOCK_STATISTICS)
+
+#include <circle/types.h>
+
+class CLockStatistics	/// Records the contention of a named spin lock (with LOCK_STATISTICS only)
+{
+public:
+	/// \param pName Name of the lock (0 to disable the statistics for this lock)
+	CLockStatistics (const char *pName);
+
+	~CLockStatistics (void);
+
+	/// \return Current value of the physical counter (to be handed over to Acquired())
+	static u64 GetTimestamp (void);
+
+	/// \brief Has to be called, after the lock has been acquired
+	/// \param ullWaitStart Timestamp from GetTimestamp() before trying to acquire the lock
+	/// \param bContended Was the lock held by someone else on the first try?
+	/// \param bExclusive Exclusive access? (FALSE for readers, which do not record the hold time)
+	void Acquired (u64 ullWaitStart, boolean bContended, boolean bExclusive = TRUE)
+	{
+		if (m_pName != 0)
+		{
+			Update (ullWaitStart, bContended, bExclusive);
+		}
+	}
+
+	/// \brief Has to be called, before an exclusively acquired lock is released
+	void Released (void)
+	{
+		if (m_pName != 0)
+		{
+			UpdateHoldTime ();
+		}
+	}
+
+	/// \brief Write the statistics of all named locks to the logger
+	static void Dump (void);
+
+	/// \brief Reset the statistics of all named locks
+	static void ResetAll (void);
+
+private:
+	void Update (u64 ullWaitStart, boolean bContended, boolean bExclusive);
+	void UpdateHoldTime (void);
+
+	void Reset (void);
+
+private:
+	const char *m_pName;
+
+	volatile unsigned m_nAcquisitions;
+	volatile unsigned m_nContended;		// lock was held on the first try
+	volatile u64 m_ullSpinTicks;		// counter ticks spent waiting for the lock
+	u64 m_ullHoldStart;			// counter value, when the lock was acquired
+	u64 m_ullMaxHoldTicks;
+
+	CLockStatistics *m_pNext;		// list of all named locks
+	CLockStatistics *m_pPrev;
+
+	static CLockStatistics *s_pFirst;
+};
+
+#endif
+
+#endif
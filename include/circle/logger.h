@@ -43,6 +43,7 @@ enum TLogSeverity
 };
 
 struct TLogEvent;
+class CLogRecordBuffer;
 
 typedef void TLogEventNotificationHandler (void);
 typedef void TLogPanicHandler (void);
@@ -77,6 +78,31 @@ public:
 	/// \brief Does not allocate memory, for critical (low memory) messages
 	void WriteNoAlloc (const char *pSource, TLogSeverity Severity, const char *pMessage);
 
+	/// \brief Enable asynchronous logging
+	/// \param nRecordsPerCore Size of the record ring buffer of each core (power of 2)
+	/// \return Operation successful?
+	/// \note Write() and WriteV() capture the format string and the arguments into a\n
+	///	  per-core ring buffer then, without formatting the message and without\n
+	///	  allocating memory. Flush() has to be called periodically (e.g. by the\n
+	///	  CLogDrainTask) to format the messages and to write them to the target.
+	/// \note Panic messages and messages with a format string, which is not a constant,\n
+	///	  are still written synchronously.
+	boolean EnableAsync (unsigned nRecordsPerCore = 256);
+
+	/// \brief Format and write all asynchronously captured messages
+	/// \return Number of written messages
+	/// \note Returns 0 immediately, if another task is flushing at the moment.
+	unsigned Flush (void);
+
+	/// \brief Limit the number of asynchronous messages per second from each source
+	/// \param nMessagesPerSecond Maximum number (0 for no limit)
+	/// \note Suppressed messages are counted and reported by Flush().
+	void SetRateLimit (unsigned nMessagesPerSecond);
+
+	/// \return Number of asynchronous messages, which have been dropped,\n
+	///	    because the ring buffer was full
+	unsigned GetDropped (void) const;
+
 	/// \brief Read log message text from the log text ring buffer
 	/// \param pBuffer Read text is copied to this buffer
 	/// \param nCount  Size of the buffer
@@ -109,6 +135,13 @@ private:
 
 	void WriteEvent (const char *pSource, TLogSeverity Severity, const char *pMessage);
 
+	void WriteMessage (const char *pSource, TLogSeverity Severity, const char *pMessage,
+			   const char *pTimeString);
+
+	CString *GetTimeString (unsigned nClockTicks);	// of an asynchronous message
+
+	unsigned FlushRecords (void);
+
 private:
 	unsigned m_nLogLevel;
 	CTimer *m_pTimer;
@@ -129,6 +162,9 @@ private:
 	TLogEventNotificationHandler *m_pEventNotificationHandler;
 	TLogPanicHandler *m_pPanicHandler;
 
+	CLogRecordBuffer *m_pRecordBuffer;
+	volatile boolean m_bFlushing;
+
 	static CLogger *s_pThis;
 };
 
@@ -0,0 +1,141 @@
+//
+/// \file logrecordbuffer.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_logrecordbuffer_h
+#define _circle_logrecordbuffer_h
+
+#include <circle/stdarg.h>
+#include <circle/string.h>
+#include <circle/sysconfig.h>
+#include <circle/synchronize.h>
+#include <circle/types.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#include <circle/memorymap.h>
+
+	#define LOG_RECORD_CORES	CORES
+#else
+	#define LOG_RECORD_CORES	1
+#endif
+
+#define LOG_RECORD_MAX_SOURCE	24
+#define LOG_RECORD_MAX_ARGS	8
+#define LOG_RECORD_STRING_SIZE	96		// for the contents of %s arguments
+
+#define LOG_RATE_SOURCES	32		// number of rate limit entries
+
+/// \brief Captures log messages without formatting them and without allocating memory
+/// \details Write() stores the pointer to the format string and the values of the\n
+///	     arguments in a binary ring buffer of the current core. The contents of\n
+///	     %s arguments are copied. Read() formats the captured messages later in\n
+///	     the order of their time stamps. Write() can be called from task level and\n
+///	     IRQ context on all cores concurrently, Read() from one task at a time.
+class CLogRecordBuffer
+{
+public:
+	/// \param nRecordsPerCore Number of records in the ring buffer of each core (power of 2)
+	CLogRecordBuffer (unsigned nRecordsPerCore);
+
+	~CLogRecordBuffer (void);
+
+	/// \param pSource  Module name of the originator of the log message
+	/// \param nSeverity Severity of the log message (TLogSeverity)
+	/// \param pMessage Format string of the log message
+	/// \param Args	    Arguments of the log message (not modified)
+	/// \return Message handled? (FALSE, if it has to be written synchronously)
+	/// \note Messages are handled (but dropped), if the ring buffer is full\n
+	///	  or the rate limit of the source is exceeded.
+	/// \note The message has to be written synchronously, if the format string is not\n
+	///	  a constant (in .rodata) or has more than LOG_RECORD_MAX_ARGS arguments.
+	boolean Write (const char *pSource, unsigned nSeverity, const char *pMessage, va_list Args);
+
+	/// \brief Format the oldest captured message
+	/// \param pSource Module name is returned here
+	/// \param pSeverity Severity (TLogSeverity) is returned here
+	/// \param pMessage Formatted message is returned here
+	/// \param pClockTicks Value of CTimer::GetClockTicks() at Write() is returned here
+	/// \return FALSE if no message is available
+	boolean Read (CString *pSource, unsigned *pSeverity, CString *pMessage,
+		      unsigned *pClockTicks);
+
+	/// \brief Limit the number of messages per second from one source
+	/// \param nMessagesPerSecond Maximum number (0 for no limit)
+	/// \note Sources are distinguished by a hash of their name.
+	void SetRateLimit (unsigned nMessagesPerSecond);
+
+	/// \brief Get the number of messages of a source, which have been suppressed by the\n
+	///	   rate limit since the last call, and reset it
+	/// \param nIndex Index of the rate limit entry (0..LOG_RATE_SOURCES-1)
+	/// \param pSource Module name is returned here
+	/// \return Number of suppressed messages
+	unsigned GetSuppressed (unsigned nIndex, CString *pSource);
+
+	/// \return Number of messages, which have been dropped, because a ring buffer was full
+	unsigned GetDropped (void) const	{ return m_nDropped; }
+
+private:
+	boolean IsRateLimited (const char *pSource);
+
+	struct TLogRecord;
+	static void FormatRecord (const TLogRecord *pRecord, CString *pResult);
+
+	struct TFormatSpec;
+	static const char *ParseFormatSpec (const char *pFormat, TFormatSpec *pSpec);
+
+private:
+	struct TLogRecord
+	{
+		volatile u32	nSequence;		// index+1, when the record is complete
+		u8		nSeverity;
+		u8		nArgs;
+		u16		nStringLength;		// used bytes in Strings[]
+		unsigned	nClockTicks;
+		const char     *pMessage;		// format string in .rodata
+		char		Source[LOG_RECORD_MAX_SOURCE];
+		u64		Arg[LOG_RECORD_MAX_ARGS];	// offset into Strings[] for %s
+		char		Strings[LOG_RECORD_STRING_SIZE];
+	};
+
+	struct TRing
+	{
+		TLogRecord	 *pRecord;
+		volatile unsigned nIn;
+		volatile unsigned nOut;
+	}
+	CACHE_ALIGN;
+
+	unsigned m_nRecordsPerCore;
+	TRing m_Ring[LOG_RECORD_CORES];
+
+	volatile unsigned m_nDropped;
+
+	struct TRateEntry
+	{
+		volatile u32	  nHash;		// of the source name (0 for unused)
+		volatile unsigned nSecond;		// current rate window
+		volatile unsigned nCount;		// messages in current window
+		volatile unsigned nSuppressed;
+		char		  Source[LOG_RECORD_MAX_SOURCE];
+	};
+
+	unsigned m_nRateLimit;
+	TRateEntry m_RateEntry[LOG_RATE_SOURCES];
+};
+
+#endif
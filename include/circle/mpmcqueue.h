@@ -0,0 +1,56 @@
+//
+// mpmcqueue.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_mpmcqueue_h
+#define _circle_mpmcqueue_h
+
+#include <circle/synchronize.h>
+#include <circle/types.h>
+
+struct TMPMCQueueCell;
+
+class CMPMCQueue	/// Lock-free bounded queue of pointers for multiple producers and consumers
+{
+public:
+	/// \param nSize Number of entries (must be a power of 2)
+	CMPMCQueue (unsigned nSize);
+
+	~CMPMCQueue (void);
+
+	/// \brief Append a pointer to the queue
+	/// \param pPtr Any pointer
+	/// \return Operation successful? (FALSE if queue is full)
+	/// \note Can be called from any core and from interrupt context.
+	boolean Enqueue (void *pPtr);
+
+	/// \brief Remove the first pointer from the queue
+	/// \param ppPtr The pointer will be returned here
+	/// \return Operation successful? (FALSE if queue is empty)
+	/// \note Can be called from any core and from interrupt context.
+	boolean Dequeue (void **ppPtr);
+
+private:
+	unsigned m_nMask;
+	TMPMCQueueCell *m_pCell;
+
+	volatile unsigned m_nEnqueuePos CACHE_ALIGN;
+	volatile unsigned m_nDequeuePos CACHE_ALIGN;
+};
+
+#endif
@@ -29,6 +29,12 @@
 
 // inter-processor interrupt (IPI)
 #define IPI_HALT_CORE		0		// halt target core
+#define IPI_SOUND_OUT		1		// sound DMA output chunk completed
+#define IPI_SOUND_IN		2		// sound DMA input chunk completed
+#define IPI_SCHEDULER		3		// wake idle core, task has been queued
+#define IPI_DOORBELL		4		// wake core, CDoorbell has been rung
+#define IPI_PROFILE		5		// take a sample of the sampling profiler
+#define IPI_TIMER		6		// set timer compare register on core 0
 #define IPI_USER		10		// first user defineable IPI
 #if RASPPI <= 3
 #define IPI_MAX			31
@@ -36,6 +42,8 @@
 #define IPI_MAX			15
 #endif
 
+typedef void TIPIHandler (unsigned nIPI, void *pParam);
+
 class CMultiCoreSupport
 {
 public:
@@ -52,6 +60,10 @@ public:
 	static void SendIPI (unsigned nCore, unsigned nIPI);		// send IPI to core
 	static void HaltAll (void);					// halt all cores
 
+	// connect handler for system IPI (< IPI_USER), called instead of IPIHandler()
+	static void ConnectIPI (unsigned nIPI, TIPIHandler *pHandler, void *pParam);
+	static void DisconnectIPI (unsigned nIPI);
+
 #if RASPPI <= 3
 	static boolean LocalInterruptHandler (void);	// returns TRUE if local interrupt was handled
 #else
@@ -73,10 +85,16 @@ public:
 
 	static void EntrySecondary (void);
 
+private:
+	static boolean CallIPIHandler (unsigned nIPI);
+
 private:
 	CMemorySystem *m_pMemorySystem;
 
 	static CMultiCoreSupport *s_pThis;
+
+	static TIPIHandler *s_apIPIHandler[IPI_USER];
+	static void *s_pIPIParam[IPI_USER];
 };
 
 #endif
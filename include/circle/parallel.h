@@ -0,0 +1,193 @@
+//
+/// \file parallel.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_parallel_h
+#define _circle_parallel_h
+
+#include <circle/sysconfig.h>
+#include <circle/multicore.h>
+#include <circle/memory.h>
+#include <circle/types.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#include <circle/memorymap.h>
+
+	#define PARALLEL_CORES		CORES
+#else
+	#define PARALLEL_CORES		1
+#endif
+
+/// \param nBegin First index of the range to be processed
+/// \param nEnd Index after the last index of the range
+/// \param pParam User parameter handed over to CParallel::For()
+typedef void TParallelForFunction (unsigned nBegin, unsigned nEnd, void *pParam);
+
+/// \param nBegin First index of the range to be processed
+/// \param nEnd Index after the last index of the range
+/// \param pParam User parameter handed over to CParallel::Reduce()
+/// \return Partial result for this range
+typedef u64 TParallelReduceFunction (unsigned nBegin, unsigned nEnd, void *pParam);
+
+/// \param ullResult1 Partial result
+/// \param ullResult2 Another partial result
+/// \return Combined result (e.g. sum or maximum, the order is not defined)
+typedef u64 TParallelCombineFunction (u64 ullResult1, u64 ullResult2);
+
+/// \param pParam User parameter handed over to CParallelTaskGraph::AddTask()
+typedef void TParallelTaskFunction (void *pParam);
+
+#define PARALLEL_GRAPH_MAX_TASKS	64
+
+class CParallelTaskGraph	/// Set of functions with dependencies, executed by CParallel::Execute()
+{
+public:
+	CParallelTaskGraph (void);
+	~CParallelTaskGraph (void);
+
+	/// \param pFunction Function to be called
+	/// \param pParam User parameter to be handed over to the function
+	/// \return Task number (0..PARALLEL_GRAPH_MAX_TASKS-1)
+	unsigned AddTask (TParallelTaskFunction *pFunction, void *pParam = 0);
+
+	/// \brief Let a task start after another task has been completed
+	/// \param nTask Task, which has to wait
+	/// \param nPredecessor Task, which has to be completed before
+	void AddDependency (unsigned nTask, unsigned nPredecessor);
+
+private:
+	void Prepare (void);
+	void Work (void);		// called on each core involved
+
+	friend class CParallel;
+
+private:
+	unsigned m_nTasks;
+	TParallelTaskFunction *m_pFunction[PARALLEL_GRAPH_MAX_TASKS];
+	void *m_pParam[PARALLEL_GRAPH_MAX_TASKS];
+	u64 m_ullPredecessors[PARALLEL_GRAPH_MAX_TASKS];	// bit mask of tasks
+
+	volatile u64 m_ullClaimed;		// tasks, which have been started
+	volatile u64 m_ullCompleted;		// tasks, which have been completed
+};
+
+/// \note The secondary cores wait with WFE for work and are woken by SEV.\n
+///	  The functions of CParallel must be called on core 0 only and cannot be nested.\n
+///	  Without ARM_ALLOW_MULTI_CORE everything is executed on core 0.\n
+///	  CParallel uses the secondary cores exclusively, it cannot be used together\n
+///	  with another CMultiCoreSupport or with CScheduler::EnterSecondaryCore().
+
+class CParallel		/// Fork-join runtime, which distributes work to all cores
+#ifdef ARM_ALLOW_MULTI_CORE
+	: public CMultiCoreSupport
+#endif
+{
+public:
+	CParallel (CMemorySystem *pMemorySystem);
+	~CParallel (void);
+
+#ifndef ARM_ALLOW_MULTI_CORE
+	boolean Initialize (void)	{ return TRUE; }
+#endif
+
+	/// \brief Restrict the number of cores used (e.g. for speedup measurement)
+	/// \param nCores Number of cores (1..PARALLEL_CORES, default PARALLEL_CORES)
+	void SetCores (unsigned nCores);
+	/// \return Number of cores used
+	unsigned GetCores (void) const		{ return m_nCores; }
+
+	/// \brief Call a function for all sub-ranges of a range in parallel and wait for completion
+	/// \param nBegin First index of the range
+	/// \param nEnd Index after the last index of the range
+	/// \param pFunction Function to be called for each sub-range
+	/// \param pParam User parameter to be handed over to the function
+	/// \param nGrain Number of indices in a sub-range (0 for automatic selection)
+	/// \note The sub-ranges are taken dynamically by the cores, so that load imbalances\n
+	///	  are compensated, if the range is split into enough sub-ranges.
+	void For (unsigned nBegin, unsigned nEnd,
+		  TParallelForFunction *pFunction, void *pParam = 0, unsigned nGrain = 0);
+
+	/// \brief Calculate partial results for all sub-ranges of a range in parallel and combine them
+	/// \param nBegin First index of the range
+	/// \param nEnd Index after the last index of the range
+	/// \param pFunction Function to be called for each sub-range
+	/// \param pParam User parameter to be handed over to the function
+	/// \param ullIdentity Result for an empty range (e.g. 0 for a sum)
+	/// \param pCombine Function to combine two results (0 to add them)
+	/// \param nGrain Number of indices in a sub-range (0 for automatic selection)
+	/// \return Combined result
+	u64 Reduce (unsigned nBegin, unsigned nEnd,
+		    TParallelReduceFunction *pFunction, void *pParam = 0,
+		    u64 ullIdentity = 0, TParallelCombineFunction *pCombine = 0,
+		    unsigned nGrain = 0);
+
+	/// \brief Execute all tasks of a task graph in the order of their dependencies
+	/// \param pGraph Task graph (can be executed multiple times)
+	void Execute (CParallelTaskGraph *pGraph);
+
+	/// \return Pointer to the only CParallel object in the system
+	static CParallel *Get (void);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	void Run (unsigned nCore);	// do not call this
+#endif
+
+private:
+	enum TJob
+	{
+		JobFor,
+		JobReduce,
+		JobGraph,
+		JobUnknown
+	};
+
+	void StartJob (TJob Job);
+	void WorkOnJob (unsigned nCore);
+	void WaitForJob (void);
+
+	void WorkOnFor (void);
+	u64 WorkOnReduce (void);
+
+	unsigned GetGrain (unsigned nBegin, unsigned nEnd, unsigned nGrain) const;
+
+	static u64 Add (u64 ullResult1, u64 ullResult2);
+
+private:
+	unsigned m_nCores;
+
+	// current job
+	TJob m_Job;
+	volatile unsigned m_nNext;			// next index to be taken
+	unsigned m_nEnd;
+	unsigned m_nGrain;
+	TParallelForFunction *m_pForFunction;
+	TParallelReduceFunction *m_pReduceFunction;
+	TParallelCombineFunction *m_pCombineFunction;
+	void *m_pParam;
+	u64 m_ullIdentity;
+	CParallelTaskGraph *m_pGraph;
+
+	u64 m_ullResult[PARALLEL_CORES];		// partial result of each core
+
+	volatile unsigned m_nJobSequence;		// incremented for each new job
+	volatile unsigned m_nCoresDone;			// secondary cores, which completed the job
+
+	static CParallel *s_pThis;
+};
+
+#endif
@@ -0,0 +1,65 @@
+//
+/// \file pwmpacer.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_pwmpacer_h
+#define _circle_pwmpacer_h
+
+#include <circle/dmachain.h>
+#include <circle/gpioclock.h>
+#include <circle/types.h>
+
+/// \note A delay in a DMA chain is generated by writing one word per tick to the FIFO of the\n
+///	  PWM device, which is consumed at the tick rate (DREQ pacing). The PWM output pins\n
+///	  are not used, but the PWM device cannot be used for other purposes (e.g. PWM sound\n
+///	  or CPWMOutput) at the same time.
+
+class CPWMPacer		/// Paces DMA chains using the PWM FIFO
+{
+public:
+	/// \param nTickMicros Duration of a tick in microseconds
+	CPWMPacer (unsigned nTickMicros);
+
+	~CPWMPacer (void);
+
+	/// \brief Starts the PWM device
+	/// \return Operation successful?
+	boolean Initialize (void);
+
+	/// \brief Append a delay to a DMA chain
+	/// \param pChain Pointer to the chain
+	/// \param nTicks Duration of the delay in ticks
+	/// \return FALSE, if the pool of the chain is exhausted
+	boolean AddDelay (CDMAChain *pChain, unsigned nTicks);
+
+	/// \brief Bring the PWM FIFO into the same state before each start of a chain
+	void Prime (void);
+
+	/// \return Duration of a tick in microseconds
+	unsigned GetTickMicros (void) const;
+
+private:
+	unsigned m_nTickMicros;
+
+	CGPIOClock m_Clock;
+	boolean m_bRunning;
+
+	u32 *m_pFillWord;		// written to the PWM FIFO (in DMA-able memory)
+};
+
+#endif
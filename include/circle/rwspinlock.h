@@ -0,0 +1,95 @@
+//
+// rwspinlock.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_rwspinlock_h
+#define _circle_rwspinlock_h
+
+#include <circle/sysconfig.h>
+#include <circle/synchronize.h>
+#include <circle/lockstatistics.h>
+#include <circle/types.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+class CRWSpinLock	/// Spin lock, which can be held by multiple readers or a single writer
+{
+public:
+	/// \param nTargetLevel Maximum execution level, from which the lock is used
+	/// \param pName Name of the lock in the lock statistics (with LOCK_STATISTICS only)
+	/// \note A waiting writer blocks new readers, so that it cannot be starved by them.
+	CRWSpinLock (unsigned nTargetLevel = IRQ_LEVEL, const char *pName = 0);
+	~CRWSpinLock (void);
+
+	/// \brief Acquire the lock for shared (read) access
+	void AcquireRead (void);
+	void ReleaseRead (void);
+
+	/// \brief Acquire the lock for exclusive (write) access
+	void AcquireWrite (void);
+	void ReleaseWrite (void);
+
+private:
+	unsigned m_nTargetLevel;
+
+	volatile u32 m_nState;
+#define RWSPINLOCK_WRITER	(1U << 31)	// held by a writer
+#define RWSPINLOCK_WAITING	(1U << 30)	// a writer is waiting
+#define RWSPINLOCK_READERS	0x3FFFFFFFU	// number of readers holding the lock
+
+#ifdef LOCK_STATISTICS
+	CLockStatistics m_Statistics;
+#endif
+};
+
+#else
+
+class CRWSpinLock
+{
+public:
+	CRWSpinLock (unsigned nTargetLevel = IRQ_LEVEL, const char *pName = 0)
+	:	m_nTargetLevel (nTargetLevel)
+	{
+	}
+
+	void AcquireRead (void)		{ AcquireWrite (); }
+	void ReleaseRead (void)		{ ReleaseWrite (); }
+
+	void AcquireWrite (void)
+	{
+		if (m_nTargetLevel >= IRQ_LEVEL)
+		{
+			EnterCritical (m_nTargetLevel);
+		}
+	}
+
+	void ReleaseWrite (void)
+	{
+		if (m_nTargetLevel >= IRQ_LEVEL)
+		{
+			LeaveCritical ();
+		}
+	}
+
+private:
+	unsigned m_nTargetLevel;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,75 @@
+//
+/// \file irqthread.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_irqthread_h
+#define _circle_sched_irqthread_h
+
+#include <circle/sched/task.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/types.h>
+
+/// \param pParam User parameter handed over to CIRQThread::CIRQThread()
+typedef void TIRQThreadHandler (void *pParam);
+
+/// \brief Threaded interrupt handler
+/// \details An IRQ handler acknowledges the device and calls Wake(). The thread handler\n
+///	     runs as a task afterwards and may block (e.g. on a CMutex). Multiple\n
+///	     calls to Wake() before the thread handler runs, result in one call only,\n
+///	     so that the thread handler has to process all work, which is pending.
+class CIRQThread : public CTask
+{
+public:
+	/// \param pHandler Thread handler to be called after Wake()
+	/// \param pParam User parameter handed over to the handler
+	/// \param nPriority Task priority (see CTask::SetTaskPriority())
+	/// \param pName Name of the task
+	/// \note The task priority takes effect with a scheduler, which evaluates it.
+	CIRQThread (TIRQThreadHandler *pHandler, void *pParam, int nPriority,
+		    const char *pName = "irqthread");
+
+	~CIRQThread (void);
+
+	/// \brief Let the thread handler run
+	/// \note Can be called from interrupt context (IRQ or CSoftIRQ handler).
+	void Wake (void);
+
+	/// \brief Terminate the thread and wait for it
+	/// \note Callable from other task only
+	/// \note The object is deleted by the scheduler after termination.
+	void Stop (void);
+
+	/// \return Number of calls to Wake() since start
+	unsigned GetWakeups (void) const	{ return m_nWakeups; }
+	/// \return Number of calls of the thread handler since start
+	unsigned GetRuns (void) const		{ return m_nRuns; }
+
+	void Run (void);
+
+private:
+	TIRQThreadHandler *m_pHandler;
+	void		  *m_pParam;
+
+	volatile boolean m_bStop;
+	CSynchronizationEvent m_Event;
+
+	volatile unsigned m_nWakeups;
+	volatile unsigned m_nRuns;
+};
+
+#endif
@@ -0,0 +1,54 @@
+//
+/// \file logdraintask.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_logdraintask_h
+#define _circle_sched_logdraintask_h
+
+#include <circle/sched/task.h>
+#include <circle/logger.h>
+#include <circle/types.h>
+
+/// \brief Task, which periodically writes the messages of the asynchronous logger
+/// \note The logger has to be switched to asynchronous mode with CLogger::EnableAsync().
+class CLogDrainTask : public CTask
+{
+public:
+	/// \param pLogger Pointer to the logger
+	/// \param nIntervalMs Sleep time between two calls of CLogger::Flush()
+	/// \param nPriority Task priority (see CTask::SetTaskPriority())
+	/// \note The task priority takes effect with a scheduler, which evaluates it.
+	CLogDrainTask (CLogger *pLogger, unsigned nIntervalMs = 20, int nPriority = 0);
+
+	~CLogDrainTask (void);
+
+	/// \brief Write the remaining messages, terminate the task and wait for it
+	/// \note Callable from other task only
+	/// \note The object is deleted by the scheduler after termination.
+	void Stop (void);
+
+	void Run (void);
+
+private:
+	CLogger *m_pLogger;
+	unsigned m_nIntervalMs;
+
+	volatile boolean m_bStop;
+};
+
+#endif
@@ -25,6 +25,7 @@
 
 #include <circle/types.h>
 #include <circle/sched/synchronizationevent.h>
+#include <circle/spinlock.h>
 
 class CTask;
 
@@ -44,7 +45,8 @@ public:
 private:
 	CTask* m_pOwningTask;
 	int m_iReentrancyCount;
-	CSynchronizationEvent m_event;
+	CSynchronizationEvent m_event;		// set, while the mutex is free
+	CSpinLock m_SpinLock;
 };
 
 #endif
@@ -23,12 +23,27 @@
 #include <circle/sched/task.h>
 #include <circle/spinlock.h>
 #include <circle/device.h>
+#include <circle/timer.h>
 #include <circle/sysconfig.h>
 #include <circle/types.h>
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	#include <circle/memorymap.h>
+
+	#define SCHEDULER_CORES		CORES
+#else
+	#define SCHEDULER_CORES		1
+#endif
+
 typedef void TSchedulerTaskHandler (CTask *pTask);
 
 /// \note This scheduler uses the round-robin policy, without priorities.
+/// \note With ARM_ALLOW_MULTI_CORE the secondary cores can run tasks too, after they\n
+///	  called EnterSecondaryCore(). Each core has its own queue of ready tasks. A core\n
+///	  without a ready task takes one from the queue of another core. An idle\n
+///	  secondary core waits for an IPI, which is sent, when a task is queued for it.\n
+///	  A new task is queued immediately, so it may start on another core, before the\n
+///	  constructor of a derived class has completed (see CTask).
 
 class CScheduler /// Cooperative non-preemtive scheduler, which controls which task runs at a time
 {
@@ -47,7 +62,7 @@ public:
 	/// \param nMicroSeconds Number of microseconds, the current task will be sleep
 	void usSleep (unsigned nMicroSeconds);
 
-	/// \return Pointer to the CTask object of the currently running task
+	/// \return Pointer to the CTask object of the currently running task (on this core)
 	CTask *GetCurrentTask (void);
 
 	/// \param pTaskName Task name to look for
@@ -78,6 +93,13 @@ public:
 	/// \param pTarget Device to be used for output
 	void ListTasks (CDevice *pTarget);
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	/// \brief Let a secondary core run tasks, does not return
+	/// \note Call this from CMultiCoreSupport::Run() on the cores 1..CORES-1.
+	/// \note The calling context becomes the idle task of the core.
+	void EnterSecondaryCore (void);
+#endif
+
 	/// \return Pointer to the only scheduler object in the system
 	static CScheduler *Get (void);
 
@@ -90,21 +112,65 @@ public:
 
 private:
 	void AddTask (CTask *pTask);
+	void StartTask (CTask *pTask);
+#ifdef ARM_ALLOW_MULTI_CORE
+	void FinishTaskSwitch (void);
+#endif
+	void WaitForTermination (CTask *pTask);
 	friend class CTask;
 
-	boolean BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds);
+	// pbEventState is checked with the lock held, the task does not block, if it is set
+	boolean BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds,
+			   const volatile boolean *pbEventState);
 	void WakeTasks (CTask **ppWaitListHead); // can be called from interrupt context
 	friend class CSynchronizationEvent;
 
 	void RemoveTask (CTask *pTask);
+
+#ifndef ARM_ALLOW_MULTI_CORE
 	unsigned GetNextTask (void); // returns index into m_pTask or MAX_TASKS if no task was found
+#else
+	// the following methods must be called with m_SpinLock acquired
+	CTask *GetNextTask (unsigned nCore);	// returns 0 if no task was found
+	boolean CanContinue (CTask *pTask, unsigned nCore);
+	void Enqueue (CTask *pTask);
+	unsigned SelectCore (CTask *pTask);
+	void WakeCore (unsigned nCore);
+	void WakeSleepingTasks (void);
+	void RemoveSleepingTask (CTask *pTask);
+
+	void StartWakeTimer (void);
+	static void WakeTimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
+
+	static void IPIHandler (unsigned nIPI, void *pParam);
+#endif
 
 private:
 	CTask *m_pTask[MAX_TASKS];
 	unsigned m_nTasks;
 
+#ifndef ARM_ALLOW_MULTI_CORE
 	CTask *m_pCurrent;
 	unsigned m_nCurrent;	// index into m_pTask
+#else
+	struct TCoreData
+	{
+		CTask *pCurrent;		// running task
+		CTask *pPrevious;		// task, which has been switched out
+		CTask *pIdleTask;		// boot context of a secondary core
+		CTask *pRunQueueHead;		// ready tasks
+		CTask *pRunQueueTail;
+		volatile boolean bIdle;		// waiting for an IPI
+	};
+	TCoreData m_Core[SCHEDULER_CORES];
+
+	unsigned m_nActiveCores;		// bit mask of cores, which run tasks
+
+	CTask *m_pSleepList;			// sleeping tasks and tasks blocked with timeout
+
+	TKernelTimerHandle m_hWakeTimer;	// wakes sleeping tasks, if secondary cores are active
+	unsigned m_nWakeTimerTicks;
+#endif
 
 	TSchedulerTaskHandler *m_pTaskSwitchHandler;
 	TSchedulerTaskHandler *m_pTaskTerminationHandler;
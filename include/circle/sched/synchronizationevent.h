@@ -55,10 +55,8 @@ public:
 	boolean WaitWithTimeout (unsigned nMicroSeconds);
 
 private:
-	void Pulse (void);	// wakes all waiting tasks without actually setting the event
-	friend class CMutex;
+	friend class CScheduler;
 
-private:
 	volatile boolean m_bState;
 	CTask	*m_pWaitListHead;	// Linked list of waiting tasks
 };
@@ -2,7 +2,7 @@
 /// task.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2021  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2024  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -44,6 +44,9 @@ class CTask	/// Overload this class, define the Run() method, and call new on it
 public:
 	/// \param nStackSize Stack size for this task (0 used internally for the main task)
 	/// \param bCreateSuspended Set to TRUE, if the task is initially not ready to run
+	/// \note With ARM_ALLOW_MULTI_CORE a task may start on another core, as soon as\n
+	///	  this constructor returns. A derived class, which initializes members in its\n
+	///	  constructor, should set bCreateSuspended and call Start() at its end then.
 	CTask (unsigned nStackSize = TASK_STACK_SIZE, boolean bCreateSuspended = FALSE);
 
 	virtual ~CTask (void);
@@ -61,6 +64,14 @@ public:
 	/// \return Is task suspended from running?
 	boolean IsSuspended (void) const	{ return m_bSuspended; }
 
+	/// \brief Set the CPU cores, on which this task is allowed to run
+	/// \param nCoreMask Bit mask of allowed cores (bit 0: core 0, default: all cores)
+	/// \note Takes effect, when the task is switched out the next time.
+	/// \note Without ARM_ALLOW_MULTI_CORE all tasks run on core 0.
+	void SetAffinity (unsigned nCoreMask);
+	/// \return Bit mask of cores, on which this task is allowed to run
+	unsigned GetAffinity (void) const	{ return m_nAffinity; }
+
 	/// \brief Terminate the execution of this task
 	/// \note Callable from this task only
 	/// \note The task terminates on return from Run() too.
@@ -121,6 +132,12 @@ private:
 	CSynchronizationEvent m_Event;
 	CTask		   *m_pWaitListNext;	// next in list of tasks waiting on an event
 
+	// managed by the scheduler
+	unsigned	    m_nAffinity;	// bit mask of allowed cores
+	unsigned	    m_nCore;		// core, on which the task runs or ran last
+	volatile boolean    m_bOnCore;		// task is running or is being switched
+	CTask		   *m_pQueueNext;	// next in run queue or sleep list
+
 	int priority;
 };
 
@@ -44,6 +44,12 @@
 /// GPIO32/33 and GPIO36/37 can be selected with system option SERIAL_GPIO_SELECT.\n
 /// GPIO0/1 are normally reserved for ID EEPROM.\n
 /// Handshake lines CTS and RTS are not supported.
+///
+/// \details With bUseDMA the data is transferred between the FIFOs and the buffers\n
+/// by two DMA channels. The buffers hold one 32-bit word per character then,\n
+/// because the DMA controller accesses the data register in words. Received\n
+/// characters, which are left in the RX FIFO, are taken over on the receive\n
+/// timeout interrupt (idle line).
 
 #if RASPPI < 4
 	#define SERIAL_DEVICES		1
@@ -51,8 +57,7 @@
 	#define SERIAL_DEVICES		6
 #endif
 
-#define SERIAL_BUF_SIZE		2048			// must be a power of 2
-#define SERIAL_BUF_MASK		(SERIAL_BUF_SIZE-1)
+#define SERIAL_BUF_SIZE		2048			// default, must be a power of 2
 
 // serial options
 #define SERIAL_OPTION_ONLCR	(1 << 0)	///< Translate NL to NL+CR on output (default)
@@ -63,6 +68,8 @@
 #define SERIAL_ERROR_FRAMING	3
 #define SERIAL_ERROR_PARITY	4
 
+class CDMAChannel;
+
 class CSerialDevice : public CDevice
 {
 public:
@@ -79,8 +86,11 @@ public:
 	/// \param pInterruptSystem Pointer to interrupt system object (or 0 for polling driver)
 	/// \param bUseFIQ Use FIQ instead of IRQ
 	/// \param nDevice Device number (see: GPIO pin mapping)
+	/// \param nBufferSize Size of the RX and TX buffers in characters (power of 2)
+	/// \param bUseDMA Transfer data using DMA (with IRQ and device 0 only)
 	CSerialDevice (CInterruptSystem *pInterruptSystem = 0, boolean bUseFIQ = FALSE,
-		       unsigned nDevice = 0);
+		       unsigned nDevice = 0, unsigned nBufferSize = SERIAL_BUF_SIZE,
+		       boolean bUseDMA = FALSE);
 
 	~CSerialDevice (void);
 #endif
@@ -140,9 +150,21 @@ protected:
 private:
 	boolean Write (u8 uchChar);
 
+	int WriteDMA (const u8 *pBuffer, size_t nCount);
+
+	void StartTxDMA (void);				// m_SpinLock must be held
+	void StartRxDMA (void);				// m_SpinLock must be held
+	boolean UpdateRxDMA (void);			// m_SpinLock must be held
+	boolean ReceiveDMA (unsigned nCount);		// m_SpinLock must be held
+	boolean ScanMagic (char chChar);
+	static int GetRxStatus (u32 nDR);
+
 	void InterruptHandler (void);
 	static void InterruptStub (void *pParam);
 
+	static void TxDMACompletionRoutine (unsigned nChannel, boolean bStatus, void *pParam);
+	static void RxDMACompletionRoutine (unsigned nChannel, boolean bStatus, void *pParam);
+
 private:
 	CInterruptSystem *m_pInterruptSystem;
 	boolean m_bUseFIQ;
@@ -157,15 +179,28 @@ private:
 	CGPIOPin m_TxDPin;
 	CGPIOPin m_RxDPin;
 
-	u8 m_RxBuffer[SERIAL_BUF_SIZE];
+	unsigned m_nBufferSize;
+	unsigned m_nBufferMask;
+
+	u8 *m_pRxBuffer;
 	volatile unsigned m_nRxInPtr;
 	volatile unsigned m_nRxOutPtr;
 	volatile int m_nRxStatus;
 
-	u8 m_TxBuffer[SERIAL_BUF_SIZE];
+	u8 *m_pTxBuffer;
 	volatile unsigned m_nTxInPtr;
 	volatile unsigned m_nTxOutPtr;
 
+	boolean m_bUseDMA;
+	CDMAChannel *m_pTxDMA;
+	CDMAChannel *m_pRxDMA;
+	u32 *m_pTxDMABuffer;				// one word per character
+	u32 *m_pRxDMABuffer;				// one word per character (with status)
+	volatile unsigned m_nTxDMALength;		// characters (0 if TX DMA is idle)
+	volatile unsigned m_nRxDMAStart;		// buffer index of active RX DMA
+	volatile unsigned m_nRxDMALength;		// characters (0 if RX DMA is stopped)
+	volatile unsigned m_nRxDMAReceived;		// characters taken over from active RX DMA
+
 	unsigned m_nOptions;
 
 	const char *m_pMagic;
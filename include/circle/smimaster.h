@@ -48,13 +48,14 @@ enum TSMIDataWidth
 /// - Drives any combination of SMI Data lines (GPIO8 to GPIO25)
 /// - May also drive SMI Address lines (GPIO0 to GPIO5)
 /// - Does not use SOE/SWE on GPIO6/GPIO7
-/// - Read/Write operation in Direct mode or Write in DMA mode
+/// - Read/Write operation in Direct mode or DMA mode
 ///
 /// \details Operations
 /// One must first call SetupTiming() with suitable timing information.
 /// The Device bank to use and the address to assert on the SAx lines may then optionally be set with SetDeviceAndAddress()
 /// Then Direct mode may then be used with Read() / Write().
-/// Or for DMA mode, one must first call SetupDMA() with a suitable internal buffer, then WriteDMA() to flush the buffer into SMI.
+/// Or for DMA mode, one must first call SetupDMA() with a suitable internal buffer, then WriteDMA() to flush the buffer into SMI,
+/// or ReadDMA() to sample the SDx lines into the buffer, one SMI cycle after the other (e.g. for a logic analyzer).
 
 
 class CSMIMaster
@@ -79,7 +80,7 @@ public:
 	/// \param nDevice		the settings bank to use between 0 and 3
 	void SetupTiming (TSMIDataWidth nWidth, unsigned nCycle_ns, unsigned nSetup, unsigned nStrobe, unsigned nHold, unsigned nPace, unsigned nDevice = 0);
 
-	/// \brief Sets up DMA for (potentially multiple) SMI cycles of data from the given buffer
+	/// \brief Sets up DMA for (potentially multiple) SMI cycles of data from/to the given buffer
 	/// \param pDMABuffer	the buffer (make sure it's DMA-aligned)
 	/// \param nLength		length of the buffer in bytes
 	void SetupDMA (void *pDMABuffer, unsigned nLength);
@@ -100,6 +101,11 @@ public:
 	/// \param bWaitForCompletion	Whether to wait for DMA completion
 	void WriteDMA (boolean bWaitForCompletion);
 
+	/// \brief Triggers the DMA transfer of a few read cycles into the buffer/length specified in SetupDMA
+	/// \param bWaitForCompletion	Whether to wait for DMA completion
+	/// \note The sample rate is determined by the read timing given to SetupTiming()
+	void ReadDMA (boolean bWaitForCompletion);
+
 protected:
 	unsigned m_nSDLinesMask;
 	boolean m_bUseAddressPins;
@@ -0,0 +1,92 @@
+//
+/// \file softirq.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_softirq_h
+#define _circle_softirq_h
+
+#include <circle/sysconfig.h>
+#include <circle/synchronize.h>
+#include <circle/types.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#include <circle/memorymap.h>
+
+	#define SOFTIRQ_CORES		CORES
+#else
+	#define SOFTIRQ_CORES		1
+#endif
+
+#define SOFTIRQ_QUEUE_SIZE	64		// entries per core, must be a power of 2
+
+/// \param pParam User parameter handed over to CSoftIRQ::Raise()
+typedef void TSoftIRQHandler (void *pParam);
+
+/// \brief Deferred interrupt work ("bottom half")
+/// \details An IRQ handler can defer the time consuming part of its work by calling\n
+///	     Raise(). The handler is queued on the current core and is called on exit\n
+///	     from the interrupt handling on this core, after all pending IRQs have been\n
+///	     acknowledged. On AArch64 the deferred handlers run with IRQs enabled, so\n
+///	     that the IRQ latency is not increased by them. CurrentExecutionLevel()\n
+///	     returns IRQ_LEVEL meanwhile nevertheless.
+/// \note On AArch32 the deferred handlers run with IRQs disabled, because the IRQ\n
+///	  stub does not allow nested IRQs. This still shortens the time, until\n
+///	  further pending IRQs are acknowledged.
+/// \note Deferred handlers must not block and have to use spin locks with\n
+///	  IRQ_LEVEL to protect data, which is shared with task level code.
+class CSoftIRQ
+{
+public:
+	/// \brief Queue a deferred handler on the current core
+	/// \param pHandler Handler to be called on exit from the interrupt handling
+	/// \param pParam User parameter handed over to the handler
+	/// \return Operation successful? (FALSE, if the queue is full)
+	/// \note Callable from IRQ context and from task level
+	static boolean Raise (TSoftIRQHandler *pHandler, void *pParam = 0);
+
+	/// \brief Call all deferred handlers, which are queued on the current core
+	/// \note Called on exit from InterruptHandler() with IRQs disabled
+	static void RunPending (void);
+
+	/// \return Are deferred handlers currently running on this core?
+	static boolean IsRunning (void);
+
+	/// \return Number of handlers, which could not be queued since system start
+	static unsigned GetOverflows (void);
+
+private:
+	struct TEntry
+	{
+		TSoftIRQHandler *pHandler;
+		void		*pParam;
+	};
+
+	struct TQueue
+	{
+		TEntry		 Entry[SOFTIRQ_QUEUE_SIZE];
+		volatile unsigned nIn;
+		volatile unsigned nOut;
+		volatile boolean bRunning;
+		unsigned	 nOverflows;
+	}
+	CACHE_ALIGN;
+
+	static TQueue s_Queue[SOFTIRQ_CORES];
+};
+
+#endif
@@ -23,6 +23,7 @@
 #include <circle/dmachannel.h>
 #include <circle/interrupt.h>
 #include <circle/spinlock.h>
+#include <circle/sysconfig.h>
 #include <circle/types.h>
 
 class CDMASoundBuffers	/// Concatenated DMA buffers to be used by sound device drivers
@@ -62,6 +63,15 @@ public:
 
 	~CDMASoundBuffers (void);
 
+	/// \brief Handle completed chunks on another core than core 0
+	/// \param nCore Core number (0..CORES-1)
+	/// \return Operation successful?
+	/// \note Must be called before the first Start().
+	/// \note On the Raspberry Pi 4 the DMA interrupt is routed to this core by the GIC.\n
+	///	  On earlier models it is acknowledged on core 0 and forwarded with an IPI.\n
+	///	  This requires an instance of CMultiCoreSupport.
+	boolean SetTargetCore (unsigned nCore);
+
 	/// \brief Start DMA operation
 	/// \param pHandler Callback handler, which gets called, when one chunk was completed
 	/// \param pParam User parameter, which will be handed over to the handler
@@ -78,8 +88,13 @@ private:
 	boolean GetNextChunk (boolean bFirstCall);
 	boolean PutChunk (void);
 
+	void ChunkCompleted (u32 nCS);
+
 	void InterruptHandler (void);
 	static void InterruptStub (void *pParam);
+#if defined (ARM_ALLOW_MULTI_CORE) && RASPPI <= 3
+	static void IPIStub (unsigned nIPI, void *pParam);
+#endif
 
 	boolean SetupDMAControlBlock (unsigned nID);
 
@@ -103,6 +118,13 @@ private:
 	unsigned m_nNextBuffer;		// 0 or 1
 
 	CSpinLock m_SpinLock;
+
+	unsigned m_nTargetCore;
+#if defined (ARM_ALLOW_MULTI_CORE) && RASPPI <= 3
+	unsigned m_nIPI;
+	volatile u32 m_nPendingCS;	// DMA status bits (OR'ed), forwarded to target core
+	volatile unsigned m_nPendingChunks;	// completed chunks, not handled on target core
+#endif
 };
 
 #endif
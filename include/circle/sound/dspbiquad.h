@@ -0,0 +1,83 @@
+//
+// dspbiquad.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sound_dspbiquad_h
+#define _circle_sound_dspbiquad_h
+
+#include <circle/sound/dspblock.h>
+#include <circle/types.h>
+
+enum TDSPBiquadType
+{
+	DSPBiquadLowPass,
+	DSPBiquadHighPass,
+	DSPBiquadBandPass,		///< 0 dB peak gain
+	DSPBiquadNotch,
+	DSPBiquadPeaking,		///< EQ band, uses gain
+	DSPBiquadLowShelf,		///< uses gain
+	DSPBiquadHighShelf,		///< uses gain
+	DSPBiquadUnknown
+};
+
+/// \note The coefficients are calculated according to the "Audio EQ Cookbook" by R. Bristow-Johnson.
+/// \note Use multiple blocks for a multi-band equalizer or for higher order filters.
+
+class CDSPBiquad : public CDSPBlock	/// DSP block: Second order IIR filter (EQ band)
+{
+public:
+	/// \param Type Filter type
+	/// \param fFrequency Center or corner frequency in Hz
+	/// \param fQ Quality factor (0.7071 for Butterworth low-/high-pass)
+	/// \param fGaindB Gain in dB (for peaking and shelving filters only)
+	CDSPBiquad (TDSPBiquadType Type, float fFrequency, float fQ = 0.7071f, float fGaindB = 0.0f);
+
+	~CDSPBiquad (void);
+
+	boolean Setup (unsigned nSampleRate, unsigned nChannels);
+
+	void Process (float *pChannel[], unsigned nFrames);
+
+	/// \brief Change the filter parameters
+	/// \note Can be called while processing, takes effect with the next processed block.
+	void SetParameters (TDSPBiquadType Type, float fFrequency, float fQ, float fGaindB);
+
+private:
+	void CalculateCoefficients (void);
+
+private:
+	TDSPBiquadType m_Type;
+	float m_fFrequency;
+	float m_fQ;
+	float m_fGaindB;
+
+	struct TCoefficients
+	{
+		float b0, b1, b2;
+		float a1, a2;			// normalized to a0
+	};
+
+	TCoefficients m_Coeffs;
+	TCoefficients m_NewCoeffs;
+	volatile boolean m_bUpdate;
+
+	float m_fZ1[DSP_MAX_CHANNELS];	// state (transposed direct form II)
+	float m_fZ2[DSP_MAX_CHANNELS];
+};
+
+#endif
@@ -0,0 +1,95 @@
+//
+// dspblock.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sound_dspblock_h
+#define _circle_sound_dspblock_h
+
+#include <circle/types.h>
+
+#define DSP_MAX_CHANNELS	2
+
+/// \note Samples are planar float values in the range [-1.0, 1.0).
+/// \note Setup() and the parameter setters have to be called from TASK_LEVEL. Process() is\n
+///	  called from CDSPPipeline, which may run in interrupt context.
+
+class CDSPBlock		/// Base class of a processing block of a DSP pipeline
+{
+public:
+	/// \param pName Name of the block (for statistics)
+	CDSPBlock (const char *pName);
+
+	virtual ~CDSPBlock (void);
+
+	/// \brief Prepare processing (calculate coefficients, allocate buffers)
+	/// \param nSampleRate Sample rate in Hz
+	/// \param nChannels Number of channels (1 or 2)
+	/// \return Operation successful?
+	/// \note Overloads have to call this method first.
+	virtual boolean Setup (unsigned nSampleRate, unsigned nChannels);
+
+	/// \brief Process one block of samples in place
+	/// \param pChannel Pointers to the sample buffers of each channel
+	/// \param nFrames Number of samples per channel
+	virtual void Process (float *pChannel[], unsigned nFrames) = 0;
+
+	/// \param bBypass Skip this block in the pipeline?
+	void SetBypass (boolean bBypass)	{ m_bBypass = bBypass; }
+	/// \return Is this block skipped in the pipeline?
+	boolean IsBypassed (void) const		{ return m_bBypass; }
+
+	/// \return Name of the block
+	const char *GetName (void) const	{ return m_pName; }
+
+	/// \return Average number of CPU cycles per frame (0 if not measured yet)
+	unsigned GetCyclesPerFrame (void) const;
+	/// \return Maximum number of CPU cycles of one Process() call
+	unsigned GetCyclesMax (void) const	{ return m_nCyclesMax; }
+	/// \brief Clear the cycle statistics
+	void ResetStatistics (void);
+
+protected:
+	static double Sin (double fX);
+	static double Cos (double fX);
+	static double Exp (double fX);
+	static double Sqrt (double fX);
+	static double FromDecibel (double fdB);		// to linear amplitude
+
+	// fast approximations for per-sample use (relative error about 1e-4)
+	static float FastLog2 (float fX);
+	static float FastExp2 (float fX);
+
+protected:
+	unsigned m_nSampleRate;
+	unsigned m_nChannels;
+
+private:
+	void AddCycles (u32 nCycles, unsigned nFrames);
+
+	friend class CDSPPipeline;
+
+private:
+	const char *m_pName;
+	volatile boolean m_bBypass;
+
+	u64 m_ullCycles;
+	u64 m_ullFrames;
+	u32 m_nCyclesMax;
+};
+
+#endif
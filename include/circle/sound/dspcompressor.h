@@ -0,0 +1,80 @@
+//
+// dspcompressor.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sound_dspcompressor_h
+#define _circle_sound_dspcompressor_h
+
+#include <circle/sound/dspblock.h>
+#include <circle/types.h>
+
+#define DSP_RATIO_LIMITER	0.0f		// infinite ratio
+
+/// \note The level is detected from the peak of all channels (stereo linked), so that the\n
+///	  stereo image does not move. There is no look-ahead, a limiter should use a short\n
+///	  attack time.
+
+class CDSPCompressor : public CDSPBlock		/// DSP block: Compressor or limiter
+{
+public:
+	/// \param fThresholddB Level above which the gain is reduced in dBFS
+	/// \param fRatio Compression ratio (e.g. 4.0 for 4:1), DSP_RATIO_LIMITER for a limiter
+	/// \param fAttackMsecs Attack time in milliseconds
+	/// \param fReleaseMsecs Release time in milliseconds
+	/// \param fMakeupdB Gain applied after compression in dB
+	CDSPCompressor (float fThresholddB = -12.0f, float fRatio = 4.0f,
+			float fAttackMsecs = 5.0f, float fReleaseMsecs = 100.0f,
+			float fMakeupdB = 0.0f);
+
+	~CDSPCompressor (void);
+
+	boolean Setup (unsigned nSampleRate, unsigned nChannels);
+
+	void Process (float *pChannel[], unsigned nFrames);
+
+	/// \brief Change the parameters (see constructor)
+	/// \note Can be called while processing.
+	void SetParameters (float fThresholddB, float fRatio, float fAttackMsecs,
+			    float fReleaseMsecs, float fMakeupdB);
+
+	/// \return Current gain reduction in dB (for metering)
+	float GetGainReduction (void) const;
+
+private:
+	void CalculateParameters (void);
+
+private:
+	float m_fThresholddB;
+	float m_fRatio;
+	float m_fAttackMsecs;
+	float m_fReleaseMsecs;
+	float m_fMakeupdB;
+
+	// derived values used by Process()
+	volatile float m_fThresholdLog2;
+	volatile float m_fThreshold;
+	volatile float m_fSlope;		// gain reduction per level above threshold (log2)
+	volatile float m_fAttack;		// filter coefficients of envelope follower
+	volatile float m_fRelease;
+	volatile float m_fMakeupLog2;
+
+	float m_fEnvelope;
+	volatile float m_fReductionLog2;
+};
+
+#endif
@@ -0,0 +1,59 @@
+//
+// dspdelay.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sound_dspdelay_h
+#define _circle_sound_dspdelay_h
+
+#include <circle/sound/dspblock.h>
+#include <circle/types.h>
+
+class CDSPDelay : public CDSPBlock	/// DSP block: Delay line with feedback (echo)
+{
+public:
+	/// \param fMaxDelayMsecs Maximum delay time in milliseconds (determines buffer size)
+	/// \param fDelayMsecs Delay time in milliseconds
+	/// \param fFeedback Part of the delayed signal, which is fed back (0.0 .. <1.0)
+	/// \param fMix Part of the delayed signal in the output (0.0: dry .. 1.0: wet only)
+	CDSPDelay (float fMaxDelayMsecs, float fDelayMsecs,
+		   float fFeedback = 0.0f, float fMix = 1.0f);
+
+	~CDSPDelay (void);
+
+	boolean Setup (unsigned nSampleRate, unsigned nChannels);
+
+	void Process (float *pChannel[], unsigned nFrames);
+
+	/// \brief Change the parameters (see constructor)
+	/// \note Can be called while processing.
+	void SetParameters (float fDelayMsecs, float fFeedback, float fMix);
+
+private:
+	float m_fMaxDelayMsecs;
+	float m_fDelayMsecs;
+
+	volatile unsigned m_nDelayFrames;
+	volatile float m_fFeedback;
+	volatile float m_fMix;
+
+	unsigned m_nBufferFrames;
+	float *m_pBuffer[DSP_MAX_CHANNELS];
+	unsigned m_nWritePos;
+};
+
+#endif
@@ -0,0 +1,53 @@
+//
+// dspfir.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sound_dspfir_h
+#define _circle_sound_dspfir_h
+
+#include <circle/sound/dspblock.h>
+#include <circle/types.h>
+
+class CDSPFIR : public CDSPBlock	/// DSP block: FIR filter with user defined coefficients
+{
+public:
+	/// \param pCoeffs Impulse response (h[0] is applied to the newest sample), is copied
+	/// \param nTaps Number of coefficients
+	CDSPFIR (const float *pCoeffs, unsigned nTaps);
+
+	~CDSPFIR (void);
+
+	boolean Setup (unsigned nSampleRate, unsigned nChannels);
+
+	void Process (float *pChannel[], unsigned nFrames);
+
+	/// \return Number of taps (rounded up to a multiple of 4)
+	unsigned GetTaps (void) const		{ return m_nTaps; }
+
+private:
+	static float DotProduct (const float *pSamples, const float *pCoeffs, unsigned nTaps);
+
+private:
+	unsigned m_nTaps;
+	float *m_pCoeffs;			// reversed, to be applied to the oldest sample first
+
+	float *m_pHistory[DSP_MAX_CHANNELS];	// 2 * m_nTaps each (mirrored ring)
+	unsigned m_nHistoryPos;
+};
+
+#endif
@@ -0,0 +1,54 @@
+//
+// dspgain.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sound_dspgain_h
+#define _circle_sound_dspgain_h
+
+#include <circle/sound/dspblock.h>
+#include <circle/types.h>
+
+class CDSPGain : public CDSPBlock	/// DSP block: Gain and mute without zipper noise
+{
+public:
+	/// \param fGaindB Initial gain in dB
+	CDSPGain (float fGaindB = 0.0f);
+
+	~CDSPGain (void);
+
+	void Process (float *pChannel[], unsigned nFrames);
+
+	/// \param fGaindB Gain in dB
+	/// \note A change is ramped linearly over the next processed block.
+	void SetGain (float fGaindB);
+
+	/// \param bMute Mute the output?
+	void SetMute (boolean bMute);
+
+private:
+	void UpdateTarget (void);
+
+private:
+	float m_fGaindB;
+	boolean m_bMute;
+
+	float m_fGain;			// currently applied linear gain
+	volatile float m_fTargetGain;
+};
+
+#endif
@@ -0,0 +1,96 @@
+//
+// dsppipeline.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sound_dsppipeline_h
+#define _circle_sound_dsppipeline_h
+
+#include <circle/sound/dspblock.h>
+#include <circle/types.h>
+
+#define DSP_MAX_BLOCKS		16
+#define DSP_BLOCK_FRAMES	128		// interleaved data is processed in blocks of this size
+
+/// \note The blocks are processed in the order, in which they have been added.
+/// \note A pipeline can be attached to a sound device with CSoundBaseDevice::SetOutputPipeline()\n
+///	  or SetInputPipeline(), or can be called from an overloaded GetChunk() or PutChunk().\n
+///	  It runs in interrupt context then. Because the blocks use floating point registers,\n
+///	  SAVE_VFP_REGS_ON_IRQ has to be defined in include/circle/sysconfig.h, if floating\n
+///	  point is used at TASK_LEVEL too.
+/// \note The number of CPU cycles used by each block is measured with the cycle counter of\n
+///	  the performance monitor unit and can be displayed with DumpStatistics().
+
+class CDSPPipeline	/// Chain of DSP blocks, processing planar or interleaved sample buffers
+{
+public:
+	CDSPPipeline (void);
+	~CDSPPipeline (void);
+
+	/// \param pBlock Block to be appended (is not deleted by the pipeline)
+	/// \return Operation successful?
+	/// \note Must be called before Setup().
+	boolean AddBlock (CDSPBlock *pBlock);
+
+	/// \brief Setup all blocks
+	/// \param nSampleRate Sample rate in Hz
+	/// \param nChannels Number of channels (1 or 2)
+	/// \return Operation successful?
+	boolean Setup (unsigned nSampleRate, unsigned nChannels = 2);
+
+	/// \return Number of channels
+	unsigned GetChannels (void) const	{ return m_nChannels; }
+
+	/// \brief Process planar float samples in place
+	/// \param pChannel Pointers to the sample buffers of each channel
+	/// \param nFrames Number of samples per channel
+	void Process (float *pChannel[], unsigned nFrames);
+
+	/// \brief Process interleaved float samples in place
+	/// \param pBuffer Samples in the range [-1.0, 1.0)
+	/// \param nFrames Number of frames (samples per channel)
+	void ProcessInterleaved (float *pBuffer, unsigned nFrames);
+
+	/// \brief Process interleaved signed 16-bit samples in place
+	/// \param pBuffer Samples (saturated on output)
+	/// \param nFrames Number of frames (samples per channel)
+	void ProcessInterleaved (s16 *pBuffer, unsigned nFrames);
+
+	/// \brief Process interleaved signed 32-bit samples in place
+	/// \param pBuffer Samples, full-scale is the range of s32 (saturated on output)
+	/// \param nFrames Number of frames (samples per channel)
+	/// \note 24-bit samples have to be shifted left by 8 bits before.
+	void ProcessInterleaved (s32 *pBuffer, unsigned nFrames);
+
+	/// \brief Write the cycle statistics of all blocks to the logger
+	/// \param pFrom Source name for the log messages
+	void DumpStatistics (const char *pFrom = "dsp");
+
+	/// \brief Clear the cycle statistics of all blocks
+	void ResetStatistics (void);
+
+private:
+	unsigned m_nSampleRate;
+	unsigned m_nChannels;
+
+	unsigned m_nBlocks;
+	CDSPBlock *m_pBlock[DSP_MAX_BLOCKS];
+
+	float m_Buffer[DSP_MAX_CHANNELS][DSP_BLOCK_FRAMES];
+};
+
+#endif
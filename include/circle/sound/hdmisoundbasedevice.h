@@ -49,6 +49,10 @@ public:
 	/// \param nChunkSize	twice the number of samples (words) to be handled\n
 	///			with one call to GetChunk() (one word per stereo channel),\n
 	///			must be a multiple of 384
+	/// \note The DMA interrupt rate is 2 * nSampleRate / nChunkSize\n
+	///	  (25 Hz for 48 kHz stereo with the default chunk size).
+	/// \note A lite DMA channel is preferred, a normal channel is used, if no lite channel\n
+	///	  is available. Use the polling mode as fallback, if Start() fails.
 	CHDMISoundBaseDevice (CInterruptSystem *pInterrupt,
 			      unsigned	        nSampleRate = 48000,
 			      unsigned	        nChunkSize  = 384 * 10);
@@ -82,6 +86,16 @@ public:
 	/// \note Must be called twice for each frame (left/right sample).
 	void WriteSample (s32 nSample);
 
+	/// \brief Write 24-bit signed samples to the data FIFO, until it is full.
+	/// \param pSamples Samples to be written (left/right interleaved)
+	/// \param nCount Number of samples (not frames) available in pSamples
+	/// \return Number of samples written (may be 0, if the FIFO is full)
+	/// \note Can be called in polling mode only.
+	/// \note Refills the FIFO in one batch with a single peripheral access sequence.\n
+	///	  This reduces the CPU load against calling IsWritable() and WriteSample()\n
+	///	  for each sample.
+	unsigned WriteSamples (const s32 *pSamples, unsigned nCount);
+
 protected:
 	/// \brief May overload this to provide the sound samples!
 	/// \param pBuffer	buffer where the samples have to be placed
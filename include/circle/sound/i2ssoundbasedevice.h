@@ -78,6 +78,12 @@ public:
 	/// \return Pointer to sound controller object or nullptr, if not supported.
 	CSoundController *GetController (void) override;
 
+	/// \brief Run the DMA interrupt handling and GetChunk()/PutChunk() on another core
+	/// \param nCore Core number (1..CORES-1), 0 for the default
+	/// \return Operation successful?
+	/// \note Must be called before the first Start().
+	boolean SetAudioCore (unsigned nCore) override;
+
 protected:
 	/// \brief May overload this to provide the sound samples!
 	/// \param pBuffer	buffer where the samples have to be placed
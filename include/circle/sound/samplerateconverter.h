@@ -0,0 +1,106 @@
+//
+// samplerateconverter.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sound_samplerateconverter_h
+#define _circle_sound_samplerateconverter_h
+
+#include <circle/types.h>
+
+#define SRC_MAX_CHANNELS	2
+
+enum TSRCQuality
+{
+	SRCQualityLow,			///< 8 taps, 32 phases
+	SRCQualityMedium,		///< 16 taps, 128 phases
+	SRCQualityHigh,			///< 32 taps, 256 phases, interpolated
+	SRCQualityUnknown
+};
+
+/// \note Samples are interleaved signed 24-bit values, stored in s32 words.
+/// \note The filter kernel uses fixed-point arithmetic (Q30 coefficients) and NEON,\n
+///	  if available. The coefficients are calculated once in Setup().
+
+class CSampleRateConverter	/// Streaming polyphase windowed-sinc sample rate converter
+{
+public:
+	/// \param nChannels Number of interleaved channels (1 or 2)
+	CSampleRateConverter (unsigned nChannels = SRC_MAX_CHANNELS);
+
+	~CSampleRateConverter (void);
+
+	/// \brief Calculate the filter bank and reset the converter
+	/// \param nInputRate Sample rate of the input stream in Hz
+	/// \param nOutputRate Sample rate of the output stream in Hz
+	/// \param Quality Selects number of taps and phases of the filter
+	/// \return Operation successful?
+	boolean Setup (unsigned nInputRate, unsigned nOutputRate,
+		       TSRCQuality Quality = SRCQualityMedium);
+
+	/// \brief Clear the sample history (e.g. on stream restart)
+	void Reset (void);
+
+	/// \brief Fine-tune the conversion ratio (e.g. for clock drift compensation)
+	/// \param nPPM Deviation from the nominal ratio in parts per million,\n
+	///	   positive values consume the input faster
+	/// \note Can be called while streaming, but must be serialized with Process().
+	void SetRatioAdjust (int nPPM);
+
+	/// \brief Convert a block of samples
+	/// \param pInput Input frames (interleaved)
+	/// \param pInputFrames On input: number of frames available in pInput,\n
+	///			on output: number of frames consumed
+	/// \param pOutput Buffer for the output frames (interleaved)
+	/// \param nOutputFrames Maximum number of frames to be written to pOutput
+	/// \return Number of frames written to pOutput
+	unsigned Process (const s32 *pInput, unsigned *pInputFrames,
+			  s32 *pOutput, unsigned nOutputFrames);
+
+	/// \return Number of taps of the filter (group delay is the half of it in input frames)
+	unsigned GetTaps (void) const		{ return m_nTaps; }
+
+private:
+	void FilterFrame (s32 *pOutput);
+
+	void CalculateCoefficients (unsigned nInputRate, unsigned nOutputRate);
+
+	static s64 DotProduct (const s32 *pSamples, const s32 *pCoeffs, unsigned nTaps);
+
+	static double Sinc (double fX);
+	static double Cos (double fX);
+
+private:
+	unsigned m_nChannels;
+
+	TSRCQuality m_Quality;
+	unsigned m_nTaps;
+	unsigned m_nPhaseBits;
+	boolean m_bInterpolate;
+
+	s32 *m_pCoeffs;			// (1 << m_nPhaseBits) + 1 phases of m_nTaps each
+
+	s32 *m_pHistory[SRC_MAX_CHANNELS];	// 2 * m_nTaps each (mirrored ring)
+	unsigned m_nHistoryPos;
+
+	u64 m_ullNominalStep;		// input frames per output frame (32.32 fixed point)
+	u64 m_ullStep;
+	u32 m_nPhase;			// fraction of current position (0.32)
+	unsigned m_nPending;		// input frames to be pushed before the next output
+};
+
+#endif
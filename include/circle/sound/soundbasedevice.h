@@ -22,6 +22,9 @@
 
 #include <circle/device.h>
 #include <circle/sound/soundcontroller.h>
+#include <circle/sound/samplerateconverter.h>
+#include <circle/sound/soundratecontroller.h>
+#include <circle/sound/dsppipeline.h>
 #include <circle/spinlock.h>
 #include <circle/types.h>
 
@@ -48,6 +51,26 @@ enum TSoundFormat			/// All supported formats are interleaved little endian
 
 typedef void TSoundDataCallback (void *pParam);
 
+struct TSoundQueueStatistics		/// Statistics of the queue used for Write()
+{
+	unsigned nQueueFrames;		///< Number of frames currently queued
+	unsigned nQueueFramesMin;	///< Minimum queue level seen by the chunk handler
+	unsigned nQueueFramesMax;	///< Maximum queue level seen by the chunk handler
+	unsigned nUnderruns;		///< Number of times the queue ran empty while streaming
+	unsigned nOverruns;		///< Number of Write() calls, which could not queue all data
+
+	unsigned nLatencySamples;	///< Number of latency measurements
+	unsigned nLatencyMin;		///< Producer-to-DAC latency in microseconds
+	unsigned nLatency50;		///< Median latency in microseconds
+	unsigned nLatency90;		///< 90th percentile of latency in microseconds
+	unsigned nLatency99;		///< 99th percentile of latency in microseconds
+	unsigned nLatencyMax;		///< Maximum latency in microseconds
+};
+
+#define SOUND_LATENCY_MARKERS		32
+#define SOUND_LATENCY_BUCKETS		256
+#define SOUND_LATENCY_BUCKET_USECS	100
+
 /// \note There are two methods to provide the sound samples:\n
 ///	  1. By overloading GetChunk()\n
 ///	  2. By using Write()
@@ -58,6 +81,8 @@ typedef void TSoundDataCallback (void *pParam);
 
 /// \note In a multi-core environment all methods, except if otherwise noted,
 ///	  have to be called or will be called (for callbacks) on core 0.
+///	  The chunk handler and the callbacks can be moved to another core with
+///	  SetAudioCore().
 
 class CSoundBaseDevice : public CDevice		/// Base class of sound devices
 {
@@ -95,6 +120,17 @@ public:
 	/// \return Pointer to sound controller object or nullptr, if not supported.
 	virtual CSoundController *GetController (void)		{ return nullptr; }
 
+	/// \brief Run the DMA interrupt handling and GetChunk()/PutChunk() on another core
+	/// \param nCore Core number (1..CORES-1), 0 for the default
+	/// \return Operation successful? (FALSE, if not supported by the device)
+	/// \note Must be called before the first Start().
+	/// \note Requires ARM_ALLOW_MULTI_CORE and an instance of CMultiCoreSupport, which\n
+	///	  does not disable IRQs in Run() for the given core.
+	/// \note Enables the low-latency mode (see SetLowLatencyMode()), so that the queue\n
+	///	  used for Write() is handed over between the cores without locking.
+	/// \note The need-data and have-data callbacks are called on the given core then.
+	virtual boolean SetAudioCore (unsigned nCore);
+
 	// Output /////////////////////////////////////////////////////////////
 
 	/// \brief Allocate the queue used for Write()
@@ -112,6 +148,33 @@ public:
 	/// \note Not used, if GetChunk() is overloaded.
 	void SetWriteFormat (TSoundFormat Format, unsigned nChannels = 2);
 
+	/// \brief Enable sample rate conversion for Write()
+	/// \param nSampleRate Sample rate of the data given to Write() in Hz
+	/// \param Quality Quality of the conversion (trades CPU load against distortion)
+	/// \return Operation successful?
+	/// \note Must be called after SetWriteFormat().
+	/// \note Fails while the device is active in low-latency mode.
+	/// \note Not used, if GetChunk() is overloaded.
+	boolean SetWriteSampleRate (unsigned nSampleRate, TSRCQuality Quality = SRCQualityMedium);
+
+	/// \brief Compensate the clock drift between the producer of Write() and the device
+	/// \param nTargetMsecs Queue level in milliseconds, which should be kept\n
+	///	  (should be at least twice the chunk duration and less than the queue size)
+	/// \param Quality Quality of the sample rate converter, if it is not enabled yet
+	/// \return Operation successful?
+	/// \note The conversion ratio of the sample rate converter is fine-tuned, so that the\n
+	///	  queue level stays at the target. If the device measures its sample rate\n
+	///	  (e.g. USB feedback endpoint), this is taken into account too.
+	/// \note Must be called after AllocateQueue() and SetWriteFormat().
+	/// \note Fails while the device is active in low-latency mode.
+	/// \note Not used, if GetChunk() is overloaded.
+	boolean EnableDriftCompensation (unsigned nTargetMsecs,
+					 TSRCQuality Quality = SRCQualityMedium);
+
+	/// \return Current correction of the conversion ratio in ppm (0 if disabled)
+	/// \note Can be called on any core.
+	int GetDriftCompensation (void) const;
+
 	/// \param pBuffer Contains the samples
 	/// \param nCount  Size of the buffer in bytes (multiple of frame size)
 	/// \return Number of bytes consumed
@@ -119,6 +182,25 @@ public:
 	/// \note Can be called on any core.
 	int Write (const void *pBuffer, size_t nCount);
 
+	/// \brief Access the queue used for Write() without locking
+	/// \param bEnable Enable low-latency mode?
+	/// \note In low-latency mode the queue is a lock-free single-producer/single-consumer\n
+	///	  ring. The chunk handler never waits for Write(), but Write() must be called\n
+	///	  from one producer (core, task or need-data callback) only.
+	/// \note Must be called before Start().
+	/// \note Not used, if GetChunk() is overloaded.
+	void SetLowLatencyMode (boolean bEnable = TRUE);
+
+	/// \param pStatistics Receives queue levels, under-/overruns and latency percentiles
+	/// \note The latency is estimated from the time, a frame was given to Write(),\n
+	///	  to the time, it is expected to leave the DMA buffer (resolution 100 us).
+	/// \note Not used, if GetChunk() is overloaded.
+	/// \note Can be called on any core.
+	void GetQueueStatistics (TSoundQueueStatistics *pStatistics);
+
+	/// \brief Clear the statistics returned by GetQueueStatistics()
+	void ResetQueueStatistics (void);
+
 	/// \return Queue size in number of frames
 	/// \note Not used, if GetChunk() is overloaded.
 	/// \note Can be called on any core.
@@ -138,6 +220,14 @@ public:
 	/// \return TRUE: Have to write right channel first into buffer in GetChunk()
 	boolean AreChannelsSwapped (void) const;
 
+	/// \brief Attach a DSP pipeline, which processes the output in the chunk handler
+	/// \param pPipeline Pipeline, set up for the sample rate of the device and 2 channels\n
+	///	   (0 to detach)
+	/// \note See the note on floating point usage in dsppipeline.h.
+	/// \note Not used, if GetChunk() is overloaded (call CDSPPipeline::ProcessInterleaved()\n
+	///	  from there instead).
+	void SetOutputPipeline (CDSPPipeline *pPipeline);
+
 	// Input //////////////////////////////////////////////////////////////
 
 	/// \brief Allocate the queue used for Read()
@@ -180,6 +270,13 @@ public:
 	/// \note Not used, if PutChunk() is overloaded.
 	void RegisterHaveDataCallback (TSoundDataCallback *pCallback, void *pParam);
 
+	/// \brief Attach a DSP pipeline, which processes the input in the chunk handler
+	/// \param pPipeline Pipeline, set up for the sample rate of the device and 2 channels\n
+	///	   (0 to detach)
+	/// \note See the note on floating point usage in dsppipeline.h.
+	/// \note Not used, if PutChunk() is overloaded.
+	void SetInputPipeline (CDSPPipeline *pPipeline);
+
 protected:
 	/// \brief May override this to provide the sound samples
 	/// \param pBuffer    Buffer where the samples have to be placed
@@ -203,10 +300,22 @@ protected:
 	/// \param nFrame Number of the IEC958 frame, this sample belongs to (0..191)
 	u32 ConvertIEC958Sample (u32 nSample, unsigned nFrame);
 
+	/// \brief Report the sample rate of the device, measured against the local clock
+	/// \param nRateMilliHz Measured sample rate in 1/1000 Hz
+	/// \note Used as feed-forward for the drift compensation, if enabled
+	void SetMeasuredSampleRate (unsigned nRateMilliHz);
+
 private:
 	// Output /////////////////////////////////////////////////////////////
 
 	void ConvertSoundFormat (void *pTo, const void *pFrom);
+	s32 GetWriteSample (const void *pFrom);
+	s32 GetHWSample (const void *pFrom);
+	void PutHWSample (void *pTo, s32 nValue);
+
+	void ProcessPipeline (CDSPPipeline *pPipeline, void *pBuffer, unsigned nFrames);
+
+	int WriteConverted (const void *pBuffer, size_t nCount);
 
 	unsigned GetChunkInternal (void *pBuffer, unsigned nChunkSize);
 
@@ -215,6 +324,9 @@ private:
 	void Enqueue (const void *pBuffer, unsigned nCount);
 	void Dequeue (void *pBuffer, unsigned nCount);
 
+	void AddLatencyMarker (u32 nFrame, unsigned nTicks);
+	void UpdateStatistics (unsigned nQueueFrames, unsigned nFrames, unsigned nChunkFrames);
+
 	// Input //////////////////////////////////////////////////////////////
 
 	void ConvertReadSoundFormat (void *pTo, const void *pFrom);
@@ -223,6 +335,7 @@ private:
 
 	unsigned GetReadQueueBytesFree (void);
 	unsigned GetReadQueueBytesAvail (void);
+	unsigned ReadEnqueueChunk (const void *pBuffer, unsigned nCount);
 	void ReadEnqueue (const void *pBuffer, unsigned nCount);
 	void ReadDequeue (void *pBuffer, unsigned nCount);
 
@@ -245,15 +358,48 @@ private:
 	unsigned m_nWriteSampleSize;
 	unsigned m_nWriteFrameSize;
 
+	CSampleRateConverter *m_pConverter;	// for Write(), if sample rates differ
+
+	boolean m_bDriftCompensation;
+	CSoundRateController m_RateController;
+	int m_nRatioAdjust;			// currently applied to m_pConverter
+
 	u8 *m_pQueue;			// Ring buffer
-	unsigned m_nInPtr;
-	unsigned m_nOutPtr;
+	volatile unsigned m_nInPtr;	// written by producer only
+	volatile unsigned m_nOutPtr;	// written by consumer only
 
 	TSoundDataCallback *m_pCallback;
 	void *m_pCallbackParam;
 
+	CDSPPipeline *volatile m_pOutputPipeline;
+
+	boolean m_bLowLatency;
 	CSpinLock m_SpinLock;
 
+	// queue statistics
+	CSpinLock m_StatisticsLock;	// taken in low-latency mode too
+	u32 m_nFramesEnqueued;
+	u32 m_nFramesDequeued;
+	unsigned m_nQueueFramesMin;
+	unsigned m_nQueueFramesMax;
+	unsigned m_nUnderruns;
+	unsigned m_nOverruns;
+	boolean m_bStreaming;
+
+	struct TLatencyMarker
+	{
+		u32	 nFrame;		// index of the first frame of a Write() call
+		unsigned nTicks;		// time of the Write() call
+	}
+	m_LatencyMarker[SOUND_LATENCY_MARKERS];
+	volatile unsigned m_nMarkerIn;
+	volatile unsigned m_nMarkerOut;
+
+	unsigned m_nLatencySamples;
+	unsigned m_nLatencyMin;
+	unsigned m_nLatencyMax;
+	unsigned m_LatencyHistogram[SOUND_LATENCY_BUCKETS];
+
 	u8 m_uchIEC958Status[IEC958_STATUS_BYTES];
 
 	// Input //////////////////////////////////////////////////////////////
@@ -274,6 +420,8 @@ private:
 	TSoundDataCallback *m_pReadCallback;
 	void *m_pReadCallbackParam;
 
+	CDSPPipeline *volatile m_pInputPipeline;
+
 	CSpinLock m_ReadSpinLock;
 };
 
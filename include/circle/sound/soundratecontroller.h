@@ -0,0 +1,77 @@
+//
+// soundratecontroller.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sound_soundratecontroller_h
+#define _circle_sound_soundratecontroller_h
+
+#include <circle/types.h>
+
+#define SOUND_RATE_MAX_ADJUST_PPM	1000
+
+/// \note The controller compensates the clock drift between a sound producer and a sound\n
+///	  device. It keeps the level of the queue between them at a target level by\n
+///	  calculating a small correction of the conversion ratio, which is applied with\n
+///	  CSampleRateConverter::SetRatioAdjust(). If the device reports its real sample rate\n
+///	  (e.g. from an USB feedback endpoint), this is used as feed-forward.
+/// \note Uses integer arithmetic only, so that it can be updated from interrupt context.
+
+class CSoundRateController	/// PI controller for adaptive sample rate (clock drift compensation)
+{
+public:
+	CSoundRateController (void);
+
+	/// \param nSampleRate Nominal sample rate of the device in Hz
+	/// \param nTargetFrames Target level of the queue in frames
+	void Setup (unsigned nSampleRate, unsigned nTargetFrames);
+
+	/// \brief Restart control (e.g. after the queue ran empty)
+	/// \note The integral term, which holds the learned drift, is kept.
+	void Reset (void);
+
+	/// \brief Set the sample rate of the device, measured against the local clock
+	/// \param nRateMilliHz Measured rate in 1/1000 Hz (0 if not known anymore)
+	void SetMeasuredRate (unsigned nRateMilliHz);
+
+	/// \brief Feed the controller with the queue level, before a chunk is taken out
+	/// \param nQueueFrames Current level of the queue in frames
+	/// \param nElapsedFrames Number of frames, consumed by the device since the last update
+	/// \return Correction of the conversion ratio in ppm (see GetRatioAdjust())
+	int Update (unsigned nQueueFrames, unsigned nElapsedFrames);
+
+	/// \return Correction of the conversion ratio in ppm,\n
+	///	    positive values let the producer side consume its input faster
+	/// \note Can be called on any core.
+	int GetRatioAdjust (void) const		{ return m_nRatioAdjust; }
+
+	/// \return Filtered queue level in frames
+	unsigned GetLevelFrames (void) const	{ return (unsigned) (m_llLevel >> 16); }
+
+private:
+	unsigned m_nSampleRate;
+	unsigned m_nTargetFrames;
+
+	boolean m_bLevelValid;
+	s64 m_llLevel;			// filtered queue level (frames, Q16)
+	s64 m_llIntegral;		// integral term (ppm, Q16)
+	volatile int m_nFeedForward;	// from measured rate (ppm)
+
+	volatile int m_nRatioAdjust;
+};
+
+#endif
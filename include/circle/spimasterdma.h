@@ -33,6 +33,21 @@
 
 typedef void TSPICompletionRoutine (boolean bStatus, void *pParam);
 
+#define SPI_DMA_QUEUE_SIZE	16		// default max. number of transfers per queue
+
+struct TSPIDMATransfer		// for CSPIMasterDMA::StartQueue()
+{
+	unsigned	 nChipSelect;		// 0, 1 or ChipSelectNone
+	unsigned	 nClockSpeed;		// in Hz, 0 for the clock set with SetClock()
+	unsigned	 CPOL;
+	unsigned	 CPHA;
+	const void	*pWriteBuffer;		// 0 to send zero bytes
+	void		*pReadBuffer;		// 0 to discard the received data
+	unsigned	 nCount;		// number of bytes (1..65535)
+};
+
+struct TSPIDMAQueueEntry;
+
 class CSPIMasterDMA
 {
 public:
@@ -40,9 +55,10 @@ public:
 
 public:
 	// set bDMAChannelLite to FALSE for very high speeds or transfer sizes >= 64K
+	// nQueueSize is the max. number of transfers, which can be given to StartQueue()
 	CSPIMasterDMA (CInterruptSystem *pInterruptSystem,
 		       unsigned nClockSpeed = 500000, unsigned CPOL = 0, unsigned CPHA = 0,
-		       boolean bDMAChannelLite = TRUE);
+		       boolean bDMAChannelLite = TRUE, unsigned nQueueSize = SPI_DMA_QUEUE_SIZE);
 	~CSPIMasterDMA (void);
 
 	boolean Initialize (void);
@@ -56,6 +72,14 @@ public:
 	// buffers must be 4-byte aligned
 	void StartWriteRead (unsigned nChipSelect, const void *pWriteBuffer, void *pReadBuffer, unsigned nCount);
 
+	// starts a sequence of transfers, which are executed by chained DMA control blocks
+	// without CPU intervention in between, each with its own chip select, clock and mode;
+	// the chip select is deasserted between the transfers;
+	// the completion routine is called once, when all transfers have been completed;
+	// buffers must be 4-byte aligned, pTransfers must be valid until completion;
+	// returns FALSE if nTransfers is 0 or exceeds the queue size
+	boolean StartQueue (const TSPIDMATransfer *pTransfers, unsigned nTransfers);
+
 	// Synchronous (polled) operation for small amounts of data
 	// returns number of bytes transferred or < 0 on failure
 	int WriteReadSync (unsigned nChipSelect, const void *pWriteBuffer, void *pReadBuffer, unsigned nCount);
@@ -82,6 +106,13 @@ private:
 
 	TSPICompletionRoutine *m_pCompletionRoutine;
 	void *m_pCompletionParam;
+
+	unsigned m_nQueueSize;
+	u8 *m_pQueueBuffer;
+	TSPIDMAQueueEntry *m_pQueue;
+
+	const TSPIDMATransfer *m_pQueuedTransfers;	// active queue (or 0)
+	unsigned m_nQueuedTransfers;
 };
 
 #endif
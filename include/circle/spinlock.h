@@ -22,6 +22,7 @@
 
 #include <circle/sysconfig.h>
 #include <circle/synchronize.h>
+#include <circle/lockstatistics.h>
 #include <circle/types.h>
 
 #ifdef ARM_ALLOW_MULTI_CORE
@@ -33,7 +34,8 @@ public:
 	// This has been a boolean parameter before and valid values were TRUE and FALSE.
 	// These parameters are still working, but are deprecated. Use the *_LEVEL defines
 	// from circle/sysconfig.h instead!
-	CSpinLock (unsigned nTargetLevel = IRQ_LEVEL);
+	// pName is used to identify the lock in the lock statistics (with LOCK_STATISTICS only).
+	CSpinLock (unsigned nTargetLevel = IRQ_LEVEL, const char *pName = 0);
 	~CSpinLock (void);
 
 	void Acquire (void);
@@ -41,11 +43,18 @@ public:
 
 	static void Enable (void);
 
+	// Returns TRUE, if spin locks actually spin (after the MMU has been enabled)
+	static boolean IsEnabled (void)		{ return s_bEnabled; }
+
 private:
 	unsigned m_nTargetLevel;
 
 	u32 m_nLocked;
 
+#ifdef LOCK_STATISTICS
+	CLockStatistics m_Statistics;
+#endif
+
 	static boolean s_bEnabled;
 };
 
@@ -54,7 +63,7 @@ private:
 class CSpinLock
 {
 public:
-	CSpinLock (unsigned nTargetLevel = IRQ_LEVEL)
+	CSpinLock (unsigned nTargetLevel = IRQ_LEVEL, const char *pName = 0)
 	:	m_nTargetLevel (nTargetLevel)
 	{
 	}
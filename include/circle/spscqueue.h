@@ -0,0 +1,62 @@
+//
+// spscqueue.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_spscqueue_h
+#define _circle_spscqueue_h
+
+#include <circle/synchronize.h>
+#include <circle/types.h>
+
+class CSPSCQueue	/// Lock-free bounded queue of pointers for a single producer and a single consumer
+{
+public:
+	/// \param nSize Number of entries (must be a power of 2)
+	/// \note One side can run on another core or in interrupt context, there must not be\n
+	///	  more than one producer and one consumer at a time.
+	CSPSCQueue (unsigned nSize);
+
+	~CSPSCQueue (void);
+
+	/// \brief Append a pointer to the queue (producer side)
+	/// \param pPtr Any pointer
+	/// \return Operation successful? (FALSE if queue is full)
+	boolean Put (void *pPtr);
+
+	/// \brief Remove the first pointer from the queue (consumer side)
+	/// \return The pointer or 0, if the queue is empty
+	/// \note Therefore null pointers should not be put into the queue.
+	void *Get (void);
+
+	/// \return Is the queue empty? (snapshot only)
+	boolean IsEmpty (void) const;
+
+private:
+	unsigned m_nMask;
+	void **m_ppBuffer;
+
+	// written by the producer, read by the consumer
+	volatile unsigned m_nHead CACHE_ALIGN;
+	unsigned m_nTailCache;			// consumer index, as last seen by the producer
+
+	// written by the consumer, read by the producer
+	volatile unsigned m_nTail CACHE_ALIGN;
+	unsigned m_nHeadCache;			// producer index, as last seen by the consumer
+};
+
+#endif
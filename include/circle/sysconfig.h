@@ -152,6 +152,29 @@
 
 #endif
 
+// LOCK_STATISTICS records the number of acquisitions and contentions,
+// the time spent spinning and the maximum hold time for each spin lock
+// (CSpinLock, CTicketSpinLock, CRWSpinLock), which has been given a name
+// on construction. CLockStatistics::Dump() writes the statistics to the
+// logger. This option takes effect with ARM_ALLOW_MULTI_CORE only and
+// slows down the spin locks a bit.
+
+//#define LOCK_STATISTICS
+
+// IRQ_STATISTICS records the number of calls, the CPU cycles spent and
+// the latency from the IRQ entry for the handler of each IRQ, which can
+// be displayed with CInterruptSystem::ListInterrupts(). This slows down
+// the IRQ handling a little.
+
+//#define IRQ_STATISTICS
+
+// TRACEPOINTS enables the tracepoints in the kernel (task switches, IRQ
+// entry and exit, net frames, block I/O), which are recorded by the class
+// CTracepoints, while it is started. Without this option the tracepoints
+// do not generate any code.
+
+//#define TRACEPOINTS
+
 // USE_PHYSICAL_COUNTER enables the use of the CPU internal physical
 // counter, which is only available on the Raspberry Pi 2, 3 and 4. Reading
 // this counter is much faster than reading the BCM2835 system timer
@@ -164,6 +187,17 @@
 #define USE_PHYSICAL_COUNTER
 #endif
 
+// USE_TICKLESS_TIMER stops the periodic timer interrupt of the class
+// CTimer, which normally occurs HZ (100) times per second. Instead the
+// timer interrupt is programmed for the next pending kernel timer only
+// and the system ticks are derived from the free-running physical
+// counter. This reduces the number of interrupts in an idle system and
+// the IRQ latency jitter caused by them. While a periodic handler is
+// registered with CTimer::RegisterPeriodicHandler(), the timer interrupt
+// occurs on each tick again. This option requires USE_PHYSICAL_COUNTER.
+
+//#define USE_TICKLESS_TIMER
+
 #endif
 
 #if RASPPI >= 4
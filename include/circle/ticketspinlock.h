@@ -0,0 +1,86 @@
+//
+// ticketspinlock.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_ticketspinlock_h
+#define _circle_ticketspinlock_h
+
+#include <circle/sysconfig.h>
+#include <circle/synchronize.h>
+#include <circle/lockstatistics.h>
+#include <circle/types.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+class CTicketSpinLock	/// Spin lock, which is granted to the cores in the order of their requests
+{
+public:
+	/// \param nTargetLevel Maximum execution level, from which the lock is used
+	/// \param pName Name of the lock in the lock statistics (with LOCK_STATISTICS only)
+	/// \note In contrast to CSpinLock a core cannot be starved by the other cores,\n
+	///	  but a core, which waits for the lock, blocks all cores behind it.
+	CTicketSpinLock (unsigned nTargetLevel = IRQ_LEVEL, const char *pName = 0);
+	~CTicketSpinLock (void);
+
+	void Acquire (void);
+	void Release (void);
+
+private:
+	unsigned m_nTargetLevel;
+
+	volatile u32 m_nNextTicket;	// ticket of the next request
+	volatile u32 m_nOwner;		// ticket of the current owner
+
+#ifdef LOCK_STATISTICS
+	CLockStatistics m_Statistics;
+#endif
+};
+
+#else
+
+class CTicketSpinLock
+{
+public:
+	CTicketSpinLock (unsigned nTargetLevel = IRQ_LEVEL, const char *pName = 0)
+	:	m_nTargetLevel (nTargetLevel)
+	{
+	}
+
+	void Acquire (void)
+	{
+		if (m_nTargetLevel >= IRQ_LEVEL)
+		{
+			EnterCritical (m_nTargetLevel);
+		}
+	}
+
+	void Release (void)
+	{
+		if (m_nTargetLevel >= IRQ_LEVEL)
+		{
+			LeaveCritical ();
+		}
+	}
+
+private:
+	unsigned m_nTargetLevel;
+};
+
+#endif
+
+#endif
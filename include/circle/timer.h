@@ -33,6 +33,14 @@
 
 typedef uintptr TKernelTimerHandle;
 
+struct TKernelTimer;
+
+struct TKernelTimerLink		// anchor in a doubly linked list of kernel timers
+{
+	TKernelTimerLink	*pNext;
+	TKernelTimerLink	*pPrev;
+};
+
 typedef void TKernelTimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
 
 /// \param nNewTime New time to be set in seconds since 1970-01-01 00:00:00 UTC
@@ -99,6 +107,10 @@ public:
 	/// resulting CString object must be deleted by caller\n
 	/// Current time according to our time zone
 	CString *GetTimeString (void);
+	/// \param nTime Local time in seconds since 1970-01-01 00:00:00
+	/// \param nHundredthTime 1/100 seconds part of the time
+	/// \return Time string in the format of GetTimeString(), must be deleted by caller
+	static CString *GetTimeString (unsigned nTime, unsigned nHundredthTime);
 
 	/// \brief Starts a kernel timer which elapses after a given delay,\n
 	/// a timer handler gets called then
@@ -111,9 +123,25 @@ public:
 					     TKernelTimerHandler *pHandler,
 					     void *pParam   = 0,
 					     void *pContext = 0);
+	/// \brief Starts a kernel timer with microsecond resolution,\n
+	/// a timer handler gets called then
+	/// \param nDelayMicros Timer elapses after nDelayMicros microseconds from now
+	/// \param pHandler	The handler to be called when the timer elapses
+	/// \param pParam	First user defined parameter to hand over to the handler
+	/// \param pContext	Second user defined parameter to hand over to the handler
+	/// \return Timer handle (cannot be 0), can be cancelled with CancelKernelTimer()
+	/// \note The timer interrupt is triggered at the deadline by the compare register of\n
+	///	  the ARM generic timer. Without USE_PHYSICAL_COUNTER the delay is rounded up\n
+	///	  to a multiple of 1/HZ seconds.
+	TKernelTimerHandle StartHighResTimer (unsigned nDelayMicros,
+					      TKernelTimerHandler *pHandler,
+					      void *pParam   = 0,
+					      void *pContext = 0);
+
 	/// \brief Cancel a running kernel timer,\n
 	/// The timer will not elapse any more.
 	/// \param hTimer	Timer handle
+	/// \note It is safe to cancel a timer, which has already elapsed.
 	void CancelKernelTimer (TKernelTimerHandle hTimer);
 
 	/// When a CTimer object is available better use this instead of SimpleMsDelay()\n
@@ -141,11 +169,42 @@ public:
 	void RegisterUpdateTimeHandler (TUpdateTimeHandler *pHandler);
 
 	/// \param pHandler Handler which is called on each timer tick (HZ times per second)
+	/// \note With USE_TICKLESS_TIMER the timer interrupt occurs on each tick again,\n
+	///	  when a periodic handler has been registered.
 	void RegisterPeriodicHandler (TPeriodicTimerHandler *pHandler);
 
+	/// \return Number of timer interrupts since Initialize() (for statistics)
+	unsigned GetInterruptCount (void) const;
+
 private:
+	TKernelTimer *AllocateKernelTimer (void);
+	void FreeKernelTimer (TKernelTimer *pTimer);
+	TKernelTimer *GetKernelTimer (TKernelTimerHandle hTimer);
+	boolean AddTimerBlock (void);
+
+	void AddToWheel (TKernelTimer *pTimer);
+	void Cascade (TKernelTimerLink *pSlot);
+
 	void PollKernelTimers (void);
 
+	void ReadTime (unsigned *pTime, unsigned *pTicks);
+
+#ifdef USE_PHYSICAL_COUNTER
+	void AddToNearList (TKernelTimer *pTimer);
+	void PollHighResTimers (void);
+	void SetCompare (void);
+#ifdef ARM_ALLOW_MULTI_CORE
+	static void TimerIPIHandler (unsigned nIPI, void *pParam);
+#endif
+#endif
+
+#ifdef USE_TICKLESS_TIMER
+	u64 GetTicks64 (void) const;
+	u64 GetTickCompare (unsigned nTick) const;
+	u64 GetNextTickCompare (void);
+	void RequestTick (unsigned nTick);
+#endif
+
 	void InterruptHandler (void);
 	static void InterruptHandler (void *pParam);
 
@@ -158,18 +217,45 @@ public:
 private:
 	CInterruptSystem	*m_pInterruptSystem;
 
-#if defined (USE_PHYSICAL_COUNTER) && AARCH == 64
+#ifdef USE_PHYSICAL_COUNTER
 	u32			 m_nClockTicksPerHZTick;
+	u64			 m_ullNextTickCompare;		// counter value of next tick
 #endif
 
+#ifndef USE_TICKLESS_TIMER
 	volatile unsigned	 m_nTicks;
 	volatile unsigned	 m_nUptime;
 	volatile unsigned	 m_nTime;			// local time
+#else
+	u64			 m_ullTickBase;			// counter value of tick 0
+	volatile unsigned	 m_nTime;			// local time at tick 0
+	unsigned		 m_nPeriodicTicks;		// last call of periodic handlers
+#endif
+	volatile unsigned	 m_nInterrupts;
 	CSpinLock		 m_TimeSpinLock;
 
 	int			 m_nMinutesDiff;		// diff to UTC
 
-	CPtrList		 m_KernelTimerList;
+	// hierarchical timer wheel: the root level has a slot per tick,
+	// each further level has a slot per round of the level below
+#define TIMER_WHEEL_ROOT_BITS	8
+#define TIMER_WHEEL_ROOT_SIZE	(1 << TIMER_WHEEL_ROOT_BITS)
+#define TIMER_WHEEL_LEVEL_BITS	6
+#define TIMER_WHEEL_LEVEL_SIZE	(1 << TIMER_WHEEL_LEVEL_BITS)
+#define TIMER_WHEEL_LEVELS	4				// covers 32 bits of ticks
+	TKernelTimerLink	 m_WheelRoot[TIMER_WHEEL_ROOT_SIZE];
+	TKernelTimerLink	 m_Wheel[TIMER_WHEEL_LEVELS][TIMER_WHEEL_LEVEL_SIZE];
+	unsigned		 m_nWheelTicks;			// next tick to be processed
+#ifdef USE_PHYSICAL_COUNTER
+	TKernelTimerLink	 m_NearList;		// high-res timers before the next tick but one
+#endif
+
+	// timer nodes are allocated in blocks and never freed until destruction
+#define KERNEL_TIMER_BLOCK_SIZE	256
+#define KERNEL_TIMER_MAX_BLOCKS	256
+	TKernelTimer		*m_pTimerBlock[KERNEL_TIMER_MAX_BLOCKS];
+	unsigned		 m_nTimerBlocks;
+	TKernelTimer		*m_pFreeTimer;
 	CSpinLock		 m_KernelTimerSpinLock;
 
 	unsigned		 m_nMsDelay;
@@ -0,0 +1,157 @@
+//
+/// \file tracepoint.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_tracepoint_h
+#define _circle_tracepoint_h
+
+#include <circle/device.h>
+#include <circle/sysconfig.h>
+#include <circle/synchronize.h>
+#include <circle/types.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#include <circle/memorymap.h>
+
+	#define TRACEPOINT_CORES	CORES
+#else
+	#define TRACEPOINT_CORES	1
+#endif
+
+enum TTracepoint			///< Parameters of the trace event
+{
+	TracepointTaskSwitch,		///< current task, next task
+	TracepointIRQEntry,		///< IRQ number
+	TracepointIRQExit,		///< IRQ number
+	TracepointNetRx,		///< frame length
+	TracepointNetTx,		///< frame length
+	TracepointBlockRead,		///< device, block number, byte count
+	TracepointBlockWrite,		///< device, block number, byte count
+	TracepointUser,			///< first of 16 tracepoints for application use
+	TracepointUnknown = TracepointUser + 16
+};
+
+#define TRACEPOINT_MASK(id)	(1U << (id))
+#define TRACEPOINT_MASK_ALL	((1U << TracepointUnknown) - 1)
+
+/// \brief Emits a trace event with up to four u32 parameters
+/// \note Without the system option TRACEPOINTS the parameters are not evaluated\n
+///	  and no code is generated.
+#ifdef TRACEPOINTS
+	#define TRACEPOINT(id, ...)	(  CTracepoints::IsEnabled (id)			\
+					 ? CTracepoints::Event (id, ##__VA_ARGS__)	\
+					 : (void) 0)
+#else
+	#define TRACEPOINT(id, ...)	((void) 0)
+#endif
+
+struct TTraceRecord			/// Binary trace record (32 bytes)
+{
+	u64	nTimestamp;		// see CTracepoints::GetTimestamp()
+	u32	nCycles;		// CPU cycle counter of this core
+	u16	nID;			// TTracepoint
+	u16	nCore;
+	u32	nParam[4];
+};
+
+/// \brief Records trace events from compile-time tracepoints into per-core ring buffers
+/// \details Other than CTracer this class can be used from task level and IRQ context\n
+///	     on all cores concurrently. Each core writes its own buffer without lock.\n
+///	     The records can be dumped to the logger or exported in the Chrome trace\n
+///	     format (JSON), which can be loaded into chrome://tracing or Perfetto.
+/// \note Tracepoints must not be used from FIQ context.
+class CTracepoints
+{
+public:
+	/// \param nDepth Number of records per core (must be a power of 2)
+	/// \param bStopIfFull Stop recording on a core, when its buffer is full\n
+	///	   (otherwise the oldest records are overwritten)
+	CTracepoints (unsigned nDepth = 4096, boolean bStopIfFull = FALSE);
+
+	~CTracepoints (void);
+
+	/// \brief Clear all buffers and start recording
+	/// \param nEnableMask Bit mask of the enabled tracepoints (see TRACEPOINT_MASK())
+	void Start (u32 nEnableMask = TRACEPOINT_MASK_ALL);
+	/// \brief Stop recording
+	/// \note Waits for events, which are currently recorded on any core.\n
+	///	  Must not be called from IRQ context.
+	void Stop (void);
+
+	/// \brief Write the recorded events to the logger
+	/// \note Stops the recording, if active
+	void Dump (void);
+
+	/// \brief Write the recorded events in the Chrome trace format (JSON)
+	/// \param pDevice Target device (e.g. CQEMUHostFile)
+	/// \return Operation successful?
+	/// \note Stops the recording, if active
+	boolean ExportChromeTrace (CDevice *pDevice);
+
+	/// \return Number of events, which have been lost, because a buffer was full
+	unsigned GetLost (void) const;
+
+	/// \param nID Tracepoint (TTracepoint)
+	/// \return Is the tracepoint enabled?
+	static boolean IsEnabled (unsigned nID)
+	{
+		return s_nEnableMask & TRACEPOINT_MASK (nID);
+	}
+
+	/// \brief Record a trace event (use the macro TRACEPOINT() instead)
+	static void Event (unsigned nID, u32 nParam1 = 0, u32 nParam2 = 0,
+			   u32 nParam3 = 0, u32 nParam4 = 0);
+
+	/// \return Current timestamp (physical counter, system timer on Raspberry Pi 1)
+	static u64 GetTimestamp (void);
+	/// \return Frequency of the timestamp in Hz
+	static u32 GetTimestampFrequency (void);
+
+	static CTracepoints *Get (void);
+
+private:
+	unsigned GetRecords (unsigned nCore) const;
+	const TTraceRecord *GetRecord (unsigned nCore, unsigned nIndex) const;
+	u64 GetTicks (const TTraceRecord *pRecord) const;	// since Start()
+
+	boolean WriteString (CDevice *pDevice, const char *pString);
+
+	void Disable (void);		// and wait for running writers
+
+private:
+	unsigned m_nDepth;
+	boolean m_bStopIfFull;
+	u64 m_nStartTimestamp;
+
+	struct TCoreBuffer
+	{
+		TTraceRecord	 *pRecord;
+		volatile unsigned nIn;		// number of reserved records since Start()
+		volatile unsigned nWriters;	// events currently recorded on this core
+		boolean		  bCycleCounter;	// cycle counter is enabled on this core
+	}
+	CACHE_ALIGN;
+
+	TCoreBuffer m_Buffer[TRACEPOINT_CORES];
+
+	static volatile u32 s_nEnableMask;
+
+	static CTracepoints *s_pThis;
+};
+
+#endif
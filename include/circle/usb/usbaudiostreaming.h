@@ -90,6 +90,10 @@ public:
 	/// \note Varies in operation, first call returns mean value
 	unsigned GetChunkSizeBytes (void) const;
 
+	/// \return Sample rate of the device in 1/1000 Hz, as measured by the feedback endpoint
+	/// \note Returns 0, if the device has no feedback endpoint or no value was received yet
+	unsigned GetFeedbackRate (void) const;
+
 	/// \brief Send a chunk of audio data to the audio streaming device
 	/// \param pBuffer Pointer to the audio data buffer
 	/// \param nChunkSizeBytes Number of bytes to be send
@@ -156,6 +160,7 @@ private:
 	volatile boolean m_bSyncEPActive;
 	DMA_BUFFER (u32, m_SyncEPBuffer, 1);
 	unsigned m_nSyncAccu;
+	volatile unsigned m_nFeedbackRate;	// in 1/1000 Hz
 
 	u8 m_uchClockSourceID;
 	u8 m_uchSelectorUnitID;
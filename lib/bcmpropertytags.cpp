@@ -37,8 +37,14 @@ struct TPropertyBuffer
 }
 PACKED;
 
+CBcmPropertyTags::TCacheEntry CBcmPropertyTags::s_Cache[PROPTAG_CACHE_ENTRIES];
+volatile unsigned CBcmPropertyTags::s_nCacheEntries = 0;
+CSpinLock CBcmPropertyTags::s_CacheSpinLock (TASK_LEVEL);
+
 CBcmPropertyTags::CBcmPropertyTags (boolean bEarlyUse)
-:	m_MailBox (BCM_MAILBOX_PROP_OUT, bEarlyUse)
+:	m_MailBox (BCM_MAILBOX_PROP_OUT, bEarlyUse),
+	m_bEarlyUse (bEarlyUse),
+	m_nBatchTags (0)
 {
 }
 
@@ -56,6 +62,11 @@ boolean CBcmPropertyTags::GetTag (u32 nTagId, void *pTag, unsigned nTagSize, uns
 	pHeader->nValueBufSize = nTagSize - sizeof (TPropertyTag);
 	pHeader->nValueLength = nRequestParmSize & ~VALUE_LENGTH_RESPONSE;
 
+	if (LookupCache (pHeader, nRequestParmSize))
+	{
+		return TRUE;
+	}
+
 	if (!GetTags (pTag, nTagSize))
 	{
 		return FALSE;
@@ -67,6 +78,8 @@ boolean CBcmPropertyTags::GetTag (u32 nTagId, void *pTag, unsigned nTagSize, uns
 		return FALSE;
 	}
 
+	UpdateCache (pHeader, nRequestParmSize);
+
 	return TRUE;
 }
 
@@ -106,3 +119,217 @@ boolean CBcmPropertyTags::GetTags (void *pTags, unsigned nTagsSize)
 
 	return TRUE;
 }
+
+boolean CBcmPropertyTags::AddTag (u32 nTagId, void *pTag, unsigned nTagSize, unsigned nRequestParmSize)
+{
+	assert (pTag != 0);
+	assert (nTagSize >= sizeof (TPropertyTagSimple));
+	assert ((nTagSize & 3) == 0);
+
+	TPropertyTag *pHeader = (TPropertyTag *) pTag;
+	pHeader->nTagId = nTagId;
+	pHeader->nValueBufSize = nTagSize - sizeof (TPropertyTag);
+	pHeader->nValueLength = nRequestParmSize & ~VALUE_LENGTH_RESPONSE;
+
+	if (LookupCache (pHeader, nRequestParmSize))
+	{
+		return TRUE;
+	}
+
+	if (m_nBatchTags >= PROPTAG_BATCH_MAX)
+	{
+		return FALSE;
+	}
+
+	m_Batch[m_nBatchTags].pTag = pHeader;
+	m_Batch[m_nBatchTags].nTagSize = nTagSize;
+	m_Batch[m_nBatchTags].nRequestParmSize = nRequestParmSize;
+	m_nBatchTags++;
+
+	return TRUE;
+}
+
+boolean CBcmPropertyTags::SubmitTags (void)
+{
+	if (m_nBatchTags == 0)			// all tags from cache?
+	{
+		return TRUE;
+	}
+
+	TPropertyBuffer *pBuffer =
+		(TPropertyBuffer *) CMemorySystem::GetCoherentPage (COHERENT_SLOT_PROP_MAILBOX);
+
+	unsigned nTagsSize = 0;
+	for (unsigned i = 0; i < m_nBatchTags; i++)
+	{
+		memcpy (pBuffer->Tags + nTagsSize, m_Batch[i].pTag, m_Batch[i].nTagSize);
+
+		nTagsSize += m_Batch[i].nTagSize;
+	}
+
+	unsigned nBufferSize = sizeof (TPropertyBuffer) + nTagsSize + sizeof (u32);
+	assert (nBufferSize <= PAGE_SIZE);
+
+	pBuffer->nBufferSize = nBufferSize;
+	pBuffer->nCode = CODE_REQUEST;
+
+	u32 *pEndTag = (u32 *) (pBuffer->Tags + nTagsSize);
+	*pEndTag = PROPTAG_END;
+
+	DataSyncBarrier ();
+
+	boolean bOK = FALSE;
+
+	u32 nBufferAddress = BUS_ADDRESS ((uintptr) pBuffer);
+	if (m_MailBox.WriteRead (nBufferAddress) == nBufferAddress)
+	{
+		DataMemBarrier ();
+
+		bOK = pBuffer->nCode == CODE_RESPONSE_SUCCESS;
+	}
+
+	nTagsSize = 0;
+	for (unsigned i = 0; i < m_nBatchTags; i++)
+	{
+		TPropertyTag *pTag = m_Batch[i].pTag;
+
+		if (bOK)
+		{
+			memcpy (pTag, pBuffer->Tags + nTagsSize, m_Batch[i].nTagSize);
+		}
+
+		nTagsSize += m_Batch[i].nTagSize;
+
+		pTag->nValueLength &= ~VALUE_LENGTH_RESPONSE;
+		if (   !bOK
+		    || pTag->nValueLength == 0)
+		{
+			pTag->nValueLength = 0;
+
+			continue;
+		}
+
+		UpdateCache (pTag, m_Batch[i].nRequestParmSize);
+	}
+
+	if (bOK)
+	{
+		for (unsigned i = 0; i < m_nBatchTags; i++)
+		{
+			if (m_Batch[i].pTag->nValueLength == 0)
+			{
+				bOK = FALSE;
+			}
+		}
+	}
+
+	m_nBatchTags = 0;
+
+	return bOK;
+}
+
+boolean CBcmPropertyTags::IsCacheable (u32 nTagId)
+{
+	switch (nTagId)
+	{
+	case PROPTAG_GET_FIRMWARE_REVISION:
+	case PROPTAG_GET_BOARD_MODEL:
+	case PROPTAG_GET_BOARD_REVISION:
+	case PROPTAG_GET_MAC_ADDRESS:
+	case PROPTAG_GET_BOARD_SERIAL:
+	case PROPTAG_GET_ARM_MEMORY:
+	case PROPTAG_GET_VC_MEMORY:
+	case PROPTAG_GET_MAX_CLOCK_RATE:
+	case PROPTAG_GET_MIN_CLOCK_RATE:
+	case PROPTAG_GET_MAX_TEMPERATURE:
+	case PROPTAG_GET_DMA_CHANNELS:
+		return TRUE;
+
+	default:
+		return FALSE;
+	}
+}
+
+boolean CBcmPropertyTags::LookupCache (TPropertyTag *pTag, unsigned nRequestParmSize)
+{
+	assert (pTag != 0);
+	if (!IsCacheable (pTag->nTagId))
+	{
+		return FALSE;
+	}
+
+	u32 *pValue = (u32 *) (pTag + 1);
+	u32 nKey = nRequestParmSize >= sizeof (u32) ? *pValue : 0;
+
+	// entries are never modified, after they have been published
+	unsigned nEntries = s_nCacheEntries;
+	DataMemBarrier ();
+
+	for (unsigned i = 0; i < nEntries; i++)
+	{
+		const TCacheEntry *pEntry = &s_Cache[i];
+
+		if (   pEntry->nTagId == pTag->nTagId
+		    && pEntry->nKey == nKey
+		    && pEntry->nValueLength <= pTag->nValueBufSize)
+		{
+			memcpy (pValue, pEntry->Value, pEntry->nValueLength);
+			pTag->nValueLength = pEntry->nValueLength;
+
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+void CBcmPropertyTags::UpdateCache (const TPropertyTag *pTag, unsigned nRequestParmSize)
+{
+	assert (pTag != 0);
+	if (   !IsCacheable (pTag->nTagId)
+	    || pTag->nValueLength > PROPTAG_CACHE_VALUE_SIZE
+	    || pTag->nValueLength > pTag->nValueBufSize)
+	{
+		return;
+	}
+
+	const u32 *pValue = (const u32 *) (pTag + 1);
+	u32 nKey = nRequestParmSize >= sizeof (u32) ? *pValue : 0;
+
+	if (!m_bEarlyUse)
+	{
+		s_CacheSpinLock.Acquire ();
+	}
+
+	unsigned nEntries = s_nCacheEntries;
+
+	unsigned i;
+	for (i = 0; i < nEntries; i++)
+	{
+		if (   s_Cache[i].nTagId == pTag->nTagId
+		    && s_Cache[i].nKey == nKey)
+		{
+			break;
+		}
+	}
+
+	if (   i >= nEntries
+	    && nEntries < PROPTAG_CACHE_ENTRIES)
+	{
+		TCacheEntry *pEntry = &s_Cache[nEntries];
+
+		pEntry->nTagId = pTag->nTagId;
+		pEntry->nKey = nKey;
+		pEntry->nValueLength = pTag->nValueLength;
+		memcpy (pEntry->Value, pValue, pTag->nValueLength);
+
+		DataMemBarrier ();
+
+		s_nCacheEntries = nEntries + 1;
+	}
+
+	if (!m_bEarlyUse)
+	{
+		s_CacheSpinLock.Release ();
+	}
+}
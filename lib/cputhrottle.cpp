@@ -67,20 +67,28 @@ CCPUThrottle::CCPUThrottle (TCPUSpeed InitialSpeed)
 
 	m_nEnforcedTemperature = CKernelOptions::Get ()->GetSoCMaxTemp () * 1000;
 
-	m_nMinClockRate = GetClockRate (PROPTAG_GET_MIN_CLOCK_RATE);
-	if (m_nMinClockRate == 0)
-	{
-		return;
-	}
-
-	m_nMaxClockRate = GetClockRate (PROPTAG_GET_MAX_CLOCK_RATE);
-	if (m_nMaxClockRate == 0)
+	// request the limits with one mailbox transaction
+	CBcmPropertyTags Tags;
+	TPropertyTagClockRate TagMinClockRate;
+	TagMinClockRate.nClockId = CLOCK_ID_ARM;
+	Tags.AddTag (PROPTAG_GET_MIN_CLOCK_RATE, &TagMinClockRate, sizeof TagMinClockRate, 4);
+	TPropertyTagClockRate TagMaxClockRate;
+	TagMaxClockRate.nClockId = CLOCK_ID_ARM;
+	Tags.AddTag (PROPTAG_GET_MAX_CLOCK_RATE, &TagMaxClockRate, sizeof TagMaxClockRate, 4);
+	TPropertyTagTemperature TagMaxTemperature;
+	TagMaxTemperature.nTemperatureId = TEMPERATURE_ID;
+	Tags.AddTag (PROPTAG_GET_MAX_TEMPERATURE, &TagMaxTemperature, sizeof TagMaxTemperature, 4);
+	if (!Tags.SubmitTags ())
 	{
 		return;
 	}
 
-	m_nMaxTemperature = GetTemperature (PROPTAG_GET_MAX_TEMPERATURE);
-	if (m_nMaxTemperature == 0)
+	m_nMinClockRate = TagMinClockRate.nRate;
+	m_nMaxClockRate = TagMaxClockRate.nRate;
+	m_nMaxTemperature = TagMaxTemperature.nValue;
+	if (   m_nMinClockRate == 0
+	    || m_nMaxClockRate == 0
+	    || m_nMaxTemperature == 0)
 	{
 		return;
 	}
@@ -197,14 +205,23 @@ boolean CCPUThrottle::SetOnTemperature (void)
 		return TRUE;
 	}
 
-	unsigned nCurrentRate = GetClockRate (PROPTAG_GET_CLOCK_RATE);
-	if (nCurrentRate == 0)
+	// request both values with one mailbox transaction
+	CBcmPropertyTags Tags;
+	TPropertyTagClockRate TagClockRate;
+	TagClockRate.nClockId = CLOCK_ID_ARM;
+	Tags.AddTag (PROPTAG_GET_CLOCK_RATE, &TagClockRate, sizeof TagClockRate, 4);
+	TPropertyTagTemperature TagTemperature;
+	TagTemperature.nTemperatureId = TEMPERATURE_ID;
+	Tags.AddTag (PROPTAG_GET_TEMPERATURE, &TagTemperature, sizeof TagTemperature, 4);
+	if (!Tags.SubmitTags ())
 	{
 		return FALSE;
 	}
 
-	unsigned nTemperature = GetTemperature (PROPTAG_GET_TEMPERATURE);
-	if (nTemperature == 0)
+	unsigned nCurrentRate = TagClockRate.nRate;
+	unsigned nTemperature = TagTemperature.nValue;
+	if (   nCurrentRate == 0
+	    || nTemperature == 0)
 	{
 		return FALSE;
 	}
@@ -18,6 +18,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/dma4channel.h>
+#include <circle/dmachain.h>
 #include <circle/bcm2711.h>
 #include <circle/bcm2711int.h>
 #include <circle/memio.h>
@@ -29,79 +30,11 @@
 #define DMA4_CHANNEL_MIN		11
 #define DMA4_CHANNEL_MAX		14
 
-#define ARM_DMA4CHAN_CS(chan)		(ARM_DMA_BASE + ((chan) * 0x100) + 0x00)
-	#define CS4_HALT			(1 << 31)
-	#define CS4_ABORT			(1 << 30)
-	#define CS4_WAIT_FOR_OUTSTANDING_WRITES	(1 << 28)
-	#define CS4_PANIC_QOS_SHIFT		20
-		#define DEFAULT_PANIC_QOS4		15
-	#define CS4_QOS_SHIFT			16
-		#define DEFAULT_QOS4			1
-	#define CS4_ERROR			(1 << 10)
-	#define CS4_INT				(1 << 2)
-	#define CS4_END				(1 << 1)
-	#define CS4_ACTIVE			(1 << 0)
-#define ARM_DMA4CHAN_CONBLK_AD(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x04)
-	#define CONBLK_AD4_ADDR_SHIFT		5
-#define ARM_DMA4CHAN_DEBUG(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x0C)
-	#define DEBUG4_VERSION_SHIFT		28
-	#define DEBUG4_VERSION_MASK		(0xF << 28)
-		#define DMA4_VERSION			1
-	#define DEBUG4_RESET			(1 << 23)
-#define ARM_DMA4CHAN_TI(chan)		(ARM_DMA_BASE + ((chan) * 0x100) + 0x10)
-	#define TI4_DEST_DREQ			(1 << 15)
-	#define TI4_SRC_DREQ			(1 << 14)
-	#define TI4_PERMAP_SHIFT		9
-	#define TI4_WAIT_RD_RESP		(1 << 3)
-	#define TI4_WAIT_RESP			(1 << 2)
-	#define TI4_TDMODE			(1 << 1)
-	#define TI4_INTEN			(1 << 0)
-#define ARM_DMA4CHAN_SOURCE_AD(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x14)	// [31:0]
-#define ARM_DMA4CHAN_SOURCE_INFO(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x18)
-	#define SOURCE4_STRIDE_SHIFT		16
-		#define SOURCE4_STRIDE_MAX		0xFFFF
-	#define SOURCE4_IGNORE			(1 << 15)
-	#define SOURCE4_SIZE_SHIFT		13
-		#define SIZE4_128			2
-		#define SIZE4_64			1
-		#define SIZE4_32			0
-	#define SOURCE4_INC			(1 << 12)
-	#define SOURCE4_BURST_LEN_SHIFT		8
-		#define BURST4_DEFAULT			0
-		#define BURST4_MAX			15
-	#define SOURCE4_ADDR_SHIFT		0					// [39:32]
-		#define FULL35_ADDR_OFFSET		4	// for "large address" masters
-#define ARM_DMA4CHAN_DEST_AD(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x1C)	// [31:0]
-#define ARM_DMA4CHAN_DEST_INFO(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x20)
-	#define DEST4_STRIDE_SHIFT		16
-		#define DEST4_STRIDE_MAX		0xFFFF
-	#define DEST4_IGNORE			(1 << 15)
-	#define DEST4_SIZE_SHIFT		13
-	#define DEST4_INC			(1 << 12)
-	#define DEST4_BURST_LEN_SHIFT		8
-	#define DEST4_ADDR_SHIFT		0					// [39:32]
-#define ARM_DMA4CHAN_LEN(chan)		(ARM_DMA_BASE + ((chan) * 0x100) + 0x24)
-	#define LEN4_YLENGTH_SHIFT		16
-		#define LEN4_YLENGTH_MAX		0x3FFF
-	#define LEN4_XLENGTH_SHIFT		0
-		#define LEN4_XLENGTH_MAX		0x3FFFFFFF
-		#define LEN4_XLENGTH_2D_MAX		0xFFFF
-#define ARM_DMA4CHAN_NEXTCONBK(chan)	(ARM_DMA_BASE + ((chan) * 0x100) + 0x28)
-#define ARM_DMA_INT_STATUS		(ARM_DMA_BASE + 0xFE0)
-#define ARM_DMA_ENABLE			(ARM_DMA_BASE + 0xFF0)
-
-#if AARCH == 32
-	#define ADDRESS4_LOW(ptr)	((uintptr) (ptr))
-	#define ADDRESS4_HIGH(ptr)	(0)
-#else
-	#define ADDRESS4_LOW(ptr)	((uintptr) (ptr) & 0xFFFFFFFFUL)
-	#define ADDRESS4_HIGH(ptr)	((((uintptr) (ptr) >> 32) & 0xFF))
-#endif
-
 CDMA4Channel::CDMA4Channel (unsigned nChannel, CInterruptSystem *pInterruptSystem)
 :	m_nChannel (nChannel),
 	m_pControlBlockBuffer (0),
 	m_pControlBlock (0),
+	m_pChain (0),
 	m_pInterruptSystem (pInterruptSystem),
 	m_bIRQConnected (FALSE),
 	m_pCompletionRoutine (0),
@@ -164,6 +97,7 @@ void CDMA4Channel::SetupMemCopy (void *pDestination, const void *pSource, size_t
 	assert (nBurstLength <= BURST4_MAX);
 
 	assert (m_pControlBlock != 0);
+	m_pChain = 0;
 	assert (nLength <= LEN4_XLENGTH_MAX);
 
 	m_pControlBlock->nTransferInformation     =   TI4_WAIT_RD_RESP
@@ -208,6 +142,7 @@ void CDMA4Channel::SetupIORead (void *pDestination, u32 nIOAddress, size_t nLeng
 	nIOAddress += GPU_IO_BASE;
 
 	assert (m_pControlBlock != 0);
+	m_pChain = 0;
 	m_pControlBlock->nTransferInformation     =   TI4_SRC_DREQ
 						    | (DREQ << TI4_PERMAP_SHIFT)
 						    | TI4_WAIT_RD_RESP
@@ -242,6 +177,7 @@ void CDMA4Channel::SetupIOWrite (u32 nIOAddress, const void *pSource, size_t nLe
 	nIOAddress += GPU_IO_BASE;
 
 	assert (m_pControlBlock != 0);
+	m_pChain = 0;
 	m_pControlBlock->nTransferInformation     =   TI4_DEST_DREQ
 						    | (DREQ << TI4_PERMAP_SHIFT)
 						    | TI4_WAIT_RD_RESP
@@ -278,6 +214,7 @@ void CDMA4Channel::SetupMemCopy2D (void *pDestination, const void *pSource,
 	assert (nBurstLength <= BURST4_MAX);
 
 	assert (m_pControlBlock != 0);
+	m_pChain = 0;
 
 	m_pControlBlock->nTransferInformation     =   TI4_WAIT_RD_RESP
 						    | TI4_WAIT_RESP
@@ -304,6 +241,15 @@ void CDMA4Channel::SetupMemCopy2D (void *pDestination, const void *pSource,
 	CleanAndInvalidateDataCacheRange ((uintptr) pSource, nBlockLength*nBlockCount);
 }
 
+void CDMA4Channel::SetupChain (CDMAChain *pChain)
+{
+	assert (pChain != 0);
+	assert (pChain->GetLength () > 0);
+	m_pChain = pChain;
+
+	m_nDestinationAddress = 0;
+}
+
 void CDMA4Channel::SetCompletionRoutine (TDMACompletionRoutine *pRoutine, void *pParam)
 {
 	assert (m_nChannel >= DMA4_CHANNEL_MIN);
@@ -330,6 +276,26 @@ void CDMA4Channel::Start (void)
 	assert (m_nChannel <= DMA4_CHANNEL_MAX);
 	assert (m_pControlBlock != 0);
 
+	if (m_pChain != 0)
+	{
+		assert (   m_pCompletionRoutine == 0
+			|| m_bIRQConnected);
+		const void *pFirst = m_pChain->Prepare (m_pCompletionRoutine != 0);
+
+		assert (!(read32 (ARM_DMA4CHAN_CS (m_nChannel)) & CS4_INT));
+		assert (!(read32 (ARM_DMA_INT_STATUS) & (1 << m_nChannel)));
+
+		write32 (ARM_DMA4CHAN_CONBLK_AD (m_nChannel),
+			 (uintptr) pFirst >> CONBLK_AD4_ADDR_SHIFT);
+
+		write32 (ARM_DMA4CHAN_CS (m_nChannel),   CS4_WAIT_FOR_OUTSTANDING_WRITES
+						      | (DEFAULT_PANIC_QOS4 << CS4_PANIC_QOS_SHIFT)
+						      | (DEFAULT_QOS4 << CS4_QOS_SHIFT)
+						      | CS4_ACTIVE);
+
+		return;
+	}
+
 	if (m_pCompletionRoutine != 0)
 	{
 		assert (m_pInterruptSystem != 0);
@@ -370,6 +336,11 @@ boolean CDMA4Channel::Wait (void)
 		CleanAndInvalidateDataCacheRange (m_nDestinationAddress, m_nBufferLength);
 	}
 
+	if (m_pChain != 0)
+	{
+		m_pChain->InvalidateDestinations ();
+	}
+
 	return m_bStatus;
 }
 
@@ -389,6 +360,11 @@ void CDMA4Channel::InterruptHandler (void)
 		CleanAndInvalidateDataCacheRange (m_nDestinationAddress, m_nBufferLength);
 	}
 
+	if (m_pChain != 0)
+	{
+		m_pChain->InvalidateDestinations ();
+	}
+
 	assert (m_nChannel >= DMA4_CHANNEL_MIN);
 	assert (m_nChannel <= DMA4_CHANNEL_MAX);
 
@@ -401,7 +377,8 @@ void CDMA4Channel::InterruptHandler (void)
 
 	u32 nCS = read32 (ARM_DMA4CHAN_CS (m_nChannel));
 	assert (nCS & CS4_INT);
-	assert (!(nCS & CS4_ACTIVE));
+	assert (   !(nCS & CS4_ACTIVE)
+		|| m_pChain != 0);		// interrupt from an inner step of a chain
 	write32 (ARM_DMA4CHAN_CS (m_nChannel), CS4_INT);
 
 	m_bStatus = nCS & CS4_ERROR ? FALSE : TRUE;
@@ -0,0 +1,597 @@
+//
+// dmachain.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/dmachain.h>
+#include <circle/bcm2835.h>
+#include <circle/synchronize.h>
+#include <circle/new.h>
+#include <assert.h>
+
+ASSERT_STATIC (sizeof (TDMAChainEntry) == DMA_CHAIN_ENTRY_SIZE);
+
+#define IO_BUS_ADDRESS(addr)	(((addr) & 0xFFFFFF) + GPU_IO_BASE)
+
+CDMAControlBlockPool::CDMAControlBlockPool (unsigned nEntries)
+:	m_pBuffer (0),
+	m_pFreeList (0),
+	m_nFreeCount (0),
+	m_SpinLock (IRQ_LEVEL)
+{
+	assert (nEntries > 0);
+
+	// DMA30 memory can be accessed by the legacy and the DMA4 controllers
+	m_pBuffer = new (HEAP_DMA30) u8[nEntries * sizeof (TDMAChainEntry) + DMA_CHAIN_ENTRY_SIZE-1];
+	assert (m_pBuffer != 0);
+
+	TDMAChainEntry *pEntries =
+		(TDMAChainEntry *) (  ((uintptr) m_pBuffer + DMA_CHAIN_ENTRY_SIZE-1)
+				    & ~(uintptr) (DMA_CHAIN_ENTRY_SIZE-1));
+
+	for (unsigned i = 0; i < nEntries; i++)
+	{
+		pEntries[i].pNext = m_pFreeList;
+		m_pFreeList = &pEntries[i];
+	}
+
+	m_nFreeCount = nEntries;
+}
+
+CDMAControlBlockPool::~CDMAControlBlockPool (void)
+{
+	m_pFreeList = 0;
+
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+}
+
+TDMAChainEntry *CDMAControlBlockPool::Allocate (void)
+{
+	m_SpinLock.Acquire ();
+
+	TDMAChainEntry *pEntry = m_pFreeList;
+	if (pEntry != 0)
+	{
+		m_pFreeList = pEntry->pNext;
+
+		assert (m_nFreeCount > 0);
+		m_nFreeCount--;
+	}
+
+	m_SpinLock.Release ();
+
+	return pEntry;
+}
+
+void CDMAControlBlockPool::Free (TDMAChainEntry *pEntry)
+{
+	assert (pEntry != 0);
+
+	m_SpinLock.Acquire ();
+
+	pEntry->pNext = m_pFreeList;
+	m_pFreeList = pEntry;
+
+	m_nFreeCount++;
+
+	m_SpinLock.Release ();
+}
+
+unsigned CDMAControlBlockPool::GetFreeCount (void) const
+{
+	return m_nFreeCount;
+}
+
+CDMAChain::CDMAChain (CDMAChannel *pChannel, CDMAControlBlockPool *pPool)
+:	m_pPool (pPool),
+	m_bDMA4 (FALSE),
+	m_nMaxLength (TXFR_LEN_MAX),
+	m_pFirst (0),
+	m_pLast (0),
+	m_nLength (0),
+	m_bCyclic (FALSE)
+{
+	assert (pChannel != 0);
+	assert (m_pPool != 0);
+
+#if RASPPI >= 4
+	if (pChannel->IsExtended ())
+	{
+		m_bDMA4 = TRUE;
+		m_nMaxLength = LEN4_XLENGTH_MAX;
+
+		return;
+	}
+#endif
+
+	if (pChannel->IsLite ())
+	{
+		m_nMaxLength = TXFR_LEN_MAX_LITE;
+	}
+}
+
+CDMAChain::~CDMAChain (void)
+{
+	Clear ();
+
+	m_pPool = 0;
+}
+
+boolean CDMAChain::AddMemCopy (void *pDestination, const void *pSource, size_t nLength,
+			       unsigned nBurstLength)
+{
+	assert (pDestination != 0);
+	assert (pSource != 0);
+	assert (nLength > 0);
+	assert (nBurstLength <= 15);
+
+	CleanAndInvalidateDataCacheRange ((uintptr) pSource, nLength);
+	CleanAndInvalidateDataCacheRange ((uintptr) pDestination, nLength);
+
+	// longer transfers are split into multiple steps
+	u8 *pDest = (u8 *) pDestination;
+	const u8 *pSrc = (const u8 *) pSource;
+	while (nLength > 0)
+	{
+		size_t nStepLength = nLength < m_nMaxLength ? nLength : m_nMaxLength;
+
+		TDMAChainEntry *pEntry = Append ();
+		if (pEntry == 0)
+		{
+			return FALSE;
+		}
+
+#if RASPPI >= 4
+		if (m_bDMA4)
+		{
+			TDMA4ControlBlock *pCB = &pEntry->ControlBlock4;
+
+			pCB->nTransferInformation    = TI4_WAIT_RD_RESP | TI4_WAIT_RESP;
+			pCB->nSourceAddress          = ADDRESS4_LOW (pSrc);
+			pCB->nSourceInformation      =   (SIZE4_128 << SOURCE4_SIZE_SHIFT)
+						       | SOURCE4_INC
+						       | (nBurstLength << SOURCE4_BURST_LEN_SHIFT)
+						       | (ADDRESS4_HIGH (pSrc) << SOURCE4_ADDR_SHIFT);
+			pCB->nDestinationAddress     = ADDRESS4_LOW (pDest);
+			pCB->nDestinationInformation =   (SIZE4_128 << DEST4_SIZE_SHIFT)
+						       | DEST4_INC
+						       | (nBurstLength << DEST4_BURST_LEN_SHIFT)
+						       | (ADDRESS4_HIGH (pDest) << DEST4_ADDR_SHIFT);
+			pCB->nTransferLength         = nStepLength << LEN4_XLENGTH_SHIFT;
+		}
+		else
+#endif
+		{
+			TDMAControlBlock *pCB = &pEntry->ControlBlock;
+
+			pCB->nTransferInformation    =   (nBurstLength << TI_BURST_LENGTH_SHIFT)
+						       | TI_SRC_WIDTH
+						       | TI_SRC_INC
+						       | TI_DEST_WIDTH
+						       | TI_DEST_INC;
+			pCB->nSourceAddress          = BUS_ADDRESS ((uintptr) pSrc);
+			pCB->nDestinationAddress     = BUS_ADDRESS ((uintptr) pDest);
+			pCB->nTransferLength         = nStepLength;
+		}
+
+		pEntry->nDestinationAddress = (uintptr) pDest;
+		pEntry->nDestinationLength = nStepLength;
+
+		pDest += nStepLength;
+		pSrc += nStepLength;
+		nLength -= nStepLength;
+	}
+
+	return TRUE;
+}
+
+boolean CDMAChain::AddIORead (void *pDestination, u32 nIOAddress, size_t nLength, TDREQ DREQ)
+{
+	assert (pDestination != 0);
+	assert (nLength > 0);
+
+	nIOAddress &= 0xFFFFFF;
+	assert (nIOAddress != 0);
+	nIOAddress += GPU_IO_BASE;
+
+	CleanAndInvalidateDataCacheRange ((uintptr) pDestination, nLength);
+
+	u8 *pDest = (u8 *) pDestination;
+	while (nLength > 0)
+	{
+		size_t nMaxLength = m_nMaxLength & ~(sizeof (u32)-1);
+		size_t nStepLength = nLength < nMaxLength ? nLength : nMaxLength;
+
+		TDMAChainEntry *pEntry = Append ();
+		if (pEntry == 0)
+		{
+			return FALSE;
+		}
+
+#if RASPPI >= 4
+		if (m_bDMA4)
+		{
+			TDMA4ControlBlock *pCB = &pEntry->ControlBlock4;
+
+			pCB->nTransferInformation    =   (DREQ << TI4_PERMAP_SHIFT)
+						       | TI4_WAIT_RD_RESP
+						       | TI4_WAIT_RESP;
+			if (DREQ != DREQSourceNone)
+			{
+				pCB->nTransferInformation |= TI4_SRC_DREQ;
+			}
+			pCB->nSourceAddress          = nIOAddress;
+			pCB->nSourceInformation      =   (SIZE4_32 << SOURCE4_SIZE_SHIFT)
+						       | (BURST4_DEFAULT << SOURCE4_BURST_LEN_SHIFT)
+						       | (FULL35_ADDR_OFFSET << SOURCE4_ADDR_SHIFT);
+			pCB->nDestinationAddress     = ADDRESS4_LOW (pDest);
+			pCB->nDestinationInformation =   (SIZE4_128 << DEST4_SIZE_SHIFT)
+						       | DEST4_INC
+						       | (BURST4_DEFAULT << DEST4_BURST_LEN_SHIFT)
+						       | (ADDRESS4_HIGH (pDest) << DEST4_ADDR_SHIFT);
+			pCB->nTransferLength         = nStepLength << LEN4_XLENGTH_SHIFT;
+		}
+		else
+#endif
+		{
+			TDMAControlBlock *pCB = &pEntry->ControlBlock;
+
+			pCB->nTransferInformation    =   (DREQ << TI_PERMAP_SHIFT)
+						       | (DEFAULT_BURST_LENGTH << TI_BURST_LENGTH_SHIFT)
+						       | TI_DEST_WIDTH
+						       | TI_DEST_INC
+						       | TI_WAIT_RESP;
+			if (DREQ != DREQSourceNone)
+			{
+				pCB->nTransferInformation |= TI_SRC_DREQ;
+			}
+			pCB->nSourceAddress          = nIOAddress;
+			pCB->nDestinationAddress     = BUS_ADDRESS ((uintptr) pDest);
+			pCB->nTransferLength         = nStepLength;
+		}
+
+		pEntry->nDestinationAddress = (uintptr) pDest;
+		pEntry->nDestinationLength = nStepLength;
+
+		pDest += nStepLength;
+		nLength -= nStepLength;
+	}
+
+	return TRUE;
+}
+
+boolean CDMAChain::AddIOWrite (u32 nIOAddress, const void *pSource, size_t nLength, TDREQ DREQ)
+{
+	assert (pSource != 0);
+	assert (nLength > 0);
+
+	nIOAddress &= 0xFFFFFF;
+	assert (nIOAddress != 0);
+	nIOAddress += GPU_IO_BASE;
+
+	CleanAndInvalidateDataCacheRange ((uintptr) pSource, nLength);
+
+	const u8 *pSrc = (const u8 *) pSource;
+	while (nLength > 0)
+	{
+		size_t nMaxLength = m_nMaxLength & ~(sizeof (u32)-1);
+		size_t nStepLength = nLength < nMaxLength ? nLength : nMaxLength;
+
+		TDMAChainEntry *pEntry = Append ();
+		if (pEntry == 0)
+		{
+			return FALSE;
+		}
+
+#if RASPPI >= 4
+		if (m_bDMA4)
+		{
+			TDMA4ControlBlock *pCB = &pEntry->ControlBlock4;
+
+			pCB->nTransferInformation    =   (DREQ << TI4_PERMAP_SHIFT)
+						       | TI4_WAIT_RD_RESP
+						       | TI4_WAIT_RESP;
+			if (DREQ != DREQSourceNone)
+			{
+				pCB->nTransferInformation |= TI4_DEST_DREQ;
+			}
+			pCB->nSourceAddress          = ADDRESS4_LOW (pSrc);
+			pCB->nSourceInformation      =   (SIZE4_128 << SOURCE4_SIZE_SHIFT)
+						       | SOURCE4_INC
+						       | (BURST4_DEFAULT << SOURCE4_BURST_LEN_SHIFT)
+						       | (ADDRESS4_HIGH (pSrc) << SOURCE4_ADDR_SHIFT);
+			pCB->nDestinationAddress     = nIOAddress;
+			pCB->nDestinationInformation =   (SIZE4_32 << DEST4_SIZE_SHIFT)
+						       | (BURST4_DEFAULT << DEST4_BURST_LEN_SHIFT)
+						       | (FULL35_ADDR_OFFSET << DEST4_ADDR_SHIFT);
+			pCB->nTransferLength         = nStepLength << LEN4_XLENGTH_SHIFT;
+		}
+		else
+#endif
+		{
+			TDMAControlBlock *pCB = &pEntry->ControlBlock;
+
+			pCB->nTransferInformation    =   (DREQ << TI_PERMAP_SHIFT)
+						       | (DEFAULT_BURST_LENGTH << TI_BURST_LENGTH_SHIFT)
+						       | TI_SRC_WIDTH
+						       | TI_SRC_INC
+						       | TI_WAIT_RESP;
+			if (DREQ != DREQSourceNone)
+			{
+				pCB->nTransferInformation |= TI_DEST_DREQ;
+			}
+			pCB->nSourceAddress          = BUS_ADDRESS ((uintptr) pSrc);
+			pCB->nDestinationAddress     = nIOAddress;
+			pCB->nTransferLength         = nStepLength;
+		}
+
+		pSrc += nStepLength;
+		nLength -= nStepLength;
+	}
+
+	return TRUE;
+}
+
+boolean CDMAChain::AddIOFill (u32 nIOAddress, const u32 *pWord, unsigned nCount, TDREQ DREQ)
+{
+	assert (pWord != 0);
+	assert (nCount > 0);
+
+	nIOAddress &= 0xFFFFFF;
+	assert (nIOAddress != 0);
+	nIOAddress += GPU_IO_BASE;
+
+	CleanAndInvalidateDataCacheRange ((uintptr) pWord, sizeof *pWord);
+
+	size_t nLength = nCount * sizeof (u32);
+	while (nLength > 0)
+	{
+		size_t nMaxLength = m_nMaxLength & ~(sizeof (u32)-1);
+		size_t nStepLength = nLength < nMaxLength ? nLength : nMaxLength;
+
+		TDMAChainEntry *pEntry = Append ();
+		if (pEntry == 0)
+		{
+			return FALSE;
+		}
+
+#if RASPPI >= 4
+		if (m_bDMA4)
+		{
+			TDMA4ControlBlock *pCB = &pEntry->ControlBlock4;
+
+			pCB->nTransferInformation    =   (DREQ << TI4_PERMAP_SHIFT)
+						       | TI4_WAIT_RD_RESP
+						       | TI4_WAIT_RESP;
+			if (DREQ != DREQSourceNone)
+			{
+				pCB->nTransferInformation |= TI4_DEST_DREQ;
+			}
+			pCB->nSourceAddress          = ADDRESS4_LOW (pWord);
+			pCB->nSourceInformation      =   (SIZE4_32 << SOURCE4_SIZE_SHIFT)
+						       | (BURST4_DEFAULT << SOURCE4_BURST_LEN_SHIFT)
+						       | (ADDRESS4_HIGH (pWord) << SOURCE4_ADDR_SHIFT);
+			pCB->nDestinationAddress     = nIOAddress;
+			pCB->nDestinationInformation =   (SIZE4_32 << DEST4_SIZE_SHIFT)
+						       | (BURST4_DEFAULT << DEST4_BURST_LEN_SHIFT)
+						       | (FULL35_ADDR_OFFSET << DEST4_ADDR_SHIFT);
+			pCB->nTransferLength         = nStepLength << LEN4_XLENGTH_SHIFT;
+		}
+		else
+#endif
+		{
+			TDMAControlBlock *pCB = &pEntry->ControlBlock;
+
+			pCB->nTransferInformation    =   (DREQ << TI_PERMAP_SHIFT)
+						       | (DEFAULT_BURST_LENGTH << TI_BURST_LENGTH_SHIFT)
+						       | TI_WAIT_RESP;
+			if (DREQ != DREQSourceNone)
+			{
+				pCB->nTransferInformation |= TI_DEST_DREQ;
+			}
+			pCB->nSourceAddress          = BUS_ADDRESS ((uintptr) pWord);
+			pCB->nDestinationAddress     = nIOAddress;
+			pCB->nTransferLength         = nStepLength;
+		}
+
+		nLength -= nStepLength;
+	}
+
+	return TRUE;
+}
+
+void CDMAChain::SetInterrupt (void)
+{
+	assert (m_pLast != 0);
+	m_pLast->bInterrupt = TRUE;
+}
+
+void CDMAChain::SetCyclic (void)
+{
+	assert (m_pFirst != 0);
+	assert (!m_bDMA4);		// CDMA4Channel cannot be cancelled
+	m_bCyclic = TRUE;
+}
+
+void CDMAChain::Clear (void)
+{
+	assert (m_pPool != 0);
+
+	while (m_pFirst != 0)
+	{
+		TDMAChainEntry *pEntry = m_pFirst;
+		m_pFirst = pEntry->pNext;
+
+		m_pPool->Free (pEntry);
+	}
+
+	m_pLast = 0;
+	m_nLength = 0;
+	m_bCyclic = FALSE;
+}
+
+unsigned CDMAChain::GetLength (void) const
+{
+	return m_nLength;
+}
+
+boolean CDMAChain::IsCyclic (void) const
+{
+	return m_bCyclic;
+}
+
+size_t CDMAChain::GetTransferLength (void) const
+{
+	size_t nLength = 0;
+	for (const TDMAChainEntry *pEntry = m_pFirst; pEntry != 0; pEntry = pEntry->pNext)
+	{
+#if RASPPI >= 4
+		if (m_bDMA4)
+		{
+			nLength +=   (pEntry->ControlBlock4.nTransferLength >> LEN4_XLENGTH_SHIFT)
+				   & LEN4_XLENGTH_MAX;
+		}
+		else
+#endif
+		{
+			nLength += pEntry->ControlBlock.nTransferLength;
+		}
+	}
+
+	return nLength;
+}
+
+boolean CDMAChain::HasInnerInterrupt (void) const
+{
+	for (const TDMAChainEntry *pEntry = m_pFirst; pEntry != m_pLast; pEntry = pEntry->pNext)
+	{
+		assert (pEntry != 0);
+		if (pEntry->bInterrupt)
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+const void *CDMAChain::Prepare (boolean bInterruptAtEnd)
+{
+	assert (m_pFirst != 0);
+	assert (m_pLast != 0);
+
+	for (TDMAChainEntry *pEntry = m_pFirst; pEntry != 0; pEntry = pEntry->pNext)
+	{
+		TDMAChainEntry *pNext = pEntry->pNext;
+		if (   pNext == 0
+		    && m_bCyclic)
+		{
+			pNext = m_pFirst;
+		}
+
+		boolean bInterrupt =    pEntry->bInterrupt
+				     || (   pEntry == m_pLast
+					 && bInterruptAtEnd
+					 && !m_bCyclic);
+
+#if RASPPI >= 4
+		if (m_bDMA4)
+		{
+			TDMA4ControlBlock *pCB = &pEntry->ControlBlock4;
+
+			pCB->nNextControlBlockAddress =
+				pNext != 0 ? (uintptr) pNext >> CONBLK_AD4_ADDR_SHIFT : 0;
+			pCB->nReserved = 0;
+
+			if (bInterrupt)
+			{
+				pCB->nTransferInformation |= TI4_INTEN;
+			}
+			else
+			{
+				pCB->nTransferInformation &= ~TI4_INTEN;
+			}
+		}
+		else
+#endif
+		{
+			TDMAControlBlock *pCB = &pEntry->ControlBlock;
+
+			pCB->n2DModeStride = 0;
+			pCB->nNextControlBlockAddress =
+				pNext != 0 ? BUS_ADDRESS ((uintptr) pNext) : 0;
+			pCB->nReserved[0] = 0;
+			pCB->nReserved[1] = 0;
+
+			if (bInterrupt)
+			{
+				pCB->nTransferInformation |= TI_INTEN;
+			}
+			else
+			{
+				pCB->nTransferInformation &= ~TI_INTEN;
+			}
+		}
+
+		CleanAndInvalidateDataCacheRange ((uintptr) pEntry, sizeof *pEntry);
+	}
+
+	return &m_pFirst->ControlBlock;
+}
+
+void CDMAChain::InvalidateDestinations (void)
+{
+	for (TDMAChainEntry *pEntry = m_pFirst; pEntry != 0; pEntry = pEntry->pNext)
+	{
+		if (pEntry->nDestinationAddress != 0)
+		{
+			CleanAndInvalidateDataCacheRange (pEntry->nDestinationAddress,
+							  pEntry->nDestinationLength);
+		}
+	}
+}
+
+TDMAChainEntry *CDMAChain::Append (void)
+{
+	assert (m_pPool != 0);
+	TDMAChainEntry *pEntry = m_pPool->Allocate ();
+	if (pEntry == 0)
+	{
+		return 0;
+	}
+
+	pEntry->pNext = 0;
+	pEntry->nDestinationAddress = 0;
+	pEntry->nDestinationLength = 0;
+	pEntry->bInterrupt = FALSE;
+
+	if (m_pLast != 0)
+	{
+		assert (m_pFirst != 0);
+		m_pLast->pNext = pEntry;
+	}
+	else
+	{
+		m_pFirst = pEntry;
+	}
+
+	m_pLast = pEntry;
+	m_nLength++;
+
+	return pEntry;
+}
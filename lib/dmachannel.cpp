@@ -18,6 +18,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/dmachannel.h>
+#include <circle/dmachain.h>
 #include <circle/bcm2835.h>
 #include <circle/bcm2835int.h>
 #include <circle/memio.h>
@@ -28,10 +29,13 @@
 
 #define DMA_CHANNELS			(DMA_CHANNEL_MAX + 1)
 
-CDMAChannel::CDMAChannel (unsigned nChannel, CInterruptSystem *pInterruptSystem)
-:	m_nChannel (CMachineInfo::Get ()->AllocateDMAChannel (nChannel)),
+CDMAChannel::CDMAChannel (unsigned nChannel, CInterruptSystem *pInterruptSystem,
+			  boolean bAllocated)
+:	m_nChannel (bAllocated ? nChannel : CMachineInfo::Get ()->AllocateDMAChannel (nChannel)),
 	m_pControlBlockBuffer (0),
 	m_pControlBlock (0),
+	m_pChainControlBlock (0),
+	m_pChain (0),
 	m_pInterruptSystem (pInterruptSystem),
 	m_bIRQConnected (FALSE),
 	m_pCompletionRoutine (0),
@@ -161,6 +165,9 @@ void CDMAChannel::SetupMemCopy (void *pDestination, const void *pSource, size_t
 	m_pControlBlock->n2DModeStride            = 0;
 	m_pControlBlock->nNextControlBlockAddress = 0;
 
+	m_pChainControlBlock = 0;
+	m_pChain = 0;
+
 	if (bCached)
 	{
 		m_nDestinationAddress = (uintptr) pDestination;
@@ -209,6 +216,9 @@ void CDMAChannel::SetupIORead (void *pDestination, u32 nIOAddress, size_t nLengt
 	m_pControlBlock->n2DModeStride            = 0;
 	m_pControlBlock->nNextControlBlockAddress = 0;
 
+	m_pChainControlBlock = 0;
+	m_pChain = 0;
+
 	m_nDestinationAddress = (uintptr) pDestination;
 	m_nBufferLength = nLength;
 
@@ -249,6 +259,9 @@ void CDMAChannel::SetupIOWrite (u32 nIOAddress, const void *pSource, size_t nLen
 	m_pControlBlock->n2DModeStride            = 0;
 	m_pControlBlock->nNextControlBlockAddress = 0;
 
+	m_pChainControlBlock = 0;
+	m_pChain = 0;
+
 	m_nDestinationAddress = 0;
 
 	CleanAndInvalidateDataCacheRange ((uintptr) pSource, nLength);
@@ -294,11 +307,46 @@ void CDMAChannel::SetupMemCopy2D (void *pDestination, const void *pSource,
 	m_pControlBlock->n2DModeStride            = nBlockStride << STRIDE_DEST_SHIFT;
 	m_pControlBlock->nNextControlBlockAddress = 0;
 
+	m_pChainControlBlock = 0;
+	m_pChain = 0;
+
 	m_nDestinationAddress = 0;
 
 	CleanAndInvalidateDataCacheRange ((uintptr) pSource, nBlockLength*nBlockCount);
 }
 
+void CDMAChannel::SetupChain (const TDMAControlBlock *pControlBlock)
+{
+#if RASPPI >= 4
+	assert (m_pDMA4Channel == 0);
+#endif
+
+	assert (pControlBlock != 0);
+	assert (((uintptr) pControlBlock & 31) == 0);
+	m_pChainControlBlock = pControlBlock;
+	m_pChain = 0;
+
+	m_nDestinationAddress = 0;
+}
+
+void CDMAChannel::SetupChain (CDMAChain *pChain)
+{
+#if RASPPI >= 4
+	if (m_pDMA4Channel != 0)
+	{
+		m_pDMA4Channel->SetupChain (pChain);
+
+		return;
+	}
+#endif
+
+	assert (pChain != 0);
+	assert (pChain->GetLength () > 0);
+	m_pChain = pChain;
+
+	m_nDestinationAddress = 0;
+}
+
 void CDMAChannel::SetCompletionRoutine (TDMACompletionRoutine *pRoutine, void *pParam)
 {
 #if RASPPI >= 4
@@ -340,6 +388,35 @@ void CDMAChannel::Start (void)
 	assert (m_nChannel < DMA_CHANNELS);
 	assert (m_pControlBlock != 0);
 
+	if (m_pChain != 0)
+	{
+		assert (   m_pCompletionRoutine == 0
+			|| m_bIRQConnected);
+		m_pChainControlBlock =
+			(const TDMAControlBlock *) m_pChain->Prepare (m_pCompletionRoutine != 0);
+	}
+
+	if (m_pChainControlBlock != 0)
+	{
+		// the chain is ready to run, the completion interrupt is set by the caller
+		PeripheralEntry ();
+
+		assert (!(read32 (ARM_DMACHAN_CS (m_nChannel)) & CS_INT));
+		assert (!(read32 (ARM_DMA_INT_STATUS) & (1 << m_nChannel)));
+
+		write32 (ARM_DMACHAN_CONBLK_AD (m_nChannel),
+			 BUS_ADDRESS ((uintptr) m_pChainControlBlock));
+
+		write32 (ARM_DMACHAN_CS (m_nChannel),   CS_WAIT_FOR_OUTSTANDING_WRITES
+						      | (DEFAULT_PANIC_PRIORITY << CS_PANIC_PRIORITY_SHIFT)
+						      | (DEFAULT_PRIORITY << CS_PRIORITY_SHIFT)
+						      | CS_ACTIVE);
+
+		PeripheralExit ();
+
+		return;
+	}
+
 	if (m_pCompletionRoutine != 0)
 	{
 		assert (m_pInterruptSystem != 0);
@@ -391,6 +468,11 @@ boolean CDMAChannel::Wait (void)
 		CleanAndInvalidateDataCacheRange (m_nDestinationAddress, m_nBufferLength);
 	}
 
+	if (m_pChain != 0)
+	{
+		m_pChain->InvalidateDestinations ();
+	}
+
 	PeripheralExit ();
 
 	return m_bStatus;
@@ -411,6 +493,85 @@ boolean CDMAChannel::GetStatus (void)
 	return m_bStatus;
 }
 
+size_t CDMAChannel::GetRemaining (void)
+{
+#if RASPPI >= 4
+	assert (m_pDMA4Channel == 0);
+#endif
+	assert (m_nChannel < DMA_CHANNELS);
+
+	PeripheralEntry ();
+
+	size_t nResult = read32 (ARM_DMACHAN_TXFR_LEN (m_nChannel)) & TXFR_LEN_MAX;
+
+	PeripheralExit ();
+
+	return nResult;
+}
+
+size_t CDMAChannel::Cancel (void)
+{
+#if RASPPI >= 4
+	assert (m_pDMA4Channel == 0);
+#endif
+	assert (m_nChannel < DMA_CHANNELS);
+
+	PeripheralEntry ();
+
+	// pause the channel, so that the remaining length does not change any more
+	write32 (ARM_DMACHAN_CS (m_nChannel), 0);
+
+	size_t nResult = read32 (ARM_DMACHAN_TXFR_LEN (m_nChannel)) & TXFR_LEN_MAX;
+
+	write32 (ARM_DMACHAN_CS (m_nChannel), CS_RESET);
+	while (read32 (ARM_DMACHAN_CS (m_nChannel)) & CS_RESET)
+	{
+		// do nothing
+	}
+
+	// the transfer may have been completed in the meantime
+	write32 (ARM_DMACHAN_CS (m_nChannel), CS_INT | CS_END);
+	write32 (ARM_DMA_INT_STATUS, 1 << m_nChannel);
+
+	PeripheralExit ();
+
+	return nResult;
+}
+
+unsigned CDMAChannel::GetChannel (void) const
+{
+	return m_nChannel;
+}
+
+boolean CDMAChannel::IsExtended (void) const
+{
+#if RASPPI >= 4
+	return m_pDMA4Channel != 0;
+#else
+	return FALSE;
+#endif
+}
+
+boolean CDMAChannel::IsLite (void) const
+{
+#if RASPPI >= 4
+	if (m_pDMA4Channel != 0)
+	{
+		return FALSE;
+	}
+#endif
+
+	assert (m_nChannel < DMA_CHANNELS);
+
+	PeripheralEntry ();
+
+	boolean bResult = read32 (ARM_DMACHAN_DEBUG (m_nChannel)) & DEBUG_LITE ? TRUE : FALSE;
+
+	PeripheralExit ();
+
+	return bResult;
+}
+
 void CDMAChannel::InterruptHandler (void)
 {
 	if (m_nDestinationAddress != 0)
@@ -418,6 +579,11 @@ void CDMAChannel::InterruptHandler (void)
 		CleanAndInvalidateDataCacheRange (m_nDestinationAddress, m_nBufferLength);
 	}
 
+	if (m_pChain != 0)
+	{
+		m_pChain->InvalidateDestinations ();
+	}
+
 	PeripheralEntry ();
 
 	assert (m_nChannel < DMA_CHANNELS);
@@ -431,7 +597,8 @@ void CDMAChannel::InterruptHandler (void)
 
 	u32 nCS = read32 (ARM_DMACHAN_CS (m_nChannel));
 	assert (nCS & CS_INT);
-	assert (!(nCS & CS_ACTIVE));
+	assert (   !(nCS & CS_ACTIVE)
+		|| m_pChain != 0);		// interrupt from an inner step of a chain
 	write32 (ARM_DMACHAN_CS (m_nChannel), CS_INT); 
 
 	PeripheralExit ();
@@ -0,0 +1,501 @@
+//
+// dmamanager.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/dmamanager.h>
+#include <circle/machineinfo.h>
+#include <circle/synchronize.h>
+#include <circle/logger.h>
+#include <circle/timer.h>
+#include <assert.h>
+
+#ifdef NO_BUSY_WAIT
+	#include <circle/sched/scheduler.h>
+#endif
+
+static const char From[] = "dma";
+
+CDMAManager *CDMAManager::s_pThis = 0;
+
+CDMAManager::CDMAManager (CInterruptSystem *pInterruptSystem)
+:	m_pInterruptSystem (pInterruptSystem),
+	m_nClients (0),
+	m_nStatisticsStart (CTimer::GetClockTicks ()),
+	m_SpinLock (IRQ_LEVEL)
+{
+	assert (s_pThis == 0);
+	s_pThis = this;
+
+	for (unsigned i = 0; i < DMA_MANAGER_CHANNELS; i++)
+	{
+		TChannelInfo *pInfo = &m_Channel[i];
+
+		pInfo->pChannel = 0;
+		pInfo->Class = DMAClassUnknown;
+		pInfo->pOwner = 0;
+		pInfo->nSharedClass = -1;
+		pInfo->nRequests = 0;
+		pInfo->ullBytes = 0;
+		pInfo->ullBusyTicks = 0;
+		pInfo->nStartTicks = 0;
+		pInfo->nMaxQueued = 0;
+	}
+
+	for (unsigned i = 0; i < DMAClassUnknown; i++)
+	{
+		TSharedChannel *pShared = &m_Shared[i];
+
+		pShared->nChannel = DMA_CHANNEL_NONE;
+		pShared->pActive = 0;
+		pShared->nNextClient = 0;
+		pShared->nQueued = 0;
+
+		for (unsigned j = 0; j < DMA_MANAGER_MAX_CLIENTS; j++)
+		{
+			pShared->pHead[j] = 0;
+			pShared->pTail[j] = 0;
+		}
+	}
+}
+
+CDMAManager::~CDMAManager (void)
+{
+	for (unsigned i = 0; i < DMA_MANAGER_CHANNELS; i++)
+	{
+		delete m_Channel[i].pChannel;
+		m_Channel[i].pChannel = 0;
+	}
+
+	m_pInterruptSystem = 0;
+
+	s_pThis = 0;
+}
+
+CDMAChannel *CDMAManager::AllocateChannel (TDMAChannelClass Class, const char *pOwner)
+{
+	assert (pOwner != 0);
+
+	m_SpinLock.Acquire ();
+
+	CDMAChannel *pChannel = CreateChannel (Class, pOwner);
+
+	m_SpinLock.Release ();
+
+	return pChannel;
+}
+
+void CDMAManager::FreeChannel (CDMAChannel *pChannel)
+{
+	assert (pChannel != 0);
+	unsigned nChannel = pChannel->GetChannel ();
+	assert (nChannel < DMA_MANAGER_CHANNELS);
+
+	m_SpinLock.Acquire ();
+
+	TChannelInfo *pInfo = &m_Channel[nChannel];
+	assert (pInfo->pChannel == pChannel);
+	assert (pInfo->nSharedClass < 0);
+
+	pInfo->pChannel = 0;
+	pInfo->Class = DMAClassUnknown;
+	pInfo->pOwner = 0;
+
+	m_SpinLock.Release ();
+
+	delete pChannel;
+}
+
+unsigned CDMAManager::RegisterClient (void)
+{
+	m_SpinLock.Acquire ();
+
+	assert (m_nClients < DMA_MANAGER_MAX_CLIENTS);
+	unsigned nClient = m_nClients++;
+
+	m_SpinLock.Release ();
+
+	return nClient;
+}
+
+CDMAChannel *CDMAManager::GetSharedChannel (TDMAChannelClass Class)
+{
+	assert (Class < DMAClassUnknown);
+	TSharedChannel *pShared = &m_Shared[Class];
+
+	// the channel is created with the lock held, so that it is created only once
+	m_SpinLock.Acquire ();
+
+	if (pShared->nChannel != DMA_CHANNEL_NONE)
+	{
+		CDMAChannel *pChannel = m_Channel[pShared->nChannel].pChannel;
+
+		m_SpinLock.Release ();
+
+		return pChannel;
+	}
+
+	CDMAChannel *pChannel = CreateChannel (Class, "shared");
+	if (pChannel == 0)
+	{
+		m_SpinLock.Release ();
+
+		return 0;
+	}
+
+	assert (m_pInterruptSystem != 0);
+	pChannel->SetCompletionRoutine (CompletionStub, this);
+
+	unsigned nChannel = pChannel->GetChannel ();
+	assert (nChannel < DMA_MANAGER_CHANNELS);
+
+	m_Channel[nChannel].nSharedClass = Class;
+	pShared->nChannel = nChannel;
+
+	m_SpinLock.Release ();
+
+	return pChannel;
+}
+
+boolean CDMAManager::Submit (unsigned nClient, TDMAChannelClass Class, TDMARequest *pRequest)
+{
+	assert (nClient < m_nClients);
+	assert (Class < DMAClassUnknown);
+	assert (pRequest != 0);
+	assert (pRequest->Type < DMARequestUnknown);
+
+	// each interrupt of the shared channel completes the active request
+	if (   pRequest->Type == DMARequestChain
+	    && pRequest->pChain->HasInnerInterrupt ())
+	{
+		return FALSE;
+	}
+
+	if (GetSharedChannel (Class) == 0)
+	{
+		return FALSE;
+	}
+
+	pRequest->bCompleted = FALSE;
+	pRequest->bStatus = FALSE;
+	pRequest->pNext = 0;
+
+	m_SpinLock.Acquire ();
+
+	TSharedChannel *pShared = &m_Shared[Class];
+
+	if (pShared->pTail[nClient] != 0)
+	{
+		pShared->pTail[nClient]->pNext = pRequest;
+	}
+	else
+	{
+		pShared->pHead[nClient] = pRequest;
+	}
+
+	pShared->pTail[nClient] = pRequest;
+
+	TChannelInfo *pInfo = &m_Channel[pShared->nChannel];
+	if (++pShared->nQueued > pInfo->nMaxQueued)
+	{
+		pInfo->nMaxQueued = pShared->nQueued;
+	}
+
+	if (pShared->pActive == 0)
+	{
+		Dispatch (Class);
+	}
+
+	m_SpinLock.Release ();
+
+	return TRUE;
+}
+
+boolean CDMAManager::Wait (TDMARequest *pRequest)
+{
+	assert (pRequest != 0);
+
+	while (!pRequest->bCompleted)
+	{
+#ifdef NO_BUSY_WAIT
+		CScheduler::Get ()->Yield ();
+#endif
+	}
+
+	DataMemBarrier ();
+
+	return pRequest->bStatus;
+}
+
+void CDMAManager::Dump (void)
+{
+	CLogger::Get ()->Write (From, LogNotice, "%-4s %-8s %-12s %10s %10s %7s %6s",
+				"Chan", "Class", "Owner", "Requests", "KBytes", "Busy %", "Queue");
+
+	for (unsigned i = 0; i < DMA_MANAGER_CHANNELS; i++)
+	{
+		// take a snapshot, the channel may be in use in the meantime
+		m_SpinLock.Acquire ();
+
+		TChannelInfo Info = m_Channel[i];
+		unsigned nElapsed = CTimer::GetClockTicks () - m_nStatisticsStart;
+
+		m_SpinLock.Release ();
+
+		if (Info.pChannel == 0)
+		{
+			continue;
+		}
+
+		assert (Info.pOwner != 0);
+
+		if (Info.nSharedClass < 0)
+		{
+			// the usage of dedicated channels is not known
+			CLogger::Get ()->Write (From, LogNotice, "%4u %-8s %-12s %10s %10s %7s %6s",
+						i, GetClassName (Info.Class), Info.pOwner,
+						"-", "-", "-", "-");
+
+			continue;
+		}
+
+		unsigned nPermille = 0;
+		if (nElapsed > 0)
+		{
+			nPermille = (unsigned) (Info.ullBusyTicks * 1000 / nElapsed);
+		}
+
+		CLogger::Get ()->Write (From, LogNotice, "%4u %-8s %-12s %10u %10lu %5u.%u %6u",
+					i, GetClassName (Info.Class), Info.pOwner,
+					Info.nRequests, (unsigned long) (Info.ullBytes / 1024),
+					nPermille / 10, nPermille % 10, Info.nMaxQueued);
+	}
+}
+
+void CDMAManager::ResetStatistics (void)
+{
+	m_SpinLock.Acquire ();
+
+	for (unsigned i = 0; i < DMA_MANAGER_CHANNELS; i++)
+	{
+		TChannelInfo *pInfo = &m_Channel[i];
+
+		pInfo->nRequests = 0;
+		pInfo->ullBytes = 0;
+		pInfo->ullBusyTicks = 0;
+		pInfo->nMaxQueued = 0;
+	}
+
+	m_nStatisticsStart = CTimer::GetClockTicks ();
+
+	m_SpinLock.Release ();
+}
+
+CDMAManager *CDMAManager::Get (void)
+{
+	return s_pThis;
+}
+
+CDMAChannel *CDMAManager::CreateChannel (TDMAChannelClass Class, const char *pOwner)
+{
+	assert (pOwner != 0);
+
+	CMachineInfo *pMachineInfo = CMachineInfo::Get ();
+	assert (pMachineInfo != 0);
+
+	// CDMAChannel cannot fail, so allocate the channel first and hand it over
+	unsigned nChannel = DMA_CHANNEL_NONE;
+	switch (Class)
+	{
+	case DMAClassLite:
+		nChannel = pMachineInfo->AllocateDMAChannel (DMA_CHANNEL_LITE);
+		break;
+
+	case DMAClassExtended:
+#if RASPPI >= 4
+		nChannel = pMachineInfo->AllocateDMAChannel (DMA_CHANNEL_EXTENDED);
+		if (nChannel != DMA_CHANNEL_NONE)
+		{
+			break;
+		}
+#endif
+		// fall through
+
+	case DMAClassNormal:
+		nChannel = pMachineInfo->AllocateDMAChannel (DMA_CHANNEL_NORMAL);
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+
+	if (nChannel == DMA_CHANNEL_NONE)
+	{
+		CLogger::Get ()->Write (From, LogWarning, "No %s channel available for %s",
+					GetClassName (Class), pOwner);
+
+		return 0;
+	}
+
+	CDMAChannel *pChannel = new CDMAChannel (nChannel, m_pInterruptSystem, TRUE);
+	assert (pChannel != 0);
+	assert (pChannel->GetChannel () == nChannel);
+	assert (nChannel < DMA_MANAGER_CHANNELS);
+
+	TChannelInfo *pInfo = &m_Channel[nChannel];
+	assert (pInfo->pChannel == 0);
+	pInfo->pChannel = pChannel;
+	pInfo->Class =   pChannel->IsExtended () ? DMAClassExtended
+		       : (pChannel->IsLite () ? DMAClassLite : DMAClassNormal);
+	pInfo->pOwner = pOwner;
+	pInfo->nSharedClass = -1;
+
+	return pChannel;
+}
+
+void CDMAManager::Dispatch (unsigned nClass)
+{
+	assert (nClass < DMAClassUnknown);
+	TSharedChannel *pShared = &m_Shared[nClass];
+	assert (pShared->pActive == 0);
+
+	if (pShared->nQueued == 0)
+	{
+		return;
+	}
+
+	// serve the clients round-robin, starting after the last served one
+	TDMARequest *pRequest = 0;
+	for (unsigned i = 0; i < m_nClients; i++)
+	{
+		unsigned nClient = (pShared->nNextClient + i) % m_nClients;
+
+		pRequest = pShared->pHead[nClient];
+		if (pRequest != 0)
+		{
+			pShared->pHead[nClient] = pRequest->pNext;
+			if (pShared->pHead[nClient] == 0)
+			{
+				pShared->pTail[nClient] = 0;
+			}
+
+			pShared->nNextClient = (nClient + 1) % m_nClients;
+
+			break;
+		}
+	}
+
+	assert (pRequest != 0);
+	pShared->nQueued--;
+	pShared->pActive = pRequest;
+
+	assert (pShared->nChannel < DMA_MANAGER_CHANNELS);
+	TChannelInfo *pInfo = &m_Channel[pShared->nChannel];
+	CDMAChannel *pChannel = pInfo->pChannel;
+	assert (pChannel != 0);
+
+	switch (pRequest->Type)
+	{
+	case DMARequestMemCopy:
+		pChannel->SetupMemCopy (pRequest->pDestination, pRequest->pSource,
+					pRequest->nLength, pRequest->nBurstLength);
+		break;
+
+	case DMARequestIORead:
+		pChannel->SetupIORead (pRequest->pDestination, pRequest->nIOAddress,
+				       pRequest->nLength, pRequest->DREQ);
+		break;
+
+	case DMARequestIOWrite:
+		pChannel->SetupIOWrite (pRequest->nIOAddress, pRequest->pSource,
+					pRequest->nLength, pRequest->DREQ);
+		break;
+
+	case DMARequestChain:
+		assert (pRequest->pChain != 0);
+		assert (!pRequest->pChain->IsCyclic ());
+		pChannel->SetupChain (pRequest->pChain);
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+
+	pInfo->nRequests++;
+	pInfo->ullBytes +=   pRequest->Type == DMARequestChain
+			   ? pRequest->pChain->GetTransferLength ()
+			   : pRequest->nLength;
+	pInfo->nStartTicks = CTimer::GetClockTicks ();
+
+	pChannel->Start ();
+}
+
+void CDMAManager::CompletionHandler (unsigned nChannel, boolean bStatus)
+{
+	assert (nChannel < DMA_MANAGER_CHANNELS);
+	TChannelInfo *pInfo = &m_Channel[nChannel];
+
+	m_SpinLock.Acquire ();
+
+	assert (pInfo->nSharedClass >= 0);
+	TSharedChannel *pShared = &m_Shared[pInfo->nSharedClass];
+
+	TDMARequest *pRequest = pShared->pActive;
+	assert (pRequest != 0);
+	pShared->pActive = 0;
+
+	pInfo->ullBusyTicks += CTimer::GetClockTicks () - pInfo->nStartTicks;
+
+	// start the next request early, to keep the channel busy
+	Dispatch (pInfo->nSharedClass);
+
+	m_SpinLock.Release ();
+
+	// the request may be re-used by the client, after bCompleted has been set
+	TDMARequestCompletionRoutine *pRoutine = pRequest->pCompletionRoutine;
+	void *pParam = pRequest->pCompletionParam;
+
+	pRequest->bStatus = bStatus;
+	DataMemBarrier ();
+	pRequest->bCompleted = TRUE;
+
+	if (pRoutine != 0)
+	{
+		(*pRoutine) (pRequest, pParam);
+	}
+}
+
+void CDMAManager::CompletionStub (unsigned nChannel, boolean bStatus, void *pParam)
+{
+	CDMAManager *pThis = (CDMAManager *) pParam;
+	assert (pThis != 0);
+
+	pThis->CompletionHandler (nChannel, bStatus);
+}
+
+const char *CDMAManager::GetClassName (TDMAChannelClass Class)
+{
+	switch (Class)
+	{
+	case DMAClassLite:	return "lite";
+	case DMAClassNormal:	return "normal";
+	case DMAClassExtended:	return "extended";
+	default:		return "unknown";
+	}
+}
@@ -0,0 +1,93 @@
+//
+// doorbell.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/doorbell.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+#include <circle/multicore.h>
+#include <circle/synchronize.h>
+#include <circle/atomic.h>
+#include <assert.h>
+
+boolean CDoorbell::s_bIPIConnected = FALSE;
+
+static void DoorbellIPIHandler (unsigned nIPI, void *pParam)
+{
+	// nothing to do, the IPI only wakes the core from WFI in Wait()
+}
+
+CDoorbell::CDoorbell (unsigned nCore)
+:	m_nCore (nCore),
+	m_nRinging (0)
+{
+	assert (m_nCore < CORES);
+
+	// all doorbells share the same IPI, the state is kept in m_nRinging
+	if (!s_bIPIConnected)
+	{
+		s_bIPIConnected = TRUE;
+
+		CMultiCoreSupport::ConnectIPI (IPI_DOORBELL, DoorbellIPIHandler, 0);
+	}
+}
+
+CDoorbell::~CDoorbell (void)
+{
+}
+
+void CDoorbell::Ring (void)
+{
+	// on the target core itself the doorbell can be rung from an interrupt handler only,
+	// which already terminates the WFI
+	if (   AtomicExchange (&m_nRinging, 1) == 0
+	    && m_nCore != CMultiCoreSupport::ThisCore ())
+	{
+		CMultiCoreSupport::SendIPI (m_nCore, IPI_DOORBELL);
+	}
+}
+
+void CDoorbell::Wait (void)
+{
+	assert (m_nCore == CMultiCoreSupport::ThisCore ());
+
+	// with IRQs disabled an IPI, which arrives after checking m_nRinging,
+	// remains pending and terminates the WFI
+	EnterCritical ();
+
+	while (AtomicExchange (&m_nRinging, 0) == 0)
+	{
+		WaitForInterrupt ();
+
+		// handle the pending interrupt
+		LeaveCritical ();
+		EnterCritical ();
+	}
+
+	LeaveCritical ();
+}
+
+boolean CDoorbell::Check (void)
+{
+	assert (m_nCore == CMultiCoreSupport::ThisCore ());
+
+	return AtomicExchange (&m_nRinging, 0) != 0;
+}
+
+#endif
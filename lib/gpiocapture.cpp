@@ -0,0 +1,352 @@
+//
+// gpiocapture.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/gpiocapture.h>
+#include <circle/bcm2835.h>
+#include <circle/memio.h>
+#include <circle/synchronize.h>
+#include <circle/util.h>
+#include <circle/new.h>
+#include <assert.h>
+
+#define BLOCKS_PER_SAMPLE	2		// read GPLEV0, delay
+#define BLOCKS_PER_BLOCK	1		// timestamp
+
+CGPIOCapture::CGPIOCapture (unsigned nSampleMicros, unsigned nSamples)
+:	m_nSampleMicros (nSampleMicros),
+	m_nSamples (nSamples),
+	m_nBlocks (nSamples / GPIO_CAPTURE_BLOCK_SIZE),
+	m_Pacer (nSampleMicros),
+	m_DMA (DMA_CHANNEL_NORMAL),
+	m_Pool (  nSamples * BLOCKS_PER_SAMPLE
+		+ nSamples / GPIO_CAPTURE_BLOCK_SIZE * BLOCKS_PER_BLOCK),
+	m_Chain (&m_DMA, &m_Pool),
+	m_pRing (0),
+	m_pBlockTime (0),
+	m_bRunning (FALSE),
+	m_Trigger (GPIOCaptureTriggerNone),
+	m_nTriggerMask (0),
+	m_nTriggerValue (0),
+	m_nPreTriggerSamples (0),
+	m_bTriggered (FALSE),
+	m_nPrevSample (0),
+	m_bPrevValid (FALSE),
+	m_nHistory (0),
+	m_nNextBlock (0),
+	m_nLastBlockTime (0),
+	m_nReadPos (0),
+	m_nAvailable (0),
+	m_nOverruns (0)
+{
+	assert (m_nSampleMicros > 0);
+	assert (m_nSamples % GPIO_CAPTURE_BLOCK_SIZE == 0);
+	assert (m_nBlocks >= 4);
+
+	m_pRing = new (HEAP_DMA30) u32[m_nSamples];
+	assert (m_pRing != 0);
+	memset (m_pRing, 0, m_nSamples * sizeof (u32));
+
+	m_pBlockTime = new (HEAP_DMA30) u32[m_nBlocks];
+	assert (m_pBlockTime != 0);
+}
+
+CGPIOCapture::~CGPIOCapture (void)
+{
+	Stop ();
+
+	m_Chain.Clear ();
+
+	delete [] m_pBlockTime;
+	m_pBlockTime = 0;
+
+	delete [] m_pRing;
+	m_pRing = 0;
+}
+
+boolean CGPIOCapture::Initialize (void)
+{
+	if (!m_Pacer.Initialize ())
+	{
+		return FALSE;
+	}
+
+	boolean bOK = TRUE;
+	for (unsigned nBlock = 0; bOK && nBlock < m_nBlocks; nBlock++)
+	{
+		for (unsigned i = 0; bOK && i < GPIO_CAPTURE_BLOCK_SIZE; i++)
+		{
+			bOK =    m_Chain.AddIORead (&m_pRing[nBlock * GPIO_CAPTURE_BLOCK_SIZE + i],
+						    ARM_GPIO_GPLEV0, sizeof (u32), DREQSourceNone)
+			      && m_Pacer.AddDelay (&m_Chain, 1);
+		}
+
+		bOK = bOK && m_Chain.AddIORead (&m_pBlockTime[nBlock], ARM_SYSTIMER_CLO,
+						sizeof (u32), DREQSourceNone);
+	}
+
+	if (!bOK)
+	{
+		m_Chain.Clear ();
+
+		return FALSE;
+	}
+
+	m_Chain.SetCyclic ();
+
+	return TRUE;
+}
+
+void CGPIOCapture::SetTrigger (TGPIOCaptureTrigger Trigger, u32 nMask, u32 nValue,
+			       unsigned nPreTriggerSamples)
+{
+	assert (!m_bRunning);
+	assert (Trigger < GPIOCaptureTriggerUnknown);
+	assert (Trigger == GPIOCaptureTriggerNone || nMask != 0);
+	assert (nPreTriggerSamples <= m_nSamples / 2);
+
+	m_Trigger = Trigger;
+	m_nTriggerMask = nMask;
+	m_nTriggerValue = nValue & nMask;
+	m_nPreTriggerSamples = nPreTriggerSamples;
+}
+
+void CGPIOCapture::Start (void)
+{
+	assert (!m_bRunning);
+	assert (m_Chain.GetLength () > 0);
+
+	m_bTriggered = FALSE;
+	m_bPrevValid = FALSE;
+	m_nHistory = 0;
+	m_nNextBlock = 0;
+	m_nReadPos = 0;
+	m_nAvailable = 0;
+	m_nOverruns = 0;
+
+	// blocks with a timestamp later than this are completed, the DMA
+	// writes the raw system timer value, so it is read the same way here
+	PeripheralEntry ();
+	m_nLastBlockTime = read32 (ARM_SYSTIMER_CLO);
+	PeripheralExit ();
+	for (unsigned i = 0; i < m_nBlocks; i++)
+	{
+		m_pBlockTime[i] = m_nLastBlockTime;
+	}
+
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pBlockTime, m_nBlocks * sizeof (u32));
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pRing, m_nSamples * sizeof (u32));
+
+	m_Pacer.Prime ();
+
+	m_DMA.SetupChain (&m_Chain);
+	m_DMA.Start ();
+
+	m_bRunning = TRUE;
+}
+
+void CGPIOCapture::Stop (void)
+{
+	if (!m_bRunning)
+	{
+		return;
+	}
+
+	m_DMA.Cancel ();
+
+	m_bRunning = FALSE;
+}
+
+unsigned CGPIOCapture::Read (u32 *pBuffer, unsigned nMaxSamples)
+{
+	assert (pBuffer != 0);
+
+	UpdateAvailable ();
+
+	if (!m_bTriggered)
+	{
+		CheckTrigger ();
+
+		if (!m_bTriggered)
+		{
+			return 0;
+		}
+	}
+
+	unsigned nResult = 0;
+	while (   nResult < nMaxSamples
+	       && m_nAvailable > 0)
+	{
+		unsigned nCount = m_nSamples - m_nReadPos;		// up to the wrap
+		if (nCount > m_nAvailable)
+		{
+			nCount = m_nAvailable;
+		}
+
+		if (nCount > nMaxSamples - nResult)
+		{
+			nCount = nMaxSamples - nResult;
+		}
+
+		memcpy (&pBuffer[nResult], &m_pRing[m_nReadPos], nCount * sizeof (u32));
+
+		nResult += nCount;
+		m_nAvailable -= nCount;
+		m_nReadPos = (m_nReadPos + nCount) % m_nSamples;
+	}
+
+	return nResult;
+}
+
+boolean CGPIOCapture::IsTriggered (void) const
+{
+	return m_bTriggered;
+}
+
+unsigned CGPIOCapture::GetOverrunCount (void) const
+{
+	return m_nOverruns;
+}
+
+unsigned CGPIOCapture::GetSampleMicros (void) const
+{
+	return m_nSampleMicros;
+}
+
+void CGPIOCapture::UpdateAvailable (void)
+{
+	// a lapped block has a timestamp about one ring buffer duration after the previous one
+	const u32 nOverrunMicros =   m_nBlocks / 2 * GPIO_CAPTURE_BLOCK_SIZE
+				   * m_nSampleMicros;
+
+	// the block, which is currently written, and one more are never available
+	const unsigned nMaxAvailable = m_nSamples - 2 * GPIO_CAPTURE_BLOCK_SIZE;
+
+	for (unsigned i = 0; i < m_nBlocks; i++)
+	{
+		unsigned nBlock = m_nNextBlock;
+
+		CleanAndInvalidateDataCacheRange ((uintptr) &m_pBlockTime[nBlock], sizeof (u32));
+		u32 nTime = m_pBlockTime[nBlock];
+
+		u32 nDelta = nTime - m_nLastBlockTime;
+		if ((int) nDelta <= 0)
+		{
+			break;
+		}
+
+		m_nLastBlockTime = nTime;
+		m_nNextBlock = (nBlock + 1) % m_nBlocks;
+
+		if (nDelta > nOverrunMicros)
+		{
+			// the DMA controller has overtaken us, resync after this block
+			m_nOverruns++;
+
+			m_nReadPos = m_nNextBlock * GPIO_CAPTURE_BLOCK_SIZE;
+			m_nAvailable = 0;
+			m_nHistory = 0;
+			m_bPrevValid = FALSE;
+
+			continue;
+		}
+
+		CleanAndInvalidateDataCacheRange ((uintptr) &m_pRing[nBlock * GPIO_CAPTURE_BLOCK_SIZE],
+						  GPIO_CAPTURE_BLOCK_SIZE * sizeof (u32));
+
+		m_nAvailable += GPIO_CAPTURE_BLOCK_SIZE;
+		if (m_nAvailable > nMaxAvailable)
+		{
+			// the oldest samples will be overwritten next, drop them
+			m_nOverruns++;
+
+			m_nReadPos = (m_nReadPos + GPIO_CAPTURE_BLOCK_SIZE) % m_nSamples;
+			m_nAvailable -= GPIO_CAPTURE_BLOCK_SIZE;
+			m_nHistory = 0;
+		}
+	}
+}
+
+void CGPIOCapture::CheckTrigger (void)
+{
+	assert (!m_bTriggered);
+
+	while (m_nAvailable > 0)
+	{
+		u32 nSample = m_pRing[m_nReadPos];
+
+		if (IsTriggerSample (nSample))
+		{
+			m_bTriggered = TRUE;
+
+			// go back for the pre-trigger samples, which are not overwritten yet
+			unsigned nPreTrigger = m_nPreTriggerSamples;
+			if (nPreTrigger > m_nHistory)
+			{
+				nPreTrigger = m_nHistory;
+			}
+
+			unsigned nMaxPreTrigger = m_nSamples - 2 * GPIO_CAPTURE_BLOCK_SIZE - m_nAvailable;
+			if (nPreTrigger > nMaxPreTrigger)
+			{
+				nPreTrigger = nMaxPreTrigger;
+			}
+
+			m_nReadPos = (m_nReadPos + m_nSamples - nPreTrigger) % m_nSamples;
+			m_nAvailable += nPreTrigger;
+
+			return;
+		}
+
+		m_nPrevSample = nSample;
+		m_bPrevValid = TRUE;
+
+		if (m_nHistory < m_nPreTriggerSamples)
+		{
+			m_nHistory++;
+		}
+
+		m_nReadPos = (m_nReadPos + 1) % m_nSamples;
+		m_nAvailable--;
+	}
+}
+
+boolean CGPIOCapture::IsTriggerSample (u32 nSample) const
+{
+	switch (m_Trigger)
+	{
+	case GPIOCaptureTriggerNone:
+		return TRUE;
+
+	case GPIOCaptureTriggerLevel:
+		return (nSample & m_nTriggerMask) == m_nTriggerValue;
+
+	case GPIOCaptureTriggerRisingEdge:
+		return m_bPrevValid && (~m_nPrevSample & nSample & m_nTriggerMask);
+
+	case GPIOCaptureTriggerFallingEdge:
+		return m_bPrevValid && (m_nPrevSample & ~nSample & m_nTriggerMask);
+
+	case GPIOCaptureTriggerAnyEdge:
+		return m_bPrevValid && ((m_nPrevSample ^ nSample) & m_nTriggerMask);
+
+	default:
+		assert (0);
+		return FALSE;
+	}
+}
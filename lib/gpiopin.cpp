@@ -344,6 +344,49 @@ u32 CGPIOPin::ReadAll (void)
 	return nResult;
 }
 
+void CGPIOPin::WriteAll64 (u64 nValue, u64 nMask)
+{
+	assert (!(nMask >> GPIO_PINS));
+
+	PeripheralEntry ();
+
+	u64 nClear = ~nValue & nMask;
+	if ((u32) nClear != 0)
+	{
+		write32 (ARM_GPIO_GPCLR0, (u32) nClear);
+	}
+
+	if (nClear >> 32 != 0)
+	{
+		write32 (ARM_GPIO_GPCLR0 + 4, (u32) (nClear >> 32));
+	}
+
+	u64 nSet = nValue & nMask;
+	if ((u32) nSet != 0)
+	{
+		write32 (ARM_GPIO_GPSET0, (u32) nSet);
+	}
+
+	if (nSet >> 32 != 0)
+	{
+		write32 (ARM_GPIO_GPSET0 + 4, (u32) (nSet >> 32));
+	}
+
+	PeripheralExit ();
+}
+
+u64 CGPIOPin::ReadAll64 (void)
+{
+	PeripheralEntry ();
+
+	u64 nResult = read32 (ARM_GPIO_GPLEV0);
+	nResult |= (u64) read32 (ARM_GPIO_GPLEV0 + 4) << 32;
+
+	PeripheralExit ();
+
+	return nResult;
+}
+
 void CGPIOPin::SetPullMode (TGPIOPullMode Mode)
 {
 	s_SpinLock.Acquire ();
@@ -0,0 +1,203 @@
+//
+// gpiowaveform.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/gpiowaveform.h>
+#include <circle/gpiopin.h>
+#include <circle/bcm2835.h>
+#include <circle/synchronize.h>
+#include <circle/util.h>
+#include <circle/new.h>
+#include <assert.h>
+
+#define MAX_BLOCKS_PER_STEP	6		// delay, timestamp, clear (2), set (2)
+
+CGPIOWaveform::CGPIOWaveform (unsigned nTickMicros, CInterruptSystem *pInterruptSystem,
+			      unsigned nMaxSteps)
+:	m_nTickMicros (nTickMicros),
+	m_nMaxSteps (nMaxSteps),
+	m_Pacer (nTickMicros),
+	m_DMA (DMA_CHANNEL_NORMAL, pInterruptSystem),
+	m_Pool (nMaxSteps * MAX_BLOCKS_PER_STEP + 1),
+	m_Chain (&m_DMA, &m_Pool),
+	m_pStepData (0),
+	m_pTrace (0)
+{
+	assert (m_nTickMicros > 0);
+	assert (m_nMaxSteps > 0);
+
+	m_pStepData = new (HEAP_DMA30) TStepData[m_nMaxSteps];
+	assert (m_pStepData != 0);
+
+	m_pTrace = new (HEAP_DMA30) TGPIOWaveTrace[m_nMaxSteps];
+	assert (m_pTrace != 0);
+	memset (m_pTrace, 0, m_nMaxSteps * sizeof (TGPIOWaveTrace));
+}
+
+CGPIOWaveform::~CGPIOWaveform (void)
+{
+	m_Chain.Clear ();
+
+	delete [] m_pTrace;
+	m_pTrace = 0;
+
+	delete [] m_pStepData;
+	m_pStepData = 0;
+}
+
+boolean CGPIOWaveform::Initialize (void)
+{
+	return m_Pacer.Initialize ();
+}
+
+boolean CGPIOWaveform::Create (const TGPIOWaveStep *pSteps, unsigned nSteps, unsigned nPeriod,
+			       TGPIOWaveMode Mode)
+{
+	assert (pSteps != 0);
+	assert (nSteps > 0);
+	assert (Mode < GPIOWaveModeUnknown);
+
+	m_Chain.Clear ();
+
+	if (nSteps > m_nMaxSteps)
+	{
+		return FALSE;
+	}
+
+	boolean bOK = TRUE;
+	unsigned nPrevTime = 0;
+	for (unsigned i = 0; bOK && i < nSteps; i++)
+	{
+		const TGPIOWaveStep *pStep = &pSteps[i];
+		assert (pStep->nTime >= nPrevTime);
+		assert (nPeriod == 0 || pStep->nTime < nPeriod);
+		assert (!(pStep->nSetMask >> GPIO_PINS));
+		assert (!(pStep->nClearMask >> GPIO_PINS));
+
+		// with repeated playback the delay before the first step is added at the end
+		unsigned nDelay = pStep->nTime - nPrevTime;
+		if (   nDelay > 0
+		    && (nPeriod == 0 || i > 0))
+		{
+			bOK = m_Pacer.AddDelay (&m_Chain, nDelay);
+		}
+
+		nPrevTime = pStep->nTime;
+
+		TStepData *pData = &m_pStepData[i];
+		pData->nClearMask[0] = (u32) pStep->nClearMask;
+		pData->nClearMask[1] = (u32) (pStep->nClearMask >> 32);
+		pData->nSetMask[0] = (u32) pStep->nSetMask;
+		pData->nSetMask[1] = (u32) (pStep->nSetMask >> 32);
+
+		if (Mode != GPIOWaveModeOutput)
+		{
+			m_pTrace[i].nTimestamp = 0;
+
+			bOK = bOK && m_Chain.AddIORead (&m_pTrace[i].nTimestamp, ARM_SYSTIMER_CLO,
+							sizeof (u32), DREQSourceNone);
+		}
+
+		if (Mode == GPIOWaveModeSimulate)
+		{
+			ASSERT_STATIC (sizeof (TStepData) == 4 * sizeof (u32));
+
+			bOK = bOK && m_Chain.AddMemCopy (m_pTrace[i].nClearMask, pData,
+							 sizeof (TStepData));
+
+			continue;
+		}
+
+		// only the registers of the used banks are written
+		for (unsigned nBank = 0; nBank < 2; nBank++)
+		{
+			if (pData->nClearMask[nBank] != 0)
+			{
+				bOK = bOK && m_Chain.AddIOWrite (ARM_GPIO_GPCLR0 + nBank*4,
+								 &pData->nClearMask[nBank],
+								 sizeof (u32), DREQSourceNone);
+			}
+		}
+
+		for (unsigned nBank = 0; nBank < 2; nBank++)
+		{
+			if (pData->nSetMask[nBank] != 0)
+			{
+				bOK = bOK && m_Chain.AddIOWrite (ARM_GPIO_GPSET0 + nBank*4,
+								 &pData->nSetMask[nBank],
+								 sizeof (u32), DREQSourceNone);
+			}
+		}
+	}
+
+	if (   bOK
+	    && nPeriod != 0)
+	{
+		unsigned nDelay = nPeriod - nPrevTime + pSteps[0].nTime;
+		assert (nDelay > 0);
+
+		bOK = m_Pacer.AddDelay (&m_Chain, nDelay);
+
+		m_Chain.SetCyclic ();
+	}
+
+	if (!bOK)
+	{
+		m_Chain.Clear ();
+	}
+
+	return bOK;
+}
+
+void CGPIOWaveform::SetCompletionRoutine (TDMACompletionRoutine *pRoutine, void *pParam)
+{
+	m_DMA.SetCompletionRoutine (pRoutine, pParam);
+}
+
+void CGPIOWaveform::Start (void)
+{
+	assert (m_Chain.GetLength () > 0);
+
+	// the pacing starts with the same FIFO level every time
+	m_Pacer.Prime ();
+
+	m_DMA.SetupChain (&m_Chain);
+	m_DMA.Start ();
+}
+
+boolean CGPIOWaveform::Wait (void)
+{
+	assert (!m_Chain.IsCyclic ());
+
+	return m_DMA.Wait ();
+}
+
+void CGPIOWaveform::Stop (void)
+{
+	m_DMA.Cancel ();
+}
+
+const TGPIOWaveTrace *CGPIOWaveform::GetTrace (void) const
+{
+	return m_pTrace;
+}
+
+unsigned CGPIOWaveform::GetTickMicros (void) const
+{
+	return m_nTickMicros;
+}
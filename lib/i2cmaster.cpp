@@ -26,8 +26,13 @@
 #include <circle/bcm2835.h>
 #include <circle/machineinfo.h>
 #include <circle/synchronize.h>
+#include <circle/sysconfig.h>
 #include <assert.h>
 
+#ifdef NO_BUSY_WAIT
+	#include <circle/sched/scheduler.h>
+#endif
+
 #if RASPPI < 4
 	#define DEVICES		2
 #else
@@ -99,14 +104,30 @@ static unsigned s_GPIOConfig[DEVICES][CONFIGS][GPIOS] =
 				 ? GPIOModeAlternateFunction0	\
 				 : GPIOModeAlternateFunction5)
 
-CI2CMaster::CI2CMaster (unsigned nDevice, boolean bFastMode, unsigned nConfig)
+unsigned CI2CMaster::s_nInterruptUseCount = 0;
+CI2CMaster *CI2CMaster::s_pThis[DEVICES] = {0};
+
+CI2CMaster::CI2CMaster (unsigned nDevice, boolean bFastMode, unsigned nConfig,
+			CInterruptSystem *pInterruptSystem, unsigned nQueueSize)
 :	m_nDevice (nDevice),
 	m_nBaseAddress (0),
 	m_bFastMode (bFastMode),
 	m_nConfig (nConfig),
 	m_bValid (FALSE),
 	m_nCoreClockRate (CMachineInfo::Get ()->GetClockRate (CLOCK_ID_CORE)),
-	m_SpinLock (TASK_LEVEL)
+	m_pInterruptSystem (pInterruptSystem),
+	m_SpinLock (pInterruptSystem != 0 ? IRQ_LEVEL : TASK_LEVEL),
+	m_ppQueue (0),
+	m_nQueueMask (0),
+	m_nQueueIn (0),
+	m_nQueueOut (0),
+	m_pActive (0),
+	m_bReadPhase (FALSE),
+	m_bWriteDataInFIFO (FALSE),
+	m_pWritePtr (0),
+	m_nWriteLeft (0),
+	m_pReadPtr (0),
+	m_nReadLeft (0)
 {
 	if (   m_nDevice >= DEVICES
 	    || m_nConfig >= CONFIGS
@@ -128,11 +149,36 @@ CI2CMaster::CI2CMaster (unsigned nDevice, boolean bFastMode, unsigned nConfig)
 
 	assert (m_nCoreClockRate > 0);
 
+	if (m_pInterruptSystem != 0)
+	{
+		assert (nQueueSize >= 2);
+		assert ((nQueueSize & (nQueueSize-1)) == 0);
+		m_ppQueue = new TI2CTransaction *[nQueueSize];
+		assert (m_ppQueue != 0);
+		m_nQueueMask = nQueueSize-1;
+	}
+
 	m_bValid = TRUE;
 }
 
 CI2CMaster::~CI2CMaster (void)
 {
+	if (   m_pInterruptSystem != 0
+	    && s_pThis[m_nDevice] == this)
+	{
+		PeripheralEntry ();
+		WriteReg (ARM_BSC_C__OFFSET, C_CLEAR);
+		PeripheralExit ();
+
+		s_pThis[m_nDevice] = 0;
+
+		assert (s_nInterruptUseCount > 0);
+		if (--s_nInterruptUseCount == 0)
+		{
+			m_pInterruptSystem->DisconnectIRQ (ARM_IRQ_I2C);
+		}
+	}
+
 	if (m_bValid)
 	{
 		m_SDA.SetMode (GPIOModeInput);
@@ -141,6 +187,10 @@ CI2CMaster::~CI2CMaster (void)
 		m_bValid = FALSE;
 	}
 
+	delete [] m_ppQueue;
+	m_ppQueue = 0;
+
+	m_pInterruptSystem = 0;
 	m_nBaseAddress = 0;
 }
 
@@ -153,6 +203,18 @@ boolean CI2CMaster::Initialize (void)
 
 	SetClock (m_bFastMode ? 400000 : 100000);
 
+	if (m_pInterruptSystem != 0)
+	{
+		// the BSC controllers share one interrupt line
+		assert (s_pThis[m_nDevice] == 0);
+		s_pThis[m_nDevice] = this;
+
+		if (s_nInterruptUseCount++ == 0)
+		{
+			m_pInterruptSystem->ConnectIRQ (ARM_IRQ_I2C, InterruptStub, 0);
+		}
+	}
+
 	return TRUE;
 }
 
@@ -164,7 +226,7 @@ void CI2CMaster::SetClock (unsigned nClockSpeed)
 
 	assert (nClockSpeed > 0);
 	u16 nDivider = (u16) (m_nCoreClockRate / nClockSpeed);
-	write32 (m_nBaseAddress + ARM_BSC_DIV__OFFSET, nDivider);
+	WriteReg (ARM_BSC_DIV__OFFSET, nDivider);
 	
 	PeripheralExit ();
 }
@@ -183,6 +245,11 @@ int CI2CMaster::Read (u8 ucAddress, void *pBuffer, unsigned nCount)
 		return -I2C_MASTER_INALID_PARM;
 	}
 
+	if (m_pInterruptSystem != 0)
+	{
+		return WriteRead (ucAddress, 0, 0, pBuffer, nCount);
+	}
+
 	m_SpinLock.Acquire ();
 
 	u8 *pData = (u8 *) pBuffer;
@@ -193,21 +260,21 @@ int CI2CMaster::Read (u8 ucAddress, void *pBuffer, unsigned nCount)
 	PeripheralEntry ();
 
 	// setup transfer
-	write32 (m_nBaseAddress + ARM_BSC_A__OFFSET, ucAddress);
+	WriteReg (ARM_BSC_A__OFFSET, ucAddress);
 
-	write32 (m_nBaseAddress + ARM_BSC_C__OFFSET, C_CLEAR);
-	write32 (m_nBaseAddress + ARM_BSC_S__OFFSET, S_CLKT | S_ERR | S_DONE);
+	WriteReg (ARM_BSC_C__OFFSET, C_CLEAR);
+	WriteReg (ARM_BSC_S__OFFSET, S_CLKT | S_ERR | S_DONE);
 
-	write32 (m_nBaseAddress + ARM_BSC_DLEN__OFFSET, nCount);
+	WriteReg (ARM_BSC_DLEN__OFFSET, nCount);
 
-	write32 (m_nBaseAddress + ARM_BSC_C__OFFSET, C_I2CEN | C_ST | C_READ);
+	WriteReg (ARM_BSC_C__OFFSET, C_I2CEN | C_ST | C_READ);
 
 	// transfer active
-	while (!(read32 (m_nBaseAddress + ARM_BSC_S__OFFSET) & S_DONE))
+	while (!(ReadReg (ARM_BSC_S__OFFSET) & S_DONE))
 	{
-		while (read32 (m_nBaseAddress + ARM_BSC_S__OFFSET) & S_RXD)
+		while (ReadReg (ARM_BSC_S__OFFSET) & S_RXD)
 		{
-			*pData++ = read32 (m_nBaseAddress + ARM_BSC_FIFO__OFFSET) & FIFO__MASK;
+			*pData++ = ReadReg (ARM_BSC_FIFO__OFFSET) & FIFO__MASK;
 
 			nCount--;
 			nResult++;
@@ -216,18 +283,18 @@ int CI2CMaster::Read (u8 ucAddress, void *pBuffer, unsigned nCount)
 
 	// transfer has finished, grab any remaining stuff from FIFO
 	while (   nCount > 0
-	       && (read32 (m_nBaseAddress + ARM_BSC_S__OFFSET) & S_RXD))
+	       && (ReadReg (ARM_BSC_S__OFFSET) & S_RXD))
 	{
-		*pData++ = read32 (m_nBaseAddress + ARM_BSC_FIFO__OFFSET) & FIFO__MASK;
+		*pData++ = ReadReg (ARM_BSC_FIFO__OFFSET) & FIFO__MASK;
 
 		nCount--;
 		nResult++;
 	}
 
-	u32 nStatus = read32 (m_nBaseAddress + ARM_BSC_S__OFFSET);
+	u32 nStatus = ReadReg (ARM_BSC_S__OFFSET);
 	if (nStatus & S_ERR)
 	{
-		write32 (m_nBaseAddress + ARM_BSC_S__OFFSET, S_ERR);
+		WriteReg (ARM_BSC_S__OFFSET, S_ERR);
 
 		nResult = -I2C_MASTER_ERROR_NACK;
 	}
@@ -240,7 +307,7 @@ int CI2CMaster::Read (u8 ucAddress, void *pBuffer, unsigned nCount)
 		nResult = -I2C_MASTER_DATA_LEFT;
 	}
 
-	write32 (m_nBaseAddress + ARM_BSC_S__OFFSET, S_DONE);
+	WriteReg (ARM_BSC_S__OFFSET, S_DONE);
 
 	PeripheralExit ();
 
@@ -263,6 +330,11 @@ int CI2CMaster::Write (u8 ucAddress, const void *pBuffer, unsigned nCount)
 		return -I2C_MASTER_INALID_PARM;
 	}
 
+	if (m_pInterruptSystem != 0)
+	{
+		return WriteRead (ucAddress, pBuffer, nCount, 0, 0);
+	}
+
 	m_SpinLock.Acquire ();
 
 	u8 *pData = (u8 *) pBuffer;
@@ -272,32 +344,32 @@ int CI2CMaster::Write (u8 ucAddress, const void *pBuffer, unsigned nCount)
 	PeripheralEntry ();
 
 	// setup transfer
-	write32 (m_nBaseAddress + ARM_BSC_A__OFFSET, ucAddress);
+	WriteReg (ARM_BSC_A__OFFSET, ucAddress);
 
-	write32 (m_nBaseAddress + ARM_BSC_C__OFFSET, C_CLEAR);
-	write32 (m_nBaseAddress + ARM_BSC_S__OFFSET, S_CLKT | S_ERR | S_DONE);
+	WriteReg (ARM_BSC_C__OFFSET, C_CLEAR);
+	WriteReg (ARM_BSC_S__OFFSET, S_CLKT | S_ERR | S_DONE);
 
-	write32 (m_nBaseAddress + ARM_BSC_DLEN__OFFSET, nCount);
+	WriteReg (ARM_BSC_DLEN__OFFSET, nCount);
 
 	// fill FIFO
 	for (unsigned i = 0; nCount > 0 && i < FIFO_SIZE; i++)
 	{
-		write32 (m_nBaseAddress + ARM_BSC_FIFO__OFFSET, *pData++);
+		WriteReg (ARM_BSC_FIFO__OFFSET, *pData++);
 
 		nCount--;
 		nResult++;
 	}
 
 	// start transfer
-	write32 (m_nBaseAddress + ARM_BSC_C__OFFSET, C_I2CEN | C_ST);
+	WriteReg (ARM_BSC_C__OFFSET, C_I2CEN | C_ST);
 
 	// transfer active
-	while (!(read32 (m_nBaseAddress + ARM_BSC_S__OFFSET) & S_DONE))
+	while (!(ReadReg (ARM_BSC_S__OFFSET) & S_DONE))
 	{
 		while (   nCount > 0
-		       && (read32 (m_nBaseAddress + ARM_BSC_S__OFFSET) & S_TXD))
+		       && (ReadReg (ARM_BSC_S__OFFSET) & S_TXD))
 		{
-			write32 (m_nBaseAddress + ARM_BSC_FIFO__OFFSET, *pData++);
+			WriteReg (ARM_BSC_FIFO__OFFSET, *pData++);
 
 			nCount--;
 			nResult++;
@@ -305,10 +377,10 @@ int CI2CMaster::Write (u8 ucAddress, const void *pBuffer, unsigned nCount)
 	}
 
 	// check status
-	u32 nStatus = read32 (m_nBaseAddress + ARM_BSC_S__OFFSET);
+	u32 nStatus = ReadReg (ARM_BSC_S__OFFSET);
 	if (nStatus & S_ERR)
 	{
-		write32 (m_nBaseAddress + ARM_BSC_S__OFFSET, S_ERR);
+		WriteReg (ARM_BSC_S__OFFSET, S_ERR);
 
 		nResult = -I2C_MASTER_ERROR_NACK;
 	}
@@ -321,7 +393,7 @@ int CI2CMaster::Write (u8 ucAddress, const void *pBuffer, unsigned nCount)
 		nResult = -I2C_MASTER_DATA_LEFT;
 	}
 
-	write32 (m_nBaseAddress + ARM_BSC_S__OFFSET, S_DONE);
+	WriteReg (ARM_BSC_S__OFFSET, S_DONE);
 
 	PeripheralExit ();
 
@@ -329,3 +401,382 @@ int CI2CMaster::Write (u8 ucAddress, const void *pBuffer, unsigned nCount)
 
 	return nResult;
 }
+
+int CI2CMaster::WriteRead (u8 ucAddress, const void *pWriteBuffer, unsigned nWriteCount,
+			   void *pReadBuffer, unsigned nReadCount)
+{
+	assert (m_bValid);
+
+	TI2CTransaction Transaction;
+	Transaction.ucAddress = ucAddress;
+	Transaction.pWriteBuffer = pWriteBuffer;
+	Transaction.nWriteCount = nWriteCount;
+	Transaction.pReadBuffer = pReadBuffer;
+	Transaction.nReadCount = nReadCount;
+	Transaction.pCompletionRoutine = 0;
+	Transaction.pParam = 0;
+	Transaction.nResult = 0;
+	Transaction.bCompleted = FALSE;
+
+	if (!IsValid (&Transaction))
+	{
+		return -I2C_MASTER_INALID_PARM;
+	}
+
+	if (m_pInterruptSystem == 0)
+	{
+		m_SpinLock.Acquire ();
+
+		PeripheralEntry ();
+
+		StartTransfer (&Transaction);
+
+		int nResult;
+		while (!ServiceTransfer (&nResult))
+		{
+			// just wait
+		}
+
+		m_pActive = 0;
+
+		PeripheralExit ();
+
+		m_SpinLock.Release ();
+
+		return nResult;
+	}
+
+	while (!SubmitTransaction (&Transaction))	// queue is full
+	{
+#ifdef NO_BUSY_WAIT
+		CScheduler::Get ()->Yield ();
+#endif
+	}
+
+	while (!Transaction.bCompleted)
+	{
+#ifdef NO_BUSY_WAIT
+		CScheduler::Get ()->Yield ();
+#endif
+	}
+
+	return Transaction.nResult;
+}
+
+boolean CI2CMaster::SubmitTransaction (TI2CTransaction *pTransaction)
+{
+	assert (m_bValid);
+
+	if (   m_pInterruptSystem == 0
+	    || !IsValid (pTransaction))
+	{
+		return FALSE;
+	}
+
+	pTransaction->nResult = 0;
+	pTransaction->bCompleted = FALSE;
+
+	m_SpinLock.Acquire ();
+
+	assert (m_ppQueue != 0);
+	if (m_nQueueIn - m_nQueueOut > m_nQueueMask)
+	{
+		m_SpinLock.Release ();
+
+		return FALSE;
+	}
+
+	m_ppQueue[m_nQueueIn++ & m_nQueueMask] = pTransaction;
+
+	if (m_pActive == 0)
+	{
+		PeripheralEntry ();
+
+		StartNextTransaction ();
+
+		PeripheralExit ();
+	}
+
+	m_SpinLock.Release ();
+
+	return TRUE;
+}
+
+u32 CI2CMaster::ReadReg (unsigned nOffset)
+{
+	return read32 (m_nBaseAddress + nOffset);
+}
+
+void CI2CMaster::WriteReg (unsigned nOffset, u32 nValue)
+{
+	write32 (m_nBaseAddress + nOffset, nValue);
+}
+
+void CI2CMaster::InterruptHandler (void)
+{
+	m_SpinLock.Acquire ();
+
+	if (m_pActive == 0)			// may be an interrupt of another device
+	{
+		m_SpinLock.Release ();
+
+		return;
+	}
+
+	PeripheralEntry ();
+
+	TI2CTransaction *pCompleted = 0;
+	int nResult;
+	if (ServiceTransfer (&nResult))
+	{
+		pCompleted = m_pActive;
+		m_pActive = 0;
+
+		StartNextTransaction ();
+	}
+
+	PeripheralExit ();
+
+	m_SpinLock.Release ();
+
+	if (pCompleted != 0)
+	{
+		// the transaction may be gone, when bCompleted has been set
+		TI2CCompletionRoutine *pRoutine = pCompleted->pCompletionRoutine;
+		void *pParam = pCompleted->pParam;
+
+		pCompleted->nResult = nResult;
+		DataMemBarrier ();
+		pCompleted->bCompleted = TRUE;
+
+		if (pRoutine != 0)
+		{
+			(*pRoutine) (pCompleted, pParam);
+		}
+	}
+}
+
+boolean CI2CMaster::IsValid (const TI2CTransaction *pTransaction)
+{
+	if (   pTransaction == 0
+	    || pTransaction->ucAddress >= 0x80)
+	{
+		return FALSE;
+	}
+
+	if (   (pTransaction->nWriteCount != 0 && pTransaction->pWriteBuffer == 0)
+	    || (pTransaction->nReadCount != 0 && pTransaction->pReadBuffer == 0))
+	{
+		return FALSE;
+	}
+
+	// the write part of a combined transaction must fit into the FIFO
+	if (   pTransaction->nWriteCount != 0
+	    && pTransaction->nReadCount != 0
+	    && pTransaction->nWriteCount > FIFO_SIZE)
+	{
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+void CI2CMaster::StartNextTransaction (void)
+{
+	assert (m_pActive == 0);
+
+	if (m_nQueueIn != m_nQueueOut)
+	{
+		StartTransfer (m_ppQueue[m_nQueueOut++ & m_nQueueMask]);
+	}
+}
+
+void CI2CMaster::StartTransfer (TI2CTransaction *pTransaction)
+{
+	assert (pTransaction != 0);
+	m_pActive = pTransaction;
+
+	m_pWritePtr = (const u8 *) pTransaction->pWriteBuffer;
+	m_nWriteLeft = pTransaction->nWriteCount;
+	m_pReadPtr = (u8 *) pTransaction->pReadBuffer;
+	m_nReadLeft = pTransaction->nReadCount;
+	m_bWriteDataInFIFO = FALSE;
+
+	// the controller does not interrupt, if we poll
+	u32 nIntMask = m_pInterruptSystem != 0 ? C_INTD : 0;
+
+	// setup transfer
+	WriteReg (ARM_BSC_A__OFFSET, pTransaction->ucAddress);
+
+	WriteReg (ARM_BSC_C__OFFSET, C_CLEAR);
+	WriteReg (ARM_BSC_S__OFFSET, S_CLKT | S_ERR | S_DONE);
+
+	if (m_nReadLeft == 0)
+	{
+		// write only
+		m_bReadPhase = FALSE;
+
+		WriteReg (ARM_BSC_DLEN__OFFSET, m_nWriteLeft);
+
+		for (unsigned i = 0; m_nWriteLeft > 0 && i < FIFO_SIZE; i++)
+		{
+			WriteReg (ARM_BSC_FIFO__OFFSET, *m_pWritePtr++);
+
+			m_nWriteLeft--;
+		}
+
+		if (   m_nWriteLeft > 0
+		    && m_pInterruptSystem != 0)
+		{
+			nIntMask |= C_INTT;
+		}
+
+		WriteReg (ARM_BSC_C__OFFSET, C_I2CEN | C_ST | nIntMask);
+
+		return;
+	}
+
+	if (m_nWriteLeft > 0)
+	{
+		// combined transfer: write phase fits into the FIFO
+		m_bReadPhase = FALSE;
+
+		assert (m_nWriteLeft <= FIFO_SIZE);
+		WriteReg (ARM_BSC_DLEN__OFFSET, m_nWriteLeft);
+
+		while (m_nWriteLeft > 0)
+		{
+			WriteReg (ARM_BSC_FIFO__OFFSET, *m_pWritePtr++);
+
+			m_nWriteLeft--;
+		}
+
+		m_bWriteDataInFIFO = TRUE;
+
+		// the read phase is set up in ServiceTransfer(), when the write phase has
+		// started (TXW is only set with TA)
+		if (m_pInterruptSystem != 0)
+		{
+			nIntMask |= C_INTT;
+		}
+
+		WriteReg (ARM_BSC_C__OFFSET, C_I2CEN | C_ST | nIntMask);
+
+		return;
+	}
+
+	StartReadPhase ();
+}
+
+void CI2CMaster::StartReadPhase (void)
+{
+	// follows with repeated start, if the write phase is still active
+	m_bReadPhase = TRUE;
+
+	u32 nIntMask = m_pInterruptSystem != 0 ? C_INTD | C_INTR : 0;
+
+	WriteReg (ARM_BSC_DLEN__OFFSET, m_nReadLeft);
+	WriteReg (ARM_BSC_C__OFFSET, C_I2CEN | C_ST | C_READ | nIntMask);
+}
+
+boolean CI2CMaster::ServiceTransfer (int *pResult)
+{
+	assert (m_pActive != 0);
+
+	u32 nStatus = ReadReg (ARM_BSC_S__OFFSET);
+
+	if (   !m_bReadPhase
+	    && m_nReadLeft > 0
+	    && !(nStatus & (S_CLKT | S_ERR)))
+	{
+		// write phase of a combined transfer
+		if (!(nStatus & (S_TA | S_DONE)))
+		{
+			return FALSE;
+		}
+
+		// the write phase may have completed already, the read phase starts anyway
+		if (nStatus & S_DONE)
+		{
+			WriteReg (ARM_BSC_S__OFFSET, S_DONE);
+		}
+
+		StartReadPhase ();
+
+		return FALSE;
+	}
+
+	if (m_bReadPhase)
+	{
+		// the FIFO is shared, so it must not be read before the write data has been sent
+		if (   m_bWriteDataInFIFO
+		    && (nStatus & (S_TXE | S_RXR | S_CLKT | S_ERR | S_DONE)))
+		{
+			m_bWriteDataInFIFO = FALSE;
+		}
+
+		while (   !m_bWriteDataInFIFO
+		       && m_nReadLeft > 0
+		       && (ReadReg (ARM_BSC_S__OFFSET) & S_RXD))
+		{
+			*m_pReadPtr++ = ReadReg (ARM_BSC_FIFO__OFFSET) & FIFO__MASK;
+
+			m_nReadLeft--;
+		}
+	}
+	else if (m_nWriteLeft > 0)
+	{
+		while (   m_nWriteLeft > 0
+		       && (ReadReg (ARM_BSC_S__OFFSET) & S_TXD))
+		{
+			WriteReg (ARM_BSC_FIFO__OFFSET, *m_pWritePtr++);
+
+			m_nWriteLeft--;
+		}
+
+		if (   m_nWriteLeft == 0
+		    && m_pInterruptSystem != 0)
+		{
+			WriteReg (ARM_BSC_C__OFFSET, C_I2CEN | C_INTD);
+		}
+	}
+
+	if (!(nStatus & (S_CLKT | S_ERR | S_DONE)))
+	{
+		return FALSE;
+	}
+
+	assert (pResult != 0);
+	if (nStatus & S_ERR)
+	{
+		*pResult = -I2C_MASTER_ERROR_NACK;
+	}
+	else if (nStatus & S_CLKT)
+	{
+		*pResult = -I2C_MASTER_ERROR_CLKT;
+	}
+	else if (m_bReadPhase ? m_nReadLeft > 0 : m_nWriteLeft > 0)
+	{
+		*pResult = -I2C_MASTER_DATA_LEFT;
+	}
+	else
+	{
+		*pResult = m_bReadPhase ? m_pActive->nReadCount : m_pActive->nWriteCount;
+	}
+
+	WriteReg (ARM_BSC_S__OFFSET, S_CLKT | S_ERR | S_DONE);
+	WriteReg (ARM_BSC_C__OFFSET, C_CLEAR);
+
+	return TRUE;
+}
+
+void CI2CMaster::InterruptStub (void *pParam)
+{
+	for (unsigned i = 0; i < DEVICES; i++)
+	{
+		if (s_pThis[i] != 0)
+		{
+			s_pThis[i]->InterruptHandler ();
+		}
+	}
+}
@@ -23,6 +23,9 @@
 #include <circle/bcm2835.h>
 #include <circle/bcm2836.h>
 #include <circle/memio.h>
+#include <circle/cyclecounter.h>
+#include <circle/softirq.h>
+#include <circle/tracepoint.h>
 #include <circle/sysconfig.h>
 #include <circle/types.h>
 #include <assert.h>
@@ -56,6 +59,10 @@ CInterruptSystem::CInterruptSystem (void)
 		m_pParam[nIRQ] = 0;
 	}
 
+#ifdef IRQ_STATISTICS
+	ResetStatistics ();
+#endif
+
 	s_pThis = this;
 }
 
@@ -234,15 +241,25 @@ CInterruptSystem *CInterruptSystem::Get (void)
 	return s_pThis;
 }
 
-boolean CInterruptSystem::CallIRQHandler (unsigned nIRQ)
+boolean CInterruptSystem::CallIRQHandler (unsigned nIRQ, u32 nEntryCycles)
 {
 	assert (nIRQ < IRQ_LINES);
 	TIRQHandler *pHandler = m_apIRQHandler[nIRQ];
 
 	if (pHandler != 0)
 	{
+#ifdef IRQ_STATISTICS
+		u32 nStartCycles = CCycleCounter::Read ();
+#endif
+		TRACEPOINT (TracepointIRQEntry, nIRQ);
+
 		(*pHandler) (m_pParam[nIRQ]);
-		
+
+		TRACEPOINT (TracepointIRQExit, nIRQ);
+#ifdef IRQ_STATISTICS
+		UpdateStatistics (nIRQ, nEntryCycles, nStartCycles);
+#endif
+
 		return TRUE;
 	}
 	else
@@ -253,58 +270,80 @@ boolean CInterruptSystem::CallIRQHandler (unsigned nIRQ)
 	return FALSE;
 }
 
+// All pending IRQs are handled, before the exception returns. The pending
+// registers are read again, until no IRQ is pending any more.
+
 void CInterruptSystem::InterruptHandler (void)
 {
 	assert (s_pThis != 0);
 
-#if RASPPI >= 2
-	u32 nLocalPending = read32 (ARM_LOCAL_IRQ_PENDING0);
-	assert (!(nLocalPending & ~(1 << 1 | 0xF << 4 | 1 << 8)));
-	if (nLocalPending & (1 << 1))		// the only implemented local IRQ so far
+	u32 nEntryCycles = 0;
+#ifdef IRQ_STATISTICS
+	CCycleCounter::Enable ();
+	nEntryCycles = CCycleCounter::Read ();
+#endif
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	unsigned nCore = CMultiCoreSupport::ThisCore ();
+#elif RASPPI >= 2
+	unsigned nCore = 0;
+#endif
+
+	boolean bPending;
+	do
 	{
-		s_pThis->CallIRQHandler (ARM_IRQLOCAL0_CNTPNS);
+		bPending = FALSE;
 
-		return;
-	}
+#if RASPPI >= 2
+		u32 nLocalPending = read32 (ARM_LOCAL_IRQ_PENDING0 + 4*nCore);
+		assert (!(nLocalPending & ~(1 << 1 | 0xF << 4 | 1 << 8)));
+		if (nLocalPending & (1 << 1))		// the only implemented local IRQ so far
+		{
+			s_pThis->CallIRQHandler (ARM_IRQLOCAL0_CNTPNS, nEntryCycles);
+
+			bPending = TRUE;
+		}
 #endif
 
 #ifdef ARM_ALLOW_MULTI_CORE
-	if (CMultiCoreSupport::LocalInterruptHandler ())
-	{
-		return;
-	}
+		while (CMultiCoreSupport::LocalInterruptHandler ())
+		{
+			bPending = TRUE;
+		}
+
+		// the peripheral IRQs are routed to core 0 only
+		if (nCore != 0)
+		{
+			continue;
+		}
 #endif
 
-	PeripheralEntry ();
+		PeripheralEntry ();
 
-	u32 Pending[ARM_IC_IRQ_REGS];
-	Pending[0] = read32 (ARM_IC_IRQ_PENDING_1);
-	Pending[1] = read32 (ARM_IC_IRQ_PENDING_2);
-	Pending[2] = read32 (ARM_IC_IRQ_BASIC_PENDING) & 0xFF;
+		u32 Pending[ARM_IC_IRQ_REGS];
+		Pending[0] = read32 (ARM_IC_IRQ_PENDING_1);
+		Pending[1] = read32 (ARM_IC_IRQ_PENDING_2);
+		Pending[2] = read32 (ARM_IC_IRQ_BASIC_PENDING) & 0xFF;
 
-	PeripheralExit ();
+		PeripheralExit ();
 
-	for (unsigned nReg = 0; nReg < ARM_IC_IRQ_REGS; nReg++)
-	{
-		u32 nPending = Pending[nReg];
-		if (nPending != 0)
+		for (unsigned nReg = 0; nReg < ARM_IC_IRQ_REGS; nReg++)
 		{
-			unsigned nIRQ = nReg * ARM_IRQS_PER_REG;
-
-			do
+			u32 nPending = Pending[nReg];
+			while (nPending != 0)
 			{
-				if (   (nPending & 1)
-				    && s_pThis->CallIRQHandler (nIRQ))
-				{
-					return;
-				}
-
-				nPending >>= 1;
-				nIRQ++;
+				// lowest pending IRQ first (count trailing zeros)
+				unsigned nIRQ = nReg * ARM_IRQS_PER_REG + __builtin_ctz (nPending);
+				nPending &= nPending - 1;
+
+				// unconnected IRQs are disabled here
+				s_pThis->CallIRQHandler (nIRQ, nEntryCycles);
+
+				bPending = TRUE;
 			}
-			while (nPending != 0);
 		}
 	}
+	while (bPending);
 }
 
 void InterruptHandler (void)
@@ -313,5 +352,7 @@ void InterruptHandler (void)
 	
 	CInterruptSystem::InterruptHandler ();
 
+	CSoftIRQ::RunPending ();	// deferred work of the handled IRQs
+
 	PeripheralEntry ();	// continuing with interrupted peripheral
 }
@@ -0,0 +1,116 @@
+//
+// interruptcommon.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/interrupt.h>
+#include <circle/synchronize.h>
+#include <circle/cyclecounter.h>
+#include <circle/string.h>
+#include <assert.h>
+
+// This file contains the parts of CInterruptSystem, which are common for
+// the BCM2835 interrupt controller (interrupt.cpp) and the GIC (interruptgic.cpp).
+
+void CInterruptSystem::ListInterrupts (CDevice *pTarget)
+{
+	assert (pTarget != 0);
+
+	CString String;
+#ifdef IRQ_STATISTICS
+	String.Format ("IRQ %-10s %10s %10s %10s %10s %10s\n", "Handler", "Count",
+		       "Avg cyc", "Max cyc", "Avg lat", "Max lat");
+#else
+	String.Format ("IRQ %-10s\n", "Handler");
+#endif
+	pTarget->Write ((const char *) String, String.GetLength ());
+
+	for (unsigned nIRQ = 0; nIRQ < IRQ_LINES; nIRQ++)
+	{
+		if (m_apIRQHandler[nIRQ] == 0)
+		{
+			continue;
+		}
+
+#ifdef IRQ_STATISTICS
+		// take a consistent snapshot
+		EnterCritical ();
+		TIRQStatistics Stat = m_Statistics[nIRQ];
+		LeaveCritical ();
+
+		unsigned nCount = Stat.nCount > 0 ? Stat.nCount : 1;
+
+		String.Format ("%3u %-10lX %10u %10u %10u %10u %10u\n", nIRQ,
+			       (unsigned long) m_apIRQHandler[nIRQ], Stat.nCount,
+			       (unsigned) (Stat.ullCycles / nCount), Stat.nMaxCycles,
+			       (unsigned) (Stat.ullLatency / nCount), Stat.nMaxLatency);
+#else
+		String.Format ("%3u %-10lX\n", nIRQ, (unsigned long) m_apIRQHandler[nIRQ]);
+#endif
+
+		pTarget->Write ((const char *) String, String.GetLength ());
+	}
+}
+
+#ifdef IRQ_STATISTICS
+
+void CInterruptSystem::ResetStatistics (void)
+{
+	EnterCritical ();
+
+	for (unsigned nIRQ = 0; nIRQ < IRQ_LINES; nIRQ++)
+	{
+		TIRQStatistics *pStat = &m_Statistics[nIRQ];
+
+		pStat->nCount = 0;
+		pStat->ullCycles = 0;
+		pStat->nMaxCycles = 0;
+		pStat->ullLatency = 0;
+		pStat->nMaxLatency = 0;
+	}
+
+	LeaveCritical ();
+}
+
+// The latency is measured from the entry of InterruptHandler() to the call of the
+// IRQ handler, so it includes the time spent in the handlers of other IRQs, which
+// have been handled before in the same exception.
+
+void CInterruptSystem::UpdateStatistics (unsigned nIRQ, u32 nEntryCycles, u32 nStartCycles)
+{
+	u32 nCycles = CCycleCounter::Read () - nStartCycles;
+	u32 nLatency = nStartCycles - nEntryCycles;
+
+	assert (nIRQ < IRQ_LINES);
+	TIRQStatistics *pStat = &m_Statistics[nIRQ];
+
+	pStat->nCount++;
+
+	pStat->ullCycles += nCycles;
+	if (nCycles > pStat->nMaxCycles)
+	{
+		pStat->nMaxCycles = nCycles;
+	}
+
+	pStat->ullLatency += nLatency;
+	if (nLatency > pStat->nMaxLatency)
+	{
+		pStat->nMaxLatency = nLatency;
+	}
+}
+
+#endif
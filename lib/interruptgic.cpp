@@ -25,6 +25,9 @@
 #include <circle/bcm2711.h>
 #include <circle/memio.h>
 #include <circle/logger.h>
+#include <circle/cyclecounter.h>
+#include <circle/softirq.h>
+#include <circle/tracepoint.h>
 #include <circle/sysconfig.h>
 #include <circle/types.h>
 #include <assert.h>
@@ -94,6 +97,10 @@ CInterruptSystem::CInterruptSystem (void)
 		m_pParam[nIRQ] = 0;
 	}
 
+#ifdef IRQ_STATISTICS
+	ResetStatistics ();
+#endif
+
 	s_pThis = this;
 }
 
@@ -272,15 +279,25 @@ CInterruptSystem *CInterruptSystem::Get (void)
 	return s_pThis;
 }
 
-boolean CInterruptSystem::CallIRQHandler (unsigned nIRQ)
+boolean CInterruptSystem::CallIRQHandler (unsigned nIRQ, u32 nEntryCycles)
 {
 	assert (nIRQ < IRQ_LINES);
 	TIRQHandler *pHandler = m_apIRQHandler[nIRQ];
 
 	if (pHandler != 0)
 	{
+#ifdef IRQ_STATISTICS
+		u32 nStartCycles = CCycleCounter::Read ();
+#endif
+		TRACEPOINT (TracepointIRQEntry, nIRQ);
+
 		(*pHandler) (m_pParam[nIRQ]);
-		
+
+		TRACEPOINT (TracepointIRQExit, nIRQ);
+#ifdef IRQ_STATISTICS
+		UpdateStatistics (nIRQ, nEntryCycles, nStartCycles);
+#endif
+
 		return TRUE;
 	}
 	else
@@ -291,18 +308,35 @@ boolean CInterruptSystem::CallIRQHandler (unsigned nIRQ)
 	return FALSE;
 }
 
+// All pending IRQs are acknowledged and handled, before the exception returns,
+// until the GIC reports a spurious interrupt (no IRQ pending any more).
+
 void CInterruptSystem::InterruptHandler (void)
 {
-	u32 nIAR = read32 (GICC_IAR);
+	u32 nEntryCycles = 0;
+#ifdef IRQ_STATISTICS
+	CCycleCounter::Enable ();
+	nEntryCycles = CCycleCounter::Read ();
+#endif
 
-	unsigned nIRQ = nIAR & GICC_IAR_INTERRUPT_ID__MASK;
-	if (nIRQ < IRQ_LINES)
+	while (1)
 	{
+		u32 nIAR = read32 (GICC_IAR);
+
+		unsigned nIRQ = nIAR & GICC_IAR_INTERRUPT_ID__MASK;
+		if (nIRQ >= IRQ_LINES)
+		{
+			// spurious interrupt
+			assert (nIRQ >= 1020);
+
+			break;
+		}
+
 		if (nIRQ > 15)
 		{
 			// peripheral interrupts (PPI and SPI)
 			assert (s_pThis != 0);
-			s_pThis->CallIRQHandler (nIRQ);
+			s_pThis->CallIRQHandler (nIRQ, nEntryCycles);
 		}
 #ifdef ARM_ALLOW_MULTI_CORE
 		else
@@ -315,18 +349,13 @@ void CInterruptSystem::InterruptHandler (void)
 
 		write32 (GICC_EOIR, nIAR);
 	}
-#ifndef NDEBUG
-	else
-	{
-		// spurious interrupts
-		assert (nIRQ >= 1020);
-	}
-#endif
 }
 
 void InterruptHandler (void)
 {
 	CInterruptSystem::InterruptHandler ();
+
+	CSoftIRQ::RunPending ();	// deferred work of the handled IRQs
 }
 
 void CInterruptSystem::InitializeSecondary (void)
@@ -346,6 +375,19 @@ void CInterruptSystem::SendIPI (unsigned nCore, unsigned nIPI)
 			    | nIPI);
 }
 
+void CInterruptSystem::SetIRQTargetCore (unsigned nIRQ, unsigned nCore)
+{
+	assert (nIRQ >= 32);		// SGIs and PPIs are banked per core
+	assert (nIRQ < IRQ_LINES);
+	assert (nCore <= 7);
+
+	u32 nReg = GICD_ITARGETSR0 + (nIRQ / 4) * 4;
+	u32 nShift = (nIRQ % 4) * 8;
+
+	write32 (nReg,   (read32 (nReg) & ~(0xFF << nShift))
+		       | (GICD_ITARGETSR_CORE0 << nCore) << nShift);
+}
+
 #if AARCH == 32
 
 void CInterruptSystem::CallSecureMonitor (u32 nFunction, u32 nParam)
@@ -0,0 +1,196 @@
+//
+// lockstatistics.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/lockstatistics.h>
+
+#if defined (ARM_ALLOW_MULTI_CORE) && defined (LOCK_STATISTICS)
+
+#include <circle/spinlock.h>
+#include <circle/logger.h>
+#include <assert.h>
+
+CLockStatistics *CLockStatistics::s_pFirst = 0;
+
+static CSpinLock s_ListSpinLock (TASK_LEVEL);	// unnamed, so it has no statistics itself
+
+static const char From[] = "lockstat";
+
+CLockStatistics::CLockStatistics (const char *pName)
+:	m_pName (pName),
+	m_pNext (0),
+	m_pPrev (0)
+{
+	Reset ();
+
+	if (m_pName != 0)
+	{
+		s_ListSpinLock.Acquire ();
+
+		m_pNext = s_pFirst;
+		if (m_pNext != 0)
+		{
+			m_pNext->m_pPrev = this;
+		}
+		s_pFirst = this;
+
+		s_ListSpinLock.Release ();
+	}
+}
+
+CLockStatistics::~CLockStatistics (void)
+{
+	if (m_pName != 0)
+	{
+		s_ListSpinLock.Acquire ();
+
+		if (m_pPrev != 0)
+		{
+			m_pPrev->m_pNext = m_pNext;
+		}
+		else
+		{
+			assert (s_pFirst == this);
+			s_pFirst = m_pNext;
+		}
+
+		if (m_pNext != 0)
+		{
+			m_pNext->m_pPrev = m_pPrev;
+		}
+
+		s_ListSpinLock.Release ();
+
+		m_pName = 0;
+	}
+}
+
+u64 CLockStatistics::GetTimestamp (void)
+{
+#if AARCH == 32
+	u32 nCNTPCTLow, nCNTPCTHigh;
+	asm volatile ("mrrc p15, 0, %0, %1, c14" : "=r" (nCNTPCTLow), "=r" (nCNTPCTHigh));
+
+	return (u64) nCNTPCTHigh << 32 | nCNTPCTLow;
+#else
+	u64 nCNTPCT;
+	asm volatile ("mrs %0, CNTPCT_EL0" : "=r" (nCNTPCT));
+
+	return nCNTPCT;
+#endif
+}
+
+void CLockStatistics::Dump (void)
+{
+#if AARCH == 32
+	u32 nCNTFRQ;
+	asm volatile ("mrc p15, 0, %0, c14, c0, 0" : "=r" (nCNTFRQ));
+#else
+	u64 nCNTFRQ;
+	asm volatile ("mrs %0, CNTFRQ_EL0" : "=r" (nCNTFRQ));
+#endif
+	assert (nCNTFRQ > 0);
+
+	CLogger::Get ()->Write (From, LogNotice,
+				"%-16s %10s %10s %12s %10s %10s", "Lock", "Acquired", "Contended",
+				"Spin us", "Spin/acq ns", "Max hold us");
+
+	s_ListSpinLock.Acquire ();
+
+	for (CLockStatistics *pStat = s_pFirst; pStat != 0; pStat = pStat->m_pNext)
+	{
+		assert (pStat->m_pName != 0);
+
+		// take a snapshot, the lock may be in use in the meantime
+		unsigned nAcquisitions = pStat->m_nAcquisitions;
+		unsigned nContended = pStat->m_nContended;
+		u64 ullSpinNanos = pStat->m_ullSpinTicks * 1000000000ULL / nCNTFRQ;
+		u64 ullMaxHoldNanos = pStat->m_ullMaxHoldTicks * 1000000000ULL / nCNTFRQ;
+
+		if (nAcquisitions == 0)
+		{
+			continue;
+		}
+
+		CLogger::Get ()->Write (From, LogNotice,
+					"%-16s %10u %10u %12lu %10lu %10lu", pStat->m_pName,
+					nAcquisitions, nContended,
+					(unsigned long) (ullSpinNanos / 1000),
+					(unsigned long) (ullSpinNanos / nAcquisitions),
+					(unsigned long) (ullMaxHoldNanos / 1000));
+	}
+
+	s_ListSpinLock.Release ();
+}
+
+void CLockStatistics::ResetAll (void)
+{
+	s_ListSpinLock.Acquire ();
+
+	for (CLockStatistics *pStat = s_pFirst; pStat != 0; pStat = pStat->m_pNext)
+	{
+		pStat->Reset ();
+	}
+
+	s_ListSpinLock.Release ();
+}
+
+void CLockStatistics::Update (u64 ullWaitStart, boolean bContended, boolean bExclusive)
+{
+	u64 ullNow = GetTimestamp ();
+
+	// readers of a CRWSpinLock may update the statistics concurrently
+	__atomic_add_fetch (&m_nAcquisitions, 1, __ATOMIC_RELAXED);
+	if (bContended)
+	{
+		__atomic_add_fetch (&m_nContended, 1, __ATOMIC_RELAXED);
+		__atomic_add_fetch (&m_ullSpinTicks, ullNow - ullWaitStart, __ATOMIC_RELAXED);
+	}
+
+	if (bExclusive)
+	{
+		m_ullHoldStart = ullNow;
+	}
+}
+
+void CLockStatistics::UpdateHoldTime (void)
+{
+	if (m_ullHoldStart == 0)	// acquired before spin locks were enabled
+	{
+		return;
+	}
+
+	u64 ullHoldTicks = GetTimestamp () - m_ullHoldStart;
+	if (ullHoldTicks > m_ullMaxHoldTicks)
+	{
+		m_ullMaxHoldTicks = ullHoldTicks;
+	}
+
+	m_ullHoldStart = 0;
+}
+
+void CLockStatistics::Reset (void)
+{
+	m_nAcquisitions = 0;
+	m_nContended = 0;
+	m_ullSpinTicks = 0;
+	m_ullHoldStart = 0;
+	m_ullMaxHoldTicks = 0;
+}
+
+#endif
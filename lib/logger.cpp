@@ -18,6 +18,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/logger.h>
+#include <circle/logrecordbuffer.h>
 #include <circle/string.h>
 #include <circle/synchronize.h>
 #include <circle/startup.h>
@@ -27,6 +28,7 @@
 #include <circle/machineinfo.h>
 #include <circle/version.h>
 #include <circle/debug.h>
+#include <assert.h>
 
 struct TLogEvent
 {
@@ -48,10 +50,13 @@ CLogger::CLogger (unsigned nLogLevel, CTimer *pTimer, boolean bOverwriteOldest)
 	m_pBuffer (0),
 	m_nInPtr (0),
 	m_nOutPtr (0),
+	m_SpinLock (IRQ_LEVEL, "logger"),
 	m_nEventInPtr (0),
 	m_nEventOutPtr (0),
 	m_pEventNotificationHandler (0),
-	m_pPanicHandler (0)
+	m_pPanicHandler (0),
+	m_pRecordBuffer (0),
+	m_bFlushing (FALSE)
 {
 	m_pBuffer = new char[LOGGER_BUFSIZE];
 
@@ -62,6 +67,9 @@ CLogger::~CLogger (void)
 {
 	s_pThis = 0;
 
+	delete m_pRecordBuffer;
+	m_pRecordBuffer = 0;
+
 	while (m_nEventInPtr != m_nEventOutPtr)
 	{
 		delete m_pEventQueue[m_nEventOutPtr];
@@ -109,6 +117,30 @@ void CLogger::Write (const char *pSource, TLogSeverity Severity, const char *pMe
 
 void CLogger::WriteV (const char *pSource, TLogSeverity Severity, const char *pMessage, va_list Args)
 {
+	if (m_pRecordBuffer != 0)
+	{
+		if (Severity == LogPanic)
+		{
+			// write pending messages before halting the system, even if a flush
+			// is in progress, because it may have been interrupted by this panic
+			__atomic_store_n (&m_bFlushing, TRUE, __ATOMIC_RELAXED);
+
+			FlushRecords ();
+		}
+		else
+		{
+			va_list ArgsCopy;
+			va_copy (ArgsCopy, Args);
+			boolean bCaptured = m_pRecordBuffer->Write (pSource, Severity, pMessage, ArgsCopy);
+			va_end (ArgsCopy);
+
+			if (bCaptured)
+			{
+				return;
+			}
+		}
+	}
+
 	CString Message;
 	Message.FormatV (pMessage, Args);
 
@@ -119,6 +151,20 @@ void CLogger::WriteV (const char *pSource, TLogSeverity Severity, const char *pM
 		return;
 	}
 
+	CString *pTimeString = 0;
+	if (m_pTimer != 0)
+	{
+		pTimeString = m_pTimer->GetTimeString ();
+	}
+
+	WriteMessage (pSource, Severity, Message, pTimeString != 0 ? (const char *) *pTimeString : 0);
+
+	delete pTimeString;
+}
+
+void CLogger::WriteMessage (const char *pSource, TLogSeverity Severity, const char *pMessage,
+			    const char *pTimeString)
+{
 	CString Buffer;
 
 #ifdef USE_LOG_COLORS
@@ -136,22 +182,16 @@ void CLogger::WriteV (const char *pSource, TLogSeverity Severity, const char *pM
 	}
 #endif
 
-	if (m_pTimer != 0)
+	if (pTimeString != 0)
 	{
-		CString *pTimeString = m_pTimer->GetTimeString ();
-		if (pTimeString != 0)
-		{
-			Buffer.Append (*pTimeString);
-			Buffer.Append (" ");
-
-			delete pTimeString;
-		}
+		Buffer.Append (pTimeString);
+		Buffer.Append (" ");
 	}
 
 	Buffer.Append (pSource);
 	Buffer.Append (": ");
 
-	Buffer.Append (Message);
+	Buffer.Append (pMessage);
 
 #ifdef USE_LOG_COLORS
 	if (Severity <= LogWarning)
@@ -234,6 +274,122 @@ void CLogger::WriteNoAlloc (const char *pSource, TLogSeverity Severity, const ch
 	}
 }
 
+boolean CLogger::EnableAsync (unsigned nRecordsPerCore)
+{
+	if (m_pRecordBuffer != 0)
+	{
+		return TRUE;
+	}
+
+	m_pRecordBuffer = new CLogRecordBuffer (nRecordsPerCore);
+
+	return m_pRecordBuffer != 0;
+}
+
+unsigned CLogger::Flush (void)
+{
+	if (   m_pRecordBuffer == 0
+	    || __atomic_exchange_n (&m_bFlushing, TRUE, __ATOMIC_ACQUIRE))
+	{
+		return 0;
+	}
+
+	unsigned nMessages = FlushRecords ();
+
+	__atomic_store_n (&m_bFlushing, FALSE, __ATOMIC_RELEASE);
+
+	return nMessages;
+}
+
+unsigned CLogger::FlushRecords (void)
+{
+	assert (m_pRecordBuffer != 0);
+
+	unsigned nMessages = 0;
+
+	CString Source;
+	CString Message;
+	unsigned nSeverity;
+	unsigned nClockTicks;
+	while (m_pRecordBuffer->Read (&Source, &nSeverity, &Message, &nClockTicks))
+	{
+		TLogSeverity Severity = (TLogSeverity) nSeverity;
+
+		WriteEvent (Source, Severity, Message);
+
+		if (Severity <= m_nLogLevel)
+		{
+			CString *pTimeString = GetTimeString (nClockTicks);
+
+			WriteMessage (Source, Severity, Message,
+				      pTimeString != 0 ? (const char *) *pTimeString : 0);
+
+			delete pTimeString;
+		}
+
+		nMessages++;
+	}
+
+	for (unsigned i = 0; i < LOG_RATE_SOURCES; i++)
+	{
+		unsigned nSuppressed = m_pRecordBuffer->GetSuppressed (i, &Source);
+		if (   nSuppressed != 0
+		    && LogWarning <= m_nLogLevel)
+		{
+			Message.Format ("%u message(s) suppressed (rate limit)", nSuppressed);
+
+			CString *pTimeString = GetTimeString (CTimer::GetClockTicks ());
+
+			WriteMessage (Source, LogWarning, Message,
+				      pTimeString != 0 ? (const char *) *pTimeString : 0);
+
+			delete pTimeString;
+		}
+	}
+
+	return nMessages;
+}
+
+void CLogger::SetRateLimit (unsigned nMessagesPerSecond)
+{
+	assert (m_pRecordBuffer != 0);
+	m_pRecordBuffer->SetRateLimit (nMessagesPerSecond);
+}
+
+unsigned CLogger::GetDropped (void) const
+{
+	if (m_pRecordBuffer == 0)
+	{
+		return 0;
+	}
+
+	return m_pRecordBuffer->GetDropped ();
+}
+
+CString *CLogger::GetTimeString (unsigned nClockTicks)
+{
+	if (m_pTimer == 0)
+	{
+		return 0;
+	}
+
+	unsigned nSeconds, nMicroSeconds;
+	if (!m_pTimer->GetLocalTime (&nSeconds, &nMicroSeconds))
+	{
+		return 0;
+	}
+
+	// go back by the age of the message
+	u64 ullTime = (u64) nSeconds * 1000000 + nMicroSeconds;
+	unsigned nAge = CTimer::GetClockTicks () - nClockTicks;
+	if (nAge < ullTime)
+	{
+		ullTime -= nAge;
+	}
+
+	return CTimer::GetTimeString (ullTime / 1000000, ullTime % 1000000 / 10000);
+}
+
 CLogger *CLogger::Get (void)
 {
 	if (s_pThis == 0)
@@ -0,0 +1,557 @@
+//
+// logrecordbuffer.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/logrecordbuffer.h>
+#include <circle/multicore.h>
+#include <circle/timer.h>
+#include <circle/util.h>
+#include <assert.h>
+
+// A producer reserves a record with a compare-and-swap on nIn of the ring of its core,
+// which may be interrupted by an IRQ handler on the same core, which logs too. The
+// record is handed over to the consumer by setting its sequence number to index+1.
+
+#define MAX_SPEC_LENGTH		24
+
+struct CLogRecordBuffer::TFormatSpec
+{
+	boolean	bLong;
+	boolean	bLongLong;
+	char	chConversion;
+};
+
+CLogRecordBuffer::CLogRecordBuffer (unsigned nRecordsPerCore)
+:	m_nRecordsPerCore (nRecordsPerCore),
+	m_nDropped (0),
+	m_nRateLimit (0)
+{
+	assert (nRecordsPerCore >= 2);
+	assert ((nRecordsPerCore & (nRecordsPerCore-1)) == 0);
+
+	for (unsigned nCore = 0; nCore < LOG_RECORD_CORES; nCore++)
+	{
+		m_Ring[nCore].pRecord = new TLogRecord[nRecordsPerCore];
+		assert (m_Ring[nCore].pRecord != 0);
+
+		for (unsigned i = 0; i < nRecordsPerCore; i++)
+		{
+			m_Ring[nCore].pRecord[i].nSequence = 0;
+		}
+
+		m_Ring[nCore].nIn = 0;
+		m_Ring[nCore].nOut = 0;
+	}
+
+	memset (m_RateEntry, 0, sizeof m_RateEntry);
+}
+
+CLogRecordBuffer::~CLogRecordBuffer (void)
+{
+	for (unsigned nCore = 0; nCore < LOG_RECORD_CORES; nCore++)
+	{
+		delete [] m_Ring[nCore].pRecord;
+		m_Ring[nCore].pRecord = 0;
+	}
+}
+
+boolean CLogRecordBuffer::Write (const char *pSource, unsigned nSeverity,
+				 const char *pMessage, va_list Args)
+{
+	// the format string is only referenced, so it must not go away
+	extern const char _etext;
+	extern const char __init_start;
+	if (   pMessage < &_etext
+	    || pMessage >= &__init_start)
+	{
+		return FALSE;
+	}
+
+	if (   m_nRateLimit != 0
+	    && IsRateLimited (pSource))
+	{
+		return TRUE;
+	}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	TRing *pRing = &m_Ring[CMultiCoreSupport::ThisCore ()];
+#else
+	TRing *pRing = &m_Ring[0];
+#endif
+
+	unsigned nIn = __atomic_load_n (&pRing->nIn, __ATOMIC_RELAXED);
+	do
+	{
+		if (nIn - __atomic_load_n (&pRing->nOut, __ATOMIC_ACQUIRE) >= m_nRecordsPerCore)
+		{
+			__atomic_add_fetch (&m_nDropped, 1, __ATOMIC_RELAXED);
+
+			return TRUE;
+		}
+	}
+	while (!__atomic_compare_exchange_n (&pRing->nIn, &nIn, nIn+1, TRUE,
+					     __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	TLogRecord *pRecord = &pRing->pRecord[nIn & (m_nRecordsPerCore-1)];
+
+	pRecord->nSeverity = (u8) nSeverity;
+	pRecord->nClockTicks = CTimer::GetClockTicks ();
+	pRecord->pMessage = pMessage;
+
+	strncpy (pRecord->Source, pSource, LOG_RECORD_MAX_SOURCE-1);
+	pRecord->Source[LOG_RECORD_MAX_SOURCE-1] = '\0';
+
+	unsigned nArgs = 0;
+	unsigned nStringLength = 0;
+	while (*pMessage != '\0')
+	{
+		if (*pMessage++ != '%')
+		{
+			continue;
+		}
+
+		if (*pMessage == '%')
+		{
+			pMessage++;
+
+			continue;
+		}
+
+		TFormatSpec Spec;
+		pMessage = ParseFormatSpec (pMessage, &Spec);
+
+		u64 ullArg;
+		switch (Spec.chConversion)
+		{
+		case 'c':
+			ullArg = (u64) va_arg (Args, int);
+			break;
+
+		case 'd':
+		case 'i':
+			if (Spec.bLongLong)
+			{
+				ullArg = (u64) va_arg (Args, long long);
+			}
+			else if (Spec.bLong)
+			{
+				ullArg = (u64) va_arg (Args, long);
+			}
+			else
+			{
+				ullArg = (u64) va_arg (Args, int);
+			}
+			break;
+
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'p':
+			if (Spec.bLongLong)
+			{
+				ullArg = va_arg (Args, unsigned long long);
+			}
+			else if (Spec.bLong)
+			{
+				ullArg = va_arg (Args, unsigned long);
+			}
+			else
+			{
+				ullArg = va_arg (Args, unsigned);
+			}
+			break;
+
+		case 'f': {
+			double fArg = va_arg (Args, double);
+			memcpy (&ullArg, &fArg, sizeof ullArg);
+			} break;
+
+		case 's': {
+			const char *pArg = va_arg (Args, const char *);
+			if (pArg == 0)
+			{
+				pArg = "(null)";
+			}
+
+			// the string is copied, because it may be gone, when the record is read
+			ullArg = nStringLength;
+			while (   *pArg != '\0'
+			       && nStringLength < LOG_RECORD_STRING_SIZE-1)
+			{
+				pRecord->Strings[nStringLength++] = *pArg++;
+			}
+
+			if (nStringLength < LOG_RECORD_STRING_SIZE)
+			{
+				pRecord->Strings[nStringLength++] = '\0';
+			}
+			} break;
+
+		default:		// does not consume an argument
+			continue;
+		}
+
+		if (nArgs == LOG_RECORD_MAX_ARGS)
+		{
+			// release the record unused, the caller writes the message synchronously
+			pRecord->pMessage = 0;
+
+			break;
+		}
+
+		pRecord->Arg[nArgs++] = ullArg;
+	}
+
+	pRecord->nArgs = (u8) nArgs;
+	pRecord->nStringLength = (u16) nStringLength;
+
+	__atomic_store_n (&pRecord->nSequence, nIn+1, __ATOMIC_RELEASE);
+
+	return pRecord->pMessage != 0;
+}
+
+boolean CLogRecordBuffer::Read (CString *pSource, unsigned *pSeverity, CString *pMessage,
+				unsigned *pClockTicks)
+{
+	while (1)
+	{
+		// find the oldest completed record of all cores
+		TRing *pOldest = 0;
+		TLogRecord *pOldestRecord = 0;
+		for (unsigned nCore = 0; nCore < LOG_RECORD_CORES; nCore++)
+		{
+			TRing *pRing = &m_Ring[nCore];
+
+			unsigned nOut = pRing->nOut;
+			TLogRecord *pRecord = &pRing->pRecord[nOut & (m_nRecordsPerCore-1)];
+			if (__atomic_load_n (&pRecord->nSequence, __ATOMIC_ACQUIRE) != nOut+1)
+			{
+				continue;
+			}
+
+			if (   pOldestRecord == 0
+			    || (int) (pRecord->nClockTicks - pOldestRecord->nClockTicks) < 0)
+			{
+				pOldest = pRing;
+				pOldestRecord = pRecord;
+			}
+		}
+
+		if (pOldestRecord == 0)
+		{
+			return FALSE;
+		}
+
+		boolean bValid = pOldestRecord->pMessage != 0;
+		if (bValid)
+		{
+			assert (pSource != 0);
+			*pSource = pOldestRecord->Source;
+
+			assert (pSeverity != 0);
+			*pSeverity = pOldestRecord->nSeverity;
+
+			assert (pMessage != 0);
+			FormatRecord (pOldestRecord, pMessage);
+
+			assert (pClockTicks != 0);
+			*pClockTicks = pOldestRecord->nClockTicks;
+		}
+
+		__atomic_store_n (&pOldest->nOut, pOldest->nOut+1, __ATOMIC_RELEASE);
+
+		if (bValid)
+		{
+			return TRUE;
+		}
+	}
+}
+
+void CLogRecordBuffer::SetRateLimit (unsigned nMessagesPerSecond)
+{
+	m_nRateLimit = nMessagesPerSecond;
+}
+
+unsigned CLogRecordBuffer::GetSuppressed (unsigned nIndex, CString *pSource)
+{
+	assert (nIndex < LOG_RATE_SOURCES);
+	TRateEntry *pEntry = &m_RateEntry[nIndex];
+
+	if (pEntry->nHash == 0)
+	{
+		return 0;
+	}
+
+	unsigned nSuppressed = __atomic_exchange_n (&pEntry->nSuppressed, 0, __ATOMIC_RELAXED);
+	if (nSuppressed != 0)
+	{
+		assert (pSource != 0);
+		*pSource = pEntry->Source;
+	}
+
+	return nSuppressed;
+}
+
+boolean CLogRecordBuffer::IsRateLimited (const char *pSource)
+{
+	u32 nHash = 2166136261U;			// FNV-1a
+	for (const char *p = pSource; *p != '\0'; p++)
+	{
+		nHash = (nHash ^ (u8) *p) * 16777619U;
+	}
+
+	if (nHash == 0)
+	{
+		nHash = 1;
+	}
+
+	TRateEntry *pEntry = 0;
+	for (unsigned i = 0; i < LOG_RATE_SOURCES; i++)
+	{
+		TRateEntry *pProbe = &m_RateEntry[(nHash + i) % LOG_RATE_SOURCES];
+
+		u32 nProbeHash = __atomic_load_n (&pProbe->nHash, __ATOMIC_ACQUIRE);
+		if (nProbeHash == nHash)
+		{
+			pEntry = pProbe;
+
+			break;
+		}
+
+		if (   nProbeHash == 0
+		    && __atomic_compare_exchange_n (&pProbe->nHash, &nProbeHash, nHash, FALSE,
+						    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		{
+			strncpy (pProbe->Source, pSource, LOG_RECORD_MAX_SOURCE-1);
+
+			pEntry = pProbe;
+
+			break;
+		}
+
+		if (nProbeHash == nHash)	// claimed by someone else in the meantime
+		{
+			pEntry = pProbe;
+
+			break;
+		}
+	}
+
+	if (pEntry == 0)
+	{
+		return FALSE;				// table full, do not limit
+	}
+
+	unsigned nSecond = CTimer::GetClockTicks () / CLOCKHZ;
+	unsigned nEntrySecond = __atomic_load_n (&pEntry->nSecond, __ATOMIC_RELAXED);
+	if (   nEntrySecond != nSecond
+	    && __atomic_compare_exchange_n (&pEntry->nSecond, &nEntrySecond, nSecond, FALSE,
+					    __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	{
+		__atomic_store_n (&pEntry->nCount, 0, __ATOMIC_RELAXED);
+	}
+
+	if (__atomic_add_fetch (&pEntry->nCount, 1, __ATOMIC_RELAXED) <= m_nRateLimit)
+	{
+		return FALSE;
+	}
+
+	__atomic_add_fetch (&pEntry->nSuppressed, 1, __ATOMIC_RELAXED);
+
+	return TRUE;
+}
+
+void CLogRecordBuffer::FormatRecord (const TLogRecord *pRecord, CString *pResult)
+{
+	assert (pResult != 0);
+	*pResult = "";
+
+	const char *pMessage = pRecord->pMessage;
+	assert (pMessage != 0);
+
+	unsigned nArg = 0;
+	while (*pMessage != '\0')
+	{
+		// append literal text up to the next format specification
+		char Buffer[64];
+		unsigned nLength = 0;
+		while (   *pMessage != '\0'
+		       && nLength < sizeof Buffer-1)
+		{
+			if (*pMessage == '%')
+			{
+				if (pMessage[1] != '%')
+				{
+					break;
+				}
+
+				pMessage++;
+			}
+
+			Buffer[nLength++] = *pMessage++;
+		}
+
+		if (nLength > 0)
+		{
+			Buffer[nLength] = '\0';
+			pResult->Append (Buffer);
+
+			continue;
+		}
+
+		if (*pMessage != '%')
+		{
+			continue;
+		}
+
+		// format one specification with the captured argument
+		const char *pSpecStart = pMessage;
+		TFormatSpec Spec;
+		pMessage = ParseFormatSpec (pMessage+1, &Spec);
+
+		char SpecString[MAX_SPEC_LENGTH+1];
+		unsigned nSpecLength = pMessage - pSpecStart;
+		if (nSpecLength > MAX_SPEC_LENGTH)
+		{
+			nSpecLength = MAX_SPEC_LENGTH;
+		}
+		memcpy (SpecString, pSpecStart, nSpecLength);
+		SpecString[nSpecLength] = '\0';
+
+		u64 ullArg = 0;
+		if (   Spec.chConversion != '\0'
+		    && strchr ("cdiouxXpfs", Spec.chConversion) != 0
+		    && nArg < pRecord->nArgs)
+		{
+			ullArg = pRecord->Arg[nArg++];
+		}
+
+		CString Item;
+		switch (Spec.chConversion)
+		{
+		case 'c':
+			Item.Format (SpecString, (int) ullArg);
+			break;
+
+		case 'd':
+		case 'i':
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+		case 'p':
+			if (Spec.bLongLong)
+			{
+				Item.Format (SpecString, (unsigned long long) ullArg);
+			}
+			else if (Spec.bLong)
+			{
+				Item.Format (SpecString, (unsigned long) ullArg);
+			}
+			else
+			{
+				Item.Format (SpecString, (unsigned) ullArg);
+			}
+			break;
+
+		case 'f': {
+			double fArg;
+			memcpy (&fArg, &ullArg, sizeof fArg);
+			Item.Format (SpecString, fArg);
+			} break;
+
+		case 's':
+			Item.Format (SpecString,   ullArg < pRecord->nStringLength
+						 ? &pRecord->Strings[ullArg] : "");
+			break;
+
+		case '\0':			// '%' at the end of the format string
+			Item = "%";
+			break;
+
+		default:
+			Item.Format (SpecString);
+			break;
+		}
+
+		pResult->Append (Item);
+	}
+}
+
+const char *CLogRecordBuffer::ParseFormatSpec (const char *pFormat, TFormatSpec *pSpec)
+{
+	// follows the syntax, which is supported by CString::FormatV()
+	if (*pFormat == '#')
+	{
+		pFormat++;
+	}
+
+	if (*pFormat == '-')
+	{
+		pFormat++;
+	}
+
+	if (*pFormat == '0')
+	{
+		pFormat++;
+	}
+
+	while ('0' <= *pFormat && *pFormat <= '9')
+	{
+		pFormat++;
+	}
+
+	if (*pFormat == '.')
+	{
+		pFormat++;
+
+		while ('0' <= *pFormat && *pFormat <= '9')
+		{
+			pFormat++;
+		}
+	}
+
+	pSpec->bLong = FALSE;
+	pSpec->bLongLong = FALSE;
+	if (*pFormat == 'l')
+	{
+#if STDLIB_SUPPORT >= 1
+		if (*(pFormat+1) == 'l')
+		{
+			pSpec->bLongLong = TRUE;
+
+			pFormat++;
+		}
+		else
+#endif
+		{
+			pSpec->bLong = TRUE;
+		}
+
+		pFormat++;
+	}
+
+	pSpec->chConversion = *pFormat;
+	if (*pFormat != '\0')
+	{
+		pFormat++;
+	}
+
+	return pFormat;
+}
@@ -168,15 +168,20 @@ CMachineInfo::CMachineInfo (void)
 	}
 	s_pThis = this;
 
+	// both tags are requested with one mailbox transaction
 	CBcmPropertyTags Tags (TRUE);
 	TPropertyTagSimple DMAChannels;
-	if (Tags.GetTag (PROPTAG_GET_DMA_CHANNELS, &DMAChannels, sizeof DMAChannels))
+	TPropertyTagSimple BoardRevision;
+	Tags.AddTag (PROPTAG_GET_DMA_CHANNELS, &DMAChannels, sizeof DMAChannels);
+	Tags.AddTag (PROPTAG_GET_BOARD_REVISION, &BoardRevision, sizeof BoardRevision);
+	Tags.SubmitTags ();
+
+	if (DMAChannels.Tag.nValueLength != 0)
 	{
 		m_usDMAChannelMap = (u16) DMAChannels.nValue;
 	}
 
-	TPropertyTagSimple BoardRevision;
-	if (!Tags.GetTag (PROPTAG_GET_BOARD_REVISION, &BoardRevision, sizeof BoardRevision))
+	if (BoardRevision.Tag.nValueLength == 0)
 	{
 		return;
 	}
@@ -502,7 +507,13 @@ unsigned CMachineInfo::AllocateDMAChannel (unsigned nChannel)
 	if (!(nChannel & ~DMA_CHANNEL__MASK))
 	{
 		// explicit channel allocation
+#if RASPPI <= 3
 		assert (nChannel <=  DMA_CHANNEL_MAX);
+#else
+		assert (   nChannel <= DMA_CHANNEL_MAX
+			|| (   nChannel >= DMA_CHANNEL_EXT_MIN
+			    && nChannel <= DMA_CHANNEL_EXT_MAX));
+#endif
 		if (m_usDMAChannelMap & (1 << nChannel))
 		{
 			m_usDMAChannelMap &= ~(1 << nChannel);
@@ -546,7 +557,13 @@ void CMachineInfo::FreeDMAChannel (unsigned nChannel)
 		return;
 	}
 
+#if RASPPI <= 3
 	assert (nChannel <= DMA_CHANNEL_MAX);
+#else
+	assert (   nChannel <= DMA_CHANNEL_MAX
+		|| (   nChannel >= DMA_CHANNEL_EXT_MIN
+		    && nChannel <= DMA_CHANNEL_EXT_MAX));
+#endif
 	assert (!(m_usDMAChannelMap & (1 << nChannel)));
 	m_usDMAChannelMap |= 1 << nChannel;
 }
@@ -0,0 +1,129 @@
+//
+// mpmcqueue.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/mpmcqueue.h>
+#include <assert.h>
+
+// Algorithm by Dmitry Vyukov:
+// Each cell has a sequence number, which tells, which round of the position counters
+// may access the cell next. A producer or consumer claims a position with a
+// compare-and-swap on the respective counter and hands the cell over to the other side
+// by updating its sequence number.
+
+struct TMPMCQueueCell
+{
+	volatile unsigned nSequence;
+	void *pPtr;
+};
+
+CMPMCQueue::CMPMCQueue (unsigned nSize)
+:	m_nMask (nSize-1),
+	m_pCell (new TMPMCQueueCell[nSize]),
+	m_nEnqueuePos (0),
+	m_nDequeuePos (0)
+{
+	assert (nSize >= 2);
+	assert ((nSize & m_nMask) == 0);
+	assert (m_pCell != 0);
+
+	for (unsigned i = 0; i < nSize; i++)
+	{
+		m_pCell[i].nSequence = i;
+		m_pCell[i].pPtr = 0;
+	}
+}
+
+CMPMCQueue::~CMPMCQueue (void)
+{
+	delete [] m_pCell;
+	m_pCell = 0;
+}
+
+boolean CMPMCQueue::Enqueue (void *pPtr)
+{
+	TMPMCQueueCell *pCell;
+	unsigned nPos = __atomic_load_n (&m_nEnqueuePos, __ATOMIC_RELAXED);
+	while (1)
+	{
+		pCell = &m_pCell[nPos & m_nMask];
+		unsigned nSequence = __atomic_load_n (&pCell->nSequence, __ATOMIC_ACQUIRE);
+
+		int nDiff = (int) (nSequence - nPos);
+		if (nDiff == 0)
+		{
+			// cell is free in this round, try to claim the position
+			if (__atomic_compare_exchange_n (&m_nEnqueuePos, &nPos, nPos+1, TRUE,
+							 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+
+			// nPos has been updated by the failed compare-and-swap
+		}
+		else if (nDiff < 0)
+		{
+			return FALSE;		// cell not consumed yet in the previous round
+		}
+		else
+		{
+			nPos = __atomic_load_n (&m_nEnqueuePos, __ATOMIC_RELAXED);
+		}
+	}
+
+	pCell->pPtr = pPtr;
+	__atomic_store_n (&pCell->nSequence, nPos+1, __ATOMIC_RELEASE);
+
+	return TRUE;
+}
+
+boolean CMPMCQueue::Dequeue (void **ppPtr)
+{
+	assert (ppPtr != 0);
+
+	TMPMCQueueCell *pCell;
+	unsigned nPos = __atomic_load_n (&m_nDequeuePos, __ATOMIC_RELAXED);
+	while (1)
+	{
+		pCell = &m_pCell[nPos & m_nMask];
+		unsigned nSequence = __atomic_load_n (&pCell->nSequence, __ATOMIC_ACQUIRE);
+
+		int nDiff = (int) (nSequence - (nPos+1));
+		if (nDiff == 0)
+		{
+			if (__atomic_compare_exchange_n (&m_nDequeuePos, &nPos, nPos+1, TRUE,
+							 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+		}
+		else if (nDiff < 0)
+		{
+			return FALSE;		// cell not filled yet in this round
+		}
+		else
+		{
+			nPos = __atomic_load_n (&m_nDequeuePos, __ATOMIC_RELAXED);
+		}
+	}
+
+	*ppPtr = pCell->pPtr;
+	__atomic_store_n (&pCell->nSequence, nPos+m_nMask+1, __ATOMIC_RELEASE);
+
+	return TRUE;
+}
@@ -38,6 +38,9 @@ static const char FromMultiCore[] = "mcore";
 
 CMultiCoreSupport *CMultiCoreSupport::s_pThis = 0;
 
+TIPIHandler *CMultiCoreSupport::s_apIPIHandler[IPI_USER] = {0};
+void *CMultiCoreSupport::s_pIPIParam[IPI_USER] = {0};
+
 CMultiCoreSupport::CMultiCoreSupport (CMemorySystem *pMemorySystem)
 :	m_pMemorySystem (pMemorySystem)
 {
@@ -164,6 +167,48 @@ void CMultiCoreSupport::HaltAll (void)
 	halt ();
 }
 
+void CMultiCoreSupport::ConnectIPI (unsigned nIPI, TIPIHandler *pHandler, void *pParam)
+{
+	assert (nIPI != IPI_HALT_CORE);
+	assert (nIPI < IPI_USER);
+	assert (pHandler != 0);
+	assert (s_apIPIHandler[nIPI] == 0);
+
+	s_pIPIParam[nIPI] = pParam;
+	DataMemBarrier ();
+	s_apIPIHandler[nIPI] = pHandler;
+}
+
+void CMultiCoreSupport::DisconnectIPI (unsigned nIPI)
+{
+	assert (nIPI < IPI_USER);
+	assert (s_apIPIHandler[nIPI] != 0);
+
+	s_apIPIHandler[nIPI] = 0;
+	DataMemBarrier ();
+	s_pIPIParam[nIPI] = 0;
+}
+
+boolean CMultiCoreSupport::CallIPIHandler (unsigned nIPI)
+{
+	if (nIPI >= IPI_USER)
+	{
+		return FALSE;
+	}
+
+	TIPIHandler *pHandler = s_apIPIHandler[nIPI];
+	if (pHandler == 0)
+	{
+		return FALSE;
+	}
+
+	DataMemBarrier ();
+
+	(*pHandler) (nIPI, s_pIPIParam[nIPI]);
+
+	return TRUE;
+}
+
 #if RASPPI <= 3
 
 boolean CMultiCoreSupport::LocalInterruptHandler (void)
@@ -195,7 +240,10 @@ boolean CMultiCoreSupport::LocalInterruptHandler (void)
 	write32 (nMailBoxClear, 1 << nIPI);
 	DataSyncBarrier ();
 
-	s_pThis->IPIHandler (nCore, nIPI);
+	if (!CallIPIHandler (nIPI))
+	{
+		s_pThis->IPIHandler (nCore, nIPI);
+	}
 
 	return TRUE;
 }
@@ -204,7 +252,8 @@ boolean CMultiCoreSupport::LocalInterruptHandler (void)
 
 void CMultiCoreSupport::LocalInterruptHandler (unsigned nFromCore, unsigned nIPI)
 {
-	if (s_pThis != 0)
+	if (   !CallIPIHandler (nIPI)
+	    && s_pThis != 0)
 	{
 		s_pThis->IPIHandler (ThisCore (), nIPI);
 	}
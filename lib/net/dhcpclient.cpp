@@ -106,7 +106,8 @@ static const char FromDHCPClient[] = "dhcp";
 const unsigned CDHCPClient::s_TimeoutHZ[MAX_TRIES] = {4*HZ, 8*HZ, 16*HZ, 32*HZ};
 
 CDHCPClient::CDHCPClient (CNetSubSystem *pNetSubSystem, const char *pHostname)
-:	m_pNetSubSystem (pNetSubSystem),
+:	CTask (TASK_STACK_SIZE, TRUE),
+	m_pNetSubSystem (pNetSubSystem),
 	m_pNetConfig (pNetSubSystem->GetConfig ()),
 	m_Hostname (pHostname != 0 ? pHostname : ""),
 	m_Socket (pNetSubSystem, IPPROTO_UDP),
@@ -118,6 +119,8 @@ CDHCPClient::CDHCPClient (CNetSubSystem *pNetSubSystem, const char *pHostname)
 	assert (m_Hostname.GetLength () <= 30);
 
 	SetName (FromDHCPClient);
+
+	Start ();
 }
 
 CDHCPClient::~CDHCPClient (void)
@@ -41,7 +41,7 @@ unsigned CHTTPDaemon::s_nInstanceCount = 0;
 
 CHTTPDaemon::CHTTPDaemon (CNetSubSystem *pNetSubSystem, CSocket *pSocket,
 			  unsigned nMaxContentSize, u16 nPort, unsigned nMaxMultipartSize)
-:	CTask (HTTPD_STACK_SIZE),
+:	CTask (HTTPD_STACK_SIZE, TRUE),
 	m_pNetSubSystem (pNetSubSystem),
 	m_pSocket (pSocket),
 	m_nMaxContentSize (nMaxContentSize),
@@ -68,6 +68,12 @@ CHTTPDaemon::CHTTPDaemon (CNetSubSystem *pNetSubSystem, CSocket *pSocket,
 
 		SetName (TaskName);
 	}
+
+	// a worker is started by the listener, after CreateWorker() has returned
+	if (pSocket == 0)
+	{
+		Start ();
+	}
 }
 
 CHTTPDaemon::~CHTTPDaemon (void)
@@ -163,7 +169,9 @@ void CHTTPDaemon::Listener (void)
 			continue;
 		}
 
-		CreateWorker (m_pNetSubSystem, pConnection);
+		CHTTPDaemon *pWorker = CreateWorker (m_pNetSubSystem, pConnection);
+		assert (pWorker != 0);
+		pWorker->Start ();
 	}
 }
 
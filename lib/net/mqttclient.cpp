@@ -51,7 +51,8 @@ static const char FromMQTTClient[] = "mqtt";
 
 CMQTTClient::CMQTTClient (CNetSubSystem *pNetSubSystem, size_t nMaxPacketSize,
 			  size_t nMaxPacketsQueued, size_t nMaxTopicSize)
-:	m_pNetSubSystem (pNetSubSystem),
+:	CTask (TASK_STACK_SIZE, TRUE),
+	m_pNetSubSystem (pNetSubSystem),
 	m_nMaxPacketSize (nMaxPacketSize),
 	m_nMaxTopicSize (nMaxTopicSize),
 	m_pTimer (CTimer::Get ()),
@@ -62,6 +63,8 @@ CMQTTClient::CMQTTClient (CNetSubSystem *pNetSubSystem, size_t nMaxPacketSize,
 	SetName (FromMQTTClient);
 
 	m_pTopicBuffer = new char [m_nMaxTopicSize+1];
+
+	Start ();
 }
 
 CMQTTClient::~CMQTTClient (void)
@@ -23,6 +23,7 @@
 #include <circle/timer.h>
 #include <circle/synchronize.h>
 #include <circle/macros.h>
+#include <circle/tracepoint.h>
 #include <assert.h>
 
 const char FromNetDev[] = "netdev";
@@ -112,11 +113,15 @@ void CNetDeviceLayer::Process (void)
 
 			break;
 		}
+
+		TRACEPOINT (TracepointNetTx, nLength);
 	}
 
 	while (m_pDevice->ReceiveFrame (Buffer, &nLength))
 	{
 		assert (nLength > 0);
+		TRACEPOINT (TracepointNetRx, nLength);
+
 		m_RxQueue.Enqueue (Buffer, nLength);
 	}
 }
@@ -22,9 +22,12 @@
 #include <assert.h>
 
 CNetTask::CNetTask (CNetSubSystem *pNetSubSystem)
-:	m_pNetSubSystem (pNetSubSystem)
+:	CTask (TASK_STACK_SIZE, TRUE),
+	m_pNetSubSystem (pNetSubSystem)
 {
 	SetName ("net");
+
+	Start ();
 }
 
 CNetTask::~CNetTask (void)
@@ -29,12 +29,15 @@
 static const char FromNTPDaemon[] = "ntpd";
 
 CNTPDaemon::CNTPDaemon (const char *pNTPServer, CNetSubSystem *pNetSubSystem)
-:	m_NTPServer (pNTPServer),
+:	CTask (TASK_STACK_SIZE, TRUE),
+	m_NTPServer (pNTPServer),
 	m_pNetSubSystem (pNetSubSystem)
 {
 	assert (m_pNetSubSystem != 0);
 
 	SetName (FromNTPDaemon);
+
+	Start ();
 }
 
 CNTPDaemon::~CNTPDaemon (void)
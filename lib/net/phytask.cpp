@@ -22,9 +22,12 @@
 #include <assert.h>
 
 CPHYTask::CPHYTask (CNetDevice *pDevice)
-:	m_pDevice (pDevice)
+:	CTask (TASK_STACK_SIZE, TRUE),
+	m_pDevice (pDevice)
 {
 	SetName ("netphy");
+
+	Start ();
 }
 
 CPHYTask::~CPHYTask (void)
@@ -60,7 +60,8 @@ CSysLogDaemon *CSysLogDaemon::s_pThis = 0;
 
 CSysLogDaemon::CSysLogDaemon (CNetSubSystem *pNetSubSystem,
 			      const CIPAddress &ServerIP, u16 usServerPort)
-:	m_pNetSubSystem (pNetSubSystem),
+:	CTask (TASK_STACK_SIZE, TRUE),
+	m_pNetSubSystem (pNetSubSystem),
 	m_ServerIP (ServerIP),
 	m_usServerPort (usServerPort),
 	m_pTimer (CTimer::Get ()),
@@ -70,6 +71,8 @@ CSysLogDaemon::CSysLogDaemon (CNetSubSystem *pNetSubSystem,
 	s_pThis = this;
 
 	SetName (FromSysLogDaemon);
+
+	Start ();
 }
 
 CSysLogDaemon::~CSysLogDaemon (void)
@@ -93,11 +93,14 @@ typedef unsigned TIMER;
 static const char FromTFPTDaemon[] = "tftpd";
 
 CTFTPDaemon::CTFTPDaemon (CNetSubSystem *pNetSubSystem)
-:	m_pNetSubSystem (pNetSubSystem),
+:	CTask (TASK_STACK_SIZE, TRUE),
+	m_pNetSubSystem (pNetSubSystem),
 	m_pRequestSocket (0),
 	m_pTransferSocket (0)
 {
 	SetName (FromTFPTDaemon);
+
+	Start ();
 }
 
 CTFTPDaemon::~CTFTPDaemon (void)
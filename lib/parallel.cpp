@@ -0,0 +1,387 @@
+//
+// parallel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/parallel.h>
+#include <circle/synchronize.h>
+#include <assert.h>
+
+#define GRAINS_PER_CORE		8	// number of sub-ranges per core with automatic grain
+
+CParallel *CParallel::s_pThis = 0;
+
+CParallelTaskGraph::CParallelTaskGraph (void)
+:	m_nTasks (0),
+	m_ullClaimed (0),
+	m_ullCompleted (0)
+{
+}
+
+CParallelTaskGraph::~CParallelTaskGraph (void)
+{
+}
+
+unsigned CParallelTaskGraph::AddTask (TParallelTaskFunction *pFunction, void *pParam)
+{
+	assert (m_nTasks < PARALLEL_GRAPH_MAX_TASKS);
+	unsigned nTask = m_nTasks++;
+
+	assert (pFunction != 0);
+	m_pFunction[nTask] = pFunction;
+	m_pParam[nTask] = pParam;
+	m_ullPredecessors[nTask] = 0;
+
+	return nTask;
+}
+
+void CParallelTaskGraph::AddDependency (unsigned nTask, unsigned nPredecessor)
+{
+	assert (nTask < m_nTasks);
+	assert (nPredecessor < m_nTasks);
+	assert (nTask != nPredecessor);
+
+	m_ullPredecessors[nTask] |= (u64) 1 << nPredecessor;
+}
+
+void CParallelTaskGraph::Prepare (void)
+{
+	m_ullClaimed = 0;
+	m_ullCompleted = 0;
+}
+
+void CParallelTaskGraph::Work (void)
+{
+	u64 ullAll = m_nTasks < 64 ? ((u64) 1 << m_nTasks) - 1 : ~(u64) 0;
+
+	while (1)
+	{
+		u64 ullCompleted = __atomic_load_n (&m_ullCompleted, __ATOMIC_ACQUIRE);
+		if (ullCompleted == ullAll)
+		{
+			break;
+		}
+
+		u64 ullClaimed = __atomic_load_n (&m_ullClaimed, __ATOMIC_RELAXED);
+
+		// find a task, which has not been started and whose predecessors are completed
+		unsigned nTask;
+		for (nTask = 0; nTask < m_nTasks; nTask++)
+		{
+			u64 ullMask = (u64) 1 << nTask;
+
+			if (   !(ullClaimed & ullMask)
+			    && (m_ullPredecessors[nTask] & ~ullCompleted) == 0)
+			{
+				break;
+			}
+		}
+
+		if (nTask == m_nTasks)
+		{
+			// all tasks have been started, or the remaining tasks have to wait,
+			// if no task is running, the graph contains a cycle
+			assert (ullClaimed != ullCompleted || ullClaimed == ullAll);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+			// woken by SEV, when a task has been completed
+			WaitForEvent ();
+
+			continue;
+#else
+			break;
+#endif
+		}
+
+		u64 ullMask = (u64) 1 << nTask;
+		if (__atomic_fetch_or (&m_ullClaimed, ullMask, __ATOMIC_RELAXED) & ullMask)
+		{
+			continue;		// another core was faster
+		}
+
+		(*m_pFunction[nTask]) (m_pParam[nTask]);
+
+		__atomic_fetch_or (&m_ullCompleted, ullMask, __ATOMIC_RELEASE);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+		DataSyncBarrier ();
+		SendEvent ();
+#endif
+	}
+}
+
+CParallel::CParallel (CMemorySystem *pMemorySystem)
+:
+#ifdef ARM_ALLOW_MULTI_CORE
+	CMultiCoreSupport (pMemorySystem),
+#endif
+	m_nCores (PARALLEL_CORES),
+	m_Job (JobUnknown),
+	m_nNext (0),
+	m_nEnd (0),
+	m_nGrain (1),
+	m_pForFunction (0),
+	m_pReduceFunction (0),
+	m_pCombineFunction (0),
+	m_pParam (0),
+	m_ullIdentity (0),
+	m_pGraph (0),
+	m_nJobSequence (0),
+	m_nCoresDone (0)
+{
+	assert (s_pThis == 0);
+	s_pThis = this;
+}
+
+CParallel::~CParallel (void)
+{
+	s_pThis = 0;
+}
+
+void CParallel::SetCores (unsigned nCores)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	assert (1 <= nCores && nCores <= PARALLEL_CORES);
+	m_nCores = nCores;
+#endif
+}
+
+void CParallel::For (unsigned nBegin, unsigned nEnd,
+		     TParallelForFunction *pFunction, void *pParam, unsigned nGrain)
+{
+	assert (pFunction != 0);
+	if (nBegin >= nEnd)
+	{
+		return;
+	}
+
+	m_nNext = nBegin;
+	m_nEnd = nEnd;
+	m_nGrain = GetGrain (nBegin, nEnd, nGrain);
+	assert (m_nEnd + PARALLEL_CORES * m_nGrain > m_nEnd);	// m_nNext must not wrap
+	m_pForFunction = pFunction;
+	m_pParam = pParam;
+
+	StartJob (JobFor);
+	WorkOnFor ();
+	WaitForJob ();
+}
+
+u64 CParallel::Reduce (unsigned nBegin, unsigned nEnd,
+		       TParallelReduceFunction *pFunction, void *pParam,
+		       u64 ullIdentity, TParallelCombineFunction *pCombine,
+		       unsigned nGrain)
+{
+	assert (pFunction != 0);
+	if (nBegin >= nEnd)
+	{
+		return ullIdentity;
+	}
+
+	m_nNext = nBegin;
+	m_nEnd = nEnd;
+	m_nGrain = GetGrain (nBegin, nEnd, nGrain);
+	assert (m_nEnd + PARALLEL_CORES * m_nGrain > m_nEnd);	// m_nNext must not wrap
+	m_pReduceFunction = pFunction;
+	m_pCombineFunction = pCombine != 0 ? pCombine : Add;
+	m_pParam = pParam;
+	m_ullIdentity = ullIdentity;
+
+	StartJob (JobReduce);
+	m_ullResult[0] = WorkOnReduce ();
+	WaitForJob ();
+
+	u64 ullResult = m_ullResult[0];
+	for (unsigned nCore = 1; nCore < m_nCores; nCore++)
+	{
+		ullResult = (*m_pCombineFunction) (ullResult, m_ullResult[nCore]);
+	}
+
+	return ullResult;
+}
+
+void CParallel::Execute (CParallelTaskGraph *pGraph)
+{
+	assert (pGraph != 0);
+	if (pGraph->m_nTasks == 0)
+	{
+		return;
+	}
+
+	pGraph->Prepare ();
+	m_pGraph = pGraph;
+
+	StartJob (JobGraph);
+	pGraph->Work ();
+	WaitForJob ();
+}
+
+CParallel *CParallel::Get (void)
+{
+	assert (s_pThis != 0);
+	return s_pThis;
+}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+void CParallel::Run (unsigned nCore)
+{
+	if (nCore == 0)
+	{
+		return;
+	}
+
+	unsigned nJobSequence = 0;
+
+	while (1)
+	{
+		// woken by SEV in StartJob(), an event in between is remembered
+		while (__atomic_load_n (&m_nJobSequence, __ATOMIC_ACQUIRE) == nJobSequence)
+		{
+			WaitForEvent ();
+		}
+
+		nJobSequence = m_nJobSequence;
+
+		if (nCore < m_nCores)
+		{
+			WorkOnJob (nCore);
+		}
+
+		__atomic_add_fetch (&m_nCoresDone, 1, __ATOMIC_RELEASE);
+
+		DataSyncBarrier ();
+		SendEvent ();
+	}
+}
+
+#endif
+
+void CParallel::StartJob (TJob Job)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	assert (ThisCore () == 0);
+	assert (m_Job == JobUnknown);		// not nested
+#endif
+
+	m_Job = Job;
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	m_nCoresDone = 0;
+
+	// publish the job description to the secondary cores
+	__atomic_add_fetch (&m_nJobSequence, 1, __ATOMIC_RELEASE);
+
+	DataSyncBarrier ();
+	SendEvent ();
+#endif
+}
+
+void CParallel::WorkOnJob (unsigned nCore)
+{
+	switch (m_Job)
+	{
+	case JobFor:
+		WorkOnFor ();
+		break;
+
+	case JobReduce:
+		m_ullResult[nCore] = WorkOnReduce ();
+		break;
+
+	case JobGraph:
+		assert (m_pGraph != 0);
+		m_pGraph->Work ();
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+}
+
+void CParallel::WaitForJob (void)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	// all secondary cores acknowledge the job, even if they are not used
+	while (__atomic_load_n (&m_nCoresDone, __ATOMIC_ACQUIRE) < PARALLEL_CORES-1)
+	{
+		WaitForEvent ();
+	}
+#endif
+
+	m_Job = JobUnknown;
+}
+
+void CParallel::WorkOnFor (void)
+{
+	assert (m_pForFunction != 0);
+
+	while (1)
+	{
+		unsigned nBegin = __atomic_fetch_add (&m_nNext, m_nGrain, __ATOMIC_RELAXED);
+		if (nBegin >= m_nEnd)
+		{
+			break;
+		}
+
+		unsigned nEnd = m_nEnd - nBegin > m_nGrain ? nBegin + m_nGrain : m_nEnd;
+
+		(*m_pForFunction) (nBegin, nEnd, m_pParam);
+	}
+}
+
+u64 CParallel::WorkOnReduce (void)
+{
+	assert (m_pReduceFunction != 0);
+	assert (m_pCombineFunction != 0);
+
+	u64 ullResult = m_ullIdentity;
+
+	while (1)
+	{
+		unsigned nBegin = __atomic_fetch_add (&m_nNext, m_nGrain, __ATOMIC_RELAXED);
+		if (nBegin >= m_nEnd)
+		{
+			break;
+		}
+
+		unsigned nEnd = m_nEnd - nBegin > m_nGrain ? nBegin + m_nGrain : m_nEnd;
+
+		ullResult = (*m_pCombineFunction) (ullResult,
+						   (*m_pReduceFunction) (nBegin, nEnd, m_pParam));
+	}
+
+	return ullResult;
+}
+
+unsigned CParallel::GetGrain (unsigned nBegin, unsigned nEnd, unsigned nGrain) const
+{
+	if (nGrain > 0)
+	{
+		return nGrain;
+	}
+
+	nGrain = (nEnd - nBegin) / (m_nCores * GRAINS_PER_CORE);
+
+	return nGrain > 0 ? nGrain : 1;
+}
+
+u64 CParallel::Add (u64 ullResult1, u64 ullResult2)
+{
+	return ullResult1 + ullResult2;
+}
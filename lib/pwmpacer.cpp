@@ -0,0 +1,146 @@
+//
+// pwmpacer.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/pwmpacer.h>
+#include <circle/bcm2835.h>
+#include <circle/memio.h>
+#include <circle/timer.h>
+#include <circle/synchronize.h>
+#include <circle/new.h>
+#include <assert.h>
+
+//
+// PWM device selection
+//
+#if RASPPI <= 3
+	#define PWM_BASE	ARM_PWM_BASE
+	#define DREQ_SOURCE	DREQSourcePWM
+#else
+	#define PWM_BASE	ARM_PWM1_BASE
+	#define DREQ_SOURCE	DREQSourcePWM1
+#endif
+
+#define PWM_CTL			(PWM_BASE + 0x00)
+#define PWM_DMAC		(PWM_BASE + 0x08)
+#define PWM_RNG1		(PWM_BASE + 0x10)
+#define PWM_FIF1		(PWM_BASE + 0x18)
+
+#define ARM_PWM_CTL_PWEN1	(1 << 0)
+#define ARM_PWM_CTL_USEF1	(1 << 5)
+#define ARM_PWM_CTL_CLRF1	(1 << 6)
+
+#define ARM_PWM_DMAC_DREQ__SHIFT	0
+#define ARM_PWM_DMAC_PANIC__SHIFT	8
+#define ARM_PWM_DMAC_ENAB		(1 << 31)
+
+#define PWM_CLOCK_RATE		10000000	// Hz, PWM range is 10 per microsecond
+#define PWM_DREQ_LEVEL		7		// FIFO threshold, FIFO is primed with this
+
+CPWMPacer::CPWMPacer (unsigned nTickMicros)
+:	m_nTickMicros (nTickMicros),
+	m_Clock (GPIOClockPWM),
+	m_bRunning (FALSE),
+	m_pFillWord (0)
+{
+	assert (m_nTickMicros > 0);
+
+	m_pFillWord = new (HEAP_DMA30) u32[1];
+	assert (m_pFillWord != 0);
+	*m_pFillWord = 0;
+}
+
+CPWMPacer::~CPWMPacer (void)
+{
+	if (m_bRunning)
+	{
+		PeripheralEntry ();
+
+		write32 (PWM_DMAC, 0);
+		write32 (PWM_CTL, ARM_PWM_CTL_CLRF1);
+
+		m_Clock.Stop ();
+
+		PeripheralExit ();
+
+		m_bRunning = FALSE;
+	}
+
+	delete [] m_pFillWord;
+	m_pFillWord = 0;
+}
+
+boolean CPWMPacer::Initialize (void)
+{
+	assert (!m_bRunning);
+
+	PeripheralEntry ();
+
+	if (!m_Clock.StartRate (PWM_CLOCK_RATE))
+	{
+		PeripheralExit ();
+
+		return FALSE;
+	}
+
+	CTimer::SimpleusDelay (2000);
+
+	write32 (PWM_RNG1, m_nTickMicros * (PWM_CLOCK_RATE / 1000000));
+
+	write32 (PWM_CTL, ARM_PWM_CTL_PWEN1 | ARM_PWM_CTL_USEF1 | ARM_PWM_CTL_CLRF1);
+	CTimer::SimpleusDelay (2000);
+
+	write32 (PWM_DMAC,   ARM_PWM_DMAC_ENAB
+			   | (PWM_DREQ_LEVEL << ARM_PWM_DMAC_PANIC__SHIFT)
+			   | (PWM_DREQ_LEVEL << ARM_PWM_DMAC_DREQ__SHIFT));
+
+	PeripheralExit ();
+
+	m_bRunning = TRUE;
+
+	return TRUE;
+}
+
+boolean CPWMPacer::AddDelay (CDMAChain *pChain, unsigned nTicks)
+{
+	assert (pChain != 0);
+	assert (nTicks > 0);
+
+	return pChain->AddIOFill (PWM_FIF1, m_pFillWord, nTicks, DREQ_SOURCE);
+}
+
+void CPWMPacer::Prime (void)
+{
+	assert (m_bRunning);
+
+	PeripheralEntry ();
+
+	write32 (PWM_CTL, read32 (PWM_CTL) | ARM_PWM_CTL_CLRF1);
+
+	for (unsigned i = 0; i < PWM_DREQ_LEVEL; i++)
+	{
+		write32 (PWM_FIF1, 0);
+	}
+
+	PeripheralExit ();
+}
+
+unsigned CPWMPacer::GetTickMicros (void) const
+{
+	return m_nTickMicros;
+}
@@ -0,0 +1,202 @@
+//
+// rwspinlock.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/rwspinlock.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+#include <circle/spinlock.h>
+#include <assert.h>
+
+CRWSpinLock::CRWSpinLock (unsigned nTargetLevel, const char *pName)
+:	m_nTargetLevel (nTargetLevel),
+	m_nState (0)
+#ifdef LOCK_STATISTICS
+	, m_Statistics (pName)
+#endif
+{
+	assert (nTargetLevel <= FIQ_LEVEL);
+}
+
+CRWSpinLock::~CRWSpinLock (void)
+{
+	assert (m_nState == 0);
+}
+
+void CRWSpinLock::AcquireRead (void)
+{
+	if (m_nTargetLevel >= IRQ_LEVEL)
+	{
+		EnterCritical (m_nTargetLevel);
+	}
+
+	if (!CSpinLock::IsEnabled ())
+	{
+		// only one core is running and exclusive accesses may not work yet
+		m_nState++;
+
+		return;
+	}
+
+#ifdef LOCK_STATISTICS
+	u64 ullWaitStart = CLockStatistics::GetTimestamp ();
+	boolean bContended = FALSE;
+#endif
+
+	u32 nState = __atomic_load_n (&m_nState, __ATOMIC_RELAXED);
+	while (1)
+	{
+		if (!(nState & (RWSPINLOCK_WRITER | RWSPINLOCK_WAITING)))
+		{
+			if (__atomic_compare_exchange_n (&m_nState, &nState, nState + 1, FALSE,
+							 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+
+			// nState has been updated, try again
+			continue;
+		}
+
+#ifdef LOCK_STATISTICS
+		bContended = TRUE;
+#endif
+
+		// woken by SEV on release, an event in between is remembered
+		WaitForEvent ();
+
+		nState = __atomic_load_n (&m_nState, __ATOMIC_RELAXED);
+	}
+
+#ifdef LOCK_STATISTICS
+	m_Statistics.Acquired (ullWaitStart, bContended, FALSE);
+#endif
+}
+
+void CRWSpinLock::ReleaseRead (void)
+{
+	assert (m_nState & RWSPINLOCK_READERS);
+
+	if (!CSpinLock::IsEnabled ())
+	{
+		m_nState--;
+	}
+	else
+	{
+		u32 nState = __atomic_sub_fetch (&m_nState, 1, __ATOMIC_RELEASE);
+
+		// the last reader wakes a waiting writer
+		if (!(nState & RWSPINLOCK_READERS))
+		{
+			DataSyncBarrier ();
+			SendEvent ();
+		}
+	}
+
+	if (m_nTargetLevel >= IRQ_LEVEL)
+	{
+		LeaveCritical ();
+	}
+}
+
+void CRWSpinLock::AcquireWrite (void)
+{
+	if (m_nTargetLevel >= IRQ_LEVEL)
+	{
+		EnterCritical (m_nTargetLevel);
+	}
+
+	if (!CSpinLock::IsEnabled ())
+	{
+		assert (m_nState == 0);
+		m_nState = RWSPINLOCK_WRITER;
+
+		return;
+	}
+
+#ifdef LOCK_STATISTICS
+	u64 ullWaitStart = CLockStatistics::GetTimestamp ();
+	boolean bContended = FALSE;
+#endif
+
+	u32 nState = __atomic_load_n (&m_nState, __ATOMIC_RELAXED);
+	while (1)
+	{
+		if (!(nState & ~RWSPINLOCK_WAITING))
+		{
+			// this clears the waiting flag too, other waiting writers set it again
+			if (__atomic_compare_exchange_n (&m_nState, &nState, RWSPINLOCK_WRITER, FALSE,
+							 __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+
+			continue;
+		}
+
+#ifdef LOCK_STATISTICS
+		bContended = TRUE;
+#endif
+
+		if (!(nState & RWSPINLOCK_WAITING))
+		{
+			// block new readers
+			nState = __atomic_or_fetch (&m_nState, RWSPINLOCK_WAITING, __ATOMIC_RELAXED);
+
+			continue;
+		}
+
+		WaitForEvent ();
+
+		nState = __atomic_load_n (&m_nState, __ATOMIC_RELAXED);
+	}
+
+#ifdef LOCK_STATISTICS
+	m_Statistics.Acquired (ullWaitStart, bContended);
+#endif
+}
+
+void CRWSpinLock::ReleaseWrite (void)
+{
+	assert (m_nState & RWSPINLOCK_WRITER);
+
+	if (!CSpinLock::IsEnabled ())
+	{
+		m_nState = 0;
+	}
+	else
+	{
+#ifdef LOCK_STATISTICS
+		m_Statistics.Released ();
+#endif
+
+		// keep the waiting flag of another writer
+		__atomic_and_fetch (&m_nState, ~RWSPINLOCK_WRITER, __ATOMIC_RELEASE);
+
+		DataSyncBarrier ();
+		SendEvent ();
+	}
+
+	if (m_nTargetLevel >= IRQ_LEVEL)
+	{
+		LeaveCritical ();
+	}
+}
+
+#endif
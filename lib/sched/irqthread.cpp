@@ -0,0 +1,81 @@
+//
+// irqthread.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/irqthread.h>
+#include <assert.h>
+
+CIRQThread::CIRQThread (TIRQThreadHandler *pHandler, void *pParam, int nPriority,
+			const char *pName)
+:	CTask (TASK_STACK_SIZE, TRUE),
+	m_pHandler (pHandler),
+	m_pParam (pParam),
+	m_bStop (FALSE),
+	m_nWakeups (0),
+	m_nRuns (0)
+{
+	assert (m_pHandler != 0);
+
+	SetTaskPriority (nPriority);
+
+	assert (pName != 0);
+	SetName (pName);
+
+	Start ();
+}
+
+CIRQThread::~CIRQThread (void)
+{
+	m_pHandler = 0;
+}
+
+void CIRQThread::Wake (void)
+{
+	m_nWakeups++;
+
+	m_Event.Set ();
+}
+
+void CIRQThread::Stop (void)
+{
+	m_bStop = TRUE;
+	m_Event.Set ();
+
+	WaitForTermination ();
+}
+
+void CIRQThread::Run (void)
+{
+	while (!m_bStop)
+	{
+		m_Event.Wait ();
+
+		// clear before handling, so that a following Wake() is not lost
+		m_Event.Clear ();
+
+		if (m_bStop)
+		{
+			break;
+		}
+
+		assert (m_pHandler != 0);
+		(*m_pHandler) (m_pParam);
+
+		m_nRuns++;
+	}
+}
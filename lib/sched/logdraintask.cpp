@@ -0,0 +1,62 @@
+//
+// logdraintask.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/logdraintask.h>
+#include <circle/sched/scheduler.h>
+#include <assert.h>
+
+CLogDrainTask::CLogDrainTask (CLogger *pLogger, unsigned nIntervalMs, int nPriority)
+:	CTask (TASK_STACK_SIZE, TRUE),
+	m_pLogger (pLogger),
+	m_nIntervalMs (nIntervalMs),
+	m_bStop (FALSE)
+{
+	assert (m_pLogger != 0);
+	assert (m_nIntervalMs > 0);
+
+	SetTaskPriority (nPriority);
+	SetName ("logdrain");
+
+	Start ();
+}
+
+CLogDrainTask::~CLogDrainTask (void)
+{
+	m_pLogger = 0;
+}
+
+void CLogDrainTask::Stop (void)
+{
+	m_bStop = TRUE;
+
+	WaitForTermination ();
+}
+
+void CLogDrainTask::Run (void)
+{
+	while (!m_bStop)
+	{
+		assert (m_pLogger != 0);
+		m_pLogger->Flush ();
+
+		CScheduler::Get ()->MsSleep (m_nIntervalMs);
+	}
+
+	m_pLogger->Flush ();
+}
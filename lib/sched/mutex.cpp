@@ -29,7 +29,9 @@
 
 CMutex::CMutex (void)
 :   m_pOwningTask (0),
-    m_iReentrancyCount (0)
+    m_iReentrancyCount (0),
+    m_event (TRUE),
+    m_SpinLock (TASK_LEVEL)
 {
 }
 
@@ -44,29 +46,42 @@ void CMutex::Acquire (void)
 
     while (true)
     {
+        m_SpinLock.Acquire();
         if (m_pOwningTask == nullptr)
         {
             m_pOwningTask = pTask;
             m_iReentrancyCount = 1;
+            m_event.Clear();
+            m_SpinLock.Release();
             return;
         }
         else if (m_pOwningTask == pTask)
         {
             m_iReentrancyCount++;
+            m_SpinLock.Release();
             return;
         }
+        m_SpinLock.Release();
+
+        // returns immediately, if the mutex has been released in the meantime
         m_event.Wait();
     }
 }
 
 void CMutex::Release (void)
 {
+    m_SpinLock.Acquire();
     assert(m_pOwningTask == CScheduler::Get()->GetCurrentTask());
     m_iReentrancyCount--;
     if (m_iReentrancyCount == 0)
     {
         m_pOwningTask = 0;
-        m_event.Pulse();
+        m_event.Set();
+        m_SpinLock.Release();
         CScheduler::Get()->Yield();
     }
+    else
+    {
+        m_SpinLock.Release();
+    }
 }
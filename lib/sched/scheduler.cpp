@@ -2,7 +2,7 @@
 // scheduler.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2021  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2024  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -18,8 +18,11 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/sched/scheduler.h>
+#include <circle/multicore.h>
+#include <circle/synchronize.h>
 #include <circle/timer.h>
 #include <circle/logger.h>
+#include <circle/tracepoint.h>
 #include <circle/string.h>
 #include <circle/util.h>
 #include <assert.h>
@@ -28,20 +31,60 @@ static const char FromScheduler[] = "sched";
 
 CScheduler *CScheduler::s_pThis = 0;
 
+#ifdef ARM_ALLOW_MULTI_CORE
+
+static inline unsigned ThisCore (void)
+{
+	return CMultiCoreSupport::ThisCore ();
+}
+
+#endif
+
 CScheduler::CScheduler (void)
 :	m_nTasks (0),
+#ifndef ARM_ALLOW_MULTI_CORE
 	m_pCurrent (0),
 	m_nCurrent (0),
+#else
+	m_nActiveCores (1 << 0),
+	m_pSleepList (0),
+	m_hWakeTimer (0),
+	m_nWakeTimerTicks (0),
+#endif
 	m_pTaskSwitchHandler (0),
 	m_pTaskTerminationHandler (0),
-	m_iSuspendNewTasks (0)
+	m_iSuspendNewTasks (0),
+	m_SpinLock (IRQ_LEVEL, "scheduler")
 {
 	assert (s_pThis == 0);
 	s_pThis = this;
 
+#ifndef ARM_ALLOW_MULTI_CORE
 	m_pCurrent = new CTask (0);		// main task currently running
 	assert (m_pCurrent != 0);
 	m_pCurrent->SetName ("main");
+#else
+	for (unsigned i = 0; i < SCHEDULER_CORES; i++)
+	{
+		TCoreData *pCore = &m_Core[i];
+
+		pCore->pCurrent = 0;
+		pCore->pPrevious = 0;
+		pCore->pIdleTask = 0;
+		pCore->pRunQueueHead = 0;
+		pCore->pRunQueueTail = 0;
+		pCore->bIdle = FALSE;
+	}
+
+	CTask *pMainTask = new CTask (0);	// main task currently running
+	assert (pMainTask != 0);
+	pMainTask->SetName ("main");
+	pMainTask->m_nAffinity = 1 << 0;	// runs on the boot stack of core 0
+	pMainTask->m_nCore = 0;
+	pMainTask->m_bOnCore = TRUE;
+
+	m_Core[0].pCurrent = pMainTask;
+#endif
 }
 
 CScheduler::~CScheduler (void)
@@ -52,6 +95,8 @@ CScheduler::~CScheduler (void)
 	s_pThis = 0;
 }
 
+#ifndef ARM_ALLOW_MULTI_CORE
+
 void CScheduler::Yield (void)
 {
 	while ((m_nCurrent = GetNextTask ()) == MAX_TASKS)	// no task is ready
@@ -67,7 +112,8 @@ void CScheduler::Yield (void)
 		return;
 	}
 	
-	TTaskRegisters *pOldRegs = m_pCurrent->GetRegs ();
+	CTask *pCurrent = m_pCurrent;
+	TTaskRegisters *pOldRegs = pCurrent->GetRegs ();
 	m_pCurrent = pNext;
 	TTaskRegisters *pNewRegs = m_pCurrent->GetRegs ();
 
@@ -76,11 +122,155 @@ void CScheduler::Yield (void)
 		(*m_pTaskSwitchHandler) (m_pCurrent);
 	}
 
+	TRACEPOINT (TracepointTaskSwitch, (u32) (uintptr) pCurrent, (u32) (uintptr) pNext);
+
+	assert (pOldRegs != 0);
+	assert (pNewRegs != 0);
+	TaskSwitch (pOldRegs, pNewRegs);
+}
+
+#else
+
+void CScheduler::Yield (void)
+{
+	unsigned nCore = ThisCore ();
+	TCoreData *pCore = &m_Core[nCore];
+
+	m_SpinLock.Acquire ();
+
+	CTask *pCurrent = pCore->pCurrent;
+	assert (pCurrent != 0);
+
+	CTask *pNext;
+	while ((pNext = GetNextTask (nCore)) == 0)	// no task is ready
+	{
+		if (pCurrent == pCore->pIdleTask)
+		{
+			// secondary core without work: wait for an IPI from Enqueue(),
+			// the IPI remains pending until IRQs are enabled again
+			pCore->bIdle = TRUE;
+
+			EnterCritical ();
+			m_SpinLock.Release ();
+
+			WaitForInterrupt ();
+
+			LeaveCritical ();
+			m_SpinLock.Acquire ();
+
+			pCore->bIdle = FALSE;
+		}
+		else if (CanContinue (pCurrent, nCore))
+		{
+			m_SpinLock.Release ();
+
+			return;
+		}
+		else if (pCore->pIdleTask != 0)
+		{
+			pNext = pCore->pIdleTask;
+
+			break;
+		}
+		else
+		{
+			// core 0 has no idle task and polls, until a task becomes ready
+			assert (m_nTasks > 0);
+
+			m_SpinLock.Release ();
+
+			// the spin lock is not fair, let the other cores acquire it meanwhile
+			if (m_nActiveCores != 1 << 0)
+			{
+				CTimer::SimpleusDelay (1);
+			}
+
+			m_SpinLock.Acquire ();
+		}
+	}
+
+	assert (pNext != pCurrent);
+	assert (!pNext->m_bOnCore);
+	pNext->m_bOnCore = TRUE;
+	pNext->m_nCore = nCore;
+
+	pCore->pPrevious = pCurrent;
+	pCore->pCurrent = pNext;
+
+	if (m_pTaskSwitchHandler != 0)
+	{
+		(*m_pTaskSwitchHandler) (pNext);
+	}
+
+	TRACEPOINT (TracepointTaskSwitch, (u32) (uintptr) pCurrent, (u32) (uintptr) pNext);
+
+	// the spin lock is held during the task switch and released in FinishTaskSwitch()
+	TTaskRegisters *pOldRegs = pCurrent->GetRegs ();
+	TTaskRegisters *pNewRegs = pNext->GetRegs ();
 	assert (pOldRegs != 0);
 	assert (pNewRegs != 0);
 	TaskSwitch (pOldRegs, pNewRegs);
+
+	FinishTaskSwitch ();
+}
+
+void CScheduler::FinishTaskSwitch (void)
+{
+	// may run on another core than before the task switch
+	TCoreData *pCore = &m_Core[ThisCore ()];
+
+	CTask *pPrevious = pCore->pPrevious;
+	assert (pPrevious != 0);
+	pCore->pPrevious = 0;
+
+	// the registers of the previous task have been saved, it can run somewhere else now
+	pPrevious->m_bOnCore = FALSE;
+
+	boolean bTerminated = FALSE;
+	if (pPrevious != pCore->pIdleTask)
+	{
+		switch (pPrevious->GetState ())
+		{
+		case TaskStateReady:
+			Enqueue (pPrevious);
+			break;
+
+		case TaskStateSleeping:
+		case TaskStateBlockedWithTimeout:
+			pPrevious->m_pQueueNext = m_pSleepList;
+			m_pSleepList = pPrevious;
+			StartWakeTimer ();
+			break;
+
+		case TaskStateBlocked:
+			break;
+
+		case TaskStateTerminated:
+			bTerminated = TRUE;
+			break;
+
+		default:
+			assert (0);
+			break;
+		}
+	}
+
+	m_SpinLock.Release ();
+
+	if (bTerminated)
+	{
+		if (m_pTaskTerminationHandler != 0)
+		{
+			(*m_pTaskTerminationHandler) (pPrevious);
+		}
+
+		RemoveTask (pPrevious);
+		delete pPrevious;
+	}
 }
 
+#endif
+
 void CScheduler::Sleep (unsigned nSeconds)
 {
 	// be sure the clock does not run over taken as signed int
@@ -111,10 +301,11 @@ void CScheduler::usSleep (unsigned nMicroSeconds)
 
 		unsigned nStartTicks = CTimer::Get ()->GetClockTicks ();
 
-		assert (m_pCurrent != 0);
-		assert (m_pCurrent->GetState () == TaskStateReady);
-		m_pCurrent->SetWakeTicks (nStartTicks + nTicks);
-		m_pCurrent->SetState (TaskStateSleeping);
+		CTask *pCurrent = GetCurrentTask ();
+		assert (pCurrent != 0);
+		assert (pCurrent->GetState () == TaskStateReady);
+		pCurrent->SetWakeTicks (nStartTicks + nTicks);
+		pCurrent->SetState (TaskStateSleeping);
 
 		Yield ();
 	}
@@ -122,7 +313,11 @@ void CScheduler::usSleep (unsigned nMicroSeconds)
 
 CTask *CScheduler::GetCurrentTask (void)
 {
+#ifndef ARM_ALLOW_MULTI_CORE
 	return m_pCurrent;
+#else
+	return m_Core[ThisCore ()].pCurrent;
+#endif
 }
 
 CTask *CScheduler::GetTask (const char *pTaskName)
@@ -145,13 +340,21 @@ CTask *CScheduler::GetTask (const char *pTaskName)
 
 boolean CScheduler::IsValidTask (CTask *pTask)
 {
+	m_SpinLock.Acquire ();
+
 	unsigned i;
 	for (i = 0; i < m_nTasks; i++)
 	{
 		if (m_pTask[i] != 0 && m_pTask[i] == pTask)
+		{
+			m_SpinLock.Release ();
+
 			return TRUE;
+		}
 	}
 
+	m_SpinLock.Release ();
+
 	return FALSE;
 }
 
@@ -215,10 +418,18 @@ void CScheduler::ListTasks (CDevice *pTarget)
 		static const char *StateNames[] =
 			{"new", "ready", "block", "block", "sleep", "term"};
 
+#ifndef ARM_ALLOW_MULTI_CORE
+		const char *pRunning = pTask == m_pCurrent ? "run" : 0;
+#else
+		CString Running;
+		Running.Format ("run%u", pTask->m_nCore);
+		const char *pRunning = pTask->m_bOnCore ? (const char *) Running : 0;
+#endif
+
 		CString Line;
 		Line.Format ("%02u %08lX %-5s %c%c %s\n",
 			     i, (uintptr) pTask,
-			     pTask == m_pCurrent ? "run" : StateNames[State],
+			     pRunning != 0 ? pRunning : StateNames[State],
 			     pTask->IsSuspended () ? 'S' : ' ',
 			     State == TaskStateBlockedWithTimeout ? 'T' : ' ',
 			     pTask->GetName ());
@@ -227,6 +438,8 @@ void CScheduler::ListTasks (CDevice *pTarget)
 	}
 }
 
+#ifndef ARM_ALLOW_MULTI_CORE
+
 void CScheduler::AddTask (CTask *pTask)
 {
 	assert (pTask != 0);
@@ -255,81 +468,35 @@ void CScheduler::AddTask (CTask *pTask)
 	m_pTask[m_nTasks++] = pTask;
 }
 
-void CScheduler::RemoveTask (CTask *pTask)
+void CScheduler::StartTask (CTask *pTask)
 {
-	for (unsigned i = 0; i < m_nTasks; i++)
+	assert (pTask != 0);
+
+	if (pTask->GetState () == TaskStateNew)
 	{
-		if (m_pTask[i] == pTask)
+		// a task, which starts itself in its constructor, is held by SuspendNewTasks() too
+		if (m_iSuspendNewTasks == 0)
 		{
-			m_pTask[i] = 0;
-
-			if (i == m_nTasks-1)
-			{
-				m_nTasks--;
-			}
-
-			return;
+			pTask->SetState (TaskStateReady);
 		}
 	}
-
-	assert (0);
-}
-
-boolean CScheduler::BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds)
-{
-	assert (ppWaitListHead != 0);
-	assert (m_pCurrent->m_pWaitListNext == 0);
-	assert (m_pCurrent != 0);
-	assert (m_pCurrent->GetState () == TaskStateReady);
-
-	m_SpinLock.Acquire ();
-
-	// Add current task to waiting task list
-	m_pCurrent->m_pWaitListNext = *ppWaitListHead;
-	*ppWaitListHead = m_pCurrent;
-
-	if (nMicroSeconds == 0)
-	{
-		m_pCurrent->SetState (TaskStateBlocked);
-	}
 	else
 	{
-		unsigned nTicks = nMicroSeconds * (CLOCKHZ / 1000000);
-		unsigned nStartTicks = CTimer::Get ()->GetClockTicks ();
-
-		m_pCurrent->SetWakeTicks (nStartTicks + nTicks);
-		m_pCurrent->SetState (TaskStateBlockedWithTimeout);
+		assert (pTask->m_bSuspended);
+		pTask->m_bSuspended = FALSE;
 	}
-	
-	m_SpinLock.Release ();
-
-	Yield ();
+}
 
-	m_SpinLock.Acquire ();
+void CScheduler::WaitForTermination (CTask *pTask)
+{
+	assert (pTask != 0);
 
-	// Remove this task from the wait list in case was woken by timeout and
-	// not by the event signalling (in which case the list will already be 
-	// cleared and the following is a no-op)
-	CTask* pPrev = 0;
-	CTask* p = *ppWaitListHead;
-	while (p)
+	if (!IsValidTask (pTask))
 	{
-		if (p == m_pCurrent)
-		{
-			if (pPrev)
-				pPrev->m_pWaitListNext = p->m_pWaitListNext;
-			else
-				*ppWaitListHead = p->m_pWaitListNext;
-		}
-		pPrev = p;
-		p = p->m_pWaitListNext;
+		return;
 	}
-	m_pCurrent->m_pWaitListNext = nullptr;
-
-	m_SpinLock.Release ();
 
-	// GetWakeTicks Will be zero if timeout expired, non-zero if event signalled
-	return m_pCurrent->GetWakeTicks() == 0;		
+	pTask->m_Event.Wait ();
 }
 
 void CScheduler::WakeTasks (CTask **ppWaitListHead)
@@ -438,6 +605,619 @@ unsigned CScheduler::GetNextTask (void)
 	return MAX_TASKS;
 }
 
+#endif
+
+void CScheduler::RemoveTask (CTask *pTask)
+{
+	m_SpinLock.Acquire ();
+
+	for (unsigned i = 0; i < m_nTasks; i++)
+	{
+		if (m_pTask[i] == pTask)
+		{
+			m_pTask[i] = 0;
+
+			if (i == m_nTasks-1)
+			{
+				m_nTasks--;
+			}
+
+			m_SpinLock.Release ();
+
+			return;
+		}
+	}
+
+	m_SpinLock.Release ();
+
+	assert (0);
+}
+
+boolean CScheduler::BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds,
+			       const volatile boolean *pbEventState)
+{
+	assert (ppWaitListHead != 0);
+	assert (pbEventState != 0);
+
+	m_SpinLock.Acquire ();
+
+	CTask *pCurrent = GetCurrentTask ();
+	assert (pCurrent != 0);
+	assert (pCurrent->m_pWaitListNext == 0);
+	assert (pCurrent->GetState () == TaskStateReady);
+
+	// the event may have been set on another core in the meantime
+	if (*pbEventState)
+	{
+		m_SpinLock.Release ();
+
+		return FALSE;
+	}
+
+	// Add current task to waiting task list
+	pCurrent->m_pWaitListNext = *ppWaitListHead;
+	*ppWaitListHead = pCurrent;
+
+	if (nMicroSeconds == 0)
+	{
+		pCurrent->SetState (TaskStateBlocked);
+	}
+	else
+	{
+		unsigned nTicks = nMicroSeconds * (CLOCKHZ / 1000000);
+		unsigned nStartTicks = CTimer::Get ()->GetClockTicks ();
+
+		pCurrent->SetWakeTicks (nStartTicks + nTicks);
+		pCurrent->SetState (TaskStateBlockedWithTimeout);
+	}
+	
+	m_SpinLock.Release ();
+
+	Yield ();
+
+	m_SpinLock.Acquire ();
+
+	// Remove this task from the wait list in case was woken by timeout and
+	// not by the event signalling (in which case the list will already be 
+	// cleared and the following is a no-op)
+	CTask* pPrev = 0;
+	CTask* p = *ppWaitListHead;
+	while (p)
+	{
+		if (p == pCurrent)
+		{
+			if (pPrev)
+				pPrev->m_pWaitListNext = p->m_pWaitListNext;
+			else
+				*ppWaitListHead = p->m_pWaitListNext;
+		}
+		pPrev = p;
+		p = p->m_pWaitListNext;
+	}
+	pCurrent->m_pWaitListNext = nullptr;
+
+	m_SpinLock.Release ();
+
+	// GetWakeTicks Will be zero if timeout expired, non-zero if event signalled
+	return pCurrent->GetWakeTicks() == 0;		
+}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+void CScheduler::EnterSecondaryCore (void)
+{
+	unsigned nCore = ThisCore ();
+	assert (1 <= nCore && nCore < SCHEDULER_CORES);
+	TCoreData *pCore = &m_Core[nCore];
+
+	// the calling context becomes the idle task of this core
+	CTask *pIdleTask = new CTask (0);
+	assert (pIdleTask != 0);
+	CString Name;
+	Name.Format ("idle%u", nCore);
+	pIdleTask->SetName (Name);
+	pIdleTask->m_nAffinity = 1 << nCore;
+
+	m_SpinLock.Acquire ();
+
+	if (m_nActiveCores == 1 << 0)
+	{
+		CMultiCoreSupport::ConnectIPI (IPI_SCHEDULER, IPIHandler, this);
+	}
+
+	pIdleTask->m_nCore = nCore;
+	pIdleTask->m_bOnCore = TRUE;
+
+	assert (pCore->pCurrent == 0);
+	pCore->pIdleTask = pIdleTask;
+	pCore->pCurrent = pIdleTask;
+
+	m_nActiveCores |= 1 << nCore;
+
+	StartWakeTimer ();
+
+	m_SpinLock.Release ();
+
+	while (1)
+	{
+		Yield ();
+	}
+}
+
+void CScheduler::AddTask (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	m_SpinLock.Acquire ();
+
+	if (m_iSuspendNewTasks)
+	{
+		pTask->SetState(TaskStateNew);
+	}
+
+	unsigned i;
+	for (i = 0; i < m_nTasks; i++)
+	{
+		if (m_pTask[i] == 0)
+		{
+			break;
+		}
+	}
+
+	if (i == m_nTasks)
+	{
+		if (m_nTasks >= MAX_TASKS)
+		{
+			m_SpinLock.Release ();
+
+			CLogger::Get ()->Write (FromScheduler, LogPanic, "System limit of tasks exceeded");
+		}
+
+		m_nTasks++;
+	}
+
+	m_pTask[i] = pTask;
+
+	// the main task and the idle tasks are already running
+	pTask->m_nCore = ThisCore ();
+	if (   pTask->GetState () == TaskStateReady
+	    && pTask->m_nStackSize != 0)
+	{
+		Enqueue (pTask);
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CScheduler::StartTask (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	m_SpinLock.Acquire ();
+
+	if (pTask->GetState () == TaskStateNew)
+	{
+		// a task, which starts itself in its constructor, is held by SuspendNewTasks() too
+		if (m_iSuspendNewTasks == 0)
+		{
+			pTask->SetState (TaskStateReady);
+
+			if (!pTask->m_bOnCore)
+			{
+				Enqueue (pTask);
+			}
+		}
+	}
+	else
+	{
+		assert (pTask->m_bSuspended);
+		pTask->m_bSuspended = FALSE;
+
+		// the task remained in its run queue, while it was suspended
+		if (   pTask->GetState () == TaskStateReady
+		    && !pTask->m_bOnCore)
+		{
+			WakeCore (pTask->m_nCore);
+		}
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CScheduler::WaitForTermination (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	m_SpinLock.Acquire ();
+
+	// the task may be deleted on another core at any time,
+	// so it is checked with the lock held, before its event is accessed
+	unsigned i;
+	for (i = 0; i < m_nTasks; i++)
+	{
+		if (m_pTask[i] == pTask)
+		{
+			break;
+		}
+	}
+
+	if (   i == m_nTasks
+	    || pTask->m_Event.m_bState)
+	{
+		m_SpinLock.Release ();
+
+		return;
+	}
+
+	CTask *pCurrent = GetCurrentTask ();
+	assert (pCurrent != 0);
+	assert (pCurrent != pTask);
+	assert (pCurrent->m_pWaitListNext == 0);
+	assert (pCurrent->GetState () == TaskStateReady);
+
+	pCurrent->m_pWaitListNext = pTask->m_Event.m_pWaitListHead;
+	pTask->m_Event.m_pWaitListHead = pCurrent;
+	pCurrent->SetState (TaskStateBlocked);
+
+	m_SpinLock.Release ();
+
+	Yield ();
+}
+
+void CScheduler::WakeTasks (CTask **ppWaitListHead)
+{
+	assert (ppWaitListHead != 0);
+
+	m_SpinLock.Acquire ();
+
+	CTask *pTask = *ppWaitListHead;
+	*ppWaitListHead = 0;
+
+	while (pTask)
+	{
+		CTask* pNext = pTask->m_pWaitListNext;
+		pTask->m_pWaitListNext = 0;
+
+		switch (pTask->GetState ())
+		{
+		case TaskStateBlockedWithTimeout:
+			if (!pTask->m_bOnCore)
+			{
+				RemoveSleepingTask (pTask);
+			}
+			// fall through
+
+		case TaskStateBlocked:
+			pTask->SetState (TaskStateReady);
+
+			// a task, which is still switched out on its core, is queued in
+			// FinishTaskSwitch()
+			if (!pTask->m_bOnCore)
+			{
+				Enqueue (pTask);
+			}
+			break;
+
+		case TaskStateReady:
+			// has been woken by timeout, but has not removed itself from the list yet
+			break;
+
+		default:
+			m_SpinLock.Release ();
+
+			CLogger::Get ()->Write (FromScheduler, LogPanic, "Tried to wake non-blocked task");
+			break;
+		}
+
+		pTask = pNext;
+	}
+
+	m_SpinLock.Release ();
+}
+
+CTask *CScheduler::GetNextTask (unsigned nCore)
+{
+	WakeSleepingTasks ();
+
+	// own run queue first, then steal work from the other cores
+	for (unsigned i = 0; i < SCHEDULER_CORES; i++)
+	{
+		TCoreData *pCore = &m_Core[(nCore + i) % SCHEDULER_CORES];
+
+		CTask *pPrev = 0;
+		for (CTask *pTask = pCore->pRunQueueHead; pTask != 0; pTask = pTask->m_pQueueNext)
+		{
+			assert (pTask->GetState () == TaskStateReady);
+			assert (!pTask->m_bOnCore);
+
+			if (   pTask->IsSuspended ()
+			    || !(pTask->m_nAffinity & (1 << nCore)))
+			{
+				pPrev = pTask;
+
+				continue;
+			}
+
+			if (pPrev != 0)
+			{
+				pPrev->m_pQueueNext = pTask->m_pQueueNext;
+			}
+			else
+			{
+				pCore->pRunQueueHead = pTask->m_pQueueNext;
+			}
+
+			if (pCore->pRunQueueTail == pTask)
+			{
+				pCore->pRunQueueTail = pPrev;
+			}
+
+			pTask->m_pQueueNext = 0;
+
+			return pTask;
+		}
+	}
+
+	return 0;
+}
+
+boolean CScheduler::CanContinue (CTask *pTask, unsigned nCore)
+{
+	assert (pTask != 0);
+
+	if (pTask->IsSuspended ())
+	{
+		return FALSE;
+	}
+
+	// core 0 cannot switch out a task, which is not allowed to run here any more,
+	// without having another task, so the task continues for now
+	if (   !(pTask->m_nAffinity & (1 << nCore))
+	    && m_Core[nCore].pIdleTask != 0)
+	{
+		return FALSE;
+	}
+
+	switch (pTask->GetState ())
+	{
+	case TaskStateReady:
+		return TRUE;
+
+	case TaskStateBlockedWithTimeout:
+	case TaskStateSleeping:
+		if ((int) (pTask->GetWakeTicks () - CTimer::Get ()->GetClockTicks ()) > 0)
+		{
+			return FALSE;
+		}
+		if (pTask->GetState () == TaskStateBlockedWithTimeout)
+		{
+			pTask->SetWakeTicks (0);	// Use as flag that timeout expired
+		}
+		pTask->SetState (TaskStateReady);
+		return TRUE;
+
+	default:
+		return FALSE;
+	}
+}
+
+void CScheduler::Enqueue (CTask *pTask)
+{
+	assert (pTask != 0);
+	assert (pTask->GetState () == TaskStateReady);
+	assert (!pTask->m_bOnCore);
+
+	unsigned nCore = SelectCore (pTask);
+	TCoreData *pCore = &m_Core[nCore];
+
+	pTask->m_nCore = nCore;
+	pTask->m_pQueueNext = 0;
+
+	if (pCore->pRunQueueTail != 0)
+	{
+		pCore->pRunQueueTail->m_pQueueNext = pTask;
+	}
+	else
+	{
+		pCore->pRunQueueHead = pTask;
+	}
+	pCore->pRunQueueTail = pTask;
+
+	WakeCore (nCore);
+}
+
+unsigned CScheduler::SelectCore (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	unsigned nMask = pTask->m_nAffinity & m_nActiveCores;
+	if (nMask == 0)
+	{
+		nMask = pTask->m_nAffinity;	// wait for an allowed core to become active
+	}
+	assert (nMask != 0);
+
+	// prefer an idle core, starting with the core, on which the task ran before
+	unsigned nCore = pTask->m_nCore;
+	for (unsigned i = 0; i < SCHEDULER_CORES; i++)
+	{
+		unsigned nTry = (nCore + i) % SCHEDULER_CORES;
+		if (   (nMask & (1 << nTry))
+		    && m_Core[nTry].bIdle)
+		{
+			return nTry;
+		}
+	}
+
+	if (nMask & (1 << nCore))
+	{
+		return nCore;
+	}
+
+	for (nCore = 0; !(nMask & (1 << nCore)); nCore++)
+	{
+		assert (nCore < SCHEDULER_CORES);
+	}
+
+	return nCore;
+}
+
+void CScheduler::WakeCore (unsigned nCore)
+{
+	assert (nCore < SCHEDULER_CORES);
+	TCoreData *pCore = &m_Core[nCore];
+
+	if (   pCore->bIdle
+	    && nCore != ThisCore ())
+	{
+		pCore->bIdle = FALSE;		// do not select this core again, before it woke up
+
+		CMultiCoreSupport::SendIPI (nCore, IPI_SCHEDULER);
+	}
+}
+
+void CScheduler::WakeSleepingTasks (void)
+{
+	if (m_pSleepList == 0)
+	{
+		return;
+	}
+
+	unsigned nTicks = CTimer::Get ()->GetClockTicks ();
+
+	CTask *pPrev = 0;
+	CTask *pTask = m_pSleepList;
+	while (pTask != 0)
+	{
+		CTask *pNext = pTask->m_pQueueNext;
+
+		if ((int) (pTask->GetWakeTicks () - nTicks) > 0)
+		{
+			pPrev = pTask;
+			pTask = pNext;
+
+			continue;
+		}
+
+		if (pPrev != 0)
+		{
+			pPrev->m_pQueueNext = pNext;
+		}
+		else
+		{
+			m_pSleepList = pNext;
+		}
+
+		if (pTask->GetState () == TaskStateBlockedWithTimeout)
+		{
+			pTask->SetWakeTicks (0);	// Use as flag that timeout expired
+		}
+		else
+		{
+			assert (pTask->GetState () == TaskStateSleeping);
+		}
+
+		pTask->SetState (TaskStateReady);
+		Enqueue (pTask);
+
+		pTask = pNext;
+	}
+}
+
+void CScheduler::RemoveSleepingTask (CTask *pTask)
+{
+	CTask *pPrev = 0;
+	for (CTask *p = m_pSleepList; p != 0; pPrev = p, p = p->m_pQueueNext)
+	{
+		if (p == pTask)
+		{
+			if (pPrev != 0)
+			{
+				pPrev->m_pQueueNext = p->m_pQueueNext;
+			}
+			else
+			{
+				m_pSleepList = p->m_pQueueNext;
+			}
+
+			pTask->m_pQueueNext = 0;
+
+			return;
+		}
+	}
+
+	assert (0);
+}
+
+// The idle secondary cores do not check the sleeping tasks. If at least one secondary core
+// is active, a timer is running, which expires, when the next sleeping task has to wake up.
+void CScheduler::StartWakeTimer (void)
+{
+	if (   m_pSleepList == 0
+	    || m_nActiveCores == 1 << 0)
+	{
+		return;
+	}
+
+	unsigned nWakeTicks = m_pSleepList->GetWakeTicks ();
+	for (CTask *pTask = m_pSleepList->m_pQueueNext; pTask != 0; pTask = pTask->m_pQueueNext)
+	{
+		if ((int) (pTask->GetWakeTicks () - nWakeTicks) < 0)
+		{
+			nWakeTicks = pTask->GetWakeTicks ();
+		}
+	}
+
+	CTimer *pTimer = CTimer::Get ();
+	assert (pTimer != 0);
+
+	if (m_hWakeTimer != 0)
+	{
+		if ((int) (nWakeTicks - m_nWakeTimerTicks) >= 0)
+		{
+			return;
+		}
+
+		pTimer->CancelKernelTimer (m_hWakeTimer);
+	}
+
+	int nDelay = (int) (nWakeTicks - pTimer->GetClockTicks ());
+	if (nDelay <= 0)
+	{
+		nDelay = 1;
+	}
+
+	m_nWakeTimerTicks = nWakeTicks;
+	m_hWakeTimer = pTimer->StartHighResTimer (nDelay * (1000000 / CLOCKHZ),
+						  WakeTimerHandler, this);
+}
+
+void CScheduler::WakeTimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CScheduler *pThis = (CScheduler *) pParam;
+	assert (pThis != 0);
+
+	pThis->m_SpinLock.Acquire ();
+
+	if (pThis->m_hWakeTimer == hTimer)
+	{
+		pThis->m_hWakeTimer = 0;
+	}
+
+	pThis->WakeSleepingTasks ();
+
+	pThis->StartWakeTimer ();
+
+	pThis->m_SpinLock.Release ();
+}
+
+void CScheduler::IPIHandler (unsigned nIPI, void *pParam)
+{
+	// nothing to do, the IPI only wakes the core from WFI in Yield()
+}
+
+#endif
+
 CScheduler *CScheduler::Get (void)
 {
 	assert (s_pThis != 0);
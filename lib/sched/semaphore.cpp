@@ -18,7 +18,6 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/sched/semaphore.h>
-#include <circle/atomic.h>
 #include <assert.h>
 
 CSemaphore::CSemaphore (unsigned nInitialCount)
@@ -35,51 +34,49 @@ CSemaphore::~CSemaphore (void)
 
 unsigned CSemaphore::GetState (void) const
 {
-	return AtomicGet (&m_nCount);
+	return m_nCount;
 }
 
 void CSemaphore::Down (void)
 {
-	while (AtomicGet (&m_nCount) == 0)
+	while (!TryDown ())
 	{
+		// returns immediately, if Up() has been called in the meantime
 		m_Event.Wait ();
 	}
-
-	if (AtomicDecrement (&m_nCount) == 0)
-	{
-		assert (m_Event.GetState ());
-		m_Event.Clear ();
-	}
 }
 
 void CSemaphore::Up (void)
 {
-	if (AtomicIncrement (&m_nCount) == 1)
+	m_SpinLock.Acquire ();
+
+	if (m_nCount++ == 0)
 	{
 		assert (!m_Event.GetState ());
 		m_Event.Set ();
 	}
-#if NDEBUG
-	else
-	{
-		assert (m_Event.GetState ());
-	}
-#endif
 
+	m_SpinLock.Release ();
 }
 
 boolean CSemaphore::TryDown (void)
 {
-	if (AtomicGet (&m_nCount) == 0)
+	m_SpinLock.Acquire ();
+
+	if (m_nCount == 0)
 	{
+		m_SpinLock.Release ();
+
 		return FALSE;
 	}
 
-	if (AtomicDecrement (&m_nCount) == 0)
+	if (--m_nCount == 0)
 	{
 		assert (m_Event.GetState ());
 		m_Event.Clear ();
 	}
 
+	m_SpinLock.Release ();
+
 	return TRUE;
 }
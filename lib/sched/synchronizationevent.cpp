@@ -63,25 +63,12 @@ void CSynchronizationEvent::Set (void)
 	}
 }
 
-// Wakes all waiting tasks and immediately resets the event again
-void CSynchronizationEvent::Pulse (void)
-{
-	// Cheaper and same effect as Set() + Clear()
-	m_bState = FALSE;
-
-#ifdef ARM_ALLOW_MULTI_CORE
-	DataSyncBarrier ();
-#endif
-
-	CScheduler::Get ()->WakeTasks (&m_pWaitListHead);
-}
-
 
 void CSynchronizationEvent::Wait (void)
 {
 	if (!m_bState)
 	{
-		CScheduler::Get ()->BlockTask (&m_pWaitListHead, 0);
+		CScheduler::Get ()->BlockTask (&m_pWaitListHead, 0, &m_bState);
 	}
 }
 
@@ -93,6 +80,6 @@ boolean CSynchronizationEvent::WaitWithTimeout (unsigned nMicroSeconds)
 	}
 	else
 	{
-		return CScheduler::Get ()->BlockTask (&m_pWaitListHead, nMicroSeconds);
+		return CScheduler::Get ()->BlockTask (&m_pWaitListHead, nMicroSeconds, &m_bState);
 	}
 }
@@ -2,7 +2,7 @@
 // task.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2021  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2024  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -27,7 +27,11 @@ CTask::CTask (unsigned nStackSize, boolean bCreateSuspended)
 	m_bSuspended (FALSE),
 	m_nStackSize (nStackSize),
 	m_pStack (0),
-	m_pWaitListNext (0)
+	m_pWaitListNext (0),
+	m_nAffinity ((1 << SCHEDULER_CORES)-1),
+	m_nCore (0),
+	m_bOnCore (FALSE),
+	m_pQueueNext (0)
 {
 	for (unsigned i = 0; i < TASK_USER_DATA_SLOTS; i++)
 	{
@@ -69,15 +73,7 @@ CTask::~CTask (void)
 
 void CTask::Start (void)
 {
-	if (m_State == TaskStateNew)
-	{
-		m_State = TaskStateReady;
-	}
-	else
-	{
-		assert (m_bSuspended);
-		m_bSuspended = FALSE;
-	}
+	CScheduler::Get ()->StartTask (this);
 }
 
 void CTask::Suspend (void)
@@ -106,12 +102,15 @@ void CTask::WaitForTermination (void)
 	// Before accessing any of our member variables
 	// make sure this task object hasn't been deleted by 
 	// checking it's still registered with the scheduler
-	if (!CScheduler::Get()->IsValidTask (this))
-	{
-		return;
-	}
+	CScheduler::Get()->WaitForTermination (this);
+}
+
+void CTask::SetAffinity (unsigned nCoreMask)
+{
+	nCoreMask &= (1 << SCHEDULER_CORES)-1;
+	assert (nCoreMask != 0);
 
-	m_Event.Wait ();
+	m_nAffinity = nCoreMask;
 }
 
 void CTask::SetName (const char *pName)
@@ -178,6 +177,10 @@ void CTask::TaskEntry (void *pParam)
 	CTask *pThis = (CTask *) pParam;
 	assert (pThis != 0);
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	CScheduler::Get ()->FinishTaskSwitch ();
+#endif
+
 	pThis->Run ();
 
 	pThis->m_State = TaskStateTerminated;
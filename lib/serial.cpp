@@ -19,10 +19,12 @@
 //
 #include <circle/serial.h>
 #include <circle/devicenameservice.h>
+#include <circle/dmachannel.h>
 #include <circle/bcm2835.h>
 #include <circle/memio.h>
 #include <circle/machineinfo.h>
 #include <circle/synchronize.h>
+#include <circle/new.h>
 #include <assert.h>
 
 #ifndef USE_RPI_STUB_AT
@@ -47,6 +49,7 @@
 #define ARM_UART_RIS    	(m_nBaseAddress + 0x3C)
 #define ARM_UART_MIS    	(m_nBaseAddress + 0x40)
 #define ARM_UART_ICR    	(m_nBaseAddress + 0x44)
+#define ARM_UART_DMACR    	(m_nBaseAddress + 0x48)
 
 // Definitions from Raspberry PI Remote Serial Protocol.
 //     Copyright 2012 Jamie Iles, jamie@jamieiles.com.
@@ -105,6 +108,9 @@
 #define INT_DCDM		(1 << 2)
 #define INT_CTSM		(1 << 1)
 
+#define DMACR_TXDMAE		(1 << 1)
+#define DMACR_RXDMAE		(1 << 0)
+
 static uintptr s_BaseAddress[SERIAL_DEVICES] =
 {
 	ARM_IO_BASE + 0x201000,
@@ -149,17 +155,31 @@ boolean CSerialDevice::s_bUseFIQ = FALSE;
 volatile u32 CSerialDevice::s_nInterruptDeviceMask = 0;
 CSerialDevice *CSerialDevice::s_pThis[SERIAL_DEVICES] = {0};
 
-CSerialDevice::CSerialDevice (CInterruptSystem *pInterruptSystem, boolean bUseFIQ, unsigned nDevice)
+CSerialDevice::CSerialDevice (CInterruptSystem *pInterruptSystem, boolean bUseFIQ, unsigned nDevice,
+			      unsigned nBufferSize, boolean bUseDMA)
 :	m_pInterruptSystem (pInterruptSystem),
 	m_bUseFIQ (bUseFIQ),
 	m_nDevice (nDevice),
 	m_nBaseAddress (0),
 	m_bValid (FALSE),
+	m_nBufferSize (nBufferSize),
+	m_nBufferMask (nBufferSize-1),
+	m_pRxBuffer (0),
 	m_nRxInPtr (0),
 	m_nRxOutPtr (0),
 	m_nRxStatus (0),
+	m_pTxBuffer (0),
 	m_nTxInPtr (0),
 	m_nTxOutPtr (0),
+	m_bUseDMA (bUseDMA),
+	m_pTxDMA (0),
+	m_pRxDMA (0),
+	m_pTxDMABuffer (0),
+	m_pRxDMABuffer (0),
+	m_nTxDMALength (0),
+	m_nRxDMAStart (0),
+	m_nRxDMALength (0),
+	m_nRxDMAReceived (0),
 	m_nOptions (SERIAL_OPTION_ONLCR),
 	m_pMagic (0),
 	m_SpinLock (bUseFIQ ? FIQ_LEVEL : IRQ_LEVEL)
@@ -198,6 +218,29 @@ CSerialDevice::CSerialDevice (CInterruptSystem *pInterruptSystem, boolean bUseFI
 	m_RxDPin.SetMode (ALT_FUNC (nDevice, GPIO_RXD));
 	m_RxDPin.SetPullMode (GPIOPullModeUp);
 
+	assert (m_nBufferSize >= 2);
+	assert ((m_nBufferSize & m_nBufferMask) == 0);
+
+	if (m_bUseDMA)
+	{
+		// the DMA controller can access the data register in words only
+		assert (m_pInterruptSystem != 0);
+		assert (!m_bUseFIQ);
+		assert (m_nDevice == 0);
+
+		m_pTxDMABuffer = new (HEAP_DMA30) u32[m_nBufferSize];
+		m_pRxDMABuffer = new (HEAP_DMA30) u32[m_nBufferSize];
+		assert (m_pTxDMABuffer != 0);
+		assert (m_pRxDMABuffer != 0);
+	}
+	else if (m_pInterruptSystem != 0)
+	{
+		m_pTxBuffer = new u8[m_nBufferSize];
+		m_pRxBuffer = new u8[m_nBufferSize];
+		assert (m_pTxBuffer != 0);
+		assert (m_pRxBuffer != 0);
+	}
+
 	m_bValid = TRUE;
 }
 
@@ -215,10 +258,17 @@ CSerialDevice::~CSerialDevice (void)
 	DataSyncBarrier ();
 
 	PeripheralEntry ();
+	write32 (ARM_UART_DMACR, 0);
 	write32 (ARM_UART_IMSC, 0);
 	write32 (ARM_UART_CR, 0);
 	PeripheralExit ();
 
+	delete m_pTxDMA;
+	m_pTxDMA = 0;
+
+	delete m_pRxDMA;
+	m_pRxDMA = 0;
+
 	// disconnect interrupt, if this is the last device, which uses interrupts
 	if (   m_pInterruptSystem != 0
 	    && --s_nInterruptUseCount == 0)
@@ -240,6 +290,18 @@ CSerialDevice::~CSerialDevice (void)
 	m_TxDPin.SetMode (GPIOModeInput);
 	m_RxDPin.SetMode (GPIOModeInput);
 
+	delete [] m_pTxDMABuffer;
+	m_pTxDMABuffer = 0;
+
+	delete [] m_pRxDMABuffer;
+	m_pRxDMABuffer = 0;
+
+	delete [] m_pTxBuffer;
+	m_pTxBuffer = 0;
+
+	delete [] m_pRxBuffer;
+	m_pRxBuffer = 0;
+
 	s_pThis[m_nDevice] = 0;
 	m_bValid = FALSE;
 }
@@ -297,6 +359,17 @@ boolean CSerialDevice::Initialize (unsigned nBaudrate,
 
 		assert (s_nInterruptUseCount < SERIAL_DEVICES);
 		s_nInterruptUseCount++;
+
+		if (m_bUseDMA)
+		{
+			m_pTxDMA = new CDMAChannel (DMA_CHANNEL_NORMAL, m_pInterruptSystem);
+			m_pRxDMA = new CDMAChannel (DMA_CHANNEL_NORMAL, m_pInterruptSystem);
+			assert (m_pTxDMA != 0);
+			assert (m_pRxDMA != 0);
+
+			m_pTxDMA->SetCompletionRoutine (TxDMACompletionRoutine, this);
+			m_pRxDMA->SetCompletionRoutine (RxDMACompletionRoutine, this);
+		}
 	}
 
 	PeripheralEntry ();
@@ -349,7 +422,17 @@ boolean CSerialDevice::Initialize (unsigned nBaudrate,
 		write32 (ARM_UART_IFLS,   IFLS_IFSEL_1_4 << IFLS_TXIFSEL_SHIFT
 					| IFLS_IFSEL_1_4 << IFLS_RXIFSEL_SHIFT);
 		write32 (ARM_UART_LCRH, nLCRH);
-		write32 (ARM_UART_IMSC, INT_RX | INT_RT | INT_OE);
+
+		if (!m_bUseDMA)
+		{
+			write32 (ARM_UART_IMSC, INT_RX | INT_RT | INT_OE);
+		}
+		else
+		{
+			// the RX interrupt is replaced by the DMA, the RX timeout signals an idle line
+			write32 (ARM_UART_IMSC, INT_RT | INT_OE);
+			write32 (ARM_UART_DMACR, DMACR_TXDMAE | DMACR_RXDMAE);
+		}
 
 		// add device to interrupt handling
 		s_nInterruptDeviceMask |= 1 << m_nDevice;
@@ -364,6 +447,15 @@ boolean CSerialDevice::Initialize (unsigned nBaudrate,
 
 	PeripheralExit ();
 
+	if (m_bUseDMA)
+	{
+		m_SpinLock.Acquire ();
+
+		StartRxDMA ();
+
+		m_SpinLock.Release ();
+	}
+
 	CDeviceNameService::Get ()->AddDevice ("ttyS", m_nDevice+1, this, FALSE);
 
 	return TRUE;
@@ -386,6 +478,15 @@ int CSerialDevice::Write (const void *pBuffer, size_t nCount)
 	u8 *pChar = (u8 *) pBuffer;
 	assert (pChar != 0);
 
+	if (m_bUseDMA)
+	{
+		int nResult = WriteDMA (pChar, nCount);
+
+		m_LineSpinLock.Release ();
+
+		return nResult;
+	}
+
 	int nResult = 0;
 
 	while (nCount--)
@@ -423,8 +524,8 @@ int CSerialDevice::Write (const void *pBuffer, size_t nCount)
 			{
 				if (!(read32 (ARM_UART_FR) & FR_TXFF_MASK))
 				{
-					write32 (ARM_UART_DR, m_TxBuffer[m_nTxOutPtr++]);
-					m_nTxOutPtr &= SERIAL_BUF_MASK;
+					write32 (ARM_UART_DR, m_pTxBuffer[m_nTxOutPtr++]);
+					m_nTxOutPtr &= m_nBufferMask;
 				}
 				else
 				{
@@ -454,8 +555,15 @@ int CSerialDevice::Read (void *pBuffer, size_t nCount)
 
 	if (m_pInterruptSystem != 0)
 	{
+		boolean bMagicReceived = FALSE;
+
 		m_SpinLock.Acquire ();
 
+		if (m_bUseDMA)
+		{
+			bMagicReceived = UpdateRxDMA ();
+		}
+
 		if (m_nRxStatus < 0)
 		{
 			nResult = m_nRxStatus;
@@ -470,15 +578,34 @@ int CSerialDevice::Read (void *pBuffer, size_t nCount)
 					break;
 				}
 
-				*pChar++ = m_RxBuffer[m_nRxOutPtr++];
-				m_nRxOutPtr &= SERIAL_BUF_MASK;
+				if (!m_bUseDMA)
+				{
+					*pChar++ = m_pRxBuffer[m_nRxOutPtr++];
+				}
+				else
+				{
+					*pChar++ = m_pRxDMABuffer[m_nRxOutPtr++] & 0xFF;
+				}
+				m_nRxOutPtr &= m_nBufferMask;
 
 				nCount--;
 				nResult++;
 			}
+
+			// restart a stalled RX DMA, now that there is space again
+			if (   m_bUseDMA
+			    && m_nRxDMALength == 0)
+			{
+				StartRxDMA ();
+			}
 		}
 
 		m_SpinLock.Release ();
+
+		if (bMagicReceived)
+		{
+			(*m_pMagicReceivedHandler) ();
+		}
 	}
 	else
 	{
@@ -564,7 +691,7 @@ unsigned CSerialDevice::AvailableForWrite (void)
 	unsigned nResult;
 	if (m_nTxOutPtr <= m_nTxInPtr)
 	{
-		nResult = SERIAL_BUF_SIZE+m_nTxOutPtr-m_nTxInPtr-1;
+		nResult = m_nBufferSize+m_nTxOutPtr-m_nTxInPtr-1;
 	}
 	else
 	{
@@ -583,10 +710,15 @@ unsigned CSerialDevice::AvailableForRead (void)
 
 	m_SpinLock.Acquire ();
 
+	if (m_bUseDMA)
+	{
+		UpdateRxDMA ();
+	}
+
 	unsigned nResult;
 	if (m_nRxInPtr < m_nRxOutPtr)
 	{
-		nResult = SERIAL_BUF_SIZE+m_nRxInPtr-m_nRxOutPtr;
+		nResult = m_nBufferSize+m_nRxInPtr-m_nRxOutPtr;
 	}
 	else
 	{
@@ -605,10 +737,15 @@ int CSerialDevice::Peek (void)
 
 	m_SpinLock.Acquire ();
 
+	if (m_bUseDMA)
+	{
+		UpdateRxDMA ();
+	}
+
 	int nResult = -1;
 	if (m_nRxInPtr != m_nRxOutPtr)
 	{
-		nResult = m_RxBuffer[m_nRxOutPtr];
+		nResult = !m_bUseDMA ? m_pRxBuffer[m_nRxOutPtr] : m_pRxDMABuffer[m_nRxOutPtr] & 0xFF;
 	}
 
 	m_SpinLock.Release ();
@@ -618,6 +755,14 @@ int CSerialDevice::Peek (void)
 
 void CSerialDevice::Flush (void)
 {
+	if (m_bUseDMA)
+	{
+		while (m_nTxInPtr != m_nTxOutPtr)
+		{
+			// just wait
+		}
+	}
+
 	PeripheralEntry ();
 
 	while (read32 (ARM_UART_FR) & FR_BUSY_MASK)
@@ -636,10 +781,10 @@ boolean CSerialDevice::Write (u8 uchChar)
 	{
 		m_SpinLock.Acquire ();
 
-		if (((m_nTxInPtr+1) & SERIAL_BUF_MASK) != m_nTxOutPtr)
+		if (((m_nTxInPtr+1) & m_nBufferMask) != m_nTxOutPtr)
 		{
-			m_TxBuffer[m_nTxInPtr++] = uchChar;
-			m_nTxInPtr &= SERIAL_BUF_MASK;
+			m_pTxBuffer[m_nTxInPtr++] = uchChar;
+			m_nTxInPtr &= m_nBufferMask;
 		}
 		else
 		{
@@ -665,6 +810,197 @@ boolean CSerialDevice::Write (u8 uchChar)
 	return bOK;
 }
 
+int CSerialDevice::WriteDMA (const u8 *pBuffer, size_t nCount)
+{
+	assert (pBuffer != 0);
+
+	int nResult = 0;
+
+	m_SpinLock.Acquire ();
+
+	for (; nCount > 0; nCount--)
+	{
+		u8 uchChar = *pBuffer++;
+		boolean bCR = uchChar == '\n' && (m_nOptions & SERIAL_OPTION_ONLCR);
+
+		// do not write NL without CR
+		unsigned nFree = (m_nTxOutPtr - m_nTxInPtr - 1) & m_nBufferMask;
+		if (nFree < (bCR ? 2U : 1U))
+		{
+			break;
+		}
+
+		m_pTxDMABuffer[m_nTxInPtr++] = uchChar;
+		m_nTxInPtr &= m_nBufferMask;
+
+		if (bCR)
+		{
+			m_pTxDMABuffer[m_nTxInPtr++] = '\r';
+			m_nTxInPtr &= m_nBufferMask;
+		}
+
+		nResult++;
+	}
+
+	if (m_nTxDMALength == 0)
+	{
+		StartTxDMA ();
+	}
+
+	m_SpinLock.Release ();
+
+	return nResult;
+}
+
+void CSerialDevice::StartTxDMA (void)
+{
+	assert (m_nTxDMALength == 0);
+
+	if (m_nTxInPtr == m_nTxOutPtr)
+	{
+		return;
+	}
+
+	// send up to the end of the buffer, the rest follows from the completion routine
+	unsigned nLength;
+	if (m_nTxOutPtr < m_nTxInPtr)
+	{
+		nLength = m_nTxInPtr - m_nTxOutPtr;
+	}
+	else
+	{
+		nLength = m_nBufferSize - m_nTxOutPtr;
+	}
+
+	m_nTxDMALength = nLength;
+
+	assert (m_pTxDMA != 0);
+	m_pTxDMA->SetupIOWrite ((u32) ARM_UART_DR, &m_pTxDMABuffer[m_nTxOutPtr],
+				nLength * sizeof (u32), DREQSourceUARTTX);
+	m_pTxDMA->Start ();
+}
+
+void CSerialDevice::StartRxDMA (void)
+{
+	assert (m_nRxDMALength == 0);
+
+	// receive up to the end of the buffer, but not more than there is space
+	unsigned nLength = m_nBufferSize - m_nRxInPtr;
+	unsigned nFree = (m_nRxOutPtr - m_nRxInPtr - 1) & m_nBufferMask;
+	if (nLength > nFree)
+	{
+		nLength = nFree;
+	}
+
+	if (nLength == 0)
+	{
+		return;			// buffer full, Read() restarts the DMA
+	}
+
+	m_nRxDMAStart = m_nRxInPtr;
+	m_nRxDMAReceived = 0;
+	m_nRxDMALength = nLength;
+
+	assert (m_pRxDMA != 0);
+	m_pRxDMA->SetupIORead (&m_pRxDMABuffer[m_nRxInPtr], (u32) ARM_UART_DR,
+			       nLength * sizeof (u32), DREQSourceUARTRX);
+	m_pRxDMA->Start ();
+}
+
+boolean CSerialDevice::UpdateRxDMA (void)
+{
+	if (m_nRxDMALength == 0)
+	{
+		return FALSE;
+	}
+
+	assert (m_pRxDMA != 0);
+	size_t nRemaining = m_pRxDMA->GetRemaining ();
+
+	return ReceiveDMA (m_nRxDMALength - nRemaining / sizeof (u32));
+}
+
+boolean CSerialDevice::ReceiveDMA (unsigned nCount)
+{
+	assert (nCount <= m_nRxDMALength);
+	if (nCount <= m_nRxDMAReceived)
+	{
+		return FALSE;
+	}
+
+	unsigned nFrom = m_nRxDMAStart + m_nRxDMAReceived;
+	unsigned nTo = m_nRxDMAStart + nCount;
+	assert (nTo <= m_nBufferSize);
+
+	CleanAndInvalidateDataCacheRange ((uintptr) &m_pRxDMABuffer[nFrom],
+					  (nTo - nFrom) * sizeof (u32));
+
+	boolean bMagicReceived = FALSE;
+	for (unsigned i = nFrom; i < nTo; i++)
+	{
+		u32 nDR = m_pRxDMABuffer[i];
+
+		if (m_nRxStatus == 0)
+		{
+			m_nRxStatus = GetRxStatus (nDR);
+		}
+
+		if (ScanMagic ((char) (nDR & 0xFF)))
+		{
+			bMagicReceived = TRUE;
+		}
+	}
+
+	m_nRxDMAReceived = nCount;
+	m_nRxInPtr = nTo & m_nBufferMask;
+
+	return bMagicReceived;
+}
+
+boolean CSerialDevice::ScanMagic (char chChar)
+{
+	if (m_pMagic == 0)
+	{
+		return FALSE;
+	}
+
+	if (chChar == *m_pMagicPtr)
+	{
+		if (*++m_pMagicPtr == '\0')
+		{
+			return TRUE;
+		}
+	}
+	else
+	{
+		m_pMagicPtr = m_pMagic;
+	}
+
+	return FALSE;
+}
+
+int CSerialDevice::GetRxStatus (u32 nDR)
+{
+	if (nDR & DR_BE_MASK)
+	{
+		return -SERIAL_ERROR_BREAK;
+	}
+	else if (nDR & DR_OE_MASK)
+	{
+		return -SERIAL_ERROR_OVERRUN;
+	}
+	else if (nDR & DR_FE_MASK)
+	{
+		return -SERIAL_ERROR_FRAMING;
+	}
+	else if (nDR & DR_PE_MASK)
+	{
+		return -SERIAL_ERROR_PARITY;
+	}
+
+	return 0;
+}
+
 void CSerialDevice::InterruptHandler (void)
 {
 	boolean bMagicReceived = FALSE;
@@ -676,57 +1012,43 @@ void CSerialDevice::InterruptHandler (void)
 	// acknowledge pending interrupts
 	write32 (ARM_UART_ICR, read32 (ARM_UART_MIS));
 
+	// On receive timeout (idle line) the RX DMA is stopped to take over the received
+	// characters. The characters, which are left in the FIFO, are read below.
+	if (   m_bUseDMA
+	    && m_nRxDMALength != 0)
+	{
+		assert (m_pRxDMA != 0);
+		size_t nRemaining = m_pRxDMA->Cancel ();
+
+		bMagicReceived = ReceiveDMA (m_nRxDMALength - nRemaining / sizeof (u32));
+
+		m_nRxDMALength = 0;
+	}
+
 	while (!(read32 (ARM_UART_FR) & FR_RXFE_MASK))
 	{
 		u32 nDR = read32 (ARM_UART_DR);
-		if (nDR & DR_BE_MASK)
+		if (m_nRxStatus == 0)
 		{
-			if (m_nRxStatus == 0)
-			{
-				m_nRxStatus = -SERIAL_ERROR_BREAK;
-			}
+			m_nRxStatus = GetRxStatus (nDR);
 		}
-		else if (nDR & DR_OE_MASK)
-		{
-			if (m_nRxStatus == 0)
-			{
-				m_nRxStatus = -SERIAL_ERROR_OVERRUN;
-			}
-		}
-		else if (nDR & DR_FE_MASK)
-		{
-			if (m_nRxStatus == 0)
-			{
-				m_nRxStatus = -SERIAL_ERROR_FRAMING;
-			}
-		}
-		else if (nDR & DR_PE_MASK)
+
+		if (ScanMagic ((char) (nDR & 0xFF)))
 		{
-			if (m_nRxStatus == 0)
-			{
-				m_nRxStatus = -SERIAL_ERROR_PARITY;
-			}
+			bMagicReceived = TRUE;
 		}
 
-		if (m_pMagic != 0)
+		if (((m_nRxInPtr+1) & m_nBufferMask) != m_nRxOutPtr)
 		{
-			if ((char) (nDR & 0xFF) == *m_pMagicPtr)
+			if (!m_bUseDMA)
 			{
-				if (*++m_pMagicPtr == '\0')
-				{
-					bMagicReceived = TRUE;
-				}
+				m_pRxBuffer[m_nRxInPtr++] = nDR & 0xFF;
 			}
 			else
 			{
-				m_pMagicPtr = m_pMagic;
+				m_pRxDMABuffer[m_nRxInPtr++] = nDR;
 			}
-		}
-
-		if (((m_nRxInPtr+1) & SERIAL_BUF_MASK) != m_nRxOutPtr)
-		{
-			m_RxBuffer[m_nRxInPtr++] = nDR & 0xFF;
-			m_nRxInPtr &= SERIAL_BUF_MASK;
+			m_nRxInPtr &= m_nBufferMask;
 		}
 		else
 		{
@@ -737,12 +1059,13 @@ void CSerialDevice::InterruptHandler (void)
 		}
 	}
 
-	while (!(read32 (ARM_UART_FR) & FR_TXFF_MASK))
+	while (   !m_bUseDMA
+	       && !(read32 (ARM_UART_FR) & FR_TXFF_MASK))
 	{
 		if (m_nTxInPtr != m_nTxOutPtr)
 		{
-			write32 (ARM_UART_DR, m_TxBuffer[m_nTxOutPtr++]);
-			m_nTxOutPtr &= SERIAL_BUF_MASK;
+			write32 (ARM_UART_DR, m_pTxBuffer[m_nTxOutPtr++]);
+			m_nTxOutPtr &= m_nBufferMask;
 		}
 		else
 		{
@@ -754,6 +1077,12 @@ void CSerialDevice::InterruptHandler (void)
 
 	PeripheralExit ();
 
+	if (   m_bUseDMA
+	    && m_nRxDMALength == 0)
+	{
+		StartRxDMA ();
+	}
+
 	m_SpinLock.Release ();
 
 	if (bMagicReceived)
@@ -786,6 +1115,43 @@ void CSerialDevice::InterruptStub (void *pParam)
 #endif
 }
 
+void CSerialDevice::TxDMACompletionRoutine (unsigned nChannel, boolean bStatus, void *pParam)
+{
+	CSerialDevice *pThis = (CSerialDevice *) pParam;
+	assert (pThis != 0);
+
+	pThis->m_SpinLock.Acquire ();
+
+	assert (pThis->m_nTxDMALength != 0);
+	pThis->m_nTxOutPtr = (pThis->m_nTxOutPtr + pThis->m_nTxDMALength) & pThis->m_nBufferMask;
+	pThis->m_nTxDMALength = 0;
+
+	pThis->StartTxDMA ();
+
+	pThis->m_SpinLock.Release ();
+}
+
+void CSerialDevice::RxDMACompletionRoutine (unsigned nChannel, boolean bStatus, void *pParam)
+{
+	CSerialDevice *pThis = (CSerialDevice *) pParam;
+	assert (pThis != 0);
+
+	pThis->m_SpinLock.Acquire ();
+
+	assert (pThis->m_nRxDMALength != 0);
+	boolean bMagicReceived = pThis->ReceiveDMA (pThis->m_nRxDMALength);
+	pThis->m_nRxDMALength = 0;
+
+	pThis->StartRxDMA ();
+
+	pThis->m_SpinLock.Release ();
+
+	if (bMagicReceived)
+	{
+		(*pThis->m_pMagicReceivedHandler) ();
+	}
+}
+
 #else	// #ifndef USE_RPI_STUB_AT
 
 boolean CSerialDevice::Initialize (unsigned nBaudrate)
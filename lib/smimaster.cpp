@@ -216,6 +216,22 @@ void CSMIMaster::WriteDMA(boolean bWaitForCompletion)
 	m_txDMA.SetupIOWrite (ARM_SMI_D, m_pDMABuffer, m_nLength, DREQSourceSMI);
 	m_txDMA.Start();
 	PeripheralEntry();
+	write32(ARM_SMI_CS, read32(ARM_SMI_CS) | CS_WRITE); // ReadDMA() may have cleared it
+	write32(ARM_SMI_CS, read32(ARM_SMI_CS) | CS_START);
+	PeripheralExit();
+	if (bWaitForCompletion) m_txDMA.Wait();
+}
+
+void CSMIMaster::ReadDMA(boolean bWaitForCompletion)
+{
+	assert (m_pDMABuffer != 0);
+	PeripheralEntry();
+	write32(ARM_SMI_CS, (read32(ARM_SMI_CS) & ~CS_WRITE) | CS_CLEAR | CS_AFERR); // read direction, clear FIFO
+	write32(ARM_SMI_L, m_nLength);
+	PeripheralExit();
+	m_txDMA.SetupIORead (m_pDMABuffer, ARM_SMI_D, m_nLength, DREQSourceSMI); // the same channel is used for both directions
+	m_txDMA.Start();
+	PeripheralEntry();
 	write32(ARM_SMI_CS, read32(ARM_SMI_CS) | CS_START);
 	PeripheralExit();
 	if (bWaitForCompletion) m_txDMA.Wait();
@@ -0,0 +1,117 @@
+//
+// softirq.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/softirq.h>
+#include <circle/multicore.h>
+#include <circle/synchronize.h>
+#include <assert.h>
+
+CSoftIRQ::TQueue CSoftIRQ::s_Queue[SOFTIRQ_CORES];
+
+boolean CSoftIRQ::Raise (TSoftIRQHandler *pHandler, void *pParam)
+{
+	assert (pHandler != 0);
+
+	EnterCritical (IRQ_LEVEL);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	TQueue *pQueue = &s_Queue[CMultiCoreSupport::ThisCore ()];
+#else
+	TQueue *pQueue = &s_Queue[0];
+#endif
+
+	unsigned nIn = pQueue->nIn;
+	if (nIn - pQueue->nOut >= SOFTIRQ_QUEUE_SIZE)
+	{
+		pQueue->nOverflows++;
+
+		LeaveCritical ();
+
+		return FALSE;
+	}
+
+	TEntry *pEntry = &pQueue->Entry[nIn & (SOFTIRQ_QUEUE_SIZE-1)];
+	pEntry->pHandler = pHandler;
+	pEntry->pParam = pParam;
+
+	pQueue->nIn = nIn + 1;
+
+	LeaveCritical ();
+
+	return TRUE;
+}
+
+void CSoftIRQ::RunPending (void)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	TQueue *pQueue = &s_Queue[CMultiCoreSupport::ThisCore ()];
+#else
+	TQueue *pQueue = &s_Queue[0];
+#endif
+
+	// a nested IRQ leaves its handlers to the interrupted instance
+	if (   pQueue->bRunning
+	    || pQueue->nIn == pQueue->nOut)
+	{
+		return;
+	}
+
+	pQueue->bRunning = TRUE;
+
+	while (pQueue->nIn != pQueue->nOut)
+	{
+		unsigned nOut = pQueue->nOut;
+		TEntry Entry = pQueue->Entry[nOut & (SOFTIRQ_QUEUE_SIZE-1)];
+		pQueue->nOut = nOut + 1;
+
+		assert (Entry.pHandler != 0);
+
+#if AARCH == 64
+		EnableIRQs ();
+#endif
+
+		(*Entry.pHandler) (Entry.pParam);
+
+#if AARCH == 64
+		DisableIRQs ();
+#endif
+	}
+
+	pQueue->bRunning = FALSE;
+}
+
+boolean CSoftIRQ::IsRunning (void)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	return s_Queue[CMultiCoreSupport::ThisCore ()].bRunning;
+#else
+	return s_Queue[0].bRunning;
+#endif
+}
+
+unsigned CSoftIRQ::GetOverflows (void)
+{
+	unsigned nResult = 0;
+	for (unsigned i = 0; i < SOFTIRQ_CORES; i++)
+	{
+		nResult += s_Queue[i].nOverflows;
+	}
+
+	return nResult;
+}
@@ -19,6 +19,7 @@
 //
 #include <circle/sound/dmasoundbuffers.h>
 #include <circle/machineinfo.h>
+#include <circle/multicore.h>
 #include <circle/synchronize.h>
 #include <circle/bcm2835int.h>
 #include <circle/bcm2835.h>
@@ -43,8 +44,14 @@ CDMASoundBuffers::CDMASoundBuffers (boolean	      bDirectionOut,
 	m_State {StateCreated},
 	m_nDMAChannel {DMA_CHANNEL_MAX+1},
 	m_pDMABuffer {nullptr, nullptr},
-	m_pControlBlock {nullptr, nullptr}
+	m_pControlBlock {nullptr, nullptr},
+	m_nTargetCore {0}
 {
+#if defined (ARM_ALLOW_MULTI_CORE) && RASPPI <= 3
+	m_nIPI = bDirectionOut ? IPI_SOUND_OUT : IPI_SOUND_IN;
+	m_nPendingCS = 0;
+	m_nPendingChunks = 0;
+#endif
 }
 
 CDMASoundBuffers::~CDMASoundBuffers (void)
@@ -59,6 +66,17 @@ CDMASoundBuffers::~CDMASoundBuffers (void)
 		{
 			assert (m_pInterruptSystem != 0);
 			m_pInterruptSystem->DisconnectIRQ (ARM_IRQ_DMA0+m_nDMAChannel);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+			if (m_nTargetCore != 0)
+			{
+#if RASPPI >= 4
+				CInterruptSystem::SetIRQTargetCore (ARM_IRQ_DMA0+m_nDMAChannel, 0);
+#else
+				CMultiCoreSupport::DisconnectIPI (m_nIPI);
+#endif
+			}
+#endif
 		}
 
 		PeripheralEntry ();
@@ -84,6 +102,24 @@ CDMASoundBuffers::~CDMASoundBuffers (void)
 	delete [] m_pDMABuffer[1];
 }
 
+boolean CDMASoundBuffers::SetTargetCore (unsigned nCore)
+{
+	assert (m_State == StateCreated);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	if (nCore >= CORES)
+	{
+		return FALSE;
+	}
+
+	m_nTargetCore = nCore;
+
+	return TRUE;
+#else
+	return nCore == 0;
+#endif
+}
+
 boolean CDMASoundBuffers::Start (TChunkCompletedHandler *pHandler, void *pParam)
 {
 	if (m_State == StateCreated)
@@ -135,6 +171,18 @@ boolean CDMASoundBuffers::Start (TChunkCompletedHandler *pHandler, void *pParam)
 		assert (!m_bIRQConnected);
 		assert (m_pInterruptSystem != 0);
 		assert (m_nDMAChannel <= DMA_CHANNEL_MAX);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+		if (m_nTargetCore != 0)
+		{
+#if RASPPI >= 4
+			CInterruptSystem::SetIRQTargetCore (ARM_IRQ_DMA0+m_nDMAChannel, m_nTargetCore);
+#else
+			CMultiCoreSupport::ConnectIPI (m_nIPI, IPIStub, this);
+#endif
+		}
+#endif
+
 		m_pInterruptSystem->ConnectIRQ (ARM_IRQ_DMA0+m_nDMAChannel, InterruptStub, this);
 		m_bIRQConnected = TRUE;
 
@@ -288,6 +336,25 @@ void CDMASoundBuffers::InterruptHandler (void)
 
 	PeripheralExit ();
 
+#if defined (ARM_ALLOW_MULTI_CORE) && RASPPI <= 3
+	if (m_nTargetCore != 0)
+	{
+		// GPU interrupts are handled on core 0 only, the target core does the work.
+		// Another chunk may complete, before the target core has handled the IPI.
+		__atomic_fetch_or (&m_nPendingCS, nCS, __ATOMIC_RELAXED);
+		__atomic_fetch_add (&m_nPendingChunks, 1, __ATOMIC_RELEASE);
+
+		CMultiCoreSupport::SendIPI (m_nTargetCore, m_nIPI);
+
+		return;
+	}
+#endif
+
+	ChunkCompleted (nCS);
+}
+
+void CDMASoundBuffers::ChunkCompleted (u32 nCS)
+{
 	if (nCS & CS_ERROR)
 	{
 		m_State = StateFailed;
@@ -347,6 +414,37 @@ void CDMASoundBuffers::InterruptStub (void *pParam)
 	pThis->InterruptHandler ();
 }
 
+#if defined (ARM_ALLOW_MULTI_CORE) && RASPPI <= 3
+
+void CDMASoundBuffers::IPIStub (unsigned nIPI, void *pParam)
+{
+	CDMASoundBuffers *pThis = static_cast <CDMASoundBuffers *> (pParam);
+	assert (pThis != 0);
+	assert (nIPI == pThis->m_nIPI);
+	assert (CMultiCoreSupport::ThisCore () == pThis->m_nTargetCore);
+
+	// IPIs may have been coalesced, or the chunks have been handled by a previous IPI
+	unsigned nChunks = __atomic_exchange_n (&pThis->m_nPendingChunks, 0, __ATOMIC_ACQUIRE);
+	if (nChunks == 0)
+	{
+		return;
+	}
+
+	u32 nCS = __atomic_exchange_n (&pThis->m_nPendingCS, 0, __ATOMIC_RELAXED);
+
+	for (unsigned i = 0; i < nChunks; i++)
+	{
+		pThis->ChunkCompleted (nCS);
+
+		if (nCS & CS_ERROR)
+		{
+			break;
+		}
+	}
+}
+
+#endif
+
 boolean CDMASoundBuffers::SetupDMAControlBlock (unsigned nID)
 {
 	assert (nID <= 1);
@@ -0,0 +1,228 @@
+//
+// dspbiquad.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sound/dspbiquad.h>
+#include <circle/synchronize.h>
+#include <assert.h>
+
+#define PI		3.14159265358979323846
+
+CDSPBiquad::CDSPBiquad (TDSPBiquadType Type, float fFrequency, float fQ, float fGaindB)
+:	CDSPBlock ("biquad"),
+	m_Type (Type),
+	m_fFrequency (fFrequency),
+	m_fQ (fQ),
+	m_fGaindB (fGaindB),
+	m_bUpdate (FALSE)
+{
+	assert (m_Type < DSPBiquadUnknown);
+
+	// pass-through until Setup()
+	m_Coeffs.b0 = 1.0f;
+	m_Coeffs.b1 = m_Coeffs.b2 = m_Coeffs.a1 = m_Coeffs.a2 = 0.0f;
+
+	for (unsigned i = 0; i < DSP_MAX_CHANNELS; i++)
+	{
+		m_fZ1[i] = m_fZ2[i] = 0.0f;
+	}
+}
+
+CDSPBiquad::~CDSPBiquad (void)
+{
+}
+
+boolean CDSPBiquad::Setup (unsigned nSampleRate, unsigned nChannels)
+{
+	if (!CDSPBlock::Setup (nSampleRate, nChannels))
+	{
+		return FALSE;
+	}
+
+	if (   m_fFrequency <= 0.0f
+	    || m_fFrequency >= nSampleRate / 2
+	    || m_fQ <= 0.0f)
+	{
+		return FALSE;
+	}
+
+	CalculateCoefficients ();
+
+	m_Coeffs = m_NewCoeffs;
+	m_bUpdate = FALSE;
+
+	for (unsigned i = 0; i < DSP_MAX_CHANNELS; i++)
+	{
+		m_fZ1[i] = m_fZ2[i] = 0.0f;
+	}
+
+	return TRUE;
+}
+
+void CDSPBiquad::Process (float *pChannel[], unsigned nFrames)
+{
+	if (m_bUpdate)
+	{
+		m_Coeffs = m_NewCoeffs;
+		m_bUpdate = FALSE;
+	}
+
+	const float b0 = m_Coeffs.b0;
+	const float b1 = m_Coeffs.b1;
+	const float b2 = m_Coeffs.b2;
+	const float a1 = m_Coeffs.a1;
+	const float a2 = m_Coeffs.a2;
+
+	// the recursion prevents vectorization over time, the state is kept in registers
+	for (unsigned j = 0; j < m_nChannels; j++)
+	{
+		float *pBuffer = pChannel[j];
+		assert (pBuffer != 0);
+
+		float z1 = m_fZ1[j];
+		float z2 = m_fZ2[j];
+
+		for (unsigned i = 0; i < nFrames; i++)
+		{
+			float x = pBuffer[i];
+			float y = b0 * x + z1;
+
+			z1 = b1 * x - a1 * y + z2;
+			z2 = b2 * x - a2 * y;
+
+			pBuffer[i] = y;
+		}
+
+		m_fZ1[j] = z1;
+		m_fZ2[j] = z2;
+	}
+}
+
+void CDSPBiquad::SetParameters (TDSPBiquadType Type, float fFrequency, float fQ, float fGaindB)
+{
+	assert (Type < DSPBiquadUnknown);
+	assert (fFrequency > 0.0f);
+	assert (fQ > 0.0f);
+
+	m_Type = Type;
+	m_fFrequency = fFrequency;
+	m_fQ = fQ;
+	m_fGaindB = fGaindB;
+
+	if (m_nSampleRate == 0)
+	{
+		return;				// will be calculated in Setup()
+	}
+
+	assert (m_fFrequency < m_nSampleRate / 2);
+
+	CalculateCoefficients ();
+
+	DataMemBarrier ();
+
+	m_bUpdate = TRUE;
+}
+
+void CDSPBiquad::CalculateCoefficients (void)
+{
+	assert (m_nSampleRate > 0);
+
+	double w0 = 2.0 * PI * m_fFrequency / m_nSampleRate;
+	double fCos = Cos (w0);
+	double fAlpha = Sin (w0) / (2.0 * m_fQ);
+	double A = FromDecibel (m_fGaindB / 2.0);	// 10^(dB/40)
+	double fSqrtA2Alpha = 2.0 * Sqrt (A) * fAlpha;
+
+	double b0, b1, b2, a0, a1, a2;
+
+	switch (m_Type)
+	{
+	case DSPBiquadLowPass:
+		b0 = (1.0 - fCos) / 2.0;
+		b1 = 1.0 - fCos;
+		b2 = b0;
+		a0 = 1.0 + fAlpha;
+		a1 = -2.0 * fCos;
+		a2 = 1.0 - fAlpha;
+		break;
+
+	case DSPBiquadHighPass:
+		b0 = (1.0 + fCos) / 2.0;
+		b1 = -(1.0 + fCos);
+		b2 = b0;
+		a0 = 1.0 + fAlpha;
+		a1 = -2.0 * fCos;
+		a2 = 1.0 - fAlpha;
+		break;
+
+	case DSPBiquadBandPass:
+		b0 = fAlpha;
+		b1 = 0.0;
+		b2 = -fAlpha;
+		a0 = 1.0 + fAlpha;
+		a1 = -2.0 * fCos;
+		a2 = 1.0 - fAlpha;
+		break;
+
+	case DSPBiquadNotch:
+		b0 = 1.0;
+		b1 = -2.0 * fCos;
+		b2 = 1.0;
+		a0 = 1.0 + fAlpha;
+		a1 = -2.0 * fCos;
+		a2 = 1.0 - fAlpha;
+		break;
+
+	case DSPBiquadPeaking:
+		b0 = 1.0 + fAlpha * A;
+		b1 = -2.0 * fCos;
+		b2 = 1.0 - fAlpha * A;
+		a0 = 1.0 + fAlpha / A;
+		a1 = -2.0 * fCos;
+		a2 = 1.0 - fAlpha / A;
+		break;
+
+	case DSPBiquadLowShelf:
+		b0 = A * ((A+1.0) - (A-1.0)*fCos + fSqrtA2Alpha);
+		b1 = 2.0 * A * ((A-1.0) - (A+1.0)*fCos);
+		b2 = A * ((A+1.0) - (A-1.0)*fCos - fSqrtA2Alpha);
+		a0 = (A+1.0) + (A-1.0)*fCos + fSqrtA2Alpha;
+		a1 = -2.0 * ((A-1.0) + (A+1.0)*fCos);
+		a2 = (A+1.0) + (A-1.0)*fCos - fSqrtA2Alpha;
+		break;
+
+	case DSPBiquadHighShelf:
+		b0 = A * ((A+1.0) + (A-1.0)*fCos + fSqrtA2Alpha);
+		b1 = -2.0 * A * ((A-1.0) + (A+1.0)*fCos);
+		b2 = A * ((A+1.0) + (A-1.0)*fCos - fSqrtA2Alpha);
+		a0 = (A+1.0) - (A-1.0)*fCos + fSqrtA2Alpha;
+		a1 = 2.0 * ((A-1.0) - (A+1.0)*fCos);
+		a2 = (A+1.0) - (A-1.0)*fCos - fSqrtA2Alpha;
+		break;
+
+	default:
+		assert (0);
+		return;
+	}
+
+	m_NewCoeffs.b0 = (float) (b0 / a0);
+	m_NewCoeffs.b1 = (float) (b1 / a0);
+	m_NewCoeffs.b2 = (float) (b2 / a0);
+	m_NewCoeffs.a1 = (float) (a1 / a0);
+	m_NewCoeffs.a2 = (float) (a2 / a0);
+}
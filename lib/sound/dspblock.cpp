@@ -0,0 +1,204 @@
+//
+// dspblock.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sound/dspblock.h>
+#include <assert.h>
+
+#define PI		3.14159265358979323846
+#define LN10		2.30258509299404568
+
+CDSPBlock::CDSPBlock (const char *pName)
+:	m_nSampleRate (0),
+	m_nChannels (0),
+	m_pName (pName),
+	m_bBypass (FALSE)
+{
+	assert (m_pName != 0);
+
+	ResetStatistics ();
+}
+
+CDSPBlock::~CDSPBlock (void)
+{
+}
+
+boolean CDSPBlock::Setup (unsigned nSampleRate, unsigned nChannels)
+{
+	assert (nSampleRate > 0);
+	assert (1 <= nChannels && nChannels <= DSP_MAX_CHANNELS);
+
+	m_nSampleRate = nSampleRate;
+	m_nChannels = nChannels;
+
+	return TRUE;
+}
+
+unsigned CDSPBlock::GetCyclesPerFrame (void) const
+{
+	u64 ullFrames = m_ullFrames;
+	if (ullFrames == 0)
+	{
+		return 0;
+	}
+
+	return (unsigned) (m_ullCycles / ullFrames);
+}
+
+void CDSPBlock::ResetStatistics (void)
+{
+	m_ullCycles = 0;
+	m_ullFrames = 0;
+	m_nCyclesMax = 0;
+}
+
+void CDSPBlock::AddCycles (u32 nCycles, unsigned nFrames)
+{
+	m_ullCycles += nCycles;
+	m_ullFrames += nFrames;
+
+	if (nCycles > m_nCyclesMax)
+	{
+		m_nCyclesMax = nCycles;
+	}
+}
+
+// libm may not be available, the following functions are used to calculate coefficients
+
+double CDSPBlock::Sin (double fX)
+{
+	return Cos (fX - PI / 2.0);
+}
+
+double CDSPBlock::Cos (double fX)
+{
+	if (fX < 0.0)
+	{
+		fX = -fX;
+	}
+
+	// reduce to 0..2PI
+	fX -= (2.0 * PI) * (long) (fX / (2.0 * PI));
+
+	// reduce to 0..PI/2
+	double fSign = 1.0;
+	if (fX > PI)
+	{
+		fX = 2.0 * PI - fX;
+	}
+	if (fX > PI / 2.0)
+	{
+		fX = PI - fX;
+		fSign = -1.0;
+	}
+
+	double fX2 = fX * fX;
+	double fTerm = 1.0;
+	double fResult = 1.0;
+	for (unsigned n = 2; n <= 20; n += 2)
+	{
+		fTerm *= -fX2 / (n * (n-1));
+		fResult += fTerm;
+	}
+
+	return fSign * fResult;
+}
+
+double CDSPBlock::Exp (double fX)
+{
+	// exp(x) = exp(x / 2^n) ^ (2^n) with |x / 2^n| < 0.5
+	unsigned nSquares = 0;
+	while (fX > 0.5 || fX < -0.5)
+	{
+		fX /= 2.0;
+		nSquares++;
+	}
+
+	double fTerm = 1.0;
+	double fResult = 1.0;
+	for (unsigned n = 1; n <= 16; n++)
+	{
+		fTerm *= fX / n;
+		fResult += fTerm;
+	}
+
+	while (nSquares-- > 0)
+	{
+		fResult *= fResult;
+	}
+
+	return fResult;
+}
+
+double CDSPBlock::Sqrt (double fX)
+{
+	assert (fX >= 0.0);
+	if (fX == 0.0)
+	{
+		return 0.0;
+	}
+
+	double fResult = fX > 1.0 ? fX : 1.0;
+	for (unsigned i = 0; i < 100; i++)
+	{
+		double fNext = 0.5 * (fResult + fX / fResult);
+		if (fNext >= fResult)
+		{
+			break;
+		}
+
+		fResult = fNext;
+	}
+
+	return fResult;
+}
+
+double CDSPBlock::FromDecibel (double fdB)
+{
+	return Exp (fdB / 20.0 * LN10);
+}
+
+float CDSPBlock::FastLog2 (float fX)
+{
+	union { float f; u32 i; } X = { fX };
+	union { u32 i; float f; } Mantissa = { (X.i & 0x007FFFFF) | 0x3F000000 };
+
+	float fY = (float) X.i * 1.1920928955078125e-7f;
+
+	return   fY - 124.22551499f - 1.498030302f * Mantissa.f
+	       - 1.72587999f / (0.3520887068f + Mantissa.f);
+}
+
+float CDSPBlock::FastExp2 (float fX)
+{
+	if (fX < -126.0f)
+	{
+		fX = -126.0f;
+	}
+
+	float fOffset = fX < 0.0f ? 1.0f : 0.0f;
+	float fZ = fX - (int) fX + fOffset;
+
+	union { u32 i; float f; } Result =
+	{
+		(u32) ((1 << 23) * (  fX + 121.2740575f + 27.7280233f / (4.84252568f - fZ)
+				    - 1.49012907f * fZ))
+	};
+
+	return Result.f;
+}
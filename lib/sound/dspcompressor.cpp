@@ -0,0 +1,146 @@
+//
+// dspcompressor.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sound/dspcompressor.h>
+#include <assert.h>
+
+#define DB_PER_LOG2	6.0205999f		// 20 * log10 (2)
+
+CDSPCompressor::CDSPCompressor (float fThresholddB, float fRatio,
+				float fAttackMsecs, float fReleaseMsecs, float fMakeupdB)
+:	CDSPBlock ("compressor"),
+	m_fThresholddB (fThresholddB),
+	m_fRatio (fRatio),
+	m_fAttackMsecs (fAttackMsecs),
+	m_fReleaseMsecs (fReleaseMsecs),
+	m_fMakeupdB (fMakeupdB),
+	m_fEnvelope (0.0f),
+	m_fReductionLog2 (0.0f)
+{
+}
+
+CDSPCompressor::~CDSPCompressor (void)
+{
+}
+
+boolean CDSPCompressor::Setup (unsigned nSampleRate, unsigned nChannels)
+{
+	if (!CDSPBlock::Setup (nSampleRate, nChannels))
+	{
+		return FALSE;
+	}
+
+	CalculateParameters ();
+
+	m_fEnvelope = 0.0f;
+	m_fReductionLog2 = 0.0f;
+
+	return TRUE;
+}
+
+void CDSPCompressor::Process (float *pChannel[], unsigned nFrames)
+{
+	const float fThreshold = m_fThreshold;
+	const float fThresholdLog2 = m_fThresholdLog2;
+	const float fSlope = m_fSlope;
+	const float fAttack = m_fAttack;
+	const float fRelease = m_fRelease;
+	const float fMakeupLog2 = m_fMakeupLog2;
+	const float fMakeup = FastExp2 (fMakeupLog2);
+
+	float fEnvelope = m_fEnvelope;
+	float fReductionLog2 = 0.0f;
+
+	for (unsigned i = 0; i < nFrames; i++)
+	{
+		float fPeak = 0.0f;
+		for (unsigned j = 0; j < m_nChannels; j++)
+		{
+			float fValue = pChannel[j][i];
+			if (fValue < 0.0f)
+			{
+				fValue = -fValue;
+			}
+
+			if (fValue > fPeak)
+			{
+				fPeak = fValue;
+			}
+		}
+
+		// envelope follower
+		float fCoeff = fPeak > fEnvelope ? fAttack : fRelease;
+		fEnvelope = fPeak + fCoeff * (fEnvelope - fPeak);
+
+		float fGain = fMakeup;
+		fReductionLog2 = 0.0f;
+
+		if (fEnvelope > fThreshold)
+		{
+			// gain computer in the log2 domain
+			fReductionLog2 = (FastLog2 (fEnvelope) - fThresholdLog2) * fSlope;
+			fGain = FastExp2 (fMakeupLog2 - fReductionLog2);
+		}
+
+		for (unsigned j = 0; j < m_nChannels; j++)
+		{
+			pChannel[j][i] *= fGain;
+		}
+	}
+
+	m_fEnvelope = fEnvelope;
+	m_fReductionLog2 = fReductionLog2;
+}
+
+void CDSPCompressor::SetParameters (float fThresholddB, float fRatio, float fAttackMsecs,
+				    float fReleaseMsecs, float fMakeupdB)
+{
+	m_fThresholddB = fThresholddB;
+	m_fRatio = fRatio;
+	m_fAttackMsecs = fAttackMsecs;
+	m_fReleaseMsecs = fReleaseMsecs;
+	m_fMakeupdB = fMakeupdB;
+
+	if (m_nSampleRate > 0)
+	{
+		CalculateParameters ();
+	}
+}
+
+float CDSPCompressor::GetGainReduction (void) const
+{
+	return m_fReductionLog2 * DB_PER_LOG2;
+}
+
+void CDSPCompressor::CalculateParameters (void)
+{
+	assert (m_nSampleRate > 0);
+	assert (m_fRatio == DSP_RATIO_LIMITER || m_fRatio >= 1.0f);
+	assert (m_fAttackMsecs > 0.0f);
+	assert (m_fReleaseMsecs > 0.0f);
+
+	m_fThreshold = (float) FromDecibel (m_fThresholddB);
+	m_fThresholdLog2 = m_fThresholddB / DB_PER_LOG2;
+	m_fSlope = m_fRatio == DSP_RATIO_LIMITER ? 1.0f : 1.0f - 1.0f / m_fRatio;
+	m_fMakeupLog2 = m_fMakeupdB / DB_PER_LOG2;
+
+	// time constant: the envelope reaches 63% of a step within the given time
+	m_fAttack = (float) Exp (-1000.0 / (m_fAttackMsecs * m_nSampleRate));
+	m_fRelease = (float) Exp (-1000.0 / (m_fReleaseMsecs * m_nSampleRate));
+}
@@ -0,0 +1,162 @@
+//
+// dspdelay.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sound/dspdelay.h>
+#include <circle/util.h>
+#include <assert.h>
+
+CDSPDelay::CDSPDelay (float fMaxDelayMsecs, float fDelayMsecs, float fFeedback, float fMix)
+:	CDSPBlock ("delay"),
+	m_fMaxDelayMsecs (fMaxDelayMsecs),
+	m_fDelayMsecs (fDelayMsecs),
+	m_nDelayFrames (0),
+	m_fFeedback (fFeedback),
+	m_fMix (fMix),
+	m_nBufferFrames (0),
+	m_nWritePos (0)
+{
+	assert (0.0f < m_fMaxDelayMsecs);
+	assert (0.0f <= m_fDelayMsecs && m_fDelayMsecs <= m_fMaxDelayMsecs);
+	assert (0.0f <= m_fFeedback && m_fFeedback < 1.0f);
+	assert (0.0f <= m_fMix && m_fMix <= 1.0f);
+
+	for (unsigned i = 0; i < DSP_MAX_CHANNELS; i++)
+	{
+		m_pBuffer[i] = 0;
+	}
+}
+
+CDSPDelay::~CDSPDelay (void)
+{
+	for (unsigned i = 0; i < DSP_MAX_CHANNELS; i++)
+	{
+		delete [] m_pBuffer[i];
+		m_pBuffer[i] = 0;
+	}
+}
+
+boolean CDSPDelay::Setup (unsigned nSampleRate, unsigned nChannels)
+{
+	if (!CDSPBlock::Setup (nSampleRate, nChannels))
+	{
+		return FALSE;
+	}
+
+	unsigned nBufferFrames = (unsigned) (m_fMaxDelayMsecs * nSampleRate / 1000.0f) + 1;
+
+	for (unsigned i = 0; i < DSP_MAX_CHANNELS; i++)
+	{
+		delete [] m_pBuffer[i];
+		m_pBuffer[i] = 0;
+	}
+
+	for (unsigned i = 0; i < m_nChannels; i++)
+	{
+		m_pBuffer[i] = new float[nBufferFrames];
+		if (m_pBuffer[i] == 0)
+		{
+			return FALSE;
+		}
+
+		memset (m_pBuffer[i], 0, nBufferFrames * sizeof (float));
+	}
+
+	m_nBufferFrames = nBufferFrames;
+	m_nWritePos = 0;
+
+	SetParameters (m_fDelayMsecs, m_fFeedback, m_fMix);
+
+	return TRUE;
+}
+
+void CDSPDelay::Process (float *pChannel[], unsigned nFrames)
+{
+	const unsigned nDelayFrames = m_nDelayFrames;
+	const float fFeedback = m_fFeedback;
+	const float fWet = m_fMix;
+	const float fDry = 1.0f - fWet;
+
+	assert (nDelayFrames < m_nBufferFrames);
+	unsigned nWritePos = m_nWritePos;
+
+	for (unsigned j = 0; j < m_nChannels; j++)
+	{
+		float *pBuffer = pChannel[j];
+		assert (pBuffer != 0);
+
+		float *pDelayLine = m_pBuffer[j];
+		assert (pDelayLine != 0);
+
+		nWritePos = m_nWritePos;
+
+		unsigned nReadPos = nWritePos + m_nBufferFrames - nDelayFrames;
+		if (nReadPos >= m_nBufferFrames)
+		{
+			nReadPos -= m_nBufferFrames;
+		}
+
+		for (unsigned i = 0; i < nFrames; i++)
+		{
+			float fInput = pBuffer[i];
+			float fDelayed = pDelayLine[nReadPos];
+
+			pDelayLine[nWritePos] = fInput + fFeedback * fDelayed;
+
+			pBuffer[i] = fDry * fInput + fWet * fDelayed;
+
+			if (++nReadPos == m_nBufferFrames)
+			{
+				nReadPos = 0;
+			}
+
+			if (++nWritePos == m_nBufferFrames)
+			{
+				nWritePos = 0;
+			}
+		}
+	}
+
+	m_nWritePos = nWritePos;
+}
+
+void CDSPDelay::SetParameters (float fDelayMsecs, float fFeedback, float fMix)
+{
+	assert (0.0f <= fDelayMsecs && fDelayMsecs <= m_fMaxDelayMsecs);
+	assert (0.0f <= fFeedback && fFeedback < 1.0f);
+	assert (0.0f <= fMix && fMix <= 1.0f);
+
+	m_fDelayMsecs = fDelayMsecs;
+	m_fFeedback = fFeedback;
+	m_fMix = fMix;
+
+	if (m_nSampleRate > 0)
+	{
+		unsigned nDelayFrames = (unsigned) (fDelayMsecs * m_nSampleRate / 1000.0f + 0.5f);
+		if (nDelayFrames == 0)
+		{
+			nDelayFrames = 1;
+		}
+		else if (nDelayFrames >= m_nBufferFrames)
+		{
+			nDelayFrames = m_nBufferFrames-1;
+		}
+
+		m_nDelayFrames = nDelayFrames;
+	}
+}
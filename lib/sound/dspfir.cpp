@@ -0,0 +1,160 @@
+//
+// dspfir.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sound/dspfir.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#if STDLIB_SUPPORT >= 1 && (defined (__ARM_NEON) || defined (__ARM_NEON__))
+	#define DSP_USE_NEON
+	#include <arm_neon.h>
+#endif
+
+CDSPFIR::CDSPFIR (const float *pCoeffs, unsigned nTaps)
+:	CDSPBlock ("fir"),
+	m_nTaps ((nTaps + 3) & ~3),		// required by the NEON kernel
+	m_pCoeffs (0),
+	m_nHistoryPos (0)
+{
+	assert (pCoeffs != 0);
+	assert (nTaps > 0);
+
+	for (unsigned i = 0; i < DSP_MAX_CHANNELS; i++)
+	{
+		m_pHistory[i] = 0;
+	}
+
+	m_pCoeffs = new float[m_nTaps];
+	if (m_pCoeffs != 0)
+	{
+		// padding is put to the oldest end of the window
+		for (unsigned i = 0; i < m_nTaps; i++)
+		{
+			unsigned nIndex = m_nTaps-1 - i;
+			m_pCoeffs[i] = nIndex < nTaps ? pCoeffs[nIndex] : 0.0f;
+		}
+	}
+}
+
+CDSPFIR::~CDSPFIR (void)
+{
+	for (unsigned i = 0; i < DSP_MAX_CHANNELS; i++)
+	{
+		delete [] m_pHistory[i];
+		m_pHistory[i] = 0;
+	}
+
+	delete [] m_pCoeffs;
+	m_pCoeffs = 0;
+}
+
+boolean CDSPFIR::Setup (unsigned nSampleRate, unsigned nChannels)
+{
+	if (   !CDSPBlock::Setup (nSampleRate, nChannels)
+	    || m_pCoeffs == 0)
+	{
+		return FALSE;
+	}
+
+	for (unsigned i = 0; i < m_nChannels; i++)
+	{
+		if (m_pHistory[i] == 0)
+		{
+			m_pHistory[i] = new float[2 * m_nTaps];
+			if (m_pHistory[i] == 0)
+			{
+				return FALSE;
+			}
+		}
+
+		memset (m_pHistory[i], 0, 2 * m_nTaps * sizeof (float));
+	}
+
+	m_nHistoryPos = 0;
+
+	return TRUE;
+}
+
+void CDSPFIR::Process (float *pChannel[], unsigned nFrames)
+{
+	unsigned nHistoryPos = m_nHistoryPos;
+
+	for (unsigned j = 0; j < m_nChannels; j++)
+	{
+		float *pBuffer = pChannel[j];
+		assert (pBuffer != 0);
+
+		float *pHistory = m_pHistory[j];
+		assert (pHistory != 0);
+
+		nHistoryPos = m_nHistoryPos;
+
+		for (unsigned i = 0; i < nFrames; i++)
+		{
+			// push into the mirrored ring, the window of the latest samples is contiguous
+			pHistory[nHistoryPos] = pBuffer[i];
+			pHistory[nHistoryPos + m_nTaps] = pBuffer[i];
+
+			if (++nHistoryPos == m_nTaps)
+			{
+				nHistoryPos = 0;
+			}
+
+			pBuffer[i] = DotProduct (pHistory + nHistoryPos, m_pCoeffs, m_nTaps);
+		}
+	}
+
+	m_nHistoryPos = nHistoryPos;
+}
+
+float CDSPFIR::DotProduct (const float *pSamples, const float *pCoeffs, unsigned nTaps)
+{
+#ifdef DSP_USE_NEON
+	float32x4_t Acc0 = vdupq_n_f32 (0.0f);
+	float32x4_t Acc1 = vdupq_n_f32 (0.0f);
+
+	unsigned i = 0;
+	for (; i + 8 <= nTaps; i += 8)
+	{
+		Acc0 = vmlaq_f32 (Acc0, vld1q_f32 (pSamples + i), vld1q_f32 (pCoeffs + i));
+		Acc1 = vmlaq_f32 (Acc1, vld1q_f32 (pSamples + i + 4), vld1q_f32 (pCoeffs + i + 4));
+	}
+
+	if (i < nTaps)
+	{
+		Acc0 = vmlaq_f32 (Acc0, vld1q_f32 (pSamples + i), vld1q_f32 (pCoeffs + i));
+	}
+
+	Acc0 = vaddq_f32 (Acc0, Acc1);
+
+	float32x2_t Sum = vadd_f32 (vget_low_f32 (Acc0), vget_high_f32 (Acc0));
+	Sum = vpadd_f32 (Sum, Sum);
+
+	return vget_lane_f32 (Sum, 0);
+#else
+	float fAcc = 0.0f;
+
+	for (unsigned i = 0; i < nTaps; i++)
+	{
+		fAcc += pSamples[i] * pCoeffs[i];
+	}
+
+	return fAcc;
+#endif
+}
@@ -0,0 +1,106 @@
+//
+// dspgain.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sound/dspgain.h>
+#include <assert.h>
+
+#if STDLIB_SUPPORT >= 1 && (defined (__ARM_NEON) || defined (__ARM_NEON__))
+	#define DSP_USE_NEON
+	#include <arm_neon.h>
+#endif
+
+CDSPGain::CDSPGain (float fGaindB)
+:	CDSPBlock ("gain"),
+	m_fGaindB (fGaindB),
+	m_bMute (FALSE),
+	m_fGain (1.0f),
+	m_fTargetGain (1.0f)
+{
+	UpdateTarget ();
+
+	m_fGain = m_fTargetGain;
+}
+
+CDSPGain::~CDSPGain (void)
+{
+}
+
+void CDSPGain::Process (float *pChannel[], unsigned nFrames)
+{
+	float fGain = m_fGain;
+	float fTargetGain = m_fTargetGain;
+
+	if (fGain == fTargetGain)
+	{
+		for (unsigned j = 0; j < m_nChannels; j++)
+		{
+			float *pBuffer = pChannel[j];
+			assert (pBuffer != 0);
+
+			unsigned i = 0;
+#ifdef DSP_USE_NEON
+			for (; i + 4 <= nFrames; i += 4)
+			{
+				vst1q_f32 (pBuffer + i, vmulq_n_f32 (vld1q_f32 (pBuffer + i), fGain));
+			}
+#endif
+			for (; i < nFrames; i++)
+			{
+				pBuffer[i] *= fGain;
+			}
+		}
+
+		return;
+	}
+
+	// ramp to the new gain
+	float fStep = (fTargetGain - fGain) / nFrames;
+
+	for (unsigned j = 0; j < m_nChannels; j++)
+	{
+		float *pBuffer = pChannel[j];
+		assert (pBuffer != 0);
+
+		for (unsigned i = 0; i < nFrames; i++)
+		{
+			pBuffer[i] *= fGain + fStep * (i+1);
+		}
+	}
+
+	m_fGain = fTargetGain;
+}
+
+void CDSPGain::SetGain (float fGaindB)
+{
+	m_fGaindB = fGaindB;
+
+	UpdateTarget ();
+}
+
+void CDSPGain::SetMute (boolean bMute)
+{
+	m_bMute = bMute;
+
+	UpdateTarget ();
+}
+
+void CDSPGain::UpdateTarget (void)
+{
+	m_fTargetGain = m_bMute ? 0.0f : (float) FromDecibel (m_fGaindB);
+}
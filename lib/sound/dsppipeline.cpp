@@ -0,0 +1,327 @@
+//
+// dsppipeline.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sound/dsppipeline.h>
+#include <circle/cyclecounter.h>
+#include <circle/logger.h>
+#include <assert.h>
+
+#if STDLIB_SUPPORT >= 1 && (defined (__ARM_NEON) || defined (__ARM_NEON__))
+	#define DSP_USE_NEON
+	#include <arm_neon.h>
+#endif
+
+#define SCALE16		32768.0f
+#define SCALE32		2147483648.0f
+
+CDSPPipeline::CDSPPipeline (void)
+:	m_nSampleRate (0),
+	m_nChannels (0),
+	m_nBlocks (0)
+{
+	for (unsigned i = 0; i < DSP_MAX_BLOCKS; i++)
+	{
+		m_pBlock[i] = 0;
+	}
+}
+
+CDSPPipeline::~CDSPPipeline (void)
+{
+	m_nBlocks = 0;
+}
+
+boolean CDSPPipeline::AddBlock (CDSPBlock *pBlock)
+{
+	assert (pBlock != 0);
+	assert (m_nSampleRate == 0);
+
+	if (m_nBlocks >= DSP_MAX_BLOCKS)
+	{
+		return FALSE;
+	}
+
+	m_pBlock[m_nBlocks++] = pBlock;
+
+	return TRUE;
+}
+
+boolean CDSPPipeline::Setup (unsigned nSampleRate, unsigned nChannels)
+{
+	assert (nSampleRate > 0);
+	assert (1 <= nChannels && nChannels <= DSP_MAX_CHANNELS);
+
+	m_nChannels = nChannels;
+
+	for (unsigned i = 0; i < m_nBlocks; i++)
+	{
+		assert (m_pBlock[i] != 0);
+		if (!m_pBlock[i]->Setup (nSampleRate, nChannels))
+		{
+			return FALSE;
+		}
+	}
+
+	m_nSampleRate = nSampleRate;
+
+	return TRUE;
+}
+
+void CDSPPipeline::Process (float *pChannel[], unsigned nFrames)
+{
+	assert (m_nSampleRate > 0);
+	assert (pChannel != 0);
+
+	if (nFrames == 0)
+	{
+		return;
+	}
+
+	CCycleCounter::Enable ();	// on each core, where the pipeline runs
+
+	for (unsigned i = 0; i < m_nBlocks; i++)
+	{
+		CDSPBlock *pBlock = m_pBlock[i];
+		assert (pBlock != 0);
+
+		if (pBlock->IsBypassed ())
+		{
+			continue;
+		}
+
+		u32 nStart = CCycleCounter::Read ();
+
+		pBlock->Process (pChannel, nFrames);
+
+		pBlock->AddCycles (CCycleCounter::Read () - nStart, nFrames);
+	}
+}
+
+void CDSPPipeline::ProcessInterleaved (float *pBuffer, unsigned nFrames)
+{
+	assert (pBuffer != 0);
+
+	float *pChannel[DSP_MAX_CHANNELS] = {m_Buffer[0], m_Buffer[1]};
+
+	while (nFrames > 0)
+	{
+		unsigned nBlockFrames = nFrames < DSP_BLOCK_FRAMES ? nFrames : DSP_BLOCK_FRAMES;
+
+		for (unsigned i = 0; i < nBlockFrames; i++)
+		{
+			for (unsigned j = 0; j < m_nChannels; j++)
+			{
+				m_Buffer[j][i] = pBuffer[i*m_nChannels + j];
+			}
+		}
+
+		Process (pChannel, nBlockFrames);
+
+		for (unsigned i = 0; i < nBlockFrames; i++)
+		{
+			for (unsigned j = 0; j < m_nChannels; j++)
+			{
+				*pBuffer++ = m_Buffer[j][i];
+			}
+		}
+
+		nFrames -= nBlockFrames;
+	}
+}
+
+void CDSPPipeline::ProcessInterleaved (s16 *pBuffer, unsigned nFrames)
+{
+	assert (pBuffer != 0);
+
+	float *pChannel[DSP_MAX_CHANNELS] = {m_Buffer[0], m_Buffer[1]};
+
+	while (nFrames > 0)
+	{
+		unsigned nBlockFrames = nFrames < DSP_BLOCK_FRAMES ? nFrames : DSP_BLOCK_FRAMES;
+		unsigned i = 0;
+
+#ifdef DSP_USE_NEON
+		if (m_nChannels == 2)
+		{
+			for (; i + 4 <= nBlockFrames; i += 4)
+			{
+				int16x4x2_t Samples = vld2_s16 (pBuffer + i*2);
+
+				vst1q_f32 (&m_Buffer[0][i],
+					   vcvtq_n_f32_s32 (vmovl_s16 (Samples.val[0]), 15));
+				vst1q_f32 (&m_Buffer[1][i],
+					   vcvtq_n_f32_s32 (vmovl_s16 (Samples.val[1]), 15));
+			}
+		}
+#endif
+
+		for (; i < nBlockFrames; i++)
+		{
+			for (unsigned j = 0; j < m_nChannels; j++)
+			{
+				m_Buffer[j][i] = pBuffer[i*m_nChannels + j] * (1.0f / SCALE16);
+			}
+		}
+
+		Process (pChannel, nBlockFrames);
+
+		i = 0;
+
+#ifdef DSP_USE_NEON
+		if (m_nChannels == 2)
+		{
+			for (; i + 4 <= nBlockFrames; i += 4)
+			{
+				// saturating conversion and narrowing
+				int16x4x2_t Samples;
+				Samples.val[0] = vqmovn_s32 (vcvtq_n_s32_f32 (vld1q_f32 (&m_Buffer[0][i]), 15));
+				Samples.val[1] = vqmovn_s32 (vcvtq_n_s32_f32 (vld1q_f32 (&m_Buffer[1][i]), 15));
+
+				vst2_s16 (pBuffer + i*2, Samples);
+			}
+		}
+#endif
+
+		for (; i < nBlockFrames; i++)
+		{
+			for (unsigned j = 0; j < m_nChannels; j++)
+			{
+				float fValue = m_Buffer[j][i] * SCALE16;
+				if (fValue > 32767.0f)
+				{
+					fValue = 32767.0f;
+				}
+				else if (fValue < -32768.0f)
+				{
+					fValue = -32768.0f;
+				}
+
+				pBuffer[i*m_nChannels + j] = (s16) fValue;
+			}
+		}
+
+		pBuffer += nBlockFrames * m_nChannels;
+		nFrames -= nBlockFrames;
+	}
+}
+
+void CDSPPipeline::ProcessInterleaved (s32 *pBuffer, unsigned nFrames)
+{
+	assert (pBuffer != 0);
+
+	float *pChannel[DSP_MAX_CHANNELS] = {m_Buffer[0], m_Buffer[1]};
+
+	while (nFrames > 0)
+	{
+		unsigned nBlockFrames = nFrames < DSP_BLOCK_FRAMES ? nFrames : DSP_BLOCK_FRAMES;
+		unsigned i = 0;
+
+#ifdef DSP_USE_NEON
+		if (m_nChannels == 2)
+		{
+			for (; i + 4 <= nBlockFrames; i += 4)
+			{
+				int32x4x2_t Samples = vld2q_s32 (pBuffer + i*2);
+
+				vst1q_f32 (&m_Buffer[0][i], vcvtq_n_f32_s32 (Samples.val[0], 31));
+				vst1q_f32 (&m_Buffer[1][i], vcvtq_n_f32_s32 (Samples.val[1], 31));
+			}
+		}
+#endif
+
+		for (; i < nBlockFrames; i++)
+		{
+			for (unsigned j = 0; j < m_nChannels; j++)
+			{
+				m_Buffer[j][i] = pBuffer[i*m_nChannels + j] * (1.0f / SCALE32);
+			}
+		}
+
+		Process (pChannel, nBlockFrames);
+
+		i = 0;
+
+#ifdef DSP_USE_NEON
+		if (m_nChannels == 2)
+		{
+			for (; i + 4 <= nBlockFrames; i += 4)
+			{
+				// the conversion saturates
+				int32x4x2_t Samples;
+				Samples.val[0] = vcvtq_n_s32_f32 (vld1q_f32 (&m_Buffer[0][i]), 31);
+				Samples.val[1] = vcvtq_n_s32_f32 (vld1q_f32 (&m_Buffer[1][i]), 31);
+
+				vst2q_s32 (pBuffer + i*2, Samples);
+			}
+		}
+#endif
+
+		for (; i < nBlockFrames; i++)
+		{
+			for (unsigned j = 0; j < m_nChannels; j++)
+			{
+				float fValue = m_Buffer[j][i];
+				s32 nValue;
+				if (fValue >= 1.0f)
+				{
+					nValue = 0x7FFFFFFF;
+				}
+				else if (fValue <= -1.0f)
+				{
+					nValue = -0x7FFFFFFF-1;
+				}
+				else
+				{
+					nValue = (s32) (fValue * SCALE32);
+				}
+
+				pBuffer[i*m_nChannels + j] = nValue;
+			}
+		}
+
+		pBuffer += nBlockFrames * m_nChannels;
+		nFrames -= nBlockFrames;
+	}
+}
+
+void CDSPPipeline::DumpStatistics (const char *pFrom)
+{
+	for (unsigned i = 0; i < m_nBlocks; i++)
+	{
+		CDSPBlock *pBlock = m_pBlock[i];
+		assert (pBlock != 0);
+
+		unsigned nCyclesPerFrame = pBlock->GetCyclesPerFrame ();
+
+		CLogger::Get ()->Write (pFrom, LogNotice,
+					"%-12s %5u cycles/frame (%u kcycles/s), max %u cycles/call%s",
+					pBlock->GetName (), nCyclesPerFrame,
+					(unsigned) ((u64) nCyclesPerFrame * m_nSampleRate / 1000),
+					pBlock->GetCyclesMax (),
+					pBlock->IsBypassed () ? " (bypassed)" : "");
+	}
+}
+
+void CDSPPipeline::ResetStatistics (void)
+{
+	for (unsigned i = 0; i < m_nBlocks; i++)
+	{
+		assert (m_pBlock[i] != 0);
+		m_pBlock[i]->ResetStatistics ();
+	}
+}
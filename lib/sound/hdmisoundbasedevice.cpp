@@ -134,6 +134,8 @@ CHDMISoundBaseDevice::CHDMISoundBaseDevice (CInterruptSystem *pInterrupt,
 
 	if (m_nDMAChannel > DMA_CHANNEL_MAX)	// no DMA channel assigned
 	{
+		CLogger::Get ()->Write (From, LogError, "No DMA channel available");
+
 		m_State = HDMISoundError;
 
 		return;
@@ -456,6 +458,36 @@ void CHDMISoundBaseDevice::WriteSample (s32 nSample)
 	}
 }
 
+unsigned CHDMISoundBaseDevice::WriteSamples (const s32 *pSamples, unsigned nCount)
+{
+	assert (m_bUsePolling);
+	assert (pSamples != 0);
+
+	unsigned nSubFrame = m_nSubFrame;
+	unsigned nWritten = 0;
+
+	PeripheralEntry ();
+
+	while (   nWritten < nCount
+	       && !(read32 (RegMaiControl) & BitMaiControlFull))
+	{
+		write32 (RegMaiData, ConvertIEC958Sample (pSamples[nWritten],
+							  nSubFrame / SOUND_HW_CHANNELS));
+		nWritten++;
+
+		if (++nSubFrame == IEC958_SUBFRAMES_PER_BLOCK)
+		{
+			nSubFrame = 0;
+		}
+	}
+
+	PeripheralExit ();
+
+	m_nSubFrame = nSubFrame;
+
+	return nWritten;
+}
+
 boolean CHDMISoundBaseDevice::GetNextChunk (void)
 {
 	assert (m_pDMABuffer[m_nNextBuffer] != 0);
@@ -269,6 +269,19 @@ CSoundController *CI2SSoundBaseDevice::GetController (void)
 	return m_pController;
 }
 
+boolean CI2SSoundBaseDevice::SetAudioCore (unsigned nCore)
+{
+	if (   !m_TXBuffers.SetTargetCore (nCore)
+	    || !m_RXBuffers.SetTargetCore (nCore))
+	{
+		return FALSE;
+	}
+
+	SetLowLatencyMode (nCore != 0);
+
+	return TRUE;
+}
+
 void CI2SSoundBaseDevice::RunI2S (void)
 {
 	PeripheralEntry ();
@@ -0,0 +1,383 @@
+//
+// samplerateconverter.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sound/samplerateconverter.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#if STDLIB_SUPPORT >= 1 && (defined (__ARM_NEON) || defined (__ARM_NEON__))
+	#define SRC_USE_NEON
+	#include <arm_neon.h>
+#endif
+
+#define PI		3.14159265358979323846
+
+#define MAX_TAPS	32
+#define COEFF_BITS	30			// Q30 coefficients
+#define SAMPLE_MAX	((1 << 23) - 1)		// signed 24-bit samples
+#define SAMPLE_MIN	(-SAMPLE_MAX)
+
+static const struct
+{
+	unsigned	nTaps;
+	unsigned	nPhaseBits;
+	boolean		bInterpolate;
+	double		fRolloff;		// cut-off relative to the Nyquist frequency
+}
+s_QualityParams[SRCQualityUnknown] =
+{
+	{8,	5,	FALSE,	0.80},		// SRCQualityLow
+	{16,	7,	FALSE,	0.88},		// SRCQualityMedium
+	{32,	8,	TRUE,	0.92}		// SRCQualityHigh
+};
+
+CSampleRateConverter::CSampleRateConverter (unsigned nChannels)
+:	m_nChannels (nChannels),
+	m_Quality (SRCQualityUnknown),
+	m_nTaps (0),
+	m_nPhaseBits (0),
+	m_bInterpolate (FALSE),
+	m_pCoeffs (0),
+	m_nHistoryPos (0),
+	m_ullNominalStep (0),
+	m_ullStep (0),
+	m_nPhase (0),
+	m_nPending (0)
+{
+	assert (1 <= m_nChannels && m_nChannels <= SRC_MAX_CHANNELS);
+
+	for (unsigned i = 0; i < SRC_MAX_CHANNELS; i++)
+	{
+		m_pHistory[i] = 0;
+	}
+}
+
+CSampleRateConverter::~CSampleRateConverter (void)
+{
+	for (unsigned i = 0; i < SRC_MAX_CHANNELS; i++)
+	{
+		delete [] m_pHistory[i];
+		m_pHistory[i] = 0;
+	}
+
+	delete [] m_pCoeffs;
+	m_pCoeffs = 0;
+}
+
+boolean CSampleRateConverter::Setup (unsigned nInputRate, unsigned nOutputRate,
+				     TSRCQuality Quality)
+{
+	assert (nInputRate > 0);
+	assert (nOutputRate > 0);
+	assert (Quality < SRCQualityUnknown);
+
+	delete [] m_pCoeffs;
+	m_pCoeffs = 0;
+
+	for (unsigned i = 0; i < SRC_MAX_CHANNELS; i++)
+	{
+		delete [] m_pHistory[i];
+		m_pHistory[i] = 0;
+	}
+
+	m_Quality = Quality;
+	m_nTaps = s_QualityParams[Quality].nTaps;
+	m_nPhaseBits = s_QualityParams[Quality].nPhaseBits;
+	m_bInterpolate = s_QualityParams[Quality].bInterpolate;
+	assert (m_nTaps <= MAX_TAPS);
+	assert (m_nTaps % 4 == 0);		// required by the NEON kernel
+
+	m_pCoeffs = new s32[((1 << m_nPhaseBits) + 1) * m_nTaps];
+	if (m_pCoeffs == 0)
+	{
+		return FALSE;
+	}
+
+	for (unsigned i = 0; i < m_nChannels; i++)
+	{
+		m_pHistory[i] = new s32[2 * m_nTaps];
+		if (m_pHistory[i] == 0)
+		{
+			return FALSE;
+		}
+	}
+
+	CalculateCoefficients (nInputRate, nOutputRate);
+
+	m_ullNominalStep = ((u64) nInputRate << 32) / nOutputRate;
+	m_ullStep = m_ullNominalStep;
+
+	Reset ();
+
+	return TRUE;
+}
+
+void CSampleRateConverter::Reset (void)
+{
+	assert (m_nTaps > 0);
+
+	for (unsigned i = 0; i < m_nChannels; i++)
+	{
+		assert (m_pHistory[i] != 0);
+		memset (m_pHistory[i], 0, 2 * m_nTaps * sizeof (s32));
+	}
+
+	m_nHistoryPos = 0;
+	m_nPhase = 0;
+	m_nPending = 1;
+}
+
+void CSampleRateConverter::SetRatioAdjust (int nPPM)
+{
+	assert (m_ullNominalStep != 0);
+	assert (-100000 < nPPM && nPPM < 100000);
+
+	s64 llDelta = (s64) (m_ullNominalStep / 1000000) * nPPM;
+
+	m_ullStep = (u64) ((s64) m_ullNominalStep + llDelta);
+}
+
+unsigned CSampleRateConverter::Process (const s32 *pInput, unsigned *pInputFrames,
+					s32 *pOutput, unsigned nOutputFrames)
+{
+	assert (m_pCoeffs != 0);
+	assert (pInput != 0);
+	assert (pInputFrames != 0);
+	assert (pOutput != 0);
+
+	unsigned nInputFrames = *pInputFrames;
+	unsigned nInputUsed = 0;
+	unsigned nOutputDone = 0;
+
+	while (nOutputDone < nOutputFrames)
+	{
+		for (; m_nPending > 0; m_nPending--)
+		{
+			if (nInputUsed == nInputFrames)
+			{
+				*pInputFrames = nInputUsed;
+
+				return nOutputDone;
+			}
+
+			// push one frame into the mirrored history ring
+			for (unsigned i = 0; i < m_nChannels; i++)
+			{
+				s32 nSample = *pInput++;
+
+				m_pHistory[i][m_nHistoryPos] = nSample;
+				m_pHistory[i][m_nHistoryPos + m_nTaps] = nSample;
+			}
+
+			if (++m_nHistoryPos == m_nTaps)
+			{
+				m_nHistoryPos = 0;
+			}
+
+			nInputUsed++;
+		}
+
+		FilterFrame (pOutput);
+		pOutput += m_nChannels;
+		nOutputDone++;
+
+		u64 ullNext = (u64) m_nPhase + m_ullStep;
+		m_nPhase = (u32) ullNext;
+		m_nPending = (unsigned) (ullNext >> 32);
+	}
+
+	*pInputFrames = nInputUsed;
+
+	return nOutputDone;
+}
+
+void CSampleRateConverter::FilterFrame (s32 *pOutput)
+{
+	unsigned nPhase = m_nPhase >> (32 - m_nPhaseBits);
+	const s32 *pCoeffs = m_pCoeffs + nPhase * m_nTaps;
+
+	for (unsigned i = 0; i < m_nChannels; i++)
+	{
+		// the window of the latest m_nTaps samples (oldest first) is contiguous
+		const s32 *pSamples = m_pHistory[i] + m_nHistoryPos;
+
+		s64 llResult = DotProduct (pSamples, pCoeffs, m_nTaps);
+
+		if (m_bInterpolate)
+		{
+			// linear interpolation between adjacent phases (16 bits fraction)
+			s64 llNext = DotProduct (pSamples, pCoeffs + m_nTaps, m_nTaps);
+			s64 llFraction = (m_nPhase >> (32 - m_nPhaseBits - 16)) & 0xFFFF;
+
+			llResult >>= COEFF_BITS - 16;
+			llNext >>= COEFF_BITS - 16;
+			llResult += ((llNext - llResult) * llFraction) >> 16;
+			llResult = (llResult + (1 << 15)) >> 16;
+		}
+		else
+		{
+			llResult = (llResult + (1 << (COEFF_BITS-1))) >> COEFF_BITS;
+		}
+
+		if (llResult > SAMPLE_MAX)
+		{
+			llResult = SAMPLE_MAX;
+		}
+		else if (llResult < SAMPLE_MIN)
+		{
+			llResult = SAMPLE_MIN;
+		}
+
+		*pOutput++ = (s32) llResult;
+	}
+}
+
+void CSampleRateConverter::CalculateCoefficients (unsigned nInputRate, unsigned nOutputRate)
+{
+	assert (m_pCoeffs != 0);
+
+	double fCutoff = 1.0;
+	if (nOutputRate < nInputRate)
+	{
+		fCutoff = (double) nOutputRate / nInputRate;	// anti-aliasing
+	}
+	fCutoff *= s_QualityParams[m_Quality].fRolloff;
+
+	unsigned nPhases = 1 << m_nPhaseBits;
+	double fHalf = m_nTaps / 2;
+
+	for (unsigned nPhase = 0; nPhase <= nPhases; nPhase++)
+	{
+		s32 *pCoeffs = m_pCoeffs + nPhase * m_nTaps;
+
+		// windowed sinc, sampled at the distance of each tap to the output position
+		double Coeffs[MAX_TAPS];
+		double fSum = 0.0;
+		for (unsigned k = 0; k < m_nTaps; k++)
+		{
+			double fT = fHalf - 1 - k + (double) nPhase / nPhases;
+
+			double fWindow = 0.0;
+			if (-fHalf < fT && fT < fHalf)
+			{
+				// 4-term Blackman-Harris window
+				double fX = PI * fT / fHalf;
+				fWindow =   0.35875 + 0.48829 * Cos (fX)
+					  + 0.14128 * Cos (2.0 * fX) + 0.01168 * Cos (3.0 * fX);
+			}
+
+			Coeffs[k] = fCutoff * Sinc (fCutoff * fT) * fWindow;
+			fSum += Coeffs[k];
+		}
+
+		// normalize to unity gain and put the rounding error onto the largest tap
+		s32 nSum = 0;
+		unsigned nMaxTap = 0;
+		for (unsigned k = 0; k < m_nTaps; k++)
+		{
+			double fValue = Coeffs[k] / fSum * (1 << COEFF_BITS);
+			pCoeffs[k] = (s32) (fValue < 0.0 ? fValue - 0.5 : fValue + 0.5);
+			nSum += pCoeffs[k];
+
+			if (pCoeffs[k] > pCoeffs[nMaxTap])
+			{
+				nMaxTap = k;
+			}
+		}
+
+		pCoeffs[nMaxTap] += (1 << COEFF_BITS) - nSum;
+	}
+}
+
+s64 CSampleRateConverter::DotProduct (const s32 *pSamples, const s32 *pCoeffs, unsigned nTaps)
+{
+#ifdef SRC_USE_NEON
+	int64x2_t Acc0 = vdupq_n_s64 (0);
+	int64x2_t Acc1 = vdupq_n_s64 (0);
+
+	for (unsigned i = 0; i < nTaps; i += 4)
+	{
+		int32x4_t Samples = vld1q_s32 (pSamples + i);
+		int32x4_t Coeffs = vld1q_s32 (pCoeffs + i);
+
+		Acc0 = vmlal_s32 (Acc0, vget_low_s32 (Samples), vget_low_s32 (Coeffs));
+		Acc1 = vmlal_s32 (Acc1, vget_high_s32 (Samples), vget_high_s32 (Coeffs));
+	}
+
+	Acc0 = vaddq_s64 (Acc0, Acc1);
+
+	return vgetq_lane_s64 (Acc0, 0) + vgetq_lane_s64 (Acc0, 1);
+#else
+	s64 llAcc = 0;
+
+	for (unsigned i = 0; i < nTaps; i++)
+	{
+		llAcc += (s64) pSamples[i] * pCoeffs[i];
+	}
+
+	return llAcc;
+#endif
+}
+
+double CSampleRateConverter::Sinc (double fX)
+{
+	if (-1e-9 < fX && fX < 1e-9)
+	{
+		return 1.0;
+	}
+
+	fX *= PI;
+
+	return Cos (fX - PI / 2.0) / fX;
+}
+
+// libm may not be available, calculate cos(x) with a Taylor series
+double CSampleRateConverter::Cos (double fX)
+{
+	if (fX < 0.0)
+	{
+		fX = -fX;
+	}
+
+	// reduce to 0..2PI
+	fX -= (2.0 * PI) * (long) (fX / (2.0 * PI));
+
+	// reduce to 0..PI/2
+	double fSign = 1.0;
+	if (fX > PI)
+	{
+		fX = 2.0 * PI - fX;
+	}
+	if (fX > PI / 2.0)
+	{
+		fX = PI - fX;
+		fSign = -1.0;
+	}
+
+	double fX2 = fX * fX;
+	double fTerm = 1.0;
+	double fResult = 1.0;
+	for (unsigned n = 2; n <= 20; n += 2)
+	{
+		fTerm *= -fX2 / (n * (n-1));
+		fResult += fTerm;
+	}
+
+	return fSign * fResult;
+}
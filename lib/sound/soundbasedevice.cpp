@@ -18,6 +18,8 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/sound/soundbasedevice.h>
+#include <circle/synchronize.h>
+#include <circle/timer.h>
 #include <circle/macros.h>
 #include <circle/util.h>
 #include <assert.h>
@@ -31,10 +33,19 @@ CSoundBaseDevice::CSoundBaseDevice (TSoundFormat HWFormat, u32 nRange32, unsigne
 	m_nNeedDataThreshold (0),
 	m_WriteFormat (SoundFormatUnknown),
 	m_nWriteChannels (0),
+	m_pConverter (0),
+	m_bDriftCompensation (FALSE),
+	m_nRatioAdjust (0),
 	m_pQueue (0),
 	m_nInPtr (0),
 	m_nOutPtr (0),
 	m_pCallback (0),
+	m_pOutputPipeline (0),
+	m_bLowLatency (FALSE),
+	m_nFramesEnqueued (0),
+	m_nFramesDequeued (0),
+	m_nMarkerIn (0),
+	m_nMarkerOut (0),
 	m_nReadQueueSize (0),
 	m_nHaveDataThreshold (0),
 	m_ReadFormat (SoundFormatUnknown),
@@ -43,10 +54,13 @@ CSoundBaseDevice::CSoundBaseDevice (TSoundFormat HWFormat, u32 nRange32, unsigne
 	m_nReadInPtr (0),
 	m_nReadOutPtr (0),
 	m_pReadCallback (0),
-	m_pReadCallbackParam (0)
+	m_pReadCallbackParam (0),
+	m_pInputPipeline (0)
 {
 	memset (m_NullFrame, 0, sizeof m_NullFrame);
 
+	ResetQueueStatistics ();
+
 	switch (m_HWFormat)
 	{
 	case SoundFormatSigned16:
@@ -112,6 +126,9 @@ CSoundBaseDevice::~CSoundBaseDevice (void)
 	m_pCallback = 0;
 	m_pReadCallback = 0;
 
+	delete m_pConverter;
+	m_pConverter = 0;
+
 	delete [] m_pQueue;
 	m_pQueue = 0;
 	delete [] m_pReadQueue;
@@ -202,6 +219,93 @@ void CSoundBaseDevice::SetWriteFormat (TSoundFormat Format, unsigned nChannels)
 	m_nWriteFrameSize = m_nWriteChannels * m_nWriteSampleSize;
 }
 
+boolean CSoundBaseDevice::SetWriteSampleRate (unsigned nSampleRate, TSRCQuality Quality)
+{
+	assert (m_WriteFormat < SoundFormatUnknown);
+	assert (nSampleRate > 0);
+
+	// Write() does not lock in low-latency mode, the converter must not change while running
+	if (   m_bLowLatency
+	    && IsActive ())
+	{
+		return FALSE;
+	}
+
+	if (   nSampleRate == m_nSampleRate
+	    && !m_bDriftCompensation)
+	{
+		return TRUE;
+	}
+
+	CSampleRateConverter *pConverter = new CSampleRateConverter (SOUND_HW_CHANNELS);
+	if (   pConverter == 0
+	    || !pConverter->Setup (nSampleRate, m_nSampleRate, Quality))
+	{
+		delete pConverter;
+
+		return FALSE;
+	}
+
+	m_SpinLock.Acquire ();
+
+	CSampleRateConverter *pOldConverter = m_pConverter;
+	m_pConverter = pConverter;
+	m_nRatioAdjust = 0;
+
+	m_SpinLock.Release ();
+
+	delete pOldConverter;
+
+	return TRUE;
+}
+
+boolean CSoundBaseDevice::EnableDriftCompensation (unsigned nTargetMsecs, TSRCQuality Quality)
+{
+	assert (m_WriteFormat < SoundFormatUnknown);
+	assert (m_nQueueSize > 0);
+
+	if (   m_bLowLatency
+	    && IsActive ())
+	{
+		return FALSE;
+	}
+
+	unsigned nTargetFrames = m_nSampleRate * nTargetMsecs / 1000;
+	if (   nTargetFrames == 0
+	    || nTargetFrames >= GetQueueSizeFrames ())
+	{
+		return FALSE;
+	}
+
+	m_SpinLock.Acquire ();
+
+	m_RateController.Setup (m_nSampleRate, nTargetFrames);
+	m_bDriftCompensation = TRUE;
+
+	m_SpinLock.Release ();
+
+	// the converter is required, even if the sample rates are equal
+	if (   m_pConverter == 0
+	    && !SetWriteSampleRate (m_nSampleRate, Quality))
+	{
+		m_bDriftCompensation = FALSE;
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+int CSoundBaseDevice::GetDriftCompensation (void) const
+{
+	if (!m_bDriftCompensation)
+	{
+		return 0;
+	}
+
+	return m_RateController.GetRatioAdjust ();
+}
+
 int CSoundBaseDevice::Write (const void *pBuffer, size_t nCount)
 {
 	assert (m_WriteFormat < SoundFormatUnknown);
@@ -211,9 +315,31 @@ int CSoundBaseDevice::Write (const void *pBuffer, size_t nCount)
 
 	int nResult = 0;
 
-	m_SpinLock.Acquire ();
+	if (!m_bLowLatency)
+	{
+		m_SpinLock.Acquire ();
+	}
+
+	size_t nTotal = nCount - nCount % m_nWriteFrameSize;
+	u32 nFirstFrame = m_nFramesEnqueued;
+	unsigned nTicks = CTimer::GetClockTicks ();
 
-	if (   m_HWFormat == m_WriteFormat
+	if (m_pConverter != 0)
+	{
+		if (m_bDriftCompensation)
+		{
+			// the ratio is calculated by the chunk handler, apply it here
+			int nRatioAdjust = m_RateController.GetRatioAdjust ();
+			if (nRatioAdjust != m_nRatioAdjust)
+			{
+				m_pConverter->SetRatioAdjust (nRatioAdjust);
+				m_nRatioAdjust = nRatioAdjust;
+			}
+		}
+
+		nResult = WriteConverted (pBuffer, nCount);
+	}
+	else if (   m_HWFormat == m_WriteFormat
 	    && m_nWriteChannels == SOUND_HW_CHANNELS
 	    && !m_bSwapChannels)
 	{
@@ -278,7 +404,24 @@ int CSoundBaseDevice::Write (const void *pBuffer, size_t nCount)
 		}
 	}
 
-	m_SpinLock.Release ();
+	if (m_nFramesEnqueued != nFirstFrame)
+	{
+		AddLatencyMarker (nFirstFrame, nTicks);
+	}
+
+	if ((size_t) nResult < nTotal)
+	{
+		m_StatisticsLock.Acquire ();
+
+		m_nOverruns++;
+
+		m_StatisticsLock.Release ();
+	}
+
+	if (!m_bLowLatency)
+	{
+		m_SpinLock.Release ();
+	}
 
 	return nResult;
 }
@@ -293,6 +436,11 @@ unsigned CSoundBaseDevice::GetQueueFramesAvail (void)
 {
 	assert (m_nQueueSize > 0);
 
+	if (m_bLowLatency)
+	{
+		return GetQueueBytesAvail () / m_nHWFrameSize;
+	}
+
 	m_SpinLock.Acquire ();
 
 	unsigned nQueueBytesAvail = GetQueueBytesAvail ();
@@ -311,11 +459,108 @@ void CSoundBaseDevice::RegisterNeedDataCallback (TSoundDataCallback *pCallback,
 	m_pCallbackParam = pParam;
 }
 
+void CSoundBaseDevice::SetLowLatencyMode (boolean bEnable)
+{
+	m_SpinLock.Acquire ();
+
+	m_bLowLatency = bEnable;
+
+	m_SpinLock.Release ();
+}
+
+void CSoundBaseDevice::GetQueueStatistics (TSoundQueueStatistics *pStatistics)
+{
+	assert (pStatistics != 0);
+	memset (pStatistics, 0, sizeof *pStatistics);
+
+	if (m_nQueueSize > 0)
+	{
+		pStatistics->nQueueFrames = GetQueueBytesAvail () / m_nHWFrameSize;
+	}
+
+	// take a consistent snapshot, the chunk handler may update it on another core
+	m_StatisticsLock.Acquire ();
+
+	pStatistics->nQueueFramesMin = m_nQueueFramesMin != (unsigned) -1 ? m_nQueueFramesMin : 0;
+	pStatistics->nQueueFramesMax = m_nQueueFramesMax;
+	pStatistics->nUnderruns = m_nUnderruns;
+	pStatistics->nOverruns = m_nOverruns;
+
+	unsigned nSamples = m_nLatencySamples;
+	pStatistics->nLatencySamples = nSamples;
+	if (nSamples == 0)
+	{
+		m_StatisticsLock.Release ();
+
+		return;
+	}
+
+	pStatistics->nLatencyMin = m_nLatencyMin;
+	pStatistics->nLatencyMax = m_nLatencyMax;
+
+	// walk the histogram, report the upper bound of the bucket
+	unsigned *pPercentile[] = {&pStatistics->nLatency50, &pStatistics->nLatency90,
+				   &pStatistics->nLatency99};
+	static const unsigned Percent[] = {50, 90, 99};
+
+	unsigned nSum = 0;
+	unsigned nIndex = 0;
+	for (unsigned i = 0; i < SOUND_LATENCY_BUCKETS && nIndex < 3; i++)
+	{
+		nSum += m_LatencyHistogram[i];
+
+		while (   nIndex < 3
+		       && (u64) nSum * 100 >= (u64) nSamples * Percent[nIndex])
+		{
+			unsigned nValue = (i+1) * SOUND_LATENCY_BUCKET_USECS;
+			*pPercentile[nIndex++] = nValue < m_nLatencyMax ? nValue : m_nLatencyMax;
+		}
+	}
+
+	assert (nIndex == 3);
+
+	m_StatisticsLock.Release ();
+}
+
+void CSoundBaseDevice::ResetQueueStatistics (void)
+{
+	m_StatisticsLock.Acquire ();
+
+	m_nQueueFramesMin = (unsigned) -1;
+	m_nQueueFramesMax = 0;
+	m_nUnderruns = 0;
+	m_nOverruns = 0;
+	m_bStreaming = FALSE;
+
+	m_nLatencySamples = 0;
+	m_nLatencyMin = (unsigned) -1;
+	m_nLatencyMax = 0;
+	memset (m_LatencyHistogram, 0, sizeof m_LatencyHistogram);
+
+	m_StatisticsLock.Release ();
+}
+
 boolean CSoundBaseDevice::AreChannelsSwapped (void) const
 {
 	return m_bSwapChannels;
 }
 
+boolean CSoundBaseDevice::SetAudioCore (unsigned nCore)
+{
+	return nCore == 0;
+}
+
+void CSoundBaseDevice::SetOutputPipeline (CDSPPipeline *pPipeline)
+{
+	assert (pPipeline == 0 || pPipeline->GetChannels () == SOUND_HW_CHANNELS);
+
+	m_SpinLock.Acquire ();
+
+	m_pOutputPipeline = pPipeline;
+
+	m_SpinLock.Release ();
+}
+
 // Input //////////////////////////////////////////////////////////////
 
 boolean CSoundBaseDevice::AllocateReadQueue (unsigned nSizeMsecs)
@@ -491,6 +736,17 @@ void CSoundBaseDevice::RegisterHaveDataCallback (TSoundDataCallback *pCallback,
 	m_pReadCallbackParam = pParam;
 }
 
+void CSoundBaseDevice::SetInputPipeline (CDSPPipeline *pPipeline)
+{
+	assert (pPipeline == 0 || pPipeline->GetChannels () == SOUND_HW_CHANNELS);
+
+	m_ReadSpinLock.Acquire ();
+
+	m_pInputPipeline = pPipeline;
+
+	m_ReadSpinLock.Release ();
+}
+
 // Output /////////////////////////////////////////////////////////////
 
 unsigned CSoundBaseDevice::GetChunk (s16 *pBuffer, unsigned nChunkSize)
@@ -537,7 +793,105 @@ u32 CSoundBaseDevice::ConvertIEC958Sample (u32 nSample, unsigned nFrame)
 	return nSample;
 }
 
+void CSoundBaseDevice::SetMeasuredSampleRate (unsigned nRateMilliHz)
+{
+	if (m_bDriftCompensation)
+	{
+		m_RateController.SetMeasuredRate (nRateMilliHz);
+	}
+}
+
+int CSoundBaseDevice::WriteConverted (const void *pBuffer, size_t nCount)
+{
+	static const unsigned BlockFrames = 64;
+	s32 InBlock[BlockFrames * SOUND_HW_CHANNELS];
+	s32 OutBlock[BlockFrames * SOUND_HW_CHANNELS];
+
+	assert (m_pConverter != 0);
+	assert (pBuffer != 0);
+	const u8 *pBuffer8 = static_cast<const u8 *> (pBuffer);
+
+	int nResult = 0;
+
+	while (nCount >= m_nWriteFrameSize)
+	{
+		unsigned nOutFrames = GetQueueBytesFree () / m_nHWFrameSize;
+		if (nOutFrames == 0)
+		{
+			break;
+		}
+
+		if (nOutFrames > BlockFrames)
+		{
+			nOutFrames = BlockFrames;
+		}
+
+		unsigned nInFrames = nCount / m_nWriteFrameSize;
+		if (nInFrames > BlockFrames)
+		{
+			nInFrames = BlockFrames;
+		}
+
+		// the converter works on signed 24-bit stereo samples
+		const u8 *pFrom = pBuffer8;
+		for (unsigned i = 0; i < nInFrames; i++)
+		{
+			InBlock[i*2] = GetWriteSample (pFrom) >> 8;
+			pFrom += m_nWriteSampleSize;
+
+			if (m_nWriteChannels == 2)
+			{
+				InBlock[i*2+1] = GetWriteSample (pFrom) >> 8;
+				pFrom += m_nWriteSampleSize;
+			}
+			else
+			{
+				InBlock[i*2+1] = InBlock[i*2];
+			}
+		}
+
+		unsigned nInFramesUsed = nInFrames;
+		nOutFrames = m_pConverter->Process (InBlock, &nInFramesUsed, OutBlock, nOutFrames);
+
+		for (unsigned i = 0; i < nOutFrames; i++)
+		{
+			u8 Frame[SOUND_MAX_FRAME_SIZE];
+
+			unsigned nLeft = m_bSwapChannels ? m_nHWSampleSize : 0;
+			PutHWSample (Frame + nLeft, OutBlock[i*2] << 8);
+			PutHWSample (Frame + (m_nHWSampleSize - nLeft), OutBlock[i*2+1] << 8);
+
+			Enqueue (Frame, m_nHWFrameSize);
+		}
+
+		unsigned nBytes = nInFramesUsed * m_nWriteFrameSize;
+		pBuffer8 += nBytes;
+		nCount -= nBytes;
+		nResult += nBytes;
+
+		if (   nInFramesUsed == 0
+		    && nOutFrames == 0)
+		{
+			break;
+		}
+	}
+
+	return nResult;
+}
+
 void CSoundBaseDevice::ConvertSoundFormat (void *pTo, const void *pFrom)
+{
+	if (m_WriteFormat == SoundFormatUnknown)
+	{
+		memcpy (pTo, pFrom, m_nWriteSampleSize);
+
+		return;
+	}
+
+	PutHWSample (pTo, GetWriteSample (pFrom));
+}
+
+s32 CSoundBaseDevice::GetWriteSample (const void *pFrom)
 {
 	s32 nValue = 0;
 
@@ -563,15 +917,59 @@ void CSoundBaseDevice::ConvertSoundFormat (void *pTo, const void *pFrom)
 		nValue <<= 8;
 		} break;
 
-	case SoundFormatUnknown:
-		memcpy (pTo, pFrom, m_nWriteSampleSize);
-		return;
+	default:
+		assert (0);
+		break;
+	}
+
+	return nValue;
+}
+
+s32 CSoundBaseDevice::GetHWSample (const void *pFrom)
+{
+	s32 nValue = 0;
+
+	switch (m_HWFormat)
+	{
+	case SoundFormatSigned16: {
+		const s16 *pValue = reinterpret_cast<const s16 *> (pFrom);
+		nValue = *pValue;
+		nValue <<= 16;
+		} break;
+
+	case SoundFormatSigned24_32: {
+		const s32 *pValue = reinterpret_cast<const s32 *> (pFrom);
+		nValue = *pValue;
+		nValue <<= 8;
+		} break;
+
+	case SoundFormatUnsigned32: {
+		const u32 *pValue = reinterpret_cast<const u32 *> (pFrom);
+		s64 llValue = ((u64) *pValue << 32) / m_nRangeMax;
+		llValue -= 1U << 31;
+		if (llValue > 0x7FFFFFFF)
+		{
+			llValue = 0x7FFFFFFF;
+		}
+
+		nValue = (s32) llValue;
+		} break;
+
+	case SoundFormatIEC958: {
+		const u32 *pValue = reinterpret_cast<const u32 *> (pFrom);
+		nValue = (s32) ((*pValue & 0x0FFFFFF0) << 4);
+		} break;
 
 	default:
 		assert (0);
 		break;
 	}
 
+	return nValue;
+}
+
+void CSoundBaseDevice::PutHWSample (void *pTo, s32 nValue)
+{
 	switch (m_HWFormat)
 	{
 	case SoundFormatSigned16: {
@@ -612,6 +1010,43 @@ void CSoundBaseDevice::ConvertSoundFormat (void *pTo, const void *pFrom)
 	}
 }
 
+void CSoundBaseDevice::ProcessPipeline (CDSPPipeline *pPipeline, void *pBuffer, unsigned nFrames)
+{
+	assert (pPipeline != 0);
+	u8 *pBuffer8 = static_cast<u8 *> (pBuffer);
+	assert (pBuffer8 != 0);
+
+	s32 Block[DSP_BLOCK_FRAMES * SOUND_HW_CHANNELS];
+
+	while (nFrames > 0)
+	{
+		unsigned nBlockFrames = nFrames < DSP_BLOCK_FRAMES ? nFrames : DSP_BLOCK_FRAMES;
+		unsigned nSamples = nBlockFrames * SOUND_HW_CHANNELS;
+
+		if (m_HWFormat == SoundFormatSigned16)
+		{
+			pPipeline->ProcessInterleaved (reinterpret_cast<s16 *> (pBuffer8), nBlockFrames);
+		}
+		else
+		{
+			for (unsigned i = 0; i < nSamples; i++)
+			{
+				Block[i] = GetHWSample (pBuffer8 + i*m_nHWSampleSize);
+			}
+
+			pPipeline->ProcessInterleaved (Block, nBlockFrames);
+
+			for (unsigned i = 0; i < nSamples; i++)
+			{
+				PutHWSample (pBuffer8 + i*m_nHWSampleSize, Block[i]);
+			}
+		}
+
+		pBuffer8 += nBlockFrames * m_nHWFrameSize;
+		nFrames -= nBlockFrames;
+	}
+}
+
 unsigned CSoundBaseDevice::GetChunkInternal (void *pBuffer, unsigned nChunkSize)
 {
 	u8 *pBuffer8 = static_cast<u8 *> (pBuffer);
@@ -621,7 +1056,11 @@ unsigned CSoundBaseDevice::GetChunkInternal (void *pBuffer, unsigned nChunkSize)
 	assert (nChunkSize % SOUND_HW_CHANNELS == 0);
 	unsigned nChunkSizeBytes = nChunkSize * m_nHWSampleSize;
 
-	m_SpinLock.Acquire ();
+	boolean bLowLatency = m_bLowLatency;
+	if (!bLowLatency)
+	{
+		m_SpinLock.Acquire ();
+	}
 
 	unsigned nQueueBytesAvail = GetQueueBytesAvail ();
 	unsigned nBytes = nQueueBytesAvail;
@@ -630,15 +1069,35 @@ unsigned CSoundBaseDevice::GetChunkInternal (void *pBuffer, unsigned nChunkSize)
 		nBytes = nChunkSizeBytes;
 	}
 
+	if (m_bDriftCompensation)
+	{
+		if (nBytes == nChunkSizeBytes)
+		{
+			m_RateController.Update (nQueueBytesAvail / m_nHWFrameSize,
+						 nChunkSize / SOUND_HW_CHANNELS);
+		}
+		else
+		{
+			m_RateController.Reset ();	// queue ran empty, restart level filter
+		}
+	}
+
 	if (nBytes > 0)
 	{
 		Dequeue (pBuffer8, nBytes);
 
 		pBuffer8 += nBytes;
-		nQueueBytesAvail -= nBytes;
 	}
 
-	m_SpinLock.Release ();
+	UpdateStatistics (nQueueBytesAvail / m_nHWFrameSize, nBytes / m_nHWFrameSize,
+			  nChunkSize / SOUND_HW_CHANNELS);
+
+	nQueueBytesAvail -= nBytes;
+
+	if (!bLowLatency)
+	{
+		m_SpinLock.Release ();
+	}
 
 	while (nBytes < nChunkSizeBytes)
 	{
@@ -648,6 +1107,13 @@ unsigned CSoundBaseDevice::GetChunkInternal (void *pBuffer, unsigned nChunkSize)
 		nBytes += m_nHWFrameSize;
 	}
 
+	// silence is processed too, so that effects can decay
+	CDSPPipeline *pPipeline = m_pOutputPipeline;
+	if (pPipeline != 0)
+	{
+		ProcessPipeline (pPipeline, pBuffer, nChunkSize / SOUND_HW_CHANNELS);
+	}
+
 	// insert control channel and parity bits, and preamble into IEC958 block
 	if (m_HWFormat == SoundFormatIEC958)
 	{
@@ -696,32 +1162,40 @@ unsigned CSoundBaseDevice::GetChunkInternal (void *pBuffer, unsigned nChunkSize)
 	return nChunkSize;
 }
 
+// The queue pointers are read once and each is written by one side only (producer: m_nInPtr,
+// consumer: m_nOutPtr), with the data access ordered by memory barriers. This allows lock-free
+// access in low-latency mode.
+
 unsigned CSoundBaseDevice::GetQueueBytesFree (void)
 {
 	assert (m_nQueueSize > 1);
-	assert (m_nInPtr < m_nQueueSize);
-	assert (m_nOutPtr < m_nQueueSize);
+	unsigned nInPtr = m_nInPtr;
+	unsigned nOutPtr = m_nOutPtr;
+	assert (nInPtr < m_nQueueSize);
+	assert (nOutPtr < m_nQueueSize);
 
-	if (m_nOutPtr <= m_nInPtr)
+	if (nOutPtr <= nInPtr)
 	{
-		return m_nQueueSize+m_nOutPtr-m_nInPtr-1;
+		return m_nQueueSize+nOutPtr-nInPtr-1;
 	}
 
-	return m_nOutPtr-m_nInPtr-1;
+	return nOutPtr-nInPtr-1;
 }
 
 unsigned CSoundBaseDevice::GetQueueBytesAvail (void)
 {
 	assert (m_nQueueSize > 1);
-	assert (m_nInPtr < m_nQueueSize);
-	assert (m_nOutPtr < m_nQueueSize);
+	unsigned nInPtr = m_nInPtr;
+	unsigned nOutPtr = m_nOutPtr;
+	assert (nInPtr < m_nQueueSize);
+	assert (nOutPtr < m_nQueueSize);
 
-	if (m_nInPtr < m_nOutPtr)
+	if (nInPtr < nOutPtr)
 	{
-		return m_nQueueSize+m_nInPtr-m_nOutPtr;
+		return m_nQueueSize+nInPtr-nOutPtr;
 	}
 
-	return m_nInPtr-m_nOutPtr;
+	return nInPtr-nOutPtr;
 }
 
 void CSoundBaseDevice::Enqueue (const void *pBuffer, unsigned nCount)
@@ -731,15 +1205,34 @@ void CSoundBaseDevice::Enqueue (const void *pBuffer, unsigned nCount)
 	assert (m_pQueue != 0);
 
 	assert (nCount > 0);
-	while (nCount-- > 0)
+	assert (nCount < m_nQueueSize);
+	unsigned nInPtr = m_nInPtr;
+
+	DataMemBarrier ();		// consumer must have read the data before
+
+	unsigned nFirst = m_nQueueSize - nInPtr;
+	if (nFirst > nCount)
 	{
-		m_pQueue[m_nInPtr] = *p++;
+		nFirst = nCount;
+	}
 
-		if (++m_nInPtr == m_nQueueSize)
-		{
-			m_nInPtr = 0;
-		}
+	memcpy (m_pQueue + nInPtr, p, nFirst);
+	if (nCount > nFirst)
+	{
+		memcpy (m_pQueue, p + nFirst, nCount - nFirst);
+	}
+
+	nInPtr += nCount;
+	if (nInPtr >= m_nQueueSize)
+	{
+		nInPtr -= m_nQueueSize;
 	}
+
+	DataMemBarrier ();		// publish the data before the pointer
+
+	m_nInPtr = nInPtr;
+
+	m_nFramesEnqueued += nCount / m_nHWFrameSize;
 }
 
 void CSoundBaseDevice::Dequeue (void *pBuffer, unsigned nCount)
@@ -749,15 +1242,134 @@ void CSoundBaseDevice::Dequeue (void *pBuffer, unsigned nCount)
 	assert (m_pQueue != 0);
 
 	assert (nCount > 0);
-	while (nCount-- > 0)
+	assert (nCount < m_nQueueSize);
+	unsigned nOutPtr = m_nOutPtr;
+
+	DataMemBarrier ();		// pointer has been read before, so read the data after
+
+	unsigned nFirst = m_nQueueSize - nOutPtr;
+	if (nFirst > nCount)
+	{
+		nFirst = nCount;
+	}
+
+	memcpy (p, m_pQueue + nOutPtr, nFirst);
+	if (nCount > nFirst)
+	{
+		memcpy (p + nFirst, m_pQueue, nCount - nFirst);
+	}
+
+	nOutPtr += nCount;
+	if (nOutPtr >= m_nQueueSize)
+	{
+		nOutPtr -= m_nQueueSize;
+	}
+
+	DataMemBarrier ();		// data has been read, before the room is given back
+
+	m_nOutPtr = nOutPtr;
+}
+
+void CSoundBaseDevice::AddLatencyMarker (u32 nFrame, unsigned nTicks)
+{
+	unsigned nMarkerIn = m_nMarkerIn;
+	unsigned nNext = (nMarkerIn + 1) % SOUND_LATENCY_MARKERS;
+	if (nNext == m_nMarkerOut)
+	{
+		return;				// marker ring is full, skip this measurement
+	}
+
+	m_LatencyMarker[nMarkerIn].nFrame = nFrame;
+	m_LatencyMarker[nMarkerIn].nTicks = nTicks;
+
+	DataMemBarrier ();
+
+	m_nMarkerIn = nNext;
+}
+
+void CSoundBaseDevice::UpdateStatistics (unsigned nQueueFrames, unsigned nFrames,
+					 unsigned nChunkFrames)
+{
+	m_StatisticsLock.Acquire ();
+
+	if (nQueueFrames < m_nQueueFramesMin)
+	{
+		m_nQueueFramesMin = nQueueFrames;
+	}
+
+	if (nQueueFrames > m_nQueueFramesMax)
+	{
+		m_nQueueFramesMax = nQueueFrames;
+	}
+
+	if (nFrames < nChunkFrames)
+	{
+		if (m_bStreaming)
+		{
+			m_nUnderruns++;
+		}
+
+		m_bStreaming = FALSE;
+	}
+	else
+	{
+		m_bStreaming = TRUE;
+	}
+
+	// the first frame of the chunk is output, when the other DMA buffer has been sent
+	u32 nFirstFrame = m_nFramesDequeued;
+	m_nFramesDequeued += nFrames;
+
+	unsigned nTicks = CTimer::GetClockTicks ();
+
+	unsigned nMarkerOut = m_nMarkerOut;
+	while (nMarkerOut != m_nMarkerIn)
 	{
-		*p++ = m_pQueue[m_nOutPtr];
+		DataMemBarrier ();
+
+		const TLatencyMarker *pMarker = &m_LatencyMarker[nMarkerOut];
+
+		int nOffset = (int) (pMarker->nFrame - nFirstFrame);
+		if (nOffset >= (int) nFrames)
+		{
+			break;				// frame is still in the queue
+		}
+
+		if (nOffset < 0)
+		{
+			nOffset = 0;
+		}
+
+		unsigned nLatency =   nTicks - pMarker->nTicks
+				    + (unsigned) (  (u64) (nChunkFrames + nOffset) * 1000000
+						  / m_nSampleRate);
 
-		if (++m_nOutPtr == m_nQueueSize)
+		m_nLatencySamples++;
+
+		if (nLatency < m_nLatencyMin)
+		{
+			m_nLatencyMin = nLatency;
+		}
+
+		if (nLatency > m_nLatencyMax)
+		{
+			m_nLatencyMax = nLatency;
+		}
+
+		unsigned nBucket = nLatency / SOUND_LATENCY_BUCKET_USECS;
+		if (nBucket >= SOUND_LATENCY_BUCKETS)
 		{
-			m_nOutPtr = 0;
+			nBucket = SOUND_LATENCY_BUCKETS-1;
 		}
+
+		m_LatencyHistogram[nBucket]++;
+
+		nMarkerOut = (nMarkerOut + 1) % SOUND_LATENCY_MARKERS;
 	}
+
+	m_nMarkerOut = nMarkerOut;
+
+	m_StatisticsLock.Release ();
 }
 
 // Input //////////////////////////////////////////////////////////////
@@ -785,23 +1397,38 @@ void CSoundBaseDevice::PutChunkInternal (const void *pBuffer, unsigned nChunkSiz
 	assert (nChunkSize % SOUND_HW_CHANNELS == 0);
 	unsigned nChunkSizeBytes = nChunkSize * m_nHWSampleSize;
 
-	m_ReadSpinLock.Acquire ();
+	unsigned nReadQueueBytesFree;
 
-	unsigned nReadQueueBytesFree = GetReadQueueBytesFree ();
-	unsigned nBytes = nReadQueueBytesFree;
-	if (nBytes > nChunkSizeBytes)
+	CDSPPipeline *pPipeline = m_pInputPipeline;
+	if (pPipeline == 0)
 	{
-		nBytes = nChunkSizeBytes;
+		nReadQueueBytesFree = ReadEnqueueChunk (pBuffer8, nChunkSizeBytes);
 	}
-
-	if (nBytes > 0)
+	else
 	{
-		ReadEnqueue (pBuffer8, nBytes);
+		// the chunk is read-only, process a copy of it block by block
+		u8 Block[DSP_BLOCK_FRAMES * SOUND_MAX_FRAME_SIZE];
+		unsigned nBlockSizeBytes = DSP_BLOCK_FRAMES * m_nHWFrameSize;
 
-		nReadQueueBytesFree -= nBytes;
-	}
+		do
+		{
+			unsigned nBytes = nChunkSizeBytes;
+			if (nBytes > nBlockSizeBytes)
+			{
+				nBytes = nBlockSizeBytes;
+			}
 
-	m_ReadSpinLock.Release ();
+			memcpy (Block, pBuffer8, nBytes);
+
+			ProcessPipeline (pPipeline, Block, nBytes / m_nHWFrameSize);
+
+			nReadQueueBytesFree = ReadEnqueueChunk (Block, nBytes);
+
+			pBuffer8 += nBytes;
+			nChunkSizeBytes -= nBytes;
+		}
+		while (nChunkSizeBytes > 0);
+	}
 
 	if (   m_pReadCallback != 0
 	    && nReadQueueBytesFree < m_nHaveDataThreshold)
@@ -885,6 +1512,29 @@ unsigned CSoundBaseDevice::GetReadQueueBytesAvail (void)
 	return m_nReadInPtr-m_nReadOutPtr;
 }
 
+unsigned CSoundBaseDevice::ReadEnqueueChunk (const void *pBuffer, unsigned nCount)
+{
+	m_ReadSpinLock.Acquire ();
+
+	unsigned nReadQueueBytesFree = GetReadQueueBytesFree ();
+	unsigned nBytes = nReadQueueBytesFree;
+	if (nBytes > nCount)
+	{
+		nBytes = nCount;
+	}
+
+	if (nBytes > 0)
+	{
+		ReadEnqueue (pBuffer, nBytes);
+
+		nReadQueueBytesFree -= nBytes;
+	}
+
+	m_ReadSpinLock.Release ();
+
+	return nReadQueueBytesFree;
+}
+
 void CSoundBaseDevice::ReadEnqueue (const void *pBuffer, unsigned nCount)
 {
 	const u8 *p = static_cast<const u8 *> (pBuffer);
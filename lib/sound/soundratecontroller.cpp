@@ -0,0 +1,141 @@
+//
+// soundratecontroller.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sound/soundratecontroller.h>
+#include <assert.h>
+
+// The queue level integrates the rate difference: a correction of 1 ppm changes the level by
+// 1 us per second. The gains below give a critically damped loop with a time constant of
+// about 30 seconds, which keeps the pitch modulation inaudible.
+
+#define LEVEL_FILTER_MSECS	250		// time constant of the level filter
+#define KP			66		// ppm per millisecond level error
+#define KI			1100		// ppm per millisecond level error and second / 1000
+#define FEED_FORWARD_WEIGHT	8		// smoothing of the measured rate
+
+#define MAX_ADJUST		SOUND_RATE_MAX_ADJUST_PPM
+
+CSoundRateController::CSoundRateController (void)
+:	m_nSampleRate (0),
+	m_nTargetFrames (0),
+	m_bLevelValid (FALSE),
+	m_llLevel (0),
+	m_llIntegral (0),
+	m_nFeedForward (0),
+	m_nRatioAdjust (0)
+{
+}
+
+void CSoundRateController::Setup (unsigned nSampleRate, unsigned nTargetFrames)
+{
+	assert (nSampleRate > 0);
+	assert (nTargetFrames > 0);
+
+	m_nSampleRate = nSampleRate;
+	m_nTargetFrames = nTargetFrames;
+
+	m_llIntegral = 0;
+	m_nFeedForward = 0;
+	m_nRatioAdjust = 0;
+
+	Reset ();
+}
+
+void CSoundRateController::Reset (void)
+{
+	m_bLevelValid = FALSE;
+}
+
+void CSoundRateController::SetMeasuredRate (unsigned nRateMilliHz)
+{
+	assert (m_nSampleRate > 0);
+
+	if (nRateMilliHz == 0)
+	{
+		m_nFeedForward = 0;
+
+		return;
+	}
+
+	// a slower device needs less output frames, the producer has to consume faster
+	s64 llNominal = (s64) m_nSampleRate * 1000;
+	s64 llPPM = (llNominal - nRateMilliHz) * 1000000 / nRateMilliHz;
+	if (   llPPM > MAX_ADJUST
+	    || llPPM < -MAX_ADJUST)
+	{
+		return;				// implausible value, ignore it
+	}
+
+	int nFeedForward = m_nFeedForward;
+	nFeedForward += ((int) llPPM - nFeedForward) / FEED_FORWARD_WEIGHT;
+	m_nFeedForward = nFeedForward;
+}
+
+int CSoundRateController::Update (unsigned nQueueFrames, unsigned nElapsedFrames)
+{
+	assert (m_nSampleRate > 0);
+
+	if (nElapsedFrames > m_nSampleRate)
+	{
+		nElapsedFrames = m_nSampleRate;
+	}
+
+	s64 llLevel = (s64) nQueueFrames << 16;
+	if (!m_bLevelValid)
+	{
+		m_llLevel = llLevel;
+		m_bLevelValid = TRUE;
+	}
+	else
+	{
+		unsigned nFilterFrames = m_nSampleRate * LEVEL_FILTER_MSECS / 1000;
+		unsigned nWeight = nElapsedFrames < nFilterFrames ? nElapsedFrames : nFilterFrames;
+
+		m_llLevel += (llLevel - m_llLevel) * nWeight / nFilterFrames;
+	}
+
+	// level error in microseconds
+	s64 llError = (m_llLevel - ((s64) m_nTargetFrames << 16)) * 1000000 / m_nSampleRate;
+	llError >>= 16;
+
+	m_llIntegral +=   ((s64) KI * llError << 16) * nElapsedFrames
+			/ ((s64) 1000000 * m_nSampleRate);
+	if (m_llIntegral > (s64) MAX_ADJUST << 16)
+	{
+		m_llIntegral = (s64) MAX_ADJUST << 16;
+	}
+	else if (m_llIntegral < -((s64) MAX_ADJUST << 16))
+	{
+		m_llIntegral = -((s64) MAX_ADJUST << 16);
+	}
+
+	s64 llAdjust = m_nFeedForward + KP * llError / 1000 + (m_llIntegral >> 16);
+	if (llAdjust > MAX_ADJUST)
+	{
+		llAdjust = MAX_ADJUST;
+	}
+	else if (llAdjust < -MAX_ADJUST)
+	{
+		llAdjust = -MAX_ADJUST;
+	}
+
+	m_nRatioAdjust = (int) llAdjust;
+
+	return m_nRatioAdjust;
+}
@@ -321,6 +321,13 @@ boolean CUSBSoundBaseDevice::SendChunk (void)
 	assert (nChunkSizeBytes % sizeof (s16) == 0);
 	assert (nChunkSizeBytes <= m_nTXChunkSizeBytes * 2);
 
+	// the feedback endpoint tells us, how fast the device really consumes the samples
+	unsigned nFeedbackRate = m_pTXUSBDevice->GetFeedbackRate ();
+	if (nFeedbackRate)
+	{
+		SetMeasuredSampleRate (nFeedbackRate);
+	}
+
 	assert (m_nTXCurrentBuffer < 2);
 	assert (m_pTXBuffer[m_nTXCurrentBuffer]);
 	unsigned nChunkSize = GetChunk (reinterpret_cast<s16 *> (m_pTXBuffer[m_nTXCurrentBuffer]),
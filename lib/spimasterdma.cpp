@@ -22,6 +22,7 @@
 #include <circle/memio.h>
 #include <circle/machineinfo.h>
 #include <circle/synchronize.h>
+#include <circle/new.h>
 #include <assert.h>
 
 // CS Register
@@ -50,9 +51,39 @@
 #define CS_CS		(3 << 0)
 #define CS_CS__SHIFT	0
 
+#define IO_BUS_ADDRESS(addr)	(((addr) & 0xFFFFFF) + GPU_IO_BASE)
+
+// control blocks and register values for one transfer of a queue
+struct TSPIDMAQueueEntry
+{
+	// executed by the RX channel
+	TDMAControlBlock	SetCSOff;		// deassert CS, clear FIFOs
+	TDMAControlBlock	SetClockLength;		// CLK and DLEN register
+	TDMAControlBlock	SetCSOn;		// assert CS, activate transfer
+	TDMAControlBlock	SetTxControlBlock;	// CONBLK_AD of TX channel
+	TDMAControlBlock	StartTx;		// CS of TX channel
+	TDMAControlBlock	Receive;
+
+	// executed by the TX channel
+	TDMAControlBlock	Transmit;
+
+	// source of the register writes
+	u32	nCSOff;
+	u32	nClock;
+	u32	nDataLength;		// must follow nClock
+	u32	nCSOn;
+	u32	nTxControlBlock;
+	u32	nTxCS;
+	u32	nZero;			// sent, if there is no write buffer
+	u32	nDiscard;		// received, if there is no read buffer
+}
+PACKED;
+
+ASSERT_STATIC ((sizeof (TSPIDMAQueueEntry) & 31) == 0);	// control blocks must stay aligned
+
 CSPIMasterDMA::CSPIMasterDMA (CInterruptSystem *pInterruptSystem,
 			      unsigned nClockSpeed, unsigned CPOL, unsigned CPHA,
-			      boolean bDMAChannelLite)
+			      boolean bDMAChannelLite, unsigned nQueueSize)
 :	m_nClockSpeed (nClockSpeed),
 	m_CPOL (CPOL),
 	m_CPHA (CPHA),
@@ -64,13 +95,30 @@ CSPIMasterDMA::CSPIMasterDMA (CInterruptSystem *pInterruptSystem,
 	m_CE0  ( 8, GPIOModeAlternateFunction0),
 	m_CE1  ( 7, GPIOModeAlternateFunction0),
 	m_nCoreClockRate (CMachineInfo::Get ()->GetClockRate (CLOCK_ID_CORE)),
-	m_pCompletionRoutine (0)
+	m_pCompletionRoutine (0),
+	m_nQueueSize (nQueueSize),
+	m_pQueueBuffer (0),
+	m_pQueue (0),
+	m_pQueuedTransfers (0),
+	m_nQueuedTransfers (0)
 {
 	assert (m_nCoreClockRate > 0);
+
+	if (m_nQueueSize > 0)
+	{
+		m_pQueueBuffer = new (HEAP_DMA30) u8[m_nQueueSize * sizeof (TSPIDMAQueueEntry) + 31];
+		assert (m_pQueueBuffer != 0);
+
+		m_pQueue = (TSPIDMAQueueEntry *) (((uintptr) m_pQueueBuffer + 31) & ~31);
+	}
 }
 
 CSPIMasterDMA::~CSPIMasterDMA (void)
 {
+	m_pQueue = 0;
+
+	delete [] m_pQueueBuffer;
+	m_pQueueBuffer = 0;
 }
 
 boolean CSPIMasterDMA::Initialize (void)
@@ -155,10 +203,171 @@ void CSPIMasterDMA::StartWriteRead (unsigned	nChipSelect,
 	m_TxDMA.Start ();
 }
 
+boolean CSPIMasterDMA::StartQueue (const TSPIDMATransfer *pTransfers, unsigned nTransfers)
+{
+	if (   nTransfers == 0
+	    || nTransfers > m_nQueueSize)
+	{
+		return FALSE;
+	}
+
+	assert (pTransfers != 0);
+	assert (m_pQueue != 0);
+	assert (m_pQueuedTransfers == 0);
+
+	unsigned nTxChannel = m_TxDMA.GetChannel ();
+
+	for (unsigned i = 0; i < nTransfers; i++)
+	{
+		const TSPIDMATransfer *pTransfer = &pTransfers[i];
+		TSPIDMAQueueEntry *pEntry = &m_pQueue[i];
+
+		unsigned nClockSpeed = pTransfer->nClockSpeed ? pTransfer->nClockSpeed : m_nClockSpeed;
+		assert (4000 <= nClockSpeed && nClockSpeed <= 125000000);
+		assert (pTransfer->CPOL <= 1);
+		assert (pTransfer->CPHA <= 1);
+		assert (pTransfer->nChipSelect <= 1 || pTransfer->nChipSelect == ChipSelectNone);
+		assert (0 < pTransfer->nCount && pTransfer->nCount <= 0xFFFF);
+
+		u32 nMode =   (pTransfer->CPOL << CS_CPOL__SHIFT)
+			    | (pTransfer->CPHA << CS_CPHA__SHIFT)
+			    | (pTransfer->nChipSelect << CS_CS__SHIFT);
+
+		pEntry->nCSOff = nMode | CS_CLEAR_RX | CS_CLEAR_TX;
+		pEntry->nClock = m_nCoreClockRate / nClockSpeed;
+		pEntry->nDataLength = pTransfer->nCount;
+		pEntry->nCSOn = nMode | CS_DMAEN | CS_ADCS | CS_TA;
+		pEntry->nTxControlBlock = BUS_ADDRESS ((uintptr) &pEntry->Transmit);
+		pEntry->nTxCS =   CS_WAIT_FOR_OUTSTANDING_WRITES
+				| (DEFAULT_PANIC_PRIORITY << CS_PANIC_PRIORITY_SHIFT)
+				| (DEFAULT_PRIORITY << CS_PRIORITY_SHIFT)
+				| CS_END | CS_ACTIVE;
+		pEntry->nZero = 0;
+
+		// register writes
+		TDMAControlBlock *pCB = &pEntry->SetCSOff;
+		pCB->nTransferInformation     = TI_WAIT_RESP;
+		pCB->nSourceAddress           = BUS_ADDRESS ((uintptr) &pEntry->nCSOff);
+		pCB->nDestinationAddress      = IO_BUS_ADDRESS (ARM_SPI0_CS);
+		pCB->nTransferLength          = sizeof (u32);
+		pCB->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) &pEntry->SetClockLength);
+
+		pCB = &pEntry->SetClockLength;
+		pCB->nTransferInformation     = TI_SRC_INC | TI_DEST_INC | TI_WAIT_RESP;
+		pCB->nSourceAddress           = BUS_ADDRESS ((uintptr) &pEntry->nClock);
+		pCB->nDestinationAddress      = IO_BUS_ADDRESS (ARM_SPI0_CLK);
+		pCB->nTransferLength          = 2 * sizeof (u32);
+		pCB->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) &pEntry->SetCSOn);
+
+		pCB = &pEntry->SetCSOn;
+		pCB->nTransferInformation     = TI_WAIT_RESP;
+		pCB->nSourceAddress           = BUS_ADDRESS ((uintptr) &pEntry->nCSOn);
+		pCB->nDestinationAddress      = IO_BUS_ADDRESS (ARM_SPI0_CS);
+		pCB->nTransferLength          = sizeof (u32);
+		pCB->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) &pEntry->SetTxControlBlock);
+
+		// the TX channel is started from here, after the previous transfer has completed
+		pCB = &pEntry->SetTxControlBlock;
+		pCB->nTransferInformation     = TI_WAIT_RESP;
+		pCB->nSourceAddress           = BUS_ADDRESS ((uintptr) &pEntry->nTxControlBlock);
+		pCB->nDestinationAddress      = IO_BUS_ADDRESS (ARM_DMACHAN_CONBLK_AD (nTxChannel));
+		pCB->nTransferLength          = sizeof (u32);
+		pCB->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) &pEntry->StartTx);
+
+		pCB = &pEntry->StartTx;
+		pCB->nTransferInformation     = TI_WAIT_RESP;
+		pCB->nSourceAddress           = BUS_ADDRESS ((uintptr) &pEntry->nTxCS);
+		pCB->nDestinationAddress      = IO_BUS_ADDRESS (ARM_DMACHAN_CS (nTxChannel));
+		pCB->nTransferLength          = sizeof (u32);
+		pCB->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) &pEntry->Receive);
+
+		// data transfer
+		pCB = &pEntry->Receive;
+		pCB->nTransferInformation     =   (DREQSourceSPIRX << TI_PERMAP_SHIFT)
+					        | (DEFAULT_BURST_LENGTH << TI_BURST_LENGTH_SHIFT)
+					        | TI_SRC_DREQ
+					        | TI_WAIT_RESP;
+		pCB->nSourceAddress           = IO_BUS_ADDRESS (ARM_SPI0_FIFO);
+		if (pTransfer->pReadBuffer != 0)
+		{
+			pCB->nTransferInformation |= TI_DEST_WIDTH | TI_DEST_INC;
+			pCB->nDestinationAddress   = BUS_ADDRESS ((uintptr) pTransfer->pReadBuffer);
+
+			CleanAndInvalidateDataCacheRange ((uintptr) pTransfer->pReadBuffer,
+							  pTransfer->nCount);
+		}
+		else
+		{
+			pCB->nDestinationAddress   = BUS_ADDRESS ((uintptr) &pEntry->nDiscard);
+		}
+		pCB->nTransferLength          = pTransfer->nCount;
+		pCB->nNextControlBlockAddress =   i+1 < nTransfers
+						? BUS_ADDRESS ((uintptr) &m_pQueue[i+1].SetCSOff) : 0;
+		if (i+1 == nTransfers)
+		{
+			pCB->nTransferInformation |= TI_INTEN;
+		}
+
+		pCB = &pEntry->Transmit;
+		pCB->nTransferInformation     =   (DREQSourceSPITX << TI_PERMAP_SHIFT)
+					        | (DEFAULT_BURST_LENGTH << TI_BURST_LENGTH_SHIFT)
+					        | TI_DEST_DREQ
+					        | TI_WAIT_RESP;
+		if (pTransfer->pWriteBuffer != 0)
+		{
+			pCB->nTransferInformation |= TI_SRC_WIDTH | TI_SRC_INC;
+			pCB->nSourceAddress        = BUS_ADDRESS ((uintptr) pTransfer->pWriteBuffer);
+
+			CleanAndInvalidateDataCacheRange ((uintptr) pTransfer->pWriteBuffer,
+							  pTransfer->nCount);
+		}
+		else
+		{
+			pCB->nSourceAddress        = BUS_ADDRESS ((uintptr) &pEntry->nZero);
+		}
+		pCB->nDestinationAddress      = IO_BUS_ADDRESS (ARM_SPI0_FIFO);
+		pCB->nTransferLength          = pTransfer->nCount;
+		pCB->nNextControlBlockAddress = 0;
+
+		for (TDMAControlBlock *p = &pEntry->SetCSOff; p <= &pEntry->Transmit; p++)
+		{
+			p->n2DModeStride = 0;
+			p->nReserved[0] = 0;
+			p->nReserved[1] = 0;
+		}
+	}
+
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pQueue, nTransfers * sizeof (TSPIDMAQueueEntry));
+
+	m_pQueuedTransfers = pTransfers;
+	m_nQueuedTransfers = nTransfers;
+
+	m_RxDMA.SetupChain (&m_pQueue[0].SetCSOff);
+	m_RxDMA.SetCompletionRoutine (DMACompletionStub, this);
+	m_RxDMA.Start ();
+
+	return TRUE;
+}
+
 void CSPIMasterDMA::DMACompletionRoutine (boolean bRxStatus)
 {
 	boolean bTxStatus = m_TxDMA.Wait ();
 
+	if (m_pQueuedTransfers != 0)
+	{
+		for (unsigned i = 0; i < m_nQueuedTransfers; i++)
+		{
+			if (m_pQueuedTransfers[i].pReadBuffer != 0)
+			{
+				CleanAndInvalidateDataCacheRange ((uintptr) m_pQueuedTransfers[i].pReadBuffer,
+								  m_pQueuedTransfers[i].nCount);
+			}
+		}
+
+		m_pQueuedTransfers = 0;
+		m_nQueuedTransfers = 0;
+	}
+
 	PeripheralEntry ();
 	write32 (ARM_SPI0_CS, read32 (ARM_SPI0_CS) & ~(CS_TA | CS_DMAEN | CS_ADCS));
 	PeripheralExit ();
@@ -28,9 +28,12 @@
 
 boolean CSpinLock::s_bEnabled = FALSE;
 
-CSpinLock::CSpinLock (unsigned nTargetLevel)
+CSpinLock::CSpinLock (unsigned nTargetLevel, const char *pName)
 :	m_nTargetLevel (nTargetLevel),
 	m_nLocked (0)
+#ifdef LOCK_STATISTICS
+	, m_Statistics (pName)
+#endif
 {
 	assert (nTargetLevel <= FIQ_LEVEL);
 }
@@ -49,6 +52,11 @@ void CSpinLock::Acquire (void)
 
 	if (s_bEnabled)
 	{
+#ifdef LOCK_STATISTICS
+		u64 ullWaitStart = CLockStatistics::GetTimestamp ();
+		boolean bContended = *(volatile u32 *) &m_nLocked != 0;
+#endif
+
 #if AARCH == 32
 		// See: ARMv7-A Architecture Reference Manual, Section D7.3
 		asm volatile
@@ -88,6 +96,10 @@ void CSpinLock::Acquire (void)
 			: : "r" ((uintptr) &m_nLocked) : "x1", "x2", "x3"
 		);
 #endif
+
+#ifdef LOCK_STATISTICS
+		m_Statistics.Acquired (ullWaitStart, bContended);
+#endif
 	}
 }
 
@@ -95,6 +107,10 @@ void CSpinLock::Release (void)
 {
 	if (s_bEnabled)
 	{
+#ifdef LOCK_STATISTICS
+		m_Statistics.Released ();
+#endif
+
 #if AARCH == 32
 		// See: ARMv7-A Architecture Reference Manual, Section D7.3
 		asm volatile
@@ -0,0 +1,92 @@
+//
+// spscqueue.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/spscqueue.h>
+#include <assert.h>
+
+CSPSCQueue::CSPSCQueue (unsigned nSize)
+:	m_nMask (nSize-1),
+	m_ppBuffer (new void *[nSize]),
+	m_nHead (0),
+	m_nTailCache (0),
+	m_nTail (0),
+	m_nHeadCache (0)
+{
+	assert (nSize >= 2);
+	assert ((nSize & m_nMask) == 0);
+	assert (m_ppBuffer != 0);
+}
+
+CSPSCQueue::~CSPSCQueue (void)
+{
+	delete [] m_ppBuffer;
+	m_ppBuffer = 0;
+}
+
+boolean CSPSCQueue::Put (void *pPtr)
+{
+	// the indices run freely and are masked on access only
+	unsigned nHead = m_nHead;
+
+	if (nHead - m_nTailCache > m_nMask)
+	{
+		// the queue seems to be full, get the current consumer index
+		m_nTailCache = __atomic_load_n (&m_nTail, __ATOMIC_ACQUIRE);
+
+		if (nHead - m_nTailCache > m_nMask)
+		{
+			return FALSE;
+		}
+	}
+
+	m_ppBuffer[nHead & m_nMask] = pPtr;
+
+	// the entry must be visible before the index
+	__atomic_store_n (&m_nHead, nHead+1, __ATOMIC_RELEASE);
+
+	return TRUE;
+}
+
+void *CSPSCQueue::Get (void)
+{
+	unsigned nTail = m_nTail;
+
+	if (nTail == m_nHeadCache)
+	{
+		m_nHeadCache = __atomic_load_n (&m_nHead, __ATOMIC_ACQUIRE);
+
+		if (nTail == m_nHeadCache)
+		{
+			return 0;
+		}
+	}
+
+	void *pPtr = m_ppBuffer[nTail & m_nMask];
+
+	// the entry must have been read, before the producer can overwrite it
+	__atomic_store_n (&m_nTail, nTail+1, __ATOMIC_RELEASE);
+
+	return pPtr;
+}
+
+boolean CSPSCQueue::IsEmpty (void) const
+{
+	return __atomic_load_n (&m_nTail, __ATOMIC_ACQUIRE)
+	    == __atomic_load_n (&m_nHead, __ATOMIC_ACQUIRE);
+}
@@ -18,6 +18,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/synchronize.h>
+#include <circle/softirq.h>
 #include <circle/sysconfig.h>
 #include <assert.h>
 
@@ -38,6 +39,12 @@ unsigned CurrentExecutionLevel (void)
 		return IRQ_LEVEL;
 	}
 
+	// deferred interrupt handlers run with IRQs enabled
+	if (CSoftIRQ::IsRunning ())
+	{
+		return IRQ_LEVEL;
+	}
+
 	return TASK_LEVEL;
 }
 
@@ -0,0 +1,106 @@
+//
+// ticketspinlock.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/ticketspinlock.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+#include <circle/spinlock.h>
+#include <assert.h>
+
+CTicketSpinLock::CTicketSpinLock (unsigned nTargetLevel, const char *pName)
+:	m_nTargetLevel (nTargetLevel),
+	m_nNextTicket (0),
+	m_nOwner (0)
+#ifdef LOCK_STATISTICS
+	, m_Statistics (pName)
+#endif
+{
+	assert (nTargetLevel <= FIQ_LEVEL);
+}
+
+CTicketSpinLock::~CTicketSpinLock (void)
+{
+	assert (m_nOwner == m_nNextTicket);
+}
+
+void CTicketSpinLock::Acquire (void)
+{
+	if (m_nTargetLevel >= IRQ_LEVEL)
+	{
+		EnterCritical (m_nTargetLevel);
+	}
+
+	if (!CSpinLock::IsEnabled ())
+	{
+		// only one core is running and exclusive accesses may not work yet,
+		// but the tickets have to be counted, because the lock may be released,
+		// after spin locks have been enabled
+		m_nNextTicket++;
+
+		return;
+	}
+
+#ifdef LOCK_STATISTICS
+	u64 ullWaitStart = CLockStatistics::GetTimestamp ();
+#endif
+
+	u32 nTicket = __atomic_fetch_add (&m_nNextTicket, 1, __ATOMIC_RELAXED);
+
+	u32 nOwner = __atomic_load_n (&m_nOwner, __ATOMIC_ACQUIRE);
+#ifdef LOCK_STATISTICS
+	boolean bContended = nOwner != nTicket;
+#endif
+	while (nOwner != nTicket)
+	{
+		// woken by SEV in Release(), an event in between is remembered
+		WaitForEvent ();
+
+		nOwner = __atomic_load_n (&m_nOwner, __ATOMIC_ACQUIRE);
+	}
+
+#ifdef LOCK_STATISTICS
+	m_Statistics.Acquired (ullWaitStart, bContended);
+#endif
+}
+
+void CTicketSpinLock::Release (void)
+{
+	assert (m_nOwner != m_nNextTicket);
+
+#ifdef LOCK_STATISTICS
+	if (CSpinLock::IsEnabled ())
+	{
+		m_Statistics.Released ();
+	}
+#endif
+
+	// only the owner writes m_nOwner
+	__atomic_store_n (&m_nOwner, m_nOwner + 1, __ATOMIC_RELEASE);
+
+	DataSyncBarrier ();
+	SendEvent ();
+
+	if (m_nTargetLevel >= IRQ_LEVEL)
+	{
+		LeaveCritical ();
+	}
+}
+
+#endif
@@ -24,13 +24,27 @@
 #include <circle/synchronize.h>
 #include <circle/logger.h>
 #include <circle/debug.h>
+#ifdef ARM_ALLOW_MULTI_CORE
+#include <circle/multicore.h>
+#endif
 #include <assert.h>
 
 #if RASPPI >= 4 && !defined (USE_PHYSICAL_COUNTER)
 	#error USE_PHYSICAL_COUNTER is required on Raspberry Pi 4!
 #endif
 
-struct TKernelTimer
+#if defined (USE_TICKLESS_TIMER) && !defined (USE_PHYSICAL_COUNTER)
+	#error USE_TICKLESS_TIMER requires USE_PHYSICAL_COUNTER!
+#endif
+
+enum TKernelTimerState
+{
+	KernelTimerFree,
+	KernelTimerArmed,		// in the wheel or in the near list
+	KernelTimerRunning		// handler is called
+};
+
+struct TKernelTimer : TKernelTimerLink
 {
 #ifndef NDEBUG
 	unsigned	     m_nMagic;
@@ -40,8 +54,110 @@ struct TKernelTimer
 	unsigned	     m_nElapsesAt;
 	void 		    *m_pParam;
 	void 		    *m_pContext;
+
+	TKernelTimerState    m_State;
+	unsigned	     m_nIndex;		// in the pool
+	unsigned	     m_nSequence;	// incremented on each allocation
+	TKernelTimerHandle   m_hTimer;		// current handle or 0 if free
+
+#ifdef USE_PHYSICAL_COUNTER
+	boolean		     m_bHighRes;
+	u64		     m_ullDeadline;	// counter value
+#endif
 };
 
+// A handle consists of the index of the timer node in the pool and a sequence number,
+// so that a stale handle of an elapsed timer does not match, when the node is reused.
+#define KERNEL_TIMER_INDEX_BITS		16
+#define KERNEL_TIMER_INDEX_MASK		((1 << KERNEL_TIMER_INDEX_BITS)-1)
+#define KERNEL_TIMER_SEQUENCE_MASK	0xFFFF
+
+#if KERNEL_TIMER_BLOCK_SIZE * KERNEL_TIMER_MAX_BLOCKS > (1 << KERNEL_TIMER_INDEX_BITS)
+	#error KERNEL_TIMER_MAX_BLOCKS is too big
+#endif
+
+// intrusive list operations, the list anchor is a node of a circular list
+
+static inline void ListInit (TKernelTimerLink *pList)
+{
+	pList->pNext = pList;
+	pList->pPrev = pList;
+}
+
+static inline boolean ListIsEmpty (const TKernelTimerLink *pList)
+{
+	return pList->pNext == pList;
+}
+
+static inline void ListAppend (TKernelTimerLink *pList, TKernelTimerLink *pLink)
+{
+	pLink->pNext = pList;
+	pLink->pPrev = pList->pPrev;
+	pList->pPrev->pNext = pLink;
+	pList->pPrev = pLink;
+}
+
+static inline void ListInsertBefore (TKernelTimerLink *pBefore, TKernelTimerLink *pLink)
+{
+	ListAppend (pBefore, pLink);
+}
+
+static inline void ListRemove (TKernelTimerLink *pLink)
+{
+	pLink->pPrev->pNext = pLink->pNext;
+	pLink->pNext->pPrev = pLink->pPrev;
+	pLink->pNext = pLink;
+	pLink->pPrev = pLink;
+}
+
+static inline void ListMove (TKernelTimerLink *pTo, TKernelTimerLink *pFrom)
+{
+	if (ListIsEmpty (pFrom))
+	{
+		ListInit (pTo);
+
+		return;
+	}
+
+	pTo->pNext = pFrom->pNext;
+	pTo->pPrev = pFrom->pPrev;
+	pTo->pNext->pPrev = pTo;
+	pTo->pPrev->pNext = pTo;
+
+	ListInit (pFrom);
+}
+
+#ifdef USE_PHYSICAL_COUNTER
+
+static inline u64 ReadCounter (void)
+{
+	InstructionSyncBarrier ();
+
+#if AARCH == 32
+	u32 nCNTPCTLow, nCNTPCTHigh;
+	asm volatile ("mrrc p15, 0, %0, %1, c14" : "=r" (nCNTPCTLow), "=r" (nCNTPCTHigh));
+
+	return (u64) nCNTPCTHigh << 32 | nCNTPCTLow;
+#else
+	u64 nCNTPCT;
+	asm volatile ("mrs %0, CNTPCT_EL0" : "=r" (nCNTPCT));
+
+	return nCNTPCT;
+#endif
+}
+
+static inline void WriteCompare (u64 nCNTP_CVAL)
+{
+#if AARCH == 32
+	asm volatile ("mcrr p15, 2, %0, %1, c14" :: "r" (nCNTP_CVAL & 0xFFFFFFFFU),
+						    "r" (nCNTP_CVAL >> 32));
+#else
+	asm volatile ("msr CNTP_CVAL_EL0, %0" :: "r" (nCNTP_CVAL));
+#endif
+}
+
+#endif
+
 static const char FromTimer[] = "timer";
 
 const unsigned CTimer::s_nDaysOfMonth[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
@@ -52,10 +168,24 @@ CTimer *CTimer::s_pThis = 0;
 
 CTimer::CTimer (CInterruptSystem *pInterruptSystem)
 :	m_pInterruptSystem (pInterruptSystem),
+#ifndef USE_TICKLESS_TIMER
 	m_nTicks (0),
 	m_nUptime (0),
 	m_nTime (0),
+#else
+	m_nClockTicksPerHZTick (0),
+	m_ullNextTickCompare (0),
+	m_ullTickBase (0),
+	m_nTime (0),
+	m_nPeriodicTicks (0),
+#endif
+	m_nInterrupts (0),
+	m_TimeSpinLock (IRQ_LEVEL, "timer-time"),
 	m_nMinutesDiff (0),
+	m_nWheelTicks (0),
+	m_nTimerBlocks (0),
+	m_pFreeTimer (0),
+	m_KernelTimerSpinLock (IRQ_LEVEL, "timer-kernel"),
 	m_nMsDelay (200000),
 	m_nusDelay (m_nMsDelay / 1000),
 	m_pUpdateTimeHandler (0),
@@ -63,6 +193,23 @@ CTimer::CTimer (CInterruptSystem *pInterruptSystem)
 {
 	assert (s_pThis == 0);
 	s_pThis = this;
+
+	for (unsigned i = 0; i < TIMER_WHEEL_ROOT_SIZE; i++)
+	{
+		ListInit (&m_WheelRoot[i]);
+	}
+
+	for (unsigned nLevel = 0; nLevel < TIMER_WHEEL_LEVELS; nLevel++)
+	{
+		for (unsigned i = 0; i < TIMER_WHEEL_LEVEL_SIZE; i++)
+		{
+			ListInit (&m_Wheel[nLevel][i]);
+		}
+	}
+
+#ifdef USE_PHYSICAL_COUNTER
+	ListInit (&m_NearList);
+#endif
 }
 
 CTimer::~CTimer (void)
@@ -78,25 +225,37 @@ CTimer::~CTimer (void)
 #endif
 
 	m_pInterruptSystem->DisconnectIRQ (ARM_IRQLOCAL0_CNTPNS);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	CMultiCoreSupport::DisconnectIPI (IPI_TIMER);
+#endif
 #endif
 
-	TPtrListElement *pElement;
-	while ((pElement = m_KernelTimerList.GetFirst ()) != 0)
+	for (unsigned i = 0; i < m_nTimerBlocks; i++)
 	{
-		TKernelTimer *pTimer = (TKernelTimer *) m_KernelTimerList.GetPtr (pElement);
-		assert (pTimer != 0);
-		assert (pTimer->m_nMagic == KERNEL_TIMER_MAGIC);
-
-		m_KernelTimerList.Remove (pElement);
-
-		delete pTimer;
+		delete [] m_pTimerBlock[i];
+		m_pTimerBlock[i] = 0;
 	}
 
+	m_pFreeTimer = 0;
+
 	s_pThis = 0;
 }
 
 boolean CTimer::Initialize (void)
 {
+	// preallocate the first block of timer nodes
+	m_KernelTimerSpinLock.Acquire ();
+
+	boolean bOK = AddTimerBlock ();
+
+	m_KernelTimerSpinLock.Release ();
+
+	if (!bOK)
+	{
+		return FALSE;
+	}
+
 	assert (m_pInterruptSystem != 0);
 #ifndef USE_PHYSICAL_COUNTER
 	m_pInterruptSystem->ConnectIRQ (ARM_IRQ_TIMER3, InterruptHandler, this);
@@ -109,28 +268,34 @@ boolean CTimer::Initialize (void)
 #else
 	m_pInterruptSystem->ConnectIRQ (ARM_IRQLOCAL0_CNTPNS, InterruptHandler, this);
 
-#if AARCH == 32
-	u32 nCNTPCTLow, nCNTPCTHigh;
-	asm volatile ("mrrc p15, 0, %0, %1, c14" : "=r" (nCNTPCTLow), "=r" (nCNTPCTHigh));
-
-	u64 nCNTP_CVAL = ((u64) nCNTPCTHigh << 32 | nCNTPCTLow) + CLOCKHZ / HZ;
-	asm volatile ("mcrr p15, 2, %0, %1, c14" :: "r" (nCNTP_CVAL & 0xFFFFFFFFU),
-						    "r" (nCNTP_CVAL >> 32));
+#ifdef ARM_ALLOW_MULTI_CORE
+	CMultiCoreSupport::ConnectIPI (IPI_TIMER, TimerIPIHandler, this);
+#endif
 
-	asm volatile ("mcr p15, 0, %0, c14, c2, 1" :: "r" (1));
+#if AARCH == 32
+	m_nClockTicksPerHZTick = CLOCKHZ / HZ;		// counter is prescaled to 1 MHz
 #else
 	u64 nCNTFRQ;
 	asm volatile ("mrs %0, CNTFRQ_EL0" : "=r" (nCNTFRQ));
 	assert (nCNTFRQ % HZ == 0);
 	m_nClockTicksPerHZTick = nCNTFRQ / HZ;
+#endif
 
-	u64 nCNTPCT;
-	asm volatile ("mrs %0, CNTPCT_EL0" : "=r" (nCNTPCT));
-	asm volatile ("msr CNTP_CVAL_EL0, %0" :: "r" (nCNTPCT + m_nClockTicksPerHZTick));
+#ifndef USE_TICKLESS_TIMER
+	m_ullNextTickCompare = ReadCounter () + m_nClockTicksPerHZTick;
+#else
+	m_ullTickBase = ReadCounter ();
+	m_ullNextTickCompare = GetNextTickCompare ();
+#endif
+	WriteCompare (m_ullNextTickCompare);
 
+#if AARCH == 32
+	asm volatile ("mcr p15, 0, %0, c14, c2, 1" :: "r" (1));
+#else
 	asm volatile ("msr CNTP_CTL_EL0, %0" :: "r" (1UL));
 #endif
 #endif
+
 	
 #ifdef CALIBRATE_DELAY
 	TuneMsDelay ();
@@ -201,7 +366,11 @@ boolean CTimer::SetTime (unsigned nTime, boolean bLocal)
 
 	m_TimeSpinLock.Acquire ();
 
+#ifndef USE_TICKLESS_TIMER
 	m_nTime = nTime;
+#else
+	m_nTime = nTime - GetUptime ();
+#endif
 
 	m_TimeSpinLock.Release ();
 
@@ -241,27 +410,35 @@ unsigned CTimer::GetClockTicks (void)
 
 unsigned CTimer::GetTicks (void) const
 {
+#ifndef USE_TICKLESS_TIMER
 	return m_nTicks;
+#else
+	return (unsigned) GetTicks64 ();
+#endif
 }
 
 unsigned CTimer::GetUptime (void) const
 {
+#ifndef USE_TICKLESS_TIMER
 	return m_nUptime;
+#else
+	return (unsigned) (GetTicks64 () / HZ);
+#endif
 }
 
 unsigned CTimer::GetTime (void) const
 {
+#ifndef USE_TICKLESS_TIMER
 	return m_nTime;
+#else
+	return m_nTime + GetUptime ();
+#endif
 }
 
 boolean CTimer::GetLocalTime (unsigned *pSeconds, unsigned *pMicroSeconds)
 {
-	m_TimeSpinLock.Acquire ();
-
-	unsigned nTime = m_nTime;
-	unsigned nTicks = m_nTicks;
-
-	m_TimeSpinLock.Release ();
+	unsigned nTime, nTicks;
+	ReadTime (&nTime, &nTicks);
 
 	assert (pSeconds != 0);
 	*pSeconds = nTime;
@@ -274,7 +451,7 @@ boolean CTimer::GetLocalTime (unsigned *pSeconds, unsigned *pMicroSeconds)
 
 unsigned CTimer::GetUniversalTime (void) const
 {
-	unsigned nResult = m_nTime;
+	unsigned nResult = GetTime ();
 
 	int nSecondsDiff = m_nMinutesDiff * 60;
 	if (nSecondsDiff > (int) nResult)
@@ -287,12 +464,8 @@ unsigned CTimer::GetUniversalTime (void) const
 
 boolean CTimer::GetUniversalTime (unsigned *pSeconds, unsigned *pMicroSeconds)
 {
-	m_TimeSpinLock.Acquire ();
-
-	unsigned nTime = m_nTime;
-	unsigned nTicks = m_nTicks;
-
-	m_TimeSpinLock.Release ();
+	unsigned nTime, nTicks;
+	ReadTime (&nTime, &nTicks);
 
 	int nSecondsDiff = m_nMinutesDiff * 60;
 	if (nSecondsDiff > (int) nTime)
@@ -309,21 +482,49 @@ boolean CTimer::GetUniversalTime (unsigned *pSeconds, unsigned *pMicroSeconds)
 	return TRUE;
 }
 
-CString *CTimer::GetTimeString (void)
+void CTimer::ReadTime (unsigned *pTime, unsigned *pTicks)
 {
 	m_TimeSpinLock.Acquire ();
 
+#ifndef USE_TICKLESS_TIMER
 	unsigned nTime = m_nTime;
 	unsigned nTicks = m_nTicks;
+#else
+	u64 ullTicks = GetTicks64 ();
+	unsigned nTime = m_nTime + (unsigned) (ullTicks / HZ);
+	unsigned nTicks = (unsigned) ullTicks;
+#endif
 
 	m_TimeSpinLock.Release ();
 
+	assert (pTime != 0);
+	*pTime = nTime;
+
+	assert (pTicks != 0);
+	*pTicks = nTicks;
+}
+
+CString *CTimer::GetTimeString (void)
+{
+	unsigned nTime, nTicks;
+	ReadTime (&nTime, &nTicks);
+
 	if (   nTime == 0
 	    && nTicks == 0)
 	{
 		return 0;
 	}
 
+	nTicks %= HZ;
+#if (HZ != 100)
+	nTicks = nTicks * 100 / HZ;
+#endif
+
+	return GetTimeString (nTime, nTicks);
+}
+
+CString *CTimer::GetTimeString (unsigned nTime, unsigned nHundredthTime)
+{
 	unsigned nSecond = nTime % 60;
 	nTime /= 60;
 	unsigned nMinute = nTime % 60;
@@ -360,21 +561,16 @@ CString *CTimer::GetTimeString (void)
 
 	unsigned nMonthDay = nTime + 1;
 
-	nTicks %= HZ;
-#if (HZ != 100)
-	nTicks = nTicks * 100 / HZ;
-#endif
-
 	CString *pString = new CString;
 	assert (pString != 0);
 
 	if (nYear > 1975)
 	{
-		pString->Format ("%s %2u %02u:%02u:%02u.%02u", s_pMonthName[nMonth], nMonthDay, nHour, nMinute, nSecond, nTicks);
+		pString->Format ("%s %2u %02u:%02u:%02u.%02u", s_pMonthName[nMonth], nMonthDay, nHour, nMinute, nSecond, nHundredthTime);
 	}
 	else
 	{
-		pString->Format ("%02u:%02u:%02u.%02u", nHours, nMinute, nSecond, nTicks);
+		pString->Format ("%02u:%02u:%02u.%02u", nHours, nMinute, nSecond, nHundredthTime);
 	}
 
 	return pString;
@@ -385,115 +581,494 @@ TKernelTimerHandle CTimer::StartKernelTimer (unsigned nDelay,
 					     void *pParam,
 					     void *pContext)
 {
-	TKernelTimer *pTimer = new TKernelTimer;
-	assert (pTimer != 0);
+	assert (pHandler != 0);
 
-	unsigned nElapsesAt = m_nTicks + nDelay;
+	m_KernelTimerSpinLock.Acquire ();
+
+	TKernelTimer *pTimer = AllocateKernelTimer ();
+	assert (pTimer != 0);
 
-	assert (pHandler != 0);
-#ifndef NDEBUG
-	pTimer->m_nMagic     = KERNEL_TIMER_MAGIC;
-#endif
 	pTimer->m_pHandler   = pHandler;
-	pTimer->m_nElapsesAt = nElapsesAt;
+	pTimer->m_nElapsesAt = GetTicks () + nDelay;
 	pTimer->m_pParam     = pParam;
 	pTimer->m_pContext   = pContext;
+#ifdef USE_PHYSICAL_COUNTER
+	pTimer->m_bHighRes   = FALSE;
+#endif
+
+	AddToWheel (pTimer);
+
+#ifdef USE_TICKLESS_TIMER
+	RequestTick (pTimer->m_nElapsesAt);
+#endif
+
+	TKernelTimerHandle hTimer = pTimer->m_hTimer;
+
+	m_KernelTimerSpinLock.Release ();
+
+	return hTimer;
+}
+
+TKernelTimerHandle CTimer::StartHighResTimer (unsigned nDelayMicros,
+					      TKernelTimerHandler *pHandler,
+					      void *pParam,
+					      void *pContext)
+{
+#ifndef USE_PHYSICAL_COUNTER
+	unsigned nDelay = (nDelayMicros + 1000000 / HZ - 1) / (1000000 / HZ);
+
+	return StartKernelTimer (nDelay, pHandler, pParam, pContext);
+#else
+	assert (pHandler != 0);
+
+	u64 ullDelay = (u64) nDelayMicros * m_nClockTicksPerHZTick * HZ / 1000000;
 
 	m_KernelTimerSpinLock.Acquire ();
 
-	TPtrListElement *pPrevElement = 0;
-	TPtrListElement *pElement = m_KernelTimerList.GetFirst ();
-	while (pElement != 0)
-	{
-		TKernelTimer *pTimer2 = (TKernelTimer *) m_KernelTimerList.GetPtr (pElement);
-		assert (pTimer2 != 0);
-		assert (pTimer2->m_nMagic == KERNEL_TIMER_MAGIC);
+	TKernelTimer *pTimer = AllocateKernelTimer ();
+	assert (pTimer != 0);
 
-		if ((int) (pTimer2->m_nElapsesAt-nElapsesAt) > 0)
-		{
-			break;
-		}
+	pTimer->m_pHandler    = pHandler;
+	pTimer->m_pParam      = pParam;
+	pTimer->m_pContext    = pContext;
+	pTimer->m_bHighRes    = TRUE;
+	pTimer->m_ullDeadline = ReadCounter () + ullDelay;
 
-		pPrevElement = pElement;
-		pElement = m_KernelTimerList.GetNext (pElement);
-	}
+#ifndef USE_TICKLESS_TIMER
+	unsigned nTicks = m_nTicks;
+	u64 ullNextTick = m_ullNextTickCompare;
+#else
+	u64 ullTicks = GetTicks64 ();
+	unsigned nTicks = (unsigned) ullTicks;
+	u64 ullNextTick = m_ullTickBase + (ullTicks + 1) * m_nClockTicksPerHZTick;
+#endif
 
-	if (pElement != 0)
+	s64 nAfterNextTick = pTimer->m_ullDeadline - ullNextTick;
+	if (nAfterNextTick < (s64) m_nClockTicksPerHZTick)
 	{
-		m_KernelTimerList.InsertBefore (pElement, pTimer);
+		AddToNearList (pTimer);
+
+		SetCompare ();
 	}
 	else
 	{
-		m_KernelTimerList.InsertAfter (pPrevElement, pTimer);
+		// moved to the near list by the tick before the deadline
+		pTimer->m_nElapsesAt = nTicks + 1 + (unsigned) (nAfterNextTick / m_nClockTicksPerHZTick);
+
+		AddToWheel (pTimer);
+
+#ifdef USE_TICKLESS_TIMER
+		RequestTick (pTimer->m_nElapsesAt);
+#endif
 	}
 
+	TKernelTimerHandle hTimer = pTimer->m_hTimer;
+
 	m_KernelTimerSpinLock.Release ();
 
-	return (TKernelTimerHandle) pTimer;
+	return hTimer;
+#endif
 }
 
 void CTimer::CancelKernelTimer (TKernelTimerHandle hTimer)
 {
-	TKernelTimer *pTimer = (TKernelTimer *) hTimer;
-	assert (pTimer != 0);
+	assert (hTimer != 0);
 
 	m_KernelTimerSpinLock.Acquire ();
 
-	TPtrListElement *pElement = m_KernelTimerList.Find (pTimer);
-	if (pElement != 0)
+	TKernelTimer *pTimer = GetKernelTimer (hTimer);
+	if (   pTimer != 0
+	    && pTimer->m_State == KernelTimerArmed)
 	{
 		assert (pTimer->m_nMagic == KERNEL_TIMER_MAGIC);
 
-		m_KernelTimerList.Remove (pElement);
+		ListRemove (pTimer);
+
+		FreeKernelTimer (pTimer);
+	}
+
+	m_KernelTimerSpinLock.Release ();
+}
+
+TKernelTimer *CTimer::AllocateKernelTimer (void)
+{
+	if (m_pFreeTimer == 0)
+	{
+		if (!AddTimerBlock ())
+		{
+			return 0;
+		}
+	}
+
+	TKernelTimer *pTimer = m_pFreeTimer;
+	assert (pTimer != 0);
+	assert (pTimer->m_State == KernelTimerFree);
+	m_pFreeTimer = static_cast<TKernelTimer *> (pTimer->pNext);
+
+	pTimer->m_nSequence = (pTimer->m_nSequence + 1) & KERNEL_TIMER_SEQUENCE_MASK;
+	if (pTimer->m_nSequence == 0)
+	{
+		pTimer->m_nSequence = 1;		// handle cannot be 0
+	}
+
+	pTimer->m_hTimer =   (TKernelTimerHandle) pTimer->m_nSequence << KERNEL_TIMER_INDEX_BITS
+			   | pTimer->m_nIndex;
+	pTimer->m_State = KernelTimerArmed;
+#ifndef NDEBUG
+	pTimer->m_nMagic = KERNEL_TIMER_MAGIC;
+#endif
+
+	ListInit (pTimer);
+
+	return pTimer;
+}
+
+void CTimer::FreeKernelTimer (TKernelTimer *pTimer)
+{
+	assert (pTimer != 0);
+	assert (pTimer->m_State != KernelTimerFree);
+
+	pTimer->m_State = KernelTimerFree;
+	pTimer->m_hTimer = 0;
+#ifndef NDEBUG
+	pTimer->m_nMagic = 0;
+#endif
+
+	pTimer->pNext = m_pFreeTimer;
+	m_pFreeTimer = pTimer;
+}
+
+boolean CTimer::AddTimerBlock (void)
+{
+	if (m_nTimerBlocks >= KERNEL_TIMER_MAX_BLOCKS)
+	{
+		return FALSE;
+	}
+
+	TKernelTimer *pBlock = new TKernelTimer[KERNEL_TIMER_BLOCK_SIZE];
+	if (pBlock == 0)
+	{
+		return FALSE;
+	}
+
+	for (unsigned i = 0; i < KERNEL_TIMER_BLOCK_SIZE; i++)
+	{
+		TKernelTimer *pTimer = &pBlock[i];
 
 #ifndef NDEBUG
 		pTimer->m_nMagic = 0;
 #endif
-		delete pTimer;
+		pTimer->m_State = KernelTimerFree;
+		pTimer->m_nIndex = m_nTimerBlocks * KERNEL_TIMER_BLOCK_SIZE + i;
+		pTimer->m_nSequence = 0;
+		pTimer->m_hTimer = 0;
+
+		pTimer->pNext = m_pFreeTimer;
+		m_pFreeTimer = pTimer;
 	}
 
-	m_KernelTimerSpinLock.Release ();
+	m_pTimerBlock[m_nTimerBlocks++] = pBlock;
+
+	return TRUE;
+}
+
+TKernelTimer *CTimer::GetKernelTimer (TKernelTimerHandle hTimer)
+{
+	unsigned nIndex = hTimer & KERNEL_TIMER_INDEX_MASK;
+	unsigned nBlock = nIndex / KERNEL_TIMER_BLOCK_SIZE;
+	if (nBlock >= m_nTimerBlocks)
+	{
+		return 0;
+	}
+
+	TKernelTimer *pTimer = &m_pTimerBlock[nBlock][nIndex % KERNEL_TIMER_BLOCK_SIZE];
+	if (pTimer->m_hTimer != hTimer)
+	{
+		return 0;		// elapsed or cancelled before
+	}
+
+	return pTimer;
+}
+
+void CTimer::AddToWheel (TKernelTimer *pTimer)
+{
+	assert (pTimer != 0);
+
+	unsigned nElapsesAt = pTimer->m_nElapsesAt;
+	unsigned nDelta = nElapsesAt - m_nWheelTicks;
+
+	TKernelTimerLink *pSlot;
+	if ((int) nDelta < 0)
+	{
+		// already due, handle with the next tick
+		pSlot = &m_WheelRoot[m_nWheelTicks & (TIMER_WHEEL_ROOT_SIZE-1)];
+	}
+	else if (nDelta < TIMER_WHEEL_ROOT_SIZE)
+	{
+		pSlot = &m_WheelRoot[nElapsesAt & (TIMER_WHEEL_ROOT_SIZE-1)];
+	}
+	else
+	{
+		unsigned nLevel = 0;
+		unsigned nShift = TIMER_WHEEL_ROOT_BITS;
+		while (   nLevel < TIMER_WHEEL_LEVELS-1
+		       && nDelta >= 1U << (nShift + TIMER_WHEEL_LEVEL_BITS))
+		{
+			nLevel++;
+			nShift += TIMER_WHEEL_LEVEL_BITS;
+		}
+
+		pSlot = &m_Wheel[nLevel][(nElapsesAt >> nShift) & (TIMER_WHEEL_LEVEL_SIZE-1)];
+	}
+
+	ListAppend (pSlot, pTimer);
+}
+
+void CTimer::Cascade (TKernelTimerLink *pSlot)
+{
+	assert (pSlot != 0);
+
+	TKernelTimerLink List;
+	ListMove (&List, pSlot);
+
+	while (!ListIsEmpty (&List))
+	{
+		TKernelTimer *pTimer = static_cast<TKernelTimer *> (List.pNext);
+		ListRemove (pTimer);
+
+		AddToWheel (pTimer);
+	}
 }
 
 void CTimer::PollKernelTimers (void)
+{
+	unsigned nTicks = GetTicks ();
+
+	m_KernelTimerSpinLock.Acquire ();
+
+	while ((int) (nTicks - m_nWheelTicks) >= 0)
+	{
+		unsigned nIndex = m_nWheelTicks & (TIMER_WHEEL_ROOT_SIZE-1);
+		if (nIndex == 0)
+		{
+			// the root level wrapped, redistribute the next slot of the upper levels
+			unsigned nShift = TIMER_WHEEL_ROOT_BITS;
+			for (unsigned nLevel = 0; nLevel < TIMER_WHEEL_LEVELS; nLevel++)
+			{
+				unsigned nLevelIndex =
+					(m_nWheelTicks >> nShift) & (TIMER_WHEEL_LEVEL_SIZE-1);
+
+				Cascade (&m_Wheel[nLevel][nLevelIndex]);
+
+				if (nLevelIndex != 0)
+				{
+					break;
+				}
+
+				nShift += TIMER_WHEEL_LEVEL_BITS;
+			}
+		}
+
+		// timers, which are started by a handler, will be handled with the next tick
+		TKernelTimerLink Elapsed;
+		ListMove (&Elapsed, &m_WheelRoot[nIndex]);
+
+		m_nWheelTicks++;
+
+		while (!ListIsEmpty (&Elapsed))
+		{
+			TKernelTimer *pTimer = static_cast<TKernelTimer *> (Elapsed.pNext);
+			assert (pTimer->m_nMagic == KERNEL_TIMER_MAGIC);
+			assert (pTimer->m_State == KernelTimerArmed);
+
+			ListRemove (pTimer);
+
+#ifdef USE_PHYSICAL_COUNTER
+			if (pTimer->m_bHighRes)
+			{
+				AddToNearList (pTimer);
+
+				continue;
+			}
+#endif
+
+			pTimer->m_State = KernelTimerRunning;
+
+			m_KernelTimerSpinLock.Release ();
+
+			TKernelTimerHandler *pHandler = pTimer->m_pHandler;
+			assert (pHandler != 0);
+			(*pHandler) (pTimer->m_hTimer, pTimer->m_pParam, pTimer->m_pContext);
+
+			m_KernelTimerSpinLock.Acquire ();
+
+			FreeKernelTimer (pTimer);
+		}
+	}
+
+	m_KernelTimerSpinLock.Release ();
+}
+
+#ifdef USE_PHYSICAL_COUNTER
+
+void CTimer::AddToNearList (TKernelTimer *pTimer)
+{
+	assert (pTimer != 0);
+	assert (pTimer->m_bHighRes);
+
+	// the list is sorted by deadline and holds the timers of one tick period only
+	TKernelTimerLink *pLink;
+	for (pLink = m_NearList.pNext; pLink != &m_NearList; pLink = pLink->pNext)
+	{
+		TKernelTimer *pTimer2 = static_cast<TKernelTimer *> (pLink);
+		if ((s64) (pTimer2->m_ullDeadline - pTimer->m_ullDeadline) > 0)
+		{
+			break;
+		}
+	}
+
+	ListInsertBefore (pLink, pTimer);
+}
+
+void CTimer::PollHighResTimers (void)
 {
 	m_KernelTimerSpinLock.Acquire ();
 
-	TPtrListElement *pElement = m_KernelTimerList.GetFirst ();
-	while (pElement != 0)
+	while (!ListIsEmpty (&m_NearList))
 	{
-		TKernelTimer *pTimer = (TKernelTimer *) m_KernelTimerList.GetPtr (pElement);
-		assert (pTimer != 0);
+		TKernelTimer *pTimer = static_cast<TKernelTimer *> (m_NearList.pNext);
 		assert (pTimer->m_nMagic == KERNEL_TIMER_MAGIC);
+		assert (pTimer->m_State == KernelTimerArmed);
 
-		if ((int) (pTimer->m_nElapsesAt-m_nTicks) > 0)
+		if ((s64) (pTimer->m_ullDeadline - ReadCounter ()) > 0)
 		{
 			break;
 		}
 
-		TPtrListElement *pNextElement = m_KernelTimerList.GetNext (pElement);
-		m_KernelTimerList.Remove (pElement);
-		pElement = pNextElement;
+		ListRemove (pTimer);
+
+		pTimer->m_State = KernelTimerRunning;
 
 		m_KernelTimerSpinLock.Release ();
 
 		TKernelTimerHandler *pHandler = pTimer->m_pHandler;
 		assert (pHandler != 0);
-		(*pHandler) ((TKernelTimerHandle) pTimer, pTimer->m_pParam, pTimer->m_pContext);
-
-#ifndef NDEBUG
-		pTimer->m_nMagic = 0;
-#endif
-		delete pTimer;
+		(*pHandler) (pTimer->m_hTimer, pTimer->m_pParam, pTimer->m_pContext);
 
 		m_KernelTimerSpinLock.Acquire ();
+
+		FreeKernelTimer (pTimer);
 	}
 
+	SetCompare ();
+
 	m_KernelTimerSpinLock.Release ();
 }
 
+void CTimer::SetCompare (void)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	// the timer interrupt is handled on core 0 only, so its compare register must be set
+	if (CMultiCoreSupport::ThisCore () != 0)
+	{
+		CMultiCoreSupport::SendIPI (0, IPI_TIMER);
+
+		return;
+	}
+#endif
+
+	u64 ullCompare = m_ullNextTickCompare;
+
+	if (!ListIsEmpty (&m_NearList))
+	{
+		TKernelTimer *pTimer = static_cast<TKernelTimer *> (m_NearList.pNext);
+		if ((s64) (pTimer->m_ullDeadline - ullCompare) < 0)
+		{
+			ullCompare = pTimer->m_ullDeadline;
+		}
+	}
+
+	WriteCompare (ullCompare);
+}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+void CTimer::TimerIPIHandler (unsigned nIPI, void *pParam)
+{
+	CTimer *pThis = static_cast<CTimer *> (pParam);
+	assert (pThis != 0);
+
+	assert (nIPI == IPI_TIMER);
+	assert (CMultiCoreSupport::ThisCore () == 0);
+
+	pThis->m_KernelTimerSpinLock.Acquire ();
+
+	pThis->SetCompare ();
+
+	pThis->m_KernelTimerSpinLock.Release ();
+}
+
+#endif
+
+#endif
+
+#ifdef USE_TICKLESS_TIMER
+
+u64 CTimer::GetTicks64 (void) const
+{
+	if (m_nClockTicksPerHZTick == 0)
+	{
+		return 0;		// not initialized yet
+	}
+
+	return (ReadCounter () - m_ullTickBase) / m_nClockTicksPerHZTick;
+}
+
+u64 CTimer::GetTickCompare (unsigned nTick) const
+{
+	u64 ullTicks = GetTicks64 ();
+	int nDelta = (int) (nTick - (unsigned) ullTicks);
+
+	return m_ullTickBase + (ullTicks + nDelta) * m_nClockTicksPerHZTick;
+}
+
+u64 CTimer::GetNextTickCompare (void)
+{
+	unsigned nTick = m_nWheelTicks;
+
+	if (m_nPeriodicHandlers == 0)
+	{
+		// find the next used slot of the root level, but stop when the root level
+		// wraps, because the next slot of the upper levels has to be cascaded then
+		while (   (nTick & (TIMER_WHEEL_ROOT_SIZE-1)) != 0
+		       && ListIsEmpty (&m_WheelRoot[nTick & (TIMER_WHEEL_ROOT_SIZE-1)]))
+		{
+			nTick++;
+		}
+	}
+
+	return GetTickCompare (nTick);
+}
+
+void CTimer::RequestTick (unsigned nTick)
+{
+	// the timer interrupt may be programmed for a later tick
+	u64 ullCompare = GetTickCompare (nTick);
+	if ((s64) (ullCompare - m_ullNextTickCompare) < 0)
+	{
+		m_ullNextTickCompare = ullCompare;
+
+		SetCompare ();
+	}
+}
+
+#endif
+
 void CTimer::InterruptHandler (void)
 {
+	m_nInterrupts++;
+
+#ifndef USE_TICKLESS_TIMER
 #ifndef USE_PHYSICAL_COUNTER
 	PeripheralEntry ();
 
@@ -510,18 +1085,25 @@ void CTimer::InterruptHandler (void)
 
 	PeripheralExit ();
 #else
-#if AARCH == 32
-	u32 nCNTP_CVALLow, nCNTP_CVALHigh;
-	asm volatile ("mrrc p15, 2, %0, %1, c14" : "=r" (nCNTP_CVALLow), "=r" (nCNTP_CVALHigh));
+	// the compare register is set for the next tick or an earlier high-res timer
+	m_KernelTimerSpinLock.Acquire ();
 
-	u64 nCNTP_CVAL = ((u64) nCNTP_CVALHigh << 32 | nCNTP_CVALLow) + CLOCKHZ / HZ;
-	asm volatile ("mcrr p15, 2, %0, %1, c14" :: "r" (nCNTP_CVAL & 0xFFFFFFFFU),
-						    "r" (nCNTP_CVAL >> 32));
-#else
-	u64 nCNTP_CVAL;
-	asm volatile ("mrs %0, CNTP_CVAL_EL0" : "=r" (nCNTP_CVAL));
-	asm volatile ("msr CNTP_CVAL_EL0, %0" :: "r" (nCNTP_CVAL + m_nClockTicksPerHZTick));
-#endif
+	boolean bTick = (s64) (ReadCounter () - m_ullNextTickCompare) >= 0;
+	if (bTick)
+	{
+		m_ullNextTickCompare += m_nClockTicksPerHZTick;
+	}
+
+	WriteCompare (m_ullNextTickCompare);
+
+	m_KernelTimerSpinLock.Release ();
+
+	if (!bTick)
+	{
+		PollHighResTimers ();
+
+		return;
+	}
 #endif
 
 #ifndef NDEBUG
@@ -540,10 +1122,37 @@ void CTimer::InterruptHandler (void)
 
 	PollKernelTimers ();
 
+#ifdef USE_PHYSICAL_COUNTER
+	PollHighResTimers ();
+#endif
+
 	for (unsigned i = 0; i < m_nPeriodicHandlers; i++)
 	{
 		(*m_pPeriodicHandler[i]) ();
 	}
+#else
+	// the compare register is set for the next used slot of the timer wheel,
+	// an earlier high-res timer or the next tick, if there are periodic handlers
+	PollKernelTimers ();
+
+	if (m_nPeriodicTicks != m_nWheelTicks)
+	{
+		m_nPeriodicTicks = m_nWheelTicks;
+
+		for (unsigned i = 0; i < m_nPeriodicHandlers; i++)
+		{
+			(*m_pPeriodicHandler[i]) ();
+		}
+	}
+
+	m_KernelTimerSpinLock.Acquire ();
+
+	m_ullNextTickCompare = GetNextTickCompare ();
+
+	m_KernelTimerSpinLock.Release ();
+
+	PollHighResTimers ();
+#endif
 }
 
 void CTimer::InterruptHandler (void *pParam)
@@ -586,6 +1195,22 @@ void CTimer::RegisterPeriodicHandler (TPeriodicTimerHandler *pHandler)
 	DataSyncBarrier ();
 
 	m_nPeriodicHandlers++;
+
+#ifdef USE_TICKLESS_TIMER
+	m_KernelTimerSpinLock.Acquire ();
+
+	if (m_nClockTicksPerHZTick != 0)	// otherwise done in Initialize()
+	{
+		RequestTick (GetTicks () + 1);
+	}
+
+	m_KernelTimerSpinLock.Release ();
+#endif
+}
+
+unsigned CTimer::GetInterruptCount (void) const
+{
+	return m_nInterrupts;
 }
 
 void CTimer::SimpleMsDelay (unsigned nMilliSeconds)
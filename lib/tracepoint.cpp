@@ -0,0 +1,377 @@
+//
+// tracepoint.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/tracepoint.h>
+#include <circle/multicore.h>
+#include <circle/cyclecounter.h>
+#include <circle/logger.h>
+#include <circle/string.h>
+#include <circle/util.h>
+#include <circle/bcm2835.h>
+#include <circle/memio.h>
+#include <assert.h>
+
+struct TTracepointInfo
+{
+	const char *pName;
+	char	    chPhase;		// Chrome trace event type
+};
+
+static const TTracepointInfo s_Info[TracepointUser] =
+{
+	{"task switch",	'i'},
+	{"irq",		'B'},
+	{"irq",		'E'},
+	{"net rx",	'i'},
+	{"net tx",	'i'},
+	{"block read",	'i'},
+	{"block write",	'i'}
+};
+
+static const char FromTracepoints[] = "tracepoints";
+
+volatile u32 CTracepoints::s_nEnableMask = 0;
+
+CTracepoints *CTracepoints::s_pThis = 0;
+
+CTracepoints::CTracepoints (unsigned nDepth, boolean bStopIfFull)
+:	m_nDepth (nDepth),
+	m_bStopIfFull (bStopIfFull),
+	m_nStartTimestamp (0)
+{
+	assert (m_nDepth >= 2);
+	assert ((m_nDepth & (m_nDepth-1)) == 0);
+
+	for (unsigned i = 0; i < TRACEPOINT_CORES; i++)
+	{
+		m_Buffer[i].pRecord = new TTraceRecord[m_nDepth];
+		assert (m_Buffer[i].pRecord != 0);
+
+		m_Buffer[i].nIn = 0;
+		m_Buffer[i].nWriters = 0;
+		m_Buffer[i].bCycleCounter = FALSE;
+	}
+
+	assert (s_pThis == 0);
+	s_pThis = this;
+}
+
+CTracepoints::~CTracepoints (void)
+{
+	Disable ();
+
+	s_pThis = 0;
+
+	for (unsigned i = 0; i < TRACEPOINT_CORES; i++)
+	{
+		delete [] m_Buffer[i].pRecord;
+		m_Buffer[i].pRecord = 0;
+	}
+}
+
+void CTracepoints::Start (u32 nEnableMask)
+{
+	Disable ();
+
+	for (unsigned i = 0; i < TRACEPOINT_CORES; i++)
+	{
+		m_Buffer[i].nIn = 0;
+	}
+
+	m_nStartTimestamp = GetTimestamp ();
+
+	DataMemBarrier ();
+	s_nEnableMask = nEnableMask & TRACEPOINT_MASK_ALL;
+}
+
+void CTracepoints::Stop (void)
+{
+	Disable ();
+}
+
+void CTracepoints::Event (unsigned nID, u32 nParam1, u32 nParam2, u32 nParam3, u32 nParam4)
+{
+	assert (nID < TracepointUnknown);
+
+	CTracepoints *pThis = s_pThis;
+	if (pThis == 0)
+	{
+		return;
+	}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	unsigned nCore = CMultiCoreSupport::ThisCore ();
+#else
+	unsigned nCore = 0;
+#endif
+	TCoreBuffer *pBuffer = &pThis->m_Buffer[nCore];
+
+	// Disable() may have cleared the mask after IsEnabled() has been checked
+	__atomic_fetch_add (&pBuffer->nWriters, 1, __ATOMIC_SEQ_CST);
+	if (!(__atomic_load_n (&s_nEnableMask, __ATOMIC_SEQ_CST) & TRACEPOINT_MASK (nID)))
+	{
+		__atomic_fetch_sub (&pBuffer->nWriters, 1, __ATOMIC_RELEASE);
+
+		return;
+	}
+
+	u64 nTimestamp = GetTimestamp ();
+
+	// an IRQ on this core may record an event in between
+	unsigned nIndex = __atomic_fetch_add (&pBuffer->nIn, 1, __ATOMIC_RELAXED);
+	if (   pThis->m_bStopIfFull
+	    && nIndex >= pThis->m_nDepth)
+	{
+		__atomic_fetch_sub (&pBuffer->nWriters, 1, __ATOMIC_RELEASE);
+
+		return;
+	}
+
+	if (!pBuffer->bCycleCounter)
+	{
+		CCycleCounter::Enable ();
+
+		pBuffer->bCycleCounter = TRUE;
+	}
+
+	TTraceRecord *pRecord = &pBuffer->pRecord[nIndex & (pThis->m_nDepth-1)];
+
+	pRecord->nTimestamp = nTimestamp;
+	pRecord->nCycles    = CCycleCounter::Read ();
+	pRecord->nID        = nID;
+	pRecord->nCore      = nCore;
+	pRecord->nParam[0]  = nParam1;
+	pRecord->nParam[1]  = nParam2;
+	pRecord->nParam[2]  = nParam3;
+	pRecord->nParam[3]  = nParam4;
+
+	__atomic_fetch_sub (&pBuffer->nWriters, 1, __ATOMIC_RELEASE);
+}
+
+void CTracepoints::Dump (void)
+{
+	Stop ();
+
+	CLogger *pLogger = CLogger::Get ();
+	assert (pLogger != 0);
+
+	u32 nFrequency = GetTimestampFrequency ();
+
+	for (unsigned nCore = 0; nCore < TRACEPOINT_CORES; nCore++)
+	{
+		unsigned nRecords = GetRecords (nCore);
+		for (unsigned i = 0; i < nRecords; i++)
+		{
+			const TTraceRecord *pRecord = GetRecord (nCore, i);
+			assert (pRecord != 0);
+
+			u64 nTicks = GetTicks (pRecord);
+			unsigned nMicros = (unsigned) (nTicks % nFrequency * 1000000 / nFrequency);
+
+			pLogger->Write (FromTracepoints, LogNotice,
+					"%u/%4u: %3u.%06u %2u %08X %08X %08X %08X",
+					nCore, i + 1, (unsigned) (nTicks / nFrequency), nMicros,
+					pRecord->nID, pRecord->nParam[0], pRecord->nParam[1],
+					pRecord->nParam[2], pRecord->nParam[3]);
+		}
+	}
+
+	unsigned nLost = GetLost ();
+	if (nLost > 0)
+	{
+		pLogger->Write (FromTracepoints, LogWarning, "%u events lost", nLost);
+	}
+}
+
+boolean CTracepoints::ExportChromeTrace (CDevice *pDevice)
+{
+	assert (pDevice != 0);
+
+	Stop ();
+
+	if (!WriteString (pDevice, "{\"traceEvents\":[\n"))
+	{
+		return FALSE;
+	}
+
+	u32 nFrequency = GetTimestampFrequency ();
+
+	CString Line;
+	for (unsigned nCore = 0; nCore < TRACEPOINT_CORES; nCore++)
+	{
+		Line.Format ("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,"
+			     "\"args\":{\"name\":\"core %u\"}}", nCore, nCore);
+		if (!WriteString (pDevice, Line))
+		{
+			return FALSE;
+		}
+
+		unsigned nRecords = GetRecords (nCore);
+		for (unsigned i = 0; i < nRecords; i++)
+		{
+			const TTraceRecord *pRecord = GetRecord (nCore, i);
+			assert (pRecord != 0);
+
+			CString Name;
+			char chPhase = 'i';
+			if (pRecord->nID < TracepointUser)
+			{
+				Name = s_Info[pRecord->nID].pName;
+				chPhase = s_Info[pRecord->nID].chPhase;
+			}
+			else
+			{
+				Name.Format ("user %u", pRecord->nID - TracepointUser);
+			}
+
+			// microseconds with nanoseconds fraction
+			u64 nTicks = GetTicks (pRecord);
+			u64 nNanos = nTicks % nFrequency * 1000000000 / nFrequency;
+			u64 nMicros = nTicks / nFrequency * 1000000 + nNanos / 1000;
+
+			Line.Format (",\n{\"name\":\"%s\",\"ph\":\"%c\",%s\"ts\":%llu.%03u,"
+				     "\"pid\":0,\"tid\":%u,\"args\":{\"cycles\":%u,"
+				     "\"p1\":%u,\"p2\":%u,\"p3\":%u,\"p4\":%u}}",
+				     (const char *) Name, chPhase, chPhase == 'i' ? "\"s\":\"t\"," : "",
+				     nMicros, (unsigned) (nNanos % 1000), nCore, pRecord->nCycles,
+				     pRecord->nParam[0], pRecord->nParam[1],
+				     pRecord->nParam[2], pRecord->nParam[3]);
+			if (!WriteString (pDevice, Line))
+			{
+				return FALSE;
+			}
+		}
+
+		if (   nCore < TRACEPOINT_CORES-1
+		    && !WriteString (pDevice, ",\n"))
+		{
+			return FALSE;
+		}
+	}
+
+	return WriteString (pDevice, "\n]}\n");
+}
+
+unsigned CTracepoints::GetLost (void) const
+{
+	unsigned nLost = 0;
+	for (unsigned i = 0; i < TRACEPOINT_CORES; i++)
+	{
+		if (m_Buffer[i].nIn > m_nDepth)
+		{
+			nLost += m_Buffer[i].nIn - m_nDepth;
+		}
+	}
+
+	return nLost;
+}
+
+u64 CTracepoints::GetTimestamp (void)
+{
+#if RASPPI == 1
+	return read32 (ARM_SYSTIMER_CLO);
+#elif AARCH == 32
+	u32 nCNTPCTLow, nCNTPCTHigh;
+	asm volatile ("mrrc p15, 0, %0, %1, c14" : "=r" (nCNTPCTLow), "=r" (nCNTPCTHigh));
+
+	return (u64) nCNTPCTHigh << 32 | nCNTPCTLow;
+#else
+	u64 nCNTPCT;
+	asm volatile ("mrs %0, CNTPCT_EL0" : "=r" (nCNTPCT));
+
+	return nCNTPCT;
+#endif
+}
+
+u32 CTracepoints::GetTimestampFrequency (void)
+{
+#if RASPPI == 1
+	return 1000000;
+#elif AARCH == 32
+	u32 nCNTFRQ;
+	asm volatile ("mrc p15, 0, %0, c14, c0, 0" : "=r" (nCNTFRQ));
+
+	return nCNTFRQ;
+#else
+	u64 nCNTFRQ;
+	asm volatile ("mrs %0, CNTFRQ_EL0" : "=r" (nCNTFRQ));
+
+	return (u32) nCNTFRQ;
+#endif
+}
+
+CTracepoints *CTracepoints::Get (void)
+{
+	return s_pThis;
+}
+
+unsigned CTracepoints::GetRecords (unsigned nCore) const
+{
+	assert (nCore < TRACEPOINT_CORES);
+	unsigned nIn = m_Buffer[nCore].nIn;
+
+	return nIn < m_nDepth ? nIn : m_nDepth;
+}
+
+const TTraceRecord *CTracepoints::GetRecord (unsigned nCore, unsigned nIndex) const
+{
+	assert (nCore < TRACEPOINT_CORES);
+	assert (nIndex < GetRecords (nCore));
+
+	// the oldest record is overwritten in a full ring buffer
+	unsigned nIn = m_Buffer[nCore].nIn;
+	unsigned nFirst = nIn > m_nDepth && !m_bStopIfFull ? nIn - m_nDepth : 0;
+
+	return &m_Buffer[nCore].pRecord[(nFirst + nIndex) & (m_nDepth-1)];
+}
+
+u64 CTracepoints::GetTicks (const TTraceRecord *pRecord) const
+{
+	assert (pRecord != 0);
+
+#if RASPPI == 1
+	return (u32) (pRecord->nTimestamp - m_nStartTimestamp);	// system timer wraps
+#else
+	return pRecord->nTimestamp - m_nStartTimestamp;
+#endif
+}
+
+void CTracepoints::Disable (void)
+{
+	__atomic_store_n (&s_nEnableMask, 0, __ATOMIC_SEQ_CST);
+
+	// let events finish, which are currently recorded on any core
+	for (unsigned i = 0; i < TRACEPOINT_CORES; i++)
+	{
+		while (__atomic_load_n (&m_Buffer[i].nWriters, __ATOMIC_ACQUIRE) != 0)
+		{
+			// just wait
+		}
+	}
+}
+
+boolean CTracepoints::WriteString (CDevice *pDevice, const char *pString)
+{
+	assert (pDevice != 0);
+	assert (pString != 0);
+
+	size_t nLength = strlen (pString);
+
+	return pDevice->Write (pString, nLength) == (int) nLength;
+}
@@ -130,6 +130,7 @@ CUSBAudioStreamingDevice::CUSBAudioStreamingDevice (CUSBFunction *pFunction)
 	m_nPacketsPerChunk (0),
 	m_bSyncEPActive (FALSE),
 	m_nSyncAccu (0),
+	m_nFeedbackRate (0),
 	m_uchClockSourceID (USB_AUDIO_UNDEFINED_UNIT_ID),
 	m_uchSelectorUnitID (USB_AUDIO_UNDEFINED_UNIT_ID),
 	From ("uaudio")
@@ -623,6 +624,11 @@ unsigned CUSBAudioStreamingDevice::GetChunkSizeBytes (void) const
 	return m_nChunkSizeBytes;
 }
 
+unsigned CUSBAudioStreamingDevice::GetFeedbackRate (void) const
+{
+	return m_nFeedbackRate;
+}
+
 boolean CUSBAudioStreamingDevice::SendChunk (const void *pBuffer, unsigned nChunkSizeBytes,
 					     TCompletionRoutine *pCompletionRoutine, void *pParam)
 {
@@ -940,6 +946,10 @@ void CUSBAudioStreamingDevice::SyncCompletionHandler (CUSBRequest *pURB, void *p
 			pThis->m_nChunkSizeBytes =   (pThis->m_nSyncAccu >> 14)
 						   * CHANNELS * SUBFRAME_SIZE;
 			pThis->m_nSyncAccu &= 0x3FFF;
+
+			// frames per 1 ms frame
+			pThis->m_nFeedbackRate = (unsigned) (  (u64) (pThis->m_SyncEPBuffer[0] & 0xFFFFFF)
+							     * 1000000 >> 14);
 		}
 		else
 		{
@@ -948,6 +958,15 @@ void CUSBAudioStreamingDevice::SyncCompletionHandler (CUSBRequest *pURB, void *p
 			pThis->m_nChunkSizeBytes =   (pThis->m_nSyncAccu >> 16)
 						   * CHANNELS * SUBFRAME_SIZE;
 			pThis->m_nSyncAccu &= 0xFFFF;
+
+			// frames per 125 us micro-frame, some devices report per 1 ms frame
+			u64 ullRate = (u64) pThis->m_SyncEPBuffer[0] * 8000000 >> 16;
+			if (ullRate > (u64) pThis->m_nSampleRate * 1000 * 4)
+			{
+				ullRate /= 8;
+			}
+
+			pThis->m_nFeedbackRate = (unsigned) ullRate;
 		}
 	}
 
@@ -26,6 +26,7 @@
 #include <circle/synchronize.h>
 #include <circle/macros.h>
 #include <circle/new.h>
+#include <circle/tracepoint.h>
 #include <assert.h>
 
 #define MAX_TRIES	8				// max. read / write attempts
@@ -509,6 +510,8 @@ int CUSBBulkOnlyMassStorageDevice::TryRead (void *pBuffer, size_t nCount)
 	}
 	u16 usTransferLength = (u16) (nCount >> UMSD_BLOCK_SHIFT);
 
+	TRACEPOINT (TracepointBlockRead, (u32) (uintptr) this, nBlockAddress, nCount);
+
 	//CLogger::Get ()->Write (FromUmsd, LogDebug, "TryRead %u/0x%X/%u", nBlockAddress, (unsigned) pBuffer, (unsigned) usTransferLength);
 
 	TSCSIRead10 SCSIRead;
@@ -546,6 +549,8 @@ int CUSBBulkOnlyMassStorageDevice::TryWrite (const void *pBuffer, size_t nCount)
 	}
 	u16 usTransferLength = (u16) (nCount >> UMSD_BLOCK_SHIFT);
 
+	TRACEPOINT (TracepointBlockWrite, (u32) (uintptr) this, nBlockAddress, nCount);
+
 	//CLogger::Get ()->Write (FromUmsd, LogDebug, "TryWrite %u/0x%X/%u", nBlockAddress, (unsigned) pBuffer, (unsigned) usTransferLength);
 
 	TSCSIWrite10 SCSIWrite;
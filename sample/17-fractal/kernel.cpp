@@ -20,13 +20,16 @@
 #include "kernel.h"
 #include <circle/memory.h>
 
+#define MAX_ITERATION	5000
+
 static const char FromKernel[] = "kernel";
 
 CKernel::CKernel (void)
 :	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
 	m_Timer (&m_Interrupt),
 	m_Logger (m_Options.GetLogLevel (), &m_Timer),
-	m_Mandelbrot (&m_Screen, CMemorySystem::Get ())
+	m_Parallel (CMemorySystem::Get ()),
+	m_Mandelbrot (&m_Screen, &m_Parallel)
 {
 	m_ActLED.Blink (5);	// show we are alive
 }
@@ -72,7 +75,7 @@ boolean CKernel::Initialize (void)
 
 	if (bOK)
 	{
-		bOK = m_Mandelbrot.Initialize ();	// must be initialized at last
+		bOK = m_Parallel.Initialize ();		// must be initialized at last
 	}
 
 	return bOK;
@@ -82,7 +85,33 @@ TShutdownMode CKernel::Run (void)
 {
 	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
 
-	m_Mandelbrot.Run (0);
+	// calculate the image with one core first for comparison
+	unsigned nSingleMsecs = Calculate (1);
+	unsigned nAllMsecs = Calculate (PARALLEL_CORES);
+
+	if (nAllMsecs > 0)
+	{
+		unsigned nSpeedup = nSingleMsecs * 100 / nAllMsecs;
+
+		m_Logger.Write (FromKernel, LogNotice, "Speedup with %u cores: %u.%02u",
+				PARALLEL_CORES, nSpeedup / 100, nSpeedup % 100);
+	}
 
 	return ShutdownHalt;
 }
+
+unsigned CKernel::Calculate (unsigned nCores)
+{
+	m_Parallel.SetCores (nCores);
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	m_Mandelbrot.Calculate (-2.0, 1.0, -1.0, 1.0, MAX_ITERATION);
+
+	unsigned nMsecs = (CTimer::GetClockTicks () - nStartTicks) / (CLOCKHZ / 1000);
+
+	m_Logger.Write (FromKernel, LogNotice, "Image calculated with %u core(s) in %u ms",
+			nCores, nMsecs);
+
+	return nMsecs;
+}
@@ -29,6 +29,7 @@
 #include <circle/interrupt.h>
 #include <circle/timer.h>
 #include <circle/logger.h>
+#include <circle/parallel.h>
 #include <circle/types.h>
 #include "mandelbrot.h"
 
@@ -48,7 +49,10 @@ public:
 	boolean Initialize (void);
 
 	TShutdownMode Run (void);
-	
+
+private:
+	unsigned Calculate (unsigned nCores);		// returns elapsed milliseconds
+
 private:
 	// do not change this order
 	CActLED			m_ActLED;
@@ -60,6 +64,7 @@ private:
 	CInterruptSystem	m_Interrupt;
 	CTimer			m_Timer;
 	CLogger			m_Logger;
+	CParallel		m_Parallel;
 
 	CMandelbrotCalculator	m_Mandelbrot;
 };
@@ -18,68 +18,48 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include "mandelbrot.h"
+#include <assert.h>
 
-#define MAX_ITERATION	5000
+#define ROWS_PER_GRAIN	4		// rows calculated at once by a core
 
-CMandelbrotCalculator::CMandelbrotCalculator (CScreenDevice *pScreen, CMemorySystem *pMemorySystem)
-:	
-#ifdef ARM_ALLOW_MULTI_CORE
-	CMultiCoreSupport (pMemorySystem),
-#endif
-	m_pScreen (pScreen)
+CMandelbrotCalculator::CMandelbrotCalculator (CScreenDevice *pScreen, CParallel *pParallel)
+:	m_pScreen (pScreen),
+	m_pParallel (pParallel)
 {
 }
 
 CMandelbrotCalculator::~CMandelbrotCalculator (void)
 {
 	m_pScreen = 0;
+	m_pParallel = 0;
 }
 
-void CMandelbrotCalculator::Run (unsigned nCore)
+// The rows are taken dynamically by the cores, because the rows in the middle of
+// the image need much more iterations than the others.
+void CMandelbrotCalculator::Calculate (float x1, float x2, float y1, float y2, unsigned nMaxIteration)
 {
-#ifdef ARM_ALLOW_MULTI_CORE
-	unsigned nQuarterHeight = m_pScreen->GetHeight () / 4;
-
-	switch (nCore)
-	{
-	case 0:
-		Calculate (-2.0, 1.0, -1.0, -0.5, MAX_ITERATION, 0, nQuarterHeight);
-		break;
-
-	case 1:
-		Calculate (-2.0, 1.0, -0.5, 0.0, MAX_ITERATION, nQuarterHeight, nQuarterHeight);
-		break;
+	m_x1 = x1;
+	m_y1 = y1;
+	m_dx = (x2-x1) / m_pScreen->GetWidth ();
+	m_dy = (y2-y1) / m_pScreen->GetHeight ();
+	m_nMaxIteration = nMaxIteration;
 
-	case 2:
-		Calculate (-2.0, 1.0, 0.0, 0.5, MAX_ITERATION, nQuarterHeight*2, nQuarterHeight);
-		break;
-
-	case 3:
-		Calculate (-2.0, 1.0, 0.5, 1.0, MAX_ITERATION, nQuarterHeight*3, nQuarterHeight);
-		break;
-	}
-#else
-	Calculate (-2.0, 1.0, -1.0, 1.0, MAX_ITERATION, 0, m_pScreen->GetHeight ());
-#endif
+	m_pParallel->For (0, m_pScreen->GetHeight (), CalculateRowsStub, this, ROWS_PER_GRAIN);
 }
 
 // See: http://en.wikipedia.org/wiki/Mandelbrot_set
-void CMandelbrotCalculator::Calculate (float x1, float x2, float y1, float y2, unsigned nMaxIteration,
-				       unsigned nPosY0, unsigned nHeight)
+void CMandelbrotCalculator::CalculateRows (unsigned nPosY0, unsigned nPosY1)
 {
-	float dx = (x2-x1) / m_pScreen->GetWidth ();
-	float dy = (y2-y1) / nHeight;
-
-	float y0 = y1;
-	for (unsigned nPosY = nPosY0; nPosY < nPosY0+nHeight; nPosY++, y0 += dy)
+	float y0 = m_y1 + m_dy * nPosY0;
+	for (unsigned nPosY = nPosY0; nPosY < nPosY1; nPosY++, y0 += m_dy)
 	{
-		float x0 = x1;
-		for (unsigned nPosX = 0; nPosX < m_pScreen->GetWidth (); nPosX++, x0 += dx)
+		float x0 = m_x1;
+		for (unsigned nPosX = 0; nPosX < m_pScreen->GetWidth (); nPosX++, x0 += m_dx)
 		{
 			float x = 0.0;
 			float y = 0.0;
 			unsigned nIteration = 0;
-			for (; x*x+y*y < 2*2 && nIteration < nMaxIteration; nIteration++)
+			for (; x*x+y*y < 2*2 && nIteration < m_nMaxIteration; nIteration++)
 			{
 				float xtmp = x*x - y*y + x0;
 				y = 2*x*y + y0;
@@ -87,9 +67,9 @@ void CMandelbrotCalculator::Calculate (float x1, float x2, float y1, float y2, u
 			}
 
 #if DEPTH == 8
-			TScreenColor Color = (TScreenColor) (nIteration * 15 / nMaxIteration);
+			TScreenColor Color = (TScreenColor) (nIteration * 15 / m_nMaxIteration);
 #elif DEPTH == 16
-			TScreenColor Color = (TScreenColor) (nIteration * 65535 / nMaxIteration);
+			TScreenColor Color = (TScreenColor) (nIteration * 65535 / m_nMaxIteration);
 			Color++;
 #else
 	#error DEPTH must be 8 or 16
@@ -98,3 +78,11 @@ void CMandelbrotCalculator::Calculate (float x1, float x2, float y1, float y2, u
 		}
 	}
 }
+
+void CMandelbrotCalculator::CalculateRowsStub (unsigned nBegin, unsigned nEnd, void *pParam)
+{
+	CMandelbrotCalculator *pThis = (CMandelbrotCalculator *) pParam;
+	assert (pThis != 0);
+
+	pThis->CalculateRows (nBegin, nEnd);
+}
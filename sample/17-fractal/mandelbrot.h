@@ -20,32 +20,31 @@
 #ifndef _mandelbrot_h
 #define _mandelbrot_h
 
-#include <circle/multicore.h>
+#include <circle/parallel.h>
 #include <circle/screen.h>
-#include <circle/memory.h>
 #include <circle/types.h>
 
 class CMandelbrotCalculator
-#ifdef ARM_ALLOW_MULTI_CORE
-	: public CMultiCoreSupport
-#endif
 {
 public:
-	CMandelbrotCalculator (CScreenDevice *pScreen, CMemorySystem *pMemorySystem);
+	CMandelbrotCalculator (CScreenDevice *pScreen, CParallel *pParallel);
 	~CMandelbrotCalculator (void);
 
-#ifndef ARM_ALLOW_MULTI_CORE
-	boolean Initialize (void)	{ return TRUE; }
-#endif
-
-	void Run (unsigned nCore);
+	void Calculate (float x1, float x2, float y1, float y2, unsigned nMaxIteration);
 
 private:
-	void Calculate (float x1, float x2, float y1, float y2, unsigned nMaxIteration,
-			unsigned nPosY0, unsigned nHeight);
+	void CalculateRows (unsigned nPosY0, unsigned nPosY1);
+	static void CalculateRowsStub (unsigned nBegin, unsigned nEnd, void *pParam);
 
 private:
 	CScreenDevice *m_pScreen;
+	CParallel *m_pParallel;
+
+	float m_x1;
+	float m_y1;
+	float m_dx;
+	float m_dy;
+	unsigned m_nMaxIteration;
 };
 
 #endif
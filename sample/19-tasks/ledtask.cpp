@@ -21,8 +21,10 @@
 #include <circle/sched/scheduler.h>
 
 CLEDTask::CLEDTask (CActLED *pActLED)
-:	m_pActLED (pActLED)
+:	CTask (TASK_STACK_SIZE, TRUE),
+	m_pActLED (pActLED)
 {
+	Start ();
 }
 
 CLEDTask::~CLEDTask (void)
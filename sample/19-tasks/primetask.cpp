@@ -31,8 +31,10 @@
 #define YIELD_COUNT	1000000
 
 CPrimeTask::CPrimeTask (CScreenDevice *pScreen)
-:	m_pScreen (pScreen)
+:	CTask (TASK_STACK_SIZE, TRUE),
+	m_pScreen (pScreen)
 {
+	Start ();
 }
 
 CPrimeTask::~CPrimeTask (void)
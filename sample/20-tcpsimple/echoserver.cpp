@@ -28,7 +28,8 @@ static const char FromEcho[] = "echo";
 unsigned CEchoServer::s_nInstanceCount = 0;
 
 CEchoServer::CEchoServer (CNetSubSystem *pNetSubSystem, CSocket *pSocket, const CIPAddress *pClientIP)
-:	m_pNetSubSystem (pNetSubSystem),
+:	CTask (TASK_STACK_SIZE, TRUE),
+	m_pNetSubSystem (pNetSubSystem),
 	m_pSocket (pSocket)
 {
 	s_nInstanceCount++;
@@ -37,6 +38,8 @@ CEchoServer::CEchoServer (CNetSubSystem *pNetSubSystem, CSocket *pSocket, const
 	{
 		m_ClientIP.Set (*pClientIP);
 	}
+
+	Start ();
 }
 
 CEchoServer::~CEchoServer (void)
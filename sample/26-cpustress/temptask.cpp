@@ -30,8 +30,10 @@
 static const char FromTempTask[] = "temptask";
 
 CTemperatureTask::CTemperatureTask (CScreenDevice  *pScreen)
-:	m_pScreen (pScreen)
+:	CTask (TASK_STACK_SIZE, TRUE),
+	m_pScreen (pScreen)
 {
+	Start ();
 }
 
 CTemperatureTask::~CTemperatureTask (void)
@@ -36,12 +36,15 @@ static const unsigned FileChunkSize = 8192;
 LOGMODULE ("recorder");
 
 CSoundRecorder::CSoundRecorder (FATFS *pFileSystem)
-:	m_RecordButtonPin (RECORD_BUTTON, GPIOModeInputPullUp),
+:	CTask (TASK_STACK_SIZE, TRUE),
+	m_RecordButtonPin (RECORD_BUTTON, GPIOModeInputPullUp),
 	m_nFileNumber (0),
 	m_bFileOpen (FALSE),
 	m_Queue (QueueSize)
 {
 	SetName ("recorder");
+
+	Start ();
 }
 
 CSoundRecorder::~CSoundRecorder (void)
@@ -30,6 +30,9 @@ CKernel::CKernel (void)
 :	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
 	m_Timer (&m_Interrupt),
 	m_Logger (m_Options.GetLogLevel (), &m_Timer)
+#ifdef ARM_ALLOW_MULTI_CORE
+	, m_Parallel (CMemorySystem::Get ())
+#endif
 {
 	m_ActLED.Blink (5);	// show we are alive
 }
@@ -73,6 +76,13 @@ boolean CKernel::Initialize (void)
 		bOK = m_Timer.Initialize ();
 	}
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	if (bOK)
+	{
+		bOK = m_Parallel.Initialize ();		// must be initialized at last
+	}
+#endif
+
 	return bOK;
 }
 
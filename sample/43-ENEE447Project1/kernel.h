@@ -31,6 +31,7 @@
 #include <circle/logger.h>
 #include <circle/sched/scheduler.h>
 #include <circle/sched/synchronizationevent.h>
+#include <circle/parallel.h>
 #include <circle/types.h>
 
 enum TShutdownMode
@@ -67,6 +68,10 @@ private:
 
 	CScheduler		m_Scheduler;
 	CSynchronizationEvent	m_Event;
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	CParallel		m_Parallel;		// used by CPrimeTask
+#endif
 };
 
 #endif
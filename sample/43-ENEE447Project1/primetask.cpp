@@ -22,17 +22,30 @@
 #include "primetask.h"
 
 #include <circle/sched/scheduler.h>
+#include <circle/parallel.h>
+#include <circle/timer.h>
 #include <circle/string.h>
 #include <circle/util.h>
+#include <assert.h>
 
 // The CPU is given up after each YIELD_COUNT loop cycles, so that other
 // tasks can run. Increase this value for faster prime number calculation,
 // decrease it, to give the other tasks more time to run.
 #define YIELD_COUNT	1000000
 
+// With ARM_ALLOW_MULTI_CORE the array is divided into segments, which are sieved
+// independently by all cores, using the primes up to PRIME_MAX_SQRT. The CPU is
+// given up after each SEGMENTS_PER_YIELD segments.
+#define SEGMENT_WORDS		4096
+#define SEGMENT_SIZE		(SEGMENT_WORDS * 32)	// numbers per segment
+#define SEGMENTS		((PRIME_ARRAY_SIZE + SEGMENT_WORDS-1) / SEGMENT_WORDS)
+#define SEGMENTS_PER_YIELD	(PARALLEL_CORES * 4)
+
 CPrimeTask::CPrimeTask (CScreenDevice *pScreen)
-:	m_pScreen (pScreen)
+:	CTask (TASK_STACK_SIZE, TRUE),
+	m_pScreen (pScreen)
 {
+	Start ();
 }
 
 CPrimeTask::~CPrimeTask (void)
@@ -40,6 +53,59 @@ CPrimeTask::~CPrimeTask (void)
 }
 
 void CPrimeTask::Run (void)
+{
+#ifndef ARM_ALLOW_MULTI_CORE
+	Sieve ();
+#else
+	// sieve with one core first for comparison
+	unsigned nMsecs[2];
+	for (unsigned i = 0; i < 2; i++)
+	{
+		unsigned nCores = i == 0 ? 1 : PARALLEL_CORES;
+		CParallel::Get ()->SetCores (nCores);
+
+		unsigned nStartTicks = CTimer::GetClockTicks ();
+
+		SieveParallel ();
+
+		nMsecs[i] = (CTimer::GetClockTicks () - nStartTicks) / (CLOCKHZ / 1000);
+
+		CString Message;
+		Message.Format ("Sieve with %u core(s) took %u ms.\n", nCores, nMsecs[i]);
+
+		m_pScreen->Write (Message, Message.GetLength ());
+	}
+
+	if (nMsecs[1] > 0)
+	{
+		unsigned nSpeedup = nMsecs[0] * 100 / nMsecs[1];
+
+		CString Message;
+		Message.Format ("Speedup with %u cores is %u.%02u.\n",
+				PARALLEL_CORES, nSpeedup / 100, nSpeedup % 100);
+
+		m_pScreen->Write (Message, Message.GetLength ());
+	}
+#endif
+
+	// display largest prime on screen
+	for (unsigned i = PRIME_MAX-1; i >= 2; i--)
+	{
+		if (IsPrime (i))
+		{
+			CString Message;
+			Message.Format ("Largest calculated prime number is %u.\n", i);
+
+			m_pScreen->Write (Message, Message.GetLength ());
+
+			break;
+		}
+	}
+
+	// task will terminate automatically
+}
+
+void CPrimeTask::Sieve (void)
 {
 	// Sieve of Eratosthenes
 	memset (m_PrimeArray, 0xFF, sizeof m_PrimeArray);	// set all bits
@@ -65,24 +131,89 @@ void CPrimeTask::Run (void)
 			CScheduler::Get ()->Yield ();		// give up CPU
 		}
 	}
+}
 
-	// display largest prime on screen
-	for (unsigned i = PRIME_MAX-1; i >= 2; i--)
+#ifdef ARM_ALLOW_MULTI_CORE
+
+void CPrimeTask::SieveParallel (void)
+{
+	memset (m_PrimeArray, 0xFF, sizeof m_PrimeArray);	// set all bits
+
+	// the primes up to PRIME_MAX_SQRT are found by trial division
+	m_nBasePrimes = 0;
+	for (unsigned i = 2; i <= PRIME_MAX_SQRT; i++)
 	{
-		if (IsPrime (i))
+		unsigned j;
+		for (j = 0; j < m_nBasePrimes && m_BasePrime[j] * m_BasePrime[j] <= i; j++)
 		{
-			CString Message;
-			Message.Format ("Largest calculated prime number is %u.\n", i);
+			if (i % m_BasePrime[j] == 0)
+			{
+				break;
+			}
+		}
 
-			m_pScreen->Write (Message, Message.GetLength ());
+		if (   j == m_nBasePrimes
+		    || m_BasePrime[j] * m_BasePrime[j] > i)
+		{
+			assert (m_nBasePrimes < PRIME_BASE_MAX);
+			m_BasePrime[m_nBasePrimes++] = i;
+		}
+	}
 
-			break;
+	for (unsigned i = 0; i < SEGMENTS; i += SEGMENTS_PER_YIELD)
+	{
+		unsigned nEnd = i + SEGMENTS_PER_YIELD;
+		if (nEnd > SEGMENTS)
+		{
+			nEnd = SEGMENTS;
 		}
+
+		CParallel::Get ()->For (i, nEnd, SieveSegmentsStub, this, 1);
+
+		CScheduler::Get ()->Yield ();		// give up CPU
 	}
+}
 
-	// task will terminate automatically
+void CPrimeTask::SieveSegment (unsigned nSegment)
+{
+	unsigned nFrom = nSegment * SEGMENT_SIZE;
+	unsigned nTo = nFrom + SEGMENT_SIZE;
+	if (nTo > PRIME_MAX)
+	{
+		nTo = PRIME_MAX;
+	}
+
+	// the segments do not share words of m_PrimeArray
+	for (unsigned i = 0; i < m_nBasePrimes; i++)
+	{
+		unsigned nPrime = m_BasePrime[i];
+
+		unsigned j = nPrime * nPrime;
+		if (j < nFrom)
+		{
+			j = (nFrom + nPrime-1) / nPrime * nPrime;
+		}
+
+		for (; j < nTo; j += nPrime)
+		{
+			NotPrime (j);
+		}
+	}
 }
 
+void CPrimeTask::SieveSegmentsStub (unsigned nBegin, unsigned nEnd, void *pParam)
+{
+	CPrimeTask *pThis = (CPrimeTask *) pParam;
+	assert (pThis != 0);
+
+	for (unsigned i = nBegin; i < nEnd; i++)
+	{
+		pThis->SieveSegment (i);
+	}
+}
+
+#endif
+
 boolean CPrimeTask::IsPrime (unsigned nNumber)
 {
 	return m_PrimeArray[nNumber / 32] & (1 << (nNumber % 32)) ? TRUE : FALSE;
@@ -22,6 +22,7 @@
 
 #include <circle/sched/task.h>
 #include <circle/screen.h>
+#include <circle/sysconfig.h>
 #include <circle/types.h>
 
 #define PRIME_MAX		100000000		// upper bound of calculation
@@ -38,6 +39,14 @@ public:
 	void Run (void);
 
 private:
+	void Sieve (void);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	void SieveParallel (void);
+	void SieveSegment (unsigned nSegment);
+	static void SieveSegmentsStub (unsigned nBegin, unsigned nEnd, void *pParam);
+#endif
+
 	boolean IsPrime (unsigned nNumber);
 
 	void NotPrime (unsigned nNumber);
@@ -45,6 +54,12 @@ private:
 private:
 	CScreenDevice  *m_pScreen;
 	u32		m_PrimeArray[PRIME_ARRAY_SIZE];
+
+#ifdef ARM_ALLOW_MULTI_CORE
+#define PRIME_BASE_MAX		1229			// number of primes up to PRIME_MAX_SQRT
+	unsigned	m_BasePrime[PRIME_BASE_MAX];
+	unsigned	m_nBasePrimes;
+#endif
 };
 
 #endif
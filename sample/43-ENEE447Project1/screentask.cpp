@@ -22,9 +22,11 @@
 #include <circle/string.h>
 
 CScreenTask::CScreenTask (unsigned nTaskID, CScreenDevice *pScreen)
-:	m_nTaskID (nTaskID),
+:	CTask (TASK_STACK_SIZE, TRUE),
+	m_nTaskID (nTaskID),
 	m_pScreen (pScreen)
 {
+	Start ();
 }
 
 CScreenTask::~CScreenTask (void)
@@ -0,0 +1,149 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/sched/logdraintask.h>
+#include <assert.h>
+
+#define SYNC_CALLS		100
+#define ASYNC_CALLS		1000
+#define RECORDS_PER_CORE	1024		// must hold ASYNC_CALLS
+#define RATE_LIMIT		10		// messages per second
+#define RATE_CALLS		100
+
+LOGMODULE ("kernel");
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	LOGNOTE ("Compile time: " __DATE__ " " __TIME__);
+
+	// synchronous logging: formatting and output at the call site
+	unsigned nSyncNanos = MeasureLogCalls (SYNC_CALLS);
+
+	// asynchronous logging: only the arguments are captured at the call site
+	if (!m_Logger.EnableAsync (RECORDS_PER_CORE))
+	{
+		LOGPANIC ("Cannot enable asynchronous logging");
+	}
+
+	unsigned nAsyncNanos = MeasureLogCalls (ASYNC_CALLS);
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	unsigned nFlushed = m_Logger.Flush ();
+	unsigned nFlushTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	LOGNOTE ("Synchronous:  %u ns per call", nSyncNanos);
+	LOGNOTE ("Asynchronous: %u ns per call", nAsyncNanos);
+	LOGNOTE ("Flush: %u messages in %u us", nFlushed, nFlushTicks);
+
+	// the rate limit suppresses the messages above RATE_LIMIT per second
+	m_Logger.SetRateLimit (RATE_LIMIT);
+
+	for (unsigned i = 0; i < RATE_CALLS; i++)
+	{
+		LOGDBG ("Flooding message %u", i);
+	}
+
+	m_Logger.SetRateLimit (0);
+
+	// from now on the messages are written by the drain task
+	CLogDrainTask *pDrainTask = new CLogDrainTask (&m_Logger);
+	assert (pDrainTask != 0);
+
+	for (unsigned i = 1; i <= 5; i++)
+	{
+		LOGNOTE ("Written by the drain task (%u/5)", i);
+
+		m_Scheduler.MsSleep (200);
+	}
+
+	LOGNOTE ("%u messages dropped", m_Logger.GetDropped ());
+
+	pDrainTask->Stop ();
+
+	m_Scheduler.Sleep (1);
+
+	return ShutdownHalt;
+}
+
+unsigned CKernel::MeasureLogCalls (unsigned nCalls)
+{
+	static const char Name[] = "sample";
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	for (unsigned i = 0; i < nCalls; i++)
+	{
+		LOGDBG ("Call %u of %u, value %d, name %s", i+1, nCalls, -(int) i, Name);
+	}
+
+	unsigned nTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	return (u64) nTicks * 1000 / nCalls;
+}
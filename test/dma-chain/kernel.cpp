@@ -0,0 +1,235 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/util.h>
+#include <assert.h>
+
+#define MAX_SIZE		0x100000
+#define CHUNK_SIZE		4096		// scatter-gather granularity
+#define POOL_SIZE		(MAX_SIZE / CHUNK_SIZE + 16)
+#define BURST_LENGTH		2
+#define BYTES_PER_SIZE		(16 * MAX_SIZE)	// total bytes copied per size and method
+
+static const char FromKernel[] = "kernel";
+
+static const size_t Sizes[] = {256, 1024, 4096, 16384, 65536, 262144, MAX_SIZE};
+
+static DMA_BUFFER (u8, SourceBuffer, MAX_SIZE);
+static DMA_BUFFER (u8, DestinationBuffer, MAX_SIZE);
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_DMA (DMA_CHANNEL_NORMAL),
+	m_Pool (POOL_SIZE),
+	m_Chain (&m_DMA, &m_Pool),
+	m_nErrors (0)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Logger.Initialize (&m_Screen);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	m_Logger.Write (FromKernel, LogNotice, "DMA channel %u, throughput in MByte/s",
+			m_DMA.GetChannel ());
+	m_Logger.Write (FromKernel, LogNotice, "   Size     CPU  DMA single   DMA chain  Steps");
+
+	for (unsigned i = 0; i < sizeof Sizes / sizeof Sizes[0]; i++)
+	{
+		Measure (Sizes[i]);
+	}
+
+	if (m_nErrors == 0)
+	{
+		m_Logger.Write (FromKernel, LogNotice, "Test passed");
+	}
+	else
+	{
+		m_Logger.Write (FromKernel, LogError, "Test failed with %u error(s)", m_nErrors);
+	}
+
+	return ShutdownHalt;
+}
+
+void CKernel::Measure (size_t nSize)
+{
+	assert (nSize <= MAX_SIZE);
+	unsigned nRounds = BYTES_PER_SIZE / nSize;
+
+	// CPU memcpy()
+	PrepareData (nSize, 0);
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	for (unsigned nRound = 0; nRound < nRounds; nRound++)
+	{
+		memcpy (DestinationBuffer, SourceBuffer, nSize);
+	}
+
+	unsigned nCPUTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	if (!CheckData (nSize, FALSE))
+	{
+		m_nErrors++;
+	}
+
+	// DMA with a single control block
+	PrepareData (nSize, 1);
+
+	nStartTicks = CTimer::GetClockTicks ();
+
+	for (unsigned nRound = 0; nRound < nRounds; nRound++)
+	{
+		m_DMA.SetupMemCopy (DestinationBuffer, SourceBuffer, nSize, BURST_LENGTH);
+		m_DMA.Start ();
+		if (!m_DMA.Wait ())
+		{
+			m_nErrors++;
+		}
+	}
+
+	unsigned nSingleTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	if (!CheckData (nSize, FALSE))
+	{
+		m_nErrors++;
+	}
+
+	// DMA with a chain, which copies the chunks in reverse order
+	PrepareData (nSize, 2);
+
+	if (!BuildChain (nSize))
+	{
+		m_Logger.Write (FromKernel, LogPanic, "Control block pool exhausted");
+	}
+
+	nStartTicks = CTimer::GetClockTicks ();
+
+	for (unsigned nRound = 0; nRound < nRounds; nRound++)
+	{
+		m_DMA.SetupChain (&m_Chain);
+		m_DMA.Start ();
+		if (!m_DMA.Wait ())
+		{
+			m_nErrors++;
+		}
+	}
+
+	unsigned nChainTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	if (!CheckData (nSize, TRUE))
+	{
+		m_nErrors++;
+	}
+
+	unsigned nSteps = m_Chain.GetLength ();
+	m_Chain.Clear ();
+
+	u64 nBytes = (u64) nRounds * nSize;
+	m_Logger.Write (FromKernel, LogNotice, "%7u %7u %11u %11u %6u", (unsigned) nSize,
+			(unsigned) (nBytes / (nCPUTicks ? nCPUTicks : 1)),
+			(unsigned) (nBytes / (nSingleTicks ? nSingleTicks : 1)),
+			(unsigned) (nBytes / (nChainTicks ? nChainTicks : 1)),
+			nSteps);
+}
+
+boolean CKernel::BuildChain (size_t nSize)
+{
+	size_t nChunkSize = nSize < CHUNK_SIZE ? nSize : CHUNK_SIZE;
+	unsigned nChunks = nSize / nChunkSize;
+
+	for (unsigned i = 0; i < nChunks; i++)
+	{
+		if (!m_Chain.AddMemCopy (DestinationBuffer + i * nChunkSize,
+					 SourceBuffer + (nChunks-1 - i) * nChunkSize,
+					 nChunkSize, BURST_LENGTH))
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+void CKernel::PrepareData (size_t nSize, unsigned nRound)
+{
+	for (size_t i = 0; i < nSize; i++)
+	{
+		SourceBuffer[i] = (u8) (i * 7 + (i >> 8) + nRound);
+	}
+
+	memset (DestinationBuffer, 0, nSize);
+}
+
+boolean CKernel::CheckData (size_t nSize, boolean bScattered)
+{
+	if (!bScattered)
+	{
+		return memcmp (DestinationBuffer, SourceBuffer, nSize) == 0;
+	}
+
+	size_t nChunkSize = nSize < CHUNK_SIZE ? nSize : CHUNK_SIZE;
+	unsigned nChunks = nSize / nChunkSize;
+
+	for (unsigned i = 0; i < nChunks; i++)
+	{
+		if (memcmp (DestinationBuffer + i * nChunkSize,
+			    SourceBuffer + (nChunks-1 - i) * nChunkSize, nChunkSize) != 0)
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
@@ -0,0 +1,333 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/string.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define REQUEST_SIZE		0x8000		// fits into a lite channel
+#define FLOOD_REQUESTS		16		// requests of client 0
+#define CHUNK_SIZE		4096		// for the chain in TestLoad()
+#define LOAD_SECONDS		2
+
+static const char FromKernel[] = "kernel";
+
+static DMA_BUFFER (u8, SourceBuffer, REQUESTS * REQUEST_SIZE);
+static DMA_BUFFER (u8, DestinationBuffer, REQUESTS * REQUEST_SIZE);
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_DMAManager (&m_Interrupt),
+	m_nCompleted (0),
+	m_nErrors (0)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Logger.Initialize (&m_Screen);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	for (unsigned i = 0; i < CLIENTS; i++)
+	{
+		m_nClient[i] = m_DMAManager.RegisterClient ();
+	}
+
+	TestAllocation ();
+	TestFairness ();
+	TestLoad ();
+
+	m_DMAManager.Dump ();
+
+	if (m_nErrors == 0)
+	{
+		m_Logger.Write (FromKernel, LogNotice, "Test passed");
+	}
+	else
+	{
+		m_Logger.Write (FromKernel, LogError, "Test failed with %u error(s)", m_nErrors);
+	}
+
+	return ShutdownHalt;
+}
+
+void CKernel::TestAllocation (void)
+{
+	static const TDMAChannelClass Classes[] = {DMAClassLite, DMAClassNormal, DMAClassExtended};
+	static const char *Names[] = {"lite", "normal", "extended"};
+
+	CDMAChannel *pChannel[3];
+	for (unsigned i = 0; i < 3; i++)
+	{
+		pChannel[i] = m_DMAManager.AllocateChannel (Classes[i], Names[i]);
+		if (pChannel[i] == 0)
+		{
+			m_Logger.Write (FromKernel, LogWarning, "No %s channel", Names[i]);
+
+			continue;
+		}
+
+		m_Logger.Write (FromKernel, LogNotice, "Class %s: channel %u (%s)",
+				Names[i], pChannel[i]->GetChannel (),
+				  pChannel[i]->IsExtended () ? "extended"
+				: (pChannel[i]->IsLite () ? "lite" : "normal"));
+
+		if (   Classes[i] == DMAClassNormal
+		    && pChannel[i]->IsLite ())
+		{
+			m_nErrors++;
+		}
+	}
+
+	m_DMAManager.Dump ();
+
+	for (unsigned i = 0; i < 3; i++)
+	{
+		if (pChannel[i] != 0)
+		{
+			m_DMAManager.FreeChannel (pChannel[i]);
+		}
+	}
+}
+
+void CKernel::TestFairness (void)
+{
+	// client 0 floods the shared channel, the others submit two requests each afterwards
+	unsigned nRequest = 0;
+	for (unsigned nClient = 0; nClient < CLIENTS; nClient++)
+	{
+		unsigned nCount = nClient == 0 ? FLOOD_REQUESTS : (REQUESTS - FLOOD_REQUESTS) / 2;
+
+		for (unsigned i = 0; i < nCount; i++, nRequest++)
+		{
+			assert (nRequest < REQUESTS);
+			PrepareData (nRequest);
+
+			TDMARequest *pRequest = &m_Request[nRequest];
+			pRequest->Type = DMARequestMemCopy;
+			pRequest->pDestination = DestinationBuffer + nRequest * REQUEST_SIZE;
+			pRequest->pSource = SourceBuffer + nRequest * REQUEST_SIZE;
+			pRequest->nLength = REQUEST_SIZE;
+			pRequest->nBurstLength = 2;
+			pRequest->pChain = 0;
+			pRequest->pCompletionRoutine = CompletionRoutine;
+			pRequest->pCompletionParam = this;
+
+			m_nRequestClient[nRequest] = nClient;
+		}
+	}
+
+	assert (nRequest == REQUESTS);
+
+	// submit all requests quickly, so that they are queued at the same time
+	for (unsigned i = 0; i < REQUESTS; i++)
+	{
+		if (!m_DMAManager.Submit (m_nClient[m_nRequestClient[i]], DMAClassLite,
+					  &m_Request[i]))
+		{
+			m_Logger.Write (FromKernel, LogPanic, "Cannot submit request");
+		}
+	}
+
+	for (unsigned i = 0; i < REQUESTS; i++)
+	{
+		if (!m_DMAManager.Wait (&m_Request[i]))
+		{
+			m_nErrors++;
+		}
+
+		if (!CheckData (i))
+		{
+			m_nErrors++;
+		}
+	}
+
+	assert (m_nCompleted == REQUESTS);
+
+	// with round-robin the late clients are done after a few requests of client 0
+	unsigned nLastOther = 0;
+	CString Order;
+	for (unsigned i = 0; i < REQUESTS; i++)
+	{
+		CString Client;
+		Client.Format ("%u", m_nCompletionOrder[i]);
+		Order.Append (Client);
+
+		if (m_nCompletionOrder[i] != 0)
+		{
+			nLastOther = i;
+		}
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "Completion order: %s", (const char *) Order);
+
+	if (nLastOther >= 2 * CLIENTS + 1)
+	{
+		m_Logger.Write (FromKernel, LogError, "Clients have not been served fairly");
+
+		m_nErrors++;
+	}
+}
+
+void CKernel::TestLoad (void)
+{
+	// the chain must be built for the shared channel of the class
+	CDMAChannel *pChannel = m_DMAManager.GetSharedChannel (DMAClassNormal);
+	if (pChannel == 0)
+	{
+		m_Logger.Write (FromKernel, LogPanic, "No shared normal channel");
+	}
+
+	CDMAControlBlockPool Pool (REQUESTS);
+	CDMAChain Chain (pChannel, &Pool);
+
+	// the chain copies all buffers, but the last one
+	for (unsigned i = 0; i < REQUESTS-1; i++)
+	{
+		PrepareData (i);
+
+		if (!Chain.AddMemCopy (DestinationBuffer + i * REQUEST_SIZE,
+				       SourceBuffer + i * REQUEST_SIZE, REQUEST_SIZE, 2))
+		{
+			m_Logger.Write (FromKernel, LogPanic, "Cannot build chain");
+		}
+	}
+
+	TDMARequest ChainRequest;
+	ChainRequest.Type = DMARequestChain;
+	ChainRequest.nLength = (REQUESTS-1) * REQUEST_SIZE;	// for the statistics only
+	ChainRequest.pChain = &Chain;
+	ChainRequest.pCompletionRoutine = 0;
+
+	PrepareData (REQUESTS-1);
+
+	TDMARequest CopyRequest;
+	CopyRequest.Type = DMARequestMemCopy;
+	CopyRequest.pDestination = DestinationBuffer + (REQUESTS-1) * REQUEST_SIZE;
+	CopyRequest.pSource = SourceBuffer + (REQUESTS-1) * REQUEST_SIZE;
+	CopyRequest.nLength = REQUEST_SIZE;
+	CopyRequest.nBurstLength = 0;
+	CopyRequest.pChain = 0;
+	CopyRequest.pCompletionRoutine = 0;
+
+	m_DMAManager.ResetStatistics ();
+
+	// the normal channel is kept busy, the lite channel only part of the time
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	while (CTimer::GetClockTicks () - nStartTicks < LOAD_SECONDS * CLOCKHZ)
+	{
+		if (!m_DMAManager.Submit (m_nClient[1], DMAClassNormal, &ChainRequest))
+		{
+			m_Logger.Write (FromKernel, LogPanic, "Cannot submit chain");
+		}
+
+		unsigned nCopyTicks = CTimer::GetClockTicks ();
+		if (!m_DMAManager.Submit (m_nClient[2], DMAClassLite, &CopyRequest))
+		{
+			m_Logger.Write (FromKernel, LogPanic, "Cannot submit request");
+		}
+
+		if (!m_DMAManager.Wait (&CopyRequest))
+		{
+			m_nErrors++;
+		}
+
+		// let the lite channel idle as long as it was busy
+		nCopyTicks = CTimer::GetClockTicks () - nCopyTicks;
+		CTimer::SimpleusDelay (nCopyTicks);
+
+		if (!m_DMAManager.Wait (&ChainRequest))
+		{
+			m_nErrors++;
+		}
+	}
+
+	for (unsigned i = 0; i < REQUESTS; i++)
+	{
+		if (!CheckData (i))
+		{
+			m_nErrors++;
+		}
+	}
+}
+
+void CKernel::PrepareData (unsigned nRequest)
+{
+	u8 *pSource = SourceBuffer + nRequest * REQUEST_SIZE;
+	for (unsigned i = 0; i < REQUEST_SIZE; i++)
+	{
+		pSource[i] = (u8) (i * 3 + nRequest);
+	}
+
+	memset (DestinationBuffer + nRequest * REQUEST_SIZE, 0, REQUEST_SIZE);
+}
+
+boolean CKernel::CheckData (unsigned nRequest)
+{
+	return memcmp (DestinationBuffer + nRequest * REQUEST_SIZE,
+		       SourceBuffer + nRequest * REQUEST_SIZE, REQUEST_SIZE) == 0;
+}
+
+void CKernel::CompletionRoutine (TDMARequest *pRequest, void *pParam)
+{
+	CKernel *pThis = (CKernel *) pParam;
+	assert (pThis != 0);
+
+	unsigned nRequest = pRequest - pThis->m_Request;
+	assert (nRequest < REQUESTS);
+
+	unsigned nCompleted = pThis->m_nCompleted;
+	assert (nCompleted < REQUESTS);
+	pThis->m_nCompletionOrder[nCompleted] = pThis->m_nRequestClient[nRequest];
+	pThis->m_nCompleted = nCompleted + 1;
+}
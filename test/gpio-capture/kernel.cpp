@@ -0,0 +1,205 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <assert.h>
+
+#define SAMPLE_MICROS		2
+#define TOGGLE_MICROS		100		// CPU toggles the pin with this interval
+#define TOGGLES			200		// 20 ms, longer than the ring buffer
+#define PRE_TRIGGER		16		// samples
+#define MAX_DEVIATION		5		// samples, CPU timing is not exact
+
+// this pin is driven by the CPU and must not be connected
+#define PIN_TEST		17
+
+static const char FromKernel[] = "kernel";
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_Pin (PIN_TEST, GPIOModeOutput),
+	m_Capture (SAMPLE_MICROS),
+	m_nSamples (0),
+	m_nErrors (0)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Logger.Initialize (&m_Screen);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Capture.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	Capture ();
+	Check ();
+
+	if (m_nErrors == 0)
+	{
+		m_Logger.Write (FromKernel, LogNotice, "Test passed");
+	}
+	else
+	{
+		m_Logger.Write (FromKernel, LogError, "Test failed with %u error(s)", m_nErrors);
+	}
+
+	return ShutdownHalt;
+}
+
+void CKernel::Capture (void)
+{
+	m_Pin.Write (LOW);
+
+	m_Capture.SetTrigger (GPIOCaptureTriggerRisingEdge, 1 << PIN_TEST, 0, PRE_TRIGGER);
+	m_Capture.Start ();
+
+	// toggle the pin with the CPU and stream the samples into m_Samples meanwhile
+	unsigned nToggles = 0;
+	unsigned nNextToggle = CTimer::GetClockTicks () + 1000;
+	while (   nToggles < TOGGLES
+	       || (int) (CTimer::GetClockTicks () - (nNextToggle + 1000)) < 0)
+	{
+		if (   nToggles < TOGGLES
+		    && (int) (CTimer::GetClockTicks () - nNextToggle) >= 0)
+		{
+			m_Pin.Invert ();
+
+			nToggles++;
+			nNextToggle += TOGGLE_MICROS;
+		}
+
+		m_nSamples += m_Capture.Read (&m_Samples[m_nSamples], MAX_SAMPLES - m_nSamples);
+	}
+
+	m_Capture.Stop ();
+
+	m_Logger.Write (FromKernel, LogNotice, "%u samples captured (%u overruns)",
+			m_nSamples, m_Capture.GetOverrunCount ());
+
+	if (m_Capture.GetOverrunCount () > 0)
+	{
+		m_nErrors++;
+	}
+}
+
+void CKernel::Check (void)
+{
+	const u32 nMask = 1 << PIN_TEST;
+
+	if (m_nSamples <= PRE_TRIGGER)
+	{
+		m_Logger.Write (FromKernel, LogError, "Not triggered");
+
+		m_nErrors++;
+
+		return;
+	}
+
+	// the trigger sample is preceded by the pre-trigger samples
+	for (unsigned i = 0; i < PRE_TRIGGER; i++)
+	{
+		if (m_Samples[i] & nMask)
+		{
+			m_Logger.Write (FromKernel, LogError, "Invalid pre-trigger sample %u", i);
+
+			m_nErrors++;
+
+			break;
+		}
+	}
+
+	if (!(m_Samples[PRE_TRIGGER] & nMask))
+	{
+		m_Logger.Write (FromKernel, LogError, "Invalid trigger sample");
+
+		m_nErrors++;
+	}
+
+	// count the edges and check the distances between them
+	const int nExpected = TOGGLE_MICROS / SAMPLE_MICROS;
+	unsigned nEdges = 1;
+	unsigned nLastEdge = PRE_TRIGGER;
+	unsigned nMaxDeviation = 0;
+	for (unsigned i = PRE_TRIGGER + 1; i < m_nSamples; i++)
+	{
+		if (!((m_Samples[i] ^ m_Samples[i-1]) & nMask))
+		{
+			continue;
+		}
+
+		int nDeviation = (int) (i - nLastEdge) - nExpected;
+		if (nDeviation < 0)
+		{
+			nDeviation = -nDeviation;
+		}
+
+		if ((unsigned) nDeviation > nMaxDeviation)
+		{
+			nMaxDeviation = nDeviation;
+		}
+
+		nEdges++;
+		nLastEdge = i;
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "%u edges found, max. deviation %u samples",
+			nEdges, nMaxDeviation);
+
+	if (   nEdges != TOGGLES
+	    || nMaxDeviation > MAX_DEVIATION)
+	{
+		m_nErrors++;
+	}
+}
@@ -0,0 +1,250 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/bcm2835.h>
+#include <circle/memio.h>
+#include <circle/synchronize.h>
+#include <assert.h>
+
+#define TICK_MICROS		1
+#define PERIOD			2000		// ticks, for repeated playback
+#define MAX_DEVIATION		2		// microseconds, allowed for DMA playback
+
+// the pins are not touched in simulation mode, GPIO40 tests the second bank
+#define PIN_DATA		17
+#define PIN_CLOCK		27
+#define PIN_BANK1		40
+
+static const char FromKernel[] = "kernel";
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_Waveform (TICK_MICROS, &m_Interrupt, STEPS),
+	m_nErrors (0)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Logger.Initialize (&m_Screen);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Waveform.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	CreateSteps ();
+
+	TestSinglePlayback ();
+	TestRepeatedPlayback ();
+	TestCPUTiming ();
+
+	if (m_nErrors == 0)
+	{
+		m_Logger.Write (FromKernel, LogNotice, "Test passed");
+	}
+	else
+	{
+		m_Logger.Write (FromKernel, LogError, "Test failed with %u error(s)", m_nErrors);
+	}
+
+	return ShutdownHalt;
+}
+
+void CKernel::CreateSteps (void)
+{
+	// a clock with irregular intervals, a data pin toggling on every 3rd step
+	// and a pin in the second bank toggling on every 5th step
+	unsigned nTime = 10;
+	u64 nLevel = 0;
+	for (unsigned i = 0; i < STEPS; i++)
+	{
+		u64 nToggle = (u64) 1 << PIN_CLOCK;
+		if (i % 3 == 0)
+		{
+			nToggle |= (u64) 1 << PIN_DATA;
+		}
+		if (i % 5 == 0)
+		{
+			nToggle |= (u64) 1 << PIN_BANK1;
+		}
+
+		nLevel ^= nToggle;
+
+		m_Steps[i].nTime = nTime;
+		m_Steps[i].nSetMask = nLevel & nToggle;
+		m_Steps[i].nClearMask = ~nLevel & nToggle;
+
+		nTime += 3 + (i * 7) % 25;
+	}
+
+	assert (nTime < PERIOD);
+}
+
+void CKernel::TestSinglePlayback (void)
+{
+	if (!m_Waveform.Create (m_Steps, STEPS, 0, GPIOWaveModeSimulate))
+	{
+		m_Logger.Write (FromKernel, LogPanic, "Cannot create waveform");
+	}
+
+	m_Waveform.Start ();
+	if (!m_Waveform.Wait ())
+	{
+		m_nErrors++;
+	}
+
+	const TGPIOWaveTrace *pTrace = m_Waveform.GetTrace ();
+	assert (pTrace != 0);
+
+	u32 Timestamps[STEPS];
+	for (unsigned i = 0; i < STEPS; i++)
+	{
+		// the simulated GPIO registers must contain the masks of the step
+		if (   pTrace[i].nSetMask[0] != (u32) m_Steps[i].nSetMask
+		    || pTrace[i].nSetMask[1] != (u32) (m_Steps[i].nSetMask >> 32)
+		    || pTrace[i].nClearMask[0] != (u32) m_Steps[i].nClearMask
+		    || pTrace[i].nClearMask[1] != (u32) (m_Steps[i].nClearMask >> 32))
+		{
+			m_Logger.Write (FromKernel, LogError, "Step %u: Invalid masks", i);
+
+			m_nErrors++;
+		}
+
+		Timestamps[i] = pTrace[i].nTimestamp;
+	}
+
+	unsigned nDeviation = GetMaxDeviation (Timestamps);
+	m_Logger.Write (FromKernel, LogNotice, "DMA playback: Max. deviation %u us", nDeviation);
+
+	if (nDeviation > MAX_DEVIATION)
+	{
+		m_nErrors++;
+	}
+}
+
+void CKernel::TestRepeatedPlayback (void)
+{
+	if (!m_Waveform.Create (m_Steps, STEPS, PERIOD, GPIOWaveModeSimulate))
+	{
+		m_Logger.Write (FromKernel, LogPanic, "Cannot create waveform");
+	}
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	m_Waveform.Start ();
+	CTimer::SimpleMsDelay (100);
+	m_Waveform.Stop ();
+
+	// the trace is updated in every period, the first step must have been executed lately
+	const TGPIOWaveTrace *pTrace = m_Waveform.GetTrace ();
+	assert (pTrace != 0);
+	CleanAndInvalidateDataCacheRange ((uintptr) pTrace, STEPS * sizeof *pTrace);
+
+	unsigned nSinceStart = pTrace[0].nTimestamp - nStartTicks;
+	m_Logger.Write (FromKernel, LogNotice, "Repeated playback: Last period started after %u us",
+			nSinceStart);
+
+	if (nSinceStart < 100000 - 2*PERIOD*TICK_MICROS)
+	{
+		m_nErrors++;
+	}
+}
+
+void CKernel::TestCPUTiming (void)
+{
+	// for comparison: the CPU waits for the time of each step (with interrupts enabled)
+	u32 Timestamps[STEPS];
+
+	u32 nStart = read32 (ARM_SYSTIMER_CLO);
+	for (unsigned i = 0; i < STEPS; i++)
+	{
+		u32 nTime = nStart + m_Steps[i].nTime * TICK_MICROS;
+
+		u32 nNow;
+		while ((int) ((nNow = read32 (ARM_SYSTIMER_CLO)) - nTime) < 0)
+		{
+			// just wait
+		}
+
+		Timestamps[i] = nNow;
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "CPU timing: Max. deviation %u us",
+			GetMaxDeviation (Timestamps));
+}
+
+unsigned CKernel::GetMaxDeviation (const u32 *pTimestamps)
+{
+	unsigned nMaxDeviation = 0;
+
+	for (unsigned i = 1; i < STEPS; i++)
+	{
+		int nExpected = (m_Steps[i].nTime - m_Steps[i-1].nTime) * TICK_MICROS;
+		int nMeasured = pTimestamps[i] - pTimestamps[i-1];
+
+		int nDeviation = nMeasured - nExpected;
+		if (nDeviation < 0)
+		{
+			nDeviation = -nDeviation;
+		}
+
+		if ((unsigned) nDeviation > nMaxDeviation)
+		{
+			nMaxDeviation = nDeviation;
+		}
+	}
+
+	return nMaxDeviation;
+}
@@ -0,0 +1,319 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <assert.h>
+
+#define MEASURE_MS		3000
+#define WORK_LOOPS		100		// per work unit
+
+static const char FromKernel[] = "kernel";
+
+static const char *ModeName[] = {"Polled", "IRQ, blocking", "IRQ, queued"};
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_nReferenceUnits (0),
+	m_nErrors (0),
+	m_nCompleted (0)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Logger.Initialize (&m_Screen);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	// work units, which can be done, while the simulation is ticking
+	CSimulatedI2CMaster *pI2CMaster = new CSimulatedI2CMaster (&m_Interrupt, FALSE);
+	assert (pI2CMaster != 0);
+	if (!pI2CMaster->Initialize ())
+	{
+		m_Logger.Write (FromKernel, LogPanic, "Cannot initialize I2C master");
+	}
+
+	m_nReferenceUnits = RunWorkload (0, ModePolled, 0);
+	assert (m_nReferenceUnits > 0);
+
+	delete pI2CMaster;
+
+	m_Logger.Write (FromKernel, LogNotice, "Reference: %u work units", m_nReferenceUnits);
+
+	Measure (ModePolled);
+	Measure (ModeIRQBlocking);
+	Measure (ModeIRQQueued);
+
+	// a transaction to a missing device must fail
+	pI2CMaster = new CSimulatedI2CMaster (&m_Interrupt, TRUE);
+	assert (pI2CMaster != 0);
+	if (!pI2CMaster->Initialize ())
+	{
+		m_Logger.Write (FromKernel, LogPanic, "Cannot initialize I2C master");
+	}
+
+	u8 ucRegister = 0;
+	int nResult = pI2CMaster->WriteRead (SIM_SENSOR_ADDRESS + SIM_SENSORS, &ucRegister, 1,
+					     m_Buffer[0], READ_SIZE);
+	if (nResult != -I2C_MASTER_ERROR_NACK)
+	{
+		m_Logger.Write (FromKernel, LogError, "Missing device not detected (%d)", nResult);
+
+		m_nErrors++;
+	}
+
+	delete pI2CMaster;
+
+	if (m_nErrors == 0)
+	{
+		m_Logger.Write (FromKernel, LogNotice, "Test passed");
+	}
+	else
+	{
+		m_Logger.Write (FromKernel, LogError, "Test failed with %u error(s)", m_nErrors);
+	}
+
+	return ShutdownHalt;
+}
+
+void CKernel::Measure (TMode Mode)
+{
+	CSimulatedI2CMaster *pI2CMaster = new CSimulatedI2CMaster (&m_Interrupt, Mode != ModePolled);
+	assert (pI2CMaster != 0);
+
+	if (!pI2CMaster->Initialize ())
+	{
+		m_Logger.Write (FromKernel, LogPanic, "Cannot initialize I2C master");
+	}
+
+	unsigned nRounds;
+	unsigned nUnits = RunWorkload (pI2CMaster, Mode, &nRounds);
+
+	unsigned nBytes = pI2CMaster->GetBytesTransferred ();
+
+	delete pI2CMaster;
+
+	unsigned nLoad = 0;
+	if (nUnits < m_nReferenceUnits)
+	{
+		nLoad = (m_nReferenceUnits - nUnits) * 1000ULL / m_nReferenceUnits;
+	}
+
+	m_Logger.Write (FromKernel, LogNotice,
+			"%s: %u transactions/s, %u bytes/s on bus, CPU load %u.%u%%",
+			ModeName[Mode],
+			(unsigned) (nRounds * SIM_SENSORS * 1000ULL / MEASURE_MS),
+			(unsigned) (nBytes * 1000ULL / MEASURE_MS),
+			nLoad / 10, nLoad % 10);
+}
+
+unsigned CKernel::RunWorkload (CSimulatedI2CMaster *pI2CMaster, TMode Mode, unsigned *pRounds)
+{
+	unsigned nRounds = 0;
+	unsigned nUnits = 0;
+	u8 ucRegister = 0;
+
+	if (   pI2CMaster != 0
+	    && Mode == ModeIRQQueued)
+	{
+		SubmitBatch (pI2CMaster, ucRegister);
+	}
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	while (CTimer::GetClockTicks () - nStartTicks < MEASURE_MS * 1000)
+	{
+		// sample all sensors once per round
+		if (pI2CMaster != 0)
+		{
+			if (Mode == ModeIRQQueued)
+			{
+				if (m_nCompleted == SIM_SENSORS)
+				{
+					if (!CheckBatch ())
+					{
+						m_nErrors++;
+					}
+
+					nRounds++;
+					ucRegister += READ_SIZE;
+
+					SubmitBatch (pI2CMaster, ucRegister);
+				}
+			}
+			else
+			{
+				if (!ReadSensors (pI2CMaster, ucRegister))
+				{
+					m_nErrors++;
+				}
+
+				nRounds++;
+				ucRegister += READ_SIZE;
+			}
+		}
+
+		// do some work
+		for (volatile unsigned i = 0; i < WORK_LOOPS; i++)
+		{
+			// just count
+		}
+
+		nUnits++;
+	}
+
+	if (   pI2CMaster != 0
+	    && Mode == ModeIRQQueued)
+	{
+		while (m_nCompleted < SIM_SENSORS)
+		{
+			// wait for the last batch
+		}
+	}
+
+	if (pRounds != 0)
+	{
+		*pRounds = nRounds;
+	}
+
+	return nUnits;
+}
+
+boolean CKernel::ReadSensors (CSimulatedI2CMaster *pI2CMaster, u8 ucRegister)
+{
+	boolean bOK = TRUE;
+
+	for (unsigned i = 0; i < SIM_SENSORS; i++)
+	{
+		u8 ucAddress = SIM_SENSOR_ADDRESS + i;
+
+		int nResult = pI2CMaster->WriteRead (ucAddress, &ucRegister, 1,
+						     m_Buffer[i], READ_SIZE);
+		if (nResult != READ_SIZE)
+		{
+			bOK = FALSE;
+
+			continue;
+		}
+
+		for (unsigned j = 0; j < READ_SIZE; j++)
+		{
+			if (m_Buffer[i][j] != CSimulatedI2CMaster::GetSensorValue (ucAddress,
+										  ucRegister + j))
+			{
+				bOK = FALSE;
+			}
+		}
+	}
+
+	return bOK;
+}
+
+void CKernel::SubmitBatch (CSimulatedI2CMaster *pI2CMaster, u8 ucRegister)
+{
+	m_nCompleted = 0;
+
+	for (unsigned i = 0; i < SIM_SENSORS; i++)
+	{
+		m_ucRegister[i] = ucRegister;
+
+		TI2CTransaction *pTransaction = &m_Transaction[i];
+		pTransaction->ucAddress = SIM_SENSOR_ADDRESS + i;
+		pTransaction->pWriteBuffer = &m_ucRegister[i];
+		pTransaction->nWriteCount = 1;
+		pTransaction->pReadBuffer = m_Buffer[i];
+		pTransaction->nReadCount = READ_SIZE;
+		pTransaction->pCompletionRoutine = TransactionCompletionRoutine;
+		pTransaction->pParam = this;
+
+		if (!pI2CMaster->SubmitTransaction (pTransaction))
+		{
+			pTransaction->nResult = -I2C_MASTER_INALID_PARM;
+
+			m_nCompleted++;		// will be detected in CheckBatch()
+		}
+	}
+}
+
+boolean CKernel::CheckBatch (void)
+{
+	boolean bOK = TRUE;
+
+	for (unsigned i = 0; i < SIM_SENSORS; i++)
+	{
+		const TI2CTransaction *pTransaction = &m_Transaction[i];
+
+		if (pTransaction->nResult != READ_SIZE)
+		{
+			bOK = FALSE;
+
+			continue;
+		}
+
+		for (unsigned j = 0; j < READ_SIZE; j++)
+		{
+			if (m_Buffer[i][j] != CSimulatedI2CMaster::GetSensorValue (pTransaction->ucAddress,
+										  m_ucRegister[i] + j))
+			{
+				bOK = FALSE;
+			}
+		}
+	}
+
+	return bOK;
+}
+
+void CKernel::TransactionCompletionRoutine (TI2CTransaction *pTransaction, void *pParam)
+{
+	CKernel *pThis = (CKernel *) pParam;
+	assert (pThis != 0);
+
+	pThis->m_nCompleted++;
+}
@@ -0,0 +1,92 @@
+//
+// kernel.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _kernel_h
+#define _kernel_h
+
+#include <circle/actled.h>
+#include <circle/koptions.h>
+#include <circle/devicenameservice.h>
+#include <circle/screen.h>
+#include <circle/exceptionhandler.h>
+#include <circle/interrupt.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <circle/i2cmaster.h>
+#include <circle/types.h>
+#include "simulatedi2cmaster.h"
+
+#define READ_SIZE	6		// bytes per sensor sample
+
+enum TShutdownMode
+{
+	ShutdownNone,
+	ShutdownHalt,
+	ShutdownReboot
+};
+
+class CKernel
+{
+public:
+	CKernel (void);
+	~CKernel (void);
+
+	boolean Initialize (void);
+
+	TShutdownMode Run (void);
+
+private:
+	enum TMode
+	{
+		ModePolled,
+		ModeIRQBlocking,
+		ModeIRQQueued
+	};
+
+	void Measure (TMode Mode);
+
+	unsigned RunWorkload (CSimulatedI2CMaster *pI2CMaster, TMode Mode, unsigned *pRounds);
+
+	boolean ReadSensors (CSimulatedI2CMaster *pI2CMaster, u8 ucRegister);
+	void SubmitBatch (CSimulatedI2CMaster *pI2CMaster, u8 ucRegister);
+	boolean CheckBatch (void);
+
+	static void TransactionCompletionRoutine (TI2CTransaction *pTransaction, void *pParam);
+
+private:
+	// do not change this order
+	CActLED			m_ActLED;
+	CKernelOptions		m_Options;
+	CDeviceNameService	m_DeviceNameService;
+	CScreenDevice		m_Screen;
+	CExceptionHandler	m_ExceptionHandler;
+	CInterruptSystem	m_Interrupt;
+	CTimer			m_Timer;
+	CLogger			m_Logger;
+
+	unsigned m_nReferenceUnits;
+	unsigned m_nErrors;
+
+	TI2CTransaction m_Transaction[SIM_SENSORS];
+	u8 m_ucRegister[SIM_SENSORS];
+	u8 m_Buffer[SIM_SENSORS][READ_SIZE];
+	volatile unsigned m_nCompleted;
+};
+
+#endif
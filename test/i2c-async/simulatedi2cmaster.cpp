@@ -0,0 +1,432 @@
+//
+// simulatedi2cmaster.cpp
+//
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "simulatedi2cmaster.h"
+#include <circle/bcm2835.h>
+#include <circle/machineinfo.h>
+#include <circle/synchronize.h>
+#include <circle/timer.h>
+#include <assert.h>
+
+#define BSC_DEVICE		1
+
+// Control register
+#define C_I2CEN			(1 << 15)
+#define C_INTR			(1 << 10)
+#define C_INTT			(1 << 9)
+#define C_INTD			(1 << 8)
+#define C_ST			(1 << 7)
+#define C_CLEAR			(3 << 4)
+#define C_READ			(1 << 0)
+
+// Status register
+#define S_CLKT			(1 << 9)
+#define S_ERR			(1 << 8)
+#define S_RXF			(1 << 7)
+#define S_TXE			(1 << 6)
+#define S_RXD			(1 << 5)
+#define S_TXD			(1 << 4)
+#define S_RXR			(1 << 3)
+#define S_TXW			(1 << 2)
+#define S_DONE			(1 << 1)
+#define S_TA			(1 << 0)
+
+#define FIFO_SIZE		16
+
+#define ADDRESS_BITS		10		// start condition, address, R/W, ACK
+#define BYTE_BITS		9		// data, ACK
+
+CSimulatedI2CMaster::CSimulatedI2CMaster (CInterruptSystem *pInterruptSystem,
+					  boolean bUseInterrupt)
+:	CI2CMaster (BSC_DEVICE, TRUE, 0, bUseInterrupt ? pInterruptSystem : 0),
+	m_bUseInterrupt (bUseInterrupt),
+	m_Timer (pInterruptSystem, TimerHandler, this),
+	m_nTickMicros (0),
+	m_nControl (0),
+	m_nStatus (0),
+	m_nDataLength (0),
+	m_nSlaveAddress (0),
+	m_nDivider (0),
+	m_nFIFOIn (0),
+	m_nFIFOCount (0),
+	m_Phase (PhaseIdle),
+	m_bRead (FALSE),
+	m_nBytesLeft (0),
+	m_bStartPending (FALSE),
+	m_bPendingRead (FALSE),
+	m_nPendingLength (0),
+	m_nLastTicks (0),
+	m_nBitBudget (0),
+	m_nSensor (SIM_SENSORS),
+	m_bFirstByte (FALSE),
+	m_nCoreClockRate (CMachineInfo::Get ()->GetClockRate (CLOCK_ID_CORE)),
+	m_nBytesTransferred (0)
+{
+	for (unsigned i = 0; i < SIM_SENSORS; i++)
+	{
+		m_Pointer[i] = 0;
+
+		for (unsigned j = 0; j < SIM_SENSOR_REGS; j++)
+		{
+			m_Registers[i][j] = GetSensorValue (SIM_SENSOR_ADDRESS + i, j);
+		}
+	}
+}
+
+CSimulatedI2CMaster::~CSimulatedI2CMaster (void)
+{
+	m_Timer.Stop ();
+}
+
+boolean CSimulatedI2CMaster::Initialize (void)
+{
+	if (!CI2CMaster::Initialize ())		// sets the DIV register
+	{
+		return FALSE;
+	}
+
+	if (!m_Timer.Initialize ())
+	{
+		return FALSE;
+	}
+
+	// the timer ticks once per byte on the bus
+	assert (m_nDivider > 0);
+	assert (m_nCoreClockRate > 0);
+	m_nTickMicros = (unsigned) (  (u64) BYTE_BITS * CLOCKHZ * m_nDivider
+				    / m_nCoreClockRate);
+	if (m_nTickMicros < 2)
+	{
+		m_nTickMicros = 2;
+	}
+
+	m_Timer.Start (m_nTickMicros);
+
+	return TRUE;
+}
+
+u8 CSimulatedI2CMaster::GetSensorValue (u8 ucAddress, u8 ucRegister)
+{
+	return ucAddress ^ ucRegister;
+}
+
+u32 CSimulatedI2CMaster::ReadReg (unsigned nOffset)
+{
+	EnterCritical (IRQ_LEVEL);
+
+	Advance ();
+
+	u32 nValue = 0;
+
+	switch (nOffset)
+	{
+	case ARM_BSC_C__OFFSET:
+		nValue = m_nControl;
+		break;
+
+	case ARM_BSC_S__OFFSET:
+		nValue = GetStatus ();
+		break;
+
+	case ARM_BSC_DLEN__OFFSET:
+		nValue = m_Phase == PhaseIdle ? m_nDataLength : m_nBytesLeft;
+		break;
+
+	case ARM_BSC_A__OFFSET:
+		nValue = m_nSlaveAddress;
+		break;
+
+	case ARM_BSC_FIFO__OFFSET:
+		if (m_nFIFOCount > 0)
+		{
+			nValue = m_FIFO[(m_nFIFOIn - m_nFIFOCount--) % FIFO_SIZE];
+		}
+		break;
+
+	case ARM_BSC_DIV__OFFSET:
+		nValue = m_nDivider;
+		break;
+
+	default:
+		break;
+	}
+
+	LeaveCritical ();
+
+	return nValue;
+}
+
+void CSimulatedI2CMaster::WriteReg (unsigned nOffset, u32 nValue)
+{
+	EnterCritical (IRQ_LEVEL);
+
+	Advance ();
+
+	switch (nOffset)
+	{
+	case ARM_BSC_C__OFFSET:
+		if (nValue & C_CLEAR)
+		{
+			m_nFIFOCount = 0;
+		}
+
+		m_nControl = nValue & ~(C_ST | C_CLEAR);
+
+		if ((nValue & (C_I2CEN | C_ST)) == (C_I2CEN | C_ST))
+		{
+			if (m_Phase != PhaseIdle)
+			{
+				// repeated start after the active transfer
+				m_bStartPending = TRUE;
+				m_bPendingRead = !!(nValue & C_READ);
+				m_nPendingLength = m_nDataLength;
+			}
+			else
+			{
+				Start (!!(nValue & C_READ), m_nDataLength);
+			}
+		}
+		break;
+
+	case ARM_BSC_S__OFFSET:
+		m_nStatus &= ~(nValue & (S_CLKT | S_ERR | S_DONE));
+		break;
+
+	case ARM_BSC_DLEN__OFFSET:
+		m_nDataLength = nValue & 0xFFFF;
+		break;
+
+	case ARM_BSC_A__OFFSET:
+		m_nSlaveAddress = nValue & 0x7F;
+		break;
+
+	case ARM_BSC_FIFO__OFFSET:
+		if (m_nFIFOCount < FIFO_SIZE)
+		{
+			m_FIFO[m_nFIFOIn++ % FIFO_SIZE] = (u8) nValue;
+			m_nFIFOCount++;
+		}
+		break;
+
+	case ARM_BSC_DIV__OFFSET:
+		m_nDivider = nValue & 0xFFFF;
+		if (m_nDivider == 0)
+		{
+			m_nDivider = 0x8000;
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	LeaveCritical ();
+}
+
+void CSimulatedI2CMaster::Start (boolean bRead, unsigned nLength)
+{
+	m_nStatus = (m_nStatus & ~S_DONE) | S_TA;
+
+	m_Phase = PhaseAddress;
+	m_bRead = bRead;
+	m_nBytesLeft = nLength;
+
+	m_nLastTicks = CTimer::GetClockTicks ();
+	m_nBitBudget = 0;
+}
+
+void CSimulatedI2CMaster::Complete (void)
+{
+	if (m_bStartPending)
+	{
+		m_bStartPending = FALSE;
+
+		m_Phase = PhaseAddress;
+		m_bRead = m_bPendingRead;
+		m_nBytesLeft = m_nPendingLength;
+	}
+	else
+	{
+		m_nStatus = (m_nStatus & ~S_TA) | S_DONE;
+
+		m_Phase = PhaseIdle;
+	}
+}
+
+void CSimulatedI2CMaster::Advance (void)
+{
+	unsigned nTicks = CTimer::GetClockTicks ();
+	unsigned nElapsed = nTicks - m_nLastTicks;
+	m_nLastTicks = nTicks;
+
+	if (m_Phase == PhaseIdle)
+	{
+		m_nBitBudget = 0;
+
+		return;
+	}
+
+	assert (m_nDivider > 0);
+	m_nBitBudget += (u64) nElapsed * (m_nCoreClockRate / m_nDivider);
+
+	while (m_Phase != PhaseIdle)
+	{
+		if (m_Phase == PhaseAddress)
+		{
+			if (m_nBitBudget < (u64) ADDRESS_BITS * CLOCKHZ)
+			{
+				break;
+			}
+			m_nBitBudget -= (u64) ADDRESS_BITS * CLOCKHZ;
+
+			m_nSensor = m_nSlaveAddress - SIM_SENSOR_ADDRESS;
+			if (m_nSensor >= SIM_SENSORS)
+			{
+				// no ACK for the address
+				m_nStatus |= S_ERR;
+				m_bStartPending = FALSE;
+
+				Complete ();
+
+				break;
+			}
+
+			m_bFirstByte = TRUE;
+			m_Phase = PhaseData;
+		}
+
+		if (m_nBytesLeft == 0)
+		{
+			Complete ();
+
+			continue;
+		}
+
+		// master stretches the clock, if the FIFO is not ready
+		if (m_bRead ? m_nFIFOCount == FIFO_SIZE : m_nFIFOCount == 0)
+		{
+			m_nBitBudget = 0;
+
+			break;
+		}
+
+		if (m_nBitBudget < (u64) BYTE_BITS * CLOCKHZ)
+		{
+			break;
+		}
+		m_nBitBudget -= (u64) BYTE_BITS * CLOCKHZ;
+
+		assert (m_nSensor < SIM_SENSORS);
+		if (m_bRead)
+		{
+			m_FIFO[m_nFIFOIn++ % FIFO_SIZE] =
+				m_Registers[m_nSensor][m_Pointer[m_nSensor]++];
+			m_nFIFOCount++;
+		}
+		else
+		{
+			u8 ucData = m_FIFO[(m_nFIFOIn - m_nFIFOCount--) % FIFO_SIZE];
+
+			// the first written byte selects the register
+			if (m_bFirstByte)
+			{
+				m_Pointer[m_nSensor] = ucData;
+				m_bFirstByte = FALSE;
+			}
+			else
+			{
+				m_Registers[m_nSensor][m_Pointer[m_nSensor]++] = ucData;
+			}
+		}
+
+		m_nBytesLeft--;
+		m_nBytesTransferred++;
+	}
+}
+
+boolean CSimulatedI2CMaster::IsInterruptPending (void) const
+{
+	u32 nStatus = GetStatus ();
+
+	return    ((m_nControl & C_INTR) && (nStatus & S_RXR))
+	       || ((m_nControl & C_INTT) && (nStatus & S_TXW))
+	       || ((m_nControl & C_INTD) && (nStatus & S_DONE));
+}
+
+u32 CSimulatedI2CMaster::GetStatus (void) const
+{
+	u32 nStatus = m_nStatus;
+
+	if (m_nFIFOCount > 0)
+	{
+		nStatus |= S_RXD;
+	}
+	else
+	{
+		nStatus |= S_TXE;
+	}
+
+	if (m_nFIFOCount < FIFO_SIZE)
+	{
+		nStatus |= S_TXD;
+	}
+	else
+	{
+		nStatus |= S_RXF;
+	}
+
+	if (m_Phase != PhaseIdle)
+	{
+		if (m_bRead && m_nFIFOCount >= FIFO_SIZE * 3 / 4)
+		{
+			nStatus |= S_RXR;
+		}
+
+		if (!m_bRead && m_nFIFOCount < FIFO_SIZE / 4)
+		{
+			nStatus |= S_TXW;
+		}
+	}
+
+	return nStatus;
+}
+
+void CSimulatedI2CMaster::TimerHandler (CUserTimer *pUserTimer, void *pParam)
+{
+	CSimulatedI2CMaster *pThis = (CSimulatedI2CMaster *) pParam;
+	assert (pThis != 0);
+
+	assert (pUserTimer != 0);
+	pUserTimer->Start (pThis->m_nTickMicros);
+
+	EnterCritical (IRQ_LEVEL);
+
+	pThis->Advance ();
+
+	boolean bInterrupt = pThis->m_bUseInterrupt && pThis->IsInterruptPending ();
+
+	LeaveCritical ();
+
+	// the simulated controller raises its interrupt
+	if (bInterrupt)
+	{
+		pThis->InterruptHandler ();
+	}
+}
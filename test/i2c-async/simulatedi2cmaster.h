@@ -0,0 +1,108 @@
+//
+// simulatedi2cmaster.h
+//
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _simulatedi2cmaster_h
+#define _simulatedi2cmaster_h
+
+#include <circle/i2cmaster.h>
+#include <circle/interrupt.h>
+#include <circle/usertimer.h>
+#include <circle/types.h>
+
+#define SIM_SENSORS		8
+#define SIM_SENSOR_ADDRESS	0x40		// first sensor, the others follow
+#define SIM_SENSOR_REGS		256
+
+// Register level stand-in for the BSC controller. The register accesses of
+// CI2CMaster are redirected to a model of the controller, which drives
+// simulated sensors with the bus timing, derived from the DIV register.
+class CSimulatedI2CMaster : public CI2CMaster
+{
+public:
+	CSimulatedI2CMaster (CInterruptSystem *pInterruptSystem, boolean bUseInterrupt);
+	~CSimulatedI2CMaster (void);
+
+	boolean Initialize (void);
+
+	// expected content of a sensor register
+	static u8 GetSensorValue (u8 ucAddress, u8 ucRegister);
+
+	unsigned GetBytesTransferred (void) const	{ return m_nBytesTransferred; }
+
+protected:
+	u32 ReadReg (unsigned nOffset);
+	void WriteReg (unsigned nOffset, u32 nValue);
+
+private:
+	void Start (boolean bRead, unsigned nLength);
+	void Complete (void);
+	void Advance (void);			// must be called with IRQs disabled
+	boolean IsInterruptPending (void) const;
+
+	u32 GetStatus (void) const;
+
+	static void TimerHandler (CUserTimer *pUserTimer, void *pParam);
+
+private:
+	boolean m_bUseInterrupt;
+	CUserTimer m_Timer;
+	unsigned m_nTickMicros;
+
+	// registers
+	u32 m_nControl;
+	u32 m_nStatus;				// only TA, DONE, ERR, CLKT
+	u32 m_nDataLength;
+	u32 m_nSlaveAddress;
+	u32 m_nDivider;
+
+	u8 m_FIFO[16];
+	unsigned m_nFIFOIn;
+	unsigned m_nFIFOCount;
+
+	// bus state
+	enum TPhase
+	{
+		PhaseIdle,
+		PhaseAddress,
+		PhaseData
+	};
+
+	TPhase m_Phase;
+	boolean m_bRead;
+	unsigned m_nBytesLeft;
+	boolean m_bStartPending;		// repeated start requested
+	boolean m_bPendingRead;
+	unsigned m_nPendingLength;
+
+	unsigned m_nLastTicks;
+	u64 m_nBitBudget;			// bits * CLOCKHZ
+
+	// sensors
+	unsigned m_nSensor;			// active sensor (or SIM_SENSORS)
+	boolean m_bFirstByte;
+	u8 m_Pointer[SIM_SENSORS];
+	u8 m_Registers[SIM_SENSORS][SIM_SENSOR_REGS];
+
+	unsigned m_nCoreClockRate;
+
+	volatile unsigned m_nBytesTransferred;
+};
+
+#endif
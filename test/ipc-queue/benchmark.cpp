@@ -0,0 +1,227 @@
+//
+// benchmark.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "benchmark.h"
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <assert.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+#define ROUND_TRIPS		100000
+#define QUEUE_SIZE		256
+
+#define PRODUCERS		(CORES-1)
+#define MESSAGES		200000		// per producer
+#define INBOX_SIZE		1024
+
+#define MSG_CORE_SHIFT		24
+#define MSG_SEQ_MASK		((1 << MSG_CORE_SHIFT)-1)
+
+static const char FromBenchmark[] = "ipc";
+
+CIPCBenchmark::CIPCBenchmark (CMemorySystem *pMemorySystem)
+:	CMultiCoreSupport (pMemorySystem),
+	m_Phase (PhaseInit),
+	m_Request (QUEUE_SIZE),
+	m_Reply (QUEUE_SIZE),
+	m_Doorbell (1),
+	m_Inbox (INBOX_SIZE),
+	m_bOK (TRUE)
+{
+}
+
+CIPCBenchmark::~CIPCBenchmark (void)
+{
+}
+
+void CIPCBenchmark::Run (unsigned nCore)
+{
+	if (nCore == 0)
+	{
+		EnterPhase (PhaseLatencyPolling);
+		MeasureLatency (FALSE);
+
+		EnterPhase (PhaseLatencyDoorbell);
+		MeasureLatency (TRUE);
+
+		EnterPhase (PhaseThroughput);
+		MeasureThroughput ();
+
+		EnterPhase (PhaseDone);
+
+		return;
+	}
+
+	WaitForPhase (PhaseLatencyPolling);
+	if (nCore == 1)
+	{
+		Echo (FALSE);
+	}
+
+	WaitForPhase (PhaseLatencyDoorbell);
+	if (nCore == 1)
+	{
+		Echo (TRUE);
+	}
+
+	WaitForPhase (PhaseThroughput);
+	Produce (nCore);
+
+	WaitForPhase (PhaseDone);
+}
+
+void CIPCBenchmark::MeasureLatency (boolean bDoorbell)
+{
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	for (uintptr i = 1; i <= ROUND_TRIPS; i++)
+	{
+		while (!m_Request.Put ((void *) i))
+		{
+			// never full, because there is only one message on the way
+		}
+
+		if (bDoorbell)
+		{
+			m_Doorbell.Ring ();
+		}
+
+		void *pReply;
+		while ((pReply = m_Reply.Get ()) == 0)
+		{
+			// just poll
+		}
+
+		if ((uintptr) pReply != i)
+		{
+			CLogger::Get ()->Write (FromBenchmark, LogError, "Invalid reply (%lu, expected %lu)",
+						(uintptr) pReply, i);
+
+			m_bOK = FALSE;
+		}
+	}
+
+	unsigned nTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	CLogger::Get ()->Write (FromBenchmark, LogNotice,
+				"Round trip to core 1 (%s): %u ns",
+				bDoorbell ? "doorbell" : "polling",
+				(unsigned) ((u64) nTicks * (1000000000 / CLOCKHZ) / ROUND_TRIPS));
+}
+
+void CIPCBenchmark::Echo (boolean bDoorbell)
+{
+	for (unsigned i = 0; i < ROUND_TRIPS; i++)
+	{
+		void *pRequest;
+		while ((pRequest = m_Request.Get ()) == 0)
+		{
+			if (bDoorbell)
+			{
+				m_Doorbell.Wait ();
+			}
+		}
+
+		while (!m_Reply.Put (pRequest))
+		{
+			// never full
+		}
+	}
+}
+
+void CIPCBenchmark::MeasureThroughput (void)
+{
+	unsigned NextSeq[CORES];
+	for (unsigned i = 0; i < CORES; i++)
+	{
+		NextSeq[i] = 0;
+	}
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	for (unsigned nReceived = 0; nReceived < PRODUCERS * MESSAGES; nReceived++)
+	{
+		void *pMessage;
+		while (!m_Inbox.Dequeue (&pMessage))
+		{
+			// just poll
+		}
+
+		// messages from the same producer must arrive in order
+		unsigned nCore = (uintptr) pMessage >> MSG_CORE_SHIFT;
+		unsigned nSeq = (uintptr) pMessage & MSG_SEQ_MASK;
+		if (   nCore == 0
+		    || nCore >= CORES
+		    || nSeq != NextSeq[nCore])
+		{
+			CLogger::Get ()->Write (FromBenchmark, LogError, "Invalid message 0x%lX",
+						(uintptr) pMessage);
+
+			m_bOK = FALSE;
+
+			return;
+		}
+
+		NextSeq[nCore]++;
+	}
+
+	unsigned nTicks = CTimer::GetClockTicks () - nStartTicks;
+	if (nTicks == 0)
+	{
+		nTicks = 1;
+	}
+
+	CLogger::Get ()->Write (FromBenchmark, LogNotice,
+				"%u producers -> core 0: %u messages per second",
+				PRODUCERS,
+				(unsigned) ((u64) PRODUCERS * MESSAGES * CLOCKHZ / nTicks));
+}
+
+void CIPCBenchmark::Produce (unsigned nCore)
+{
+	assert (1 <= nCore && nCore < CORES);
+
+	for (uintptr i = 0; i < MESSAGES; i++)
+	{
+		void *pMessage = (void *) ((uintptr) nCore << MSG_CORE_SHIFT | i);
+
+		while (!m_Inbox.Enqueue (pMessage))
+		{
+			// inbox is full, wait for core 0
+		}
+	}
+}
+
+void CIPCBenchmark::EnterPhase (TPhase Phase)
+{
+	m_Phase = Phase;
+
+	DataSyncBarrier ();
+}
+
+void CIPCBenchmark::WaitForPhase (TPhase Phase)
+{
+	while (m_Phase < Phase)
+	{
+		DataMemBarrier ();
+	}
+}
+
+#endif
@@ -0,0 +1,77 @@
+//
+// benchmark.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _benchmark_h
+#define _benchmark_h
+
+#include <circle/multicore.h>
+#include <circle/memory.h>
+#include <circle/spscqueue.h>
+#include <circle/mpmcqueue.h>
+#include <circle/doorbell.h>
+#include <circle/types.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+class CIPCBenchmark : public CMultiCoreSupport
+{
+public:
+	CIPCBenchmark (CMemorySystem *pMemorySystem);
+	~CIPCBenchmark (void);
+
+	void Run (unsigned nCore);
+
+	boolean GetResult (void) const		{ return m_bOK; }
+
+private:
+	// core 0
+	void MeasureLatency (boolean bDoorbell);
+	void MeasureThroughput (void);
+
+	// secondary cores
+	void Echo (boolean bDoorbell);
+	void Produce (unsigned nCore);
+
+	enum TPhase
+	{
+		PhaseInit,
+		PhaseLatencyPolling,
+		PhaseLatencyDoorbell,
+		PhaseThroughput,
+		PhaseDone
+	};
+
+	void EnterPhase (TPhase Phase);		// on core 0
+	void WaitForPhase (TPhase Phase);	// on secondary cores
+
+private:
+	volatile TPhase m_Phase;
+
+	CSPSCQueue m_Request;		// core 0 -> core 1
+	CSPSCQueue m_Reply;		// core 1 -> core 0
+	CDoorbell m_Doorbell;		// wakes core 1
+
+	CMPMCQueue m_Inbox;		// cores 1-3 -> core 0
+
+	boolean m_bOK;
+};
+
+#endif
+
+#endif
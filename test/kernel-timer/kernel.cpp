@@ -0,0 +1,258 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/util.h>
+#include <assert.h>
+
+#define ARMED_TIMERS		10000
+#define BENCHMARK_TIMERS	10000		// started and cancelled per round
+#define BENCHMARK_ROUNDS	10
+#define MAX_DELAY_HZ		(100 * HZ)
+
+#define HIGHRES_TESTS		200
+#define HIGHRES_MAX_DELAY	5000		// microseconds
+
+#define IDLE_SECONDS		10
+#define LATENCY_SAMPLE_RATE	25000		// IRQs per second
+
+static const char FromKernel[] = "kernel";
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_Latency (&m_Interrupt),
+	m_nRandom (1)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	MeasureIdle ();
+
+	BenchmarkStartCancel (0);
+	BenchmarkStartCancel (ARMED_TIMERS);
+
+	TestHighResTimer ();
+
+	m_Logger.Write (FromKernel, LogNotice, "Test completed");
+
+	return ShutdownHalt;
+}
+
+void CKernel::MeasureIdle (void)
+{
+#ifdef USE_TICKLESS_TIMER
+	m_Logger.Write (FromKernel, LogNotice, "Tickless timer mode");
+#else
+	m_Logger.Write (FromKernel, LogNotice, "Periodic timer mode (%u Hz)", HZ);
+#endif
+
+	m_Latency.Start (LATENCY_SAMPLE_RATE);
+
+	unsigned nInterrupts = m_Timer.GetInterruptCount ();
+
+	unsigned nStartTicks = m_Timer.GetTicks ();
+	while (m_Timer.GetTicks () - nStartTicks < IDLE_SECONDS * HZ)
+	{
+		// just wait
+	}
+
+	nInterrupts = m_Timer.GetInterruptCount () - nInterrupts;
+
+	m_Latency.Stop ();
+
+	m_Logger.Write (FromKernel, LogNotice, "%u timer interrupts in %u seconds idle time",
+			nInterrupts, IDLE_SECONDS);
+
+	m_Latency.Dump ();
+}
+
+void CKernel::BenchmarkStartCancel (unsigned nArmedTimers)
+{
+	TKernelTimerHandle *pArmed = new TKernelTimerHandle[nArmedTimers + BENCHMARK_TIMERS];
+	assert (pArmed != 0);
+	TKernelTimerHandle *pTimers = pArmed + nArmedTimers;
+
+	unsigned *pDelay = new unsigned[BENCHMARK_TIMERS];
+	assert (pDelay != 0);
+
+	for (unsigned i = 0; i < nArmedTimers; i++)
+	{
+		pArmed[i] = m_Timer.StartKernelTimer (HZ + Random () % MAX_DELAY_HZ, TimerHandler, this);
+	}
+
+	unsigned nStartTicks = 0;
+	unsigned nCancelTicks = 0;
+
+	for (unsigned nRound = 0; nRound < BENCHMARK_ROUNDS; nRound++)
+	{
+		for (unsigned i = 0; i < BENCHMARK_TIMERS; i++)
+		{
+			pDelay[i] = HZ + Random () % MAX_DELAY_HZ;
+		}
+
+		unsigned nClockTicks = CTimer::GetClockTicks ();
+
+		for (unsigned i = 0; i < BENCHMARK_TIMERS; i++)
+		{
+			pTimers[i] = m_Timer.StartKernelTimer (pDelay[i], TimerHandler, this);
+		}
+
+		nStartTicks += CTimer::GetClockTicks () - nClockTicks;
+
+		// cancel in a different order than started
+		nClockTicks = CTimer::GetClockTicks ();
+
+		for (unsigned i = 0; i < BENCHMARK_TIMERS; i++)
+		{
+			m_Timer.CancelKernelTimer (pTimers[(i * 7919) % BENCHMARK_TIMERS]);
+		}
+
+		nCancelTicks += CTimer::GetClockTicks () - nClockTicks;
+	}
+
+	for (unsigned i = 0; i < nArmedTimers; i++)
+	{
+		m_Timer.CancelKernelTimer (pArmed[i]);
+	}
+
+	delete [] pDelay;
+	delete [] pArmed;
+
+	unsigned nOperations = BENCHMARK_TIMERS * BENCHMARK_ROUNDS;
+	m_Logger.Write (FromKernel, LogNotice,
+			"%5u armed timers: start %u ns, cancel %u ns",
+			nArmedTimers,
+			(unsigned) ((u64) nStartTicks * 1000000000 / CLOCKHZ / nOperations),
+			(unsigned) ((u64) nCancelTicks * 1000000000 / CLOCKHZ / nOperations));
+}
+
+void CKernel::TestHighResTimer (void)
+{
+	unsigned nLatencyMin = (unsigned) -1;
+	unsigned nLatencyMax = 0;
+	u64 nLatencySum = 0;
+
+	for (unsigned i = 0; i < HIGHRES_TESTS; i++)
+	{
+		unsigned nDelay = 1 + Random () % HIGHRES_MAX_DELAY;
+
+		m_nFiredAt = 0;
+
+		unsigned nStartTicks = CTimer::GetClockTicks ();
+		m_Timer.StartHighResTimer (nDelay, HighResTimerHandler, this);
+
+		while (m_nFiredAt == 0)
+		{
+			// just wait
+		}
+
+		int nLatency = (int) (m_nFiredAt - nStartTicks - nDelay);
+		if (nLatency < 0)
+		{
+			m_Logger.Write (FromKernel, LogPanic, "Timer elapsed %d us early", -nLatency);
+		}
+
+		if ((unsigned) nLatency < nLatencyMin)
+		{
+			nLatencyMin = nLatency;
+		}
+
+		if ((unsigned) nLatency > nLatencyMax)
+		{
+			nLatencyMax = nLatency;
+		}
+
+		nLatencySum += nLatency;
+	}
+
+	m_Logger.Write (FromKernel, LogNotice,
+			"High-res timer latency: min %u us, avg %u us, max %u us",
+			nLatencyMin, (unsigned) (nLatencySum / HIGHRES_TESTS), nLatencyMax);
+}
+
+void CKernel::TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CKernel *pThis = static_cast<CKernel *> (pParam);
+	assert (pThis != 0);
+
+	pThis->m_Logger.Write (FromKernel, LogPanic, "Benchmark timer elapsed");
+}
+
+void CKernel::HighResTimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CKernel *pThis = static_cast<CKernel *> (pParam);
+	assert (pThis != 0);
+
+	pThis->m_nFiredAt = CTimer::GetClockTicks ();
+}
+
+unsigned CKernel::Random (void)
+{
+	m_nRandom = m_nRandom * 1103515245 + 12345;
+
+	return m_nRandom >> 8;
+}
@@ -0,0 +1,181 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/util.h>
+#include <assert.h>
+
+#define ROUNDS		3
+
+static const char FromKernel[] = "kernel";
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_nErrors (0)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Logger.Initialize (&m_Screen);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	// the immutable values are cached after the first round
+	for (unsigned nRound = 1; nRound <= ROUNDS; nRound++)
+	{
+		TTags Tags1, Tags2;
+
+		unsigned nSequential = GetSequential (&Tags1);
+		unsigned nBatched = GetBatched (&Tags2);
+
+		m_Logger.Write (FromKernel, LogNotice, "Round %u: Sequential %u us, batched %u us",
+				nRound, nSequential, nBatched);
+
+		Compare (Tags1, Tags2);
+	}
+
+	if (m_nErrors == 0)
+	{
+		m_Logger.Write (FromKernel, LogNotice, "Test passed");
+	}
+	else
+	{
+		m_Logger.Write (FromKernel, LogError, "Test failed with %u error(s)", m_nErrors);
+	}
+
+	return ShutdownHalt;
+}
+
+unsigned CKernel::GetSequential (TTags *pTags)
+{
+	assert (pTags != 0);
+	memset (pTags, 0, sizeof *pTags);
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	CBcmPropertyTags Tags;
+	boolean bOK = Tags.GetTag (PROPTAG_GET_BOARD_REVISION, &pTags->BoardRevision,
+				   sizeof pTags->BoardRevision);
+	bOK = Tags.GetTag (PROPTAG_GET_ARM_MEMORY, &pTags->ARMMemory, sizeof pTags->ARMMemory) && bOK;
+	bOK = Tags.GetTag (PROPTAG_GET_VC_MEMORY, &pTags->VCMemory, sizeof pTags->VCMemory) && bOK;
+	pTags->MaxClockRate.nClockId = CLOCK_ID_ARM;
+	bOK = Tags.GetTag (PROPTAG_GET_MAX_CLOCK_RATE, &pTags->MaxClockRate,
+			   sizeof pTags->MaxClockRate, 4) && bOK;
+	pTags->ClockRate.nClockId = CLOCK_ID_CORE;
+	bOK = Tags.GetTag (PROPTAG_GET_CLOCK_RATE, &pTags->ClockRate,
+			   sizeof pTags->ClockRate, 4) && bOK;
+	pTags->Temperature.nTemperatureId = TEMPERATURE_ID;
+	bOK = Tags.GetTag (PROPTAG_GET_TEMPERATURE, &pTags->Temperature,
+			   sizeof pTags->Temperature, 4) && bOK;
+
+	unsigned nDuration = CTimer::GetClockTicks () - nStartTicks;
+
+	if (!bOK)
+	{
+		m_Logger.Write (FromKernel, LogError, "Sequential request failed");
+
+		m_nErrors++;
+	}
+
+	return nDuration;
+}
+
+unsigned CKernel::GetBatched (TTags *pTags)
+{
+	assert (pTags != 0);
+	memset (pTags, 0, sizeof *pTags);
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	CBcmPropertyTags Tags;
+	Tags.AddTag (PROPTAG_GET_BOARD_REVISION, &pTags->BoardRevision,
+		     sizeof pTags->BoardRevision);
+	Tags.AddTag (PROPTAG_GET_ARM_MEMORY, &pTags->ARMMemory, sizeof pTags->ARMMemory);
+	Tags.AddTag (PROPTAG_GET_VC_MEMORY, &pTags->VCMemory, sizeof pTags->VCMemory);
+	pTags->MaxClockRate.nClockId = CLOCK_ID_ARM;
+	Tags.AddTag (PROPTAG_GET_MAX_CLOCK_RATE, &pTags->MaxClockRate,
+		     sizeof pTags->MaxClockRate, 4);
+	pTags->ClockRate.nClockId = CLOCK_ID_CORE;
+	Tags.AddTag (PROPTAG_GET_CLOCK_RATE, &pTags->ClockRate, sizeof pTags->ClockRate, 4);
+	pTags->Temperature.nTemperatureId = TEMPERATURE_ID;
+	Tags.AddTag (PROPTAG_GET_TEMPERATURE, &pTags->Temperature, sizeof pTags->Temperature, 4);
+	boolean bOK = Tags.SubmitTags ();
+
+	unsigned nDuration = CTimer::GetClockTicks () - nStartTicks;
+
+	if (!bOK)
+	{
+		m_Logger.Write (FromKernel, LogError, "Batched request failed");
+
+		m_nErrors++;
+	}
+
+	return nDuration;
+}
+
+void CKernel::Compare (const TTags &Tags1, const TTags &Tags2)
+{
+	// the temperature may have changed in between and is not compared
+	if (   Tags1.BoardRevision.nValue != Tags2.BoardRevision.nValue
+	    || Tags1.ARMMemory.nBaseAddress != Tags2.ARMMemory.nBaseAddress
+	    || Tags1.ARMMemory.nSize != Tags2.ARMMemory.nSize
+	    || Tags1.VCMemory.nBaseAddress != Tags2.VCMemory.nBaseAddress
+	    || Tags1.VCMemory.nSize != Tags2.VCMemory.nSize
+	    || Tags1.MaxClockRate.nRate != Tags2.MaxClockRate.nRate
+	    || Tags1.ClockRate.nRate != Tags2.ClockRate.nRate
+	    || Tags2.Temperature.nValue == 0)
+	{
+		m_Logger.Write (FromKernel, LogError, "Values differ");
+
+		m_nErrors++;
+	}
+}
@@ -0,0 +1,359 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/sched/task.h>
+#include <circle/sched/mutex.h>
+#include <circle/sched/semaphore.h>
+#include <assert.h>
+
+#define PRIME_TASKS		8
+#define PRIME_LIMIT		400000
+#define PRIME_COUNT		33860		// number of primes below PRIME_LIMIT
+#define PRIME_YIELD		1000		// call Yield() after this many numbers
+
+#define COUNTER_TASKS		6
+#define COUNTER_ITERATIONS	2000
+
+#define ALL_CORES		((1 << SCHEDULER_CORES)-1)
+
+static const char FromKernel[] = "kernel";
+
+static unsigned ThisCore (void)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	return CMultiCoreSupport::ThisCore ();
+#else
+	return 0;
+#endif
+}
+
+class CPrimeTask : public CTask		// counts the prime numbers in a range
+{
+public:
+	CPrimeTask (unsigned nFrom, unsigned nTo, unsigned nAffinity,
+		    unsigned *pResult, unsigned *pCoreMask)
+	:	CTask (TASK_STACK_SIZE, TRUE),	// may start on another core at once otherwise
+		m_nFrom (nFrom),
+		m_nTo (nTo),
+		m_pResult (pResult),
+		m_pCoreMask (pCoreMask)
+	{
+		SetAffinity (nAffinity);
+
+		Start ();
+	}
+
+	void Run (void)
+	{
+		unsigned nCount = 0;
+		unsigned nCoreMask = 0;
+
+		for (unsigned n = m_nFrom; n < m_nTo; n++)
+		{
+			if (IsPrime (n))
+			{
+				nCount++;
+			}
+
+			if ((n - m_nFrom) % PRIME_YIELD == 0)
+			{
+				nCoreMask |= 1 << ThisCore ();
+
+				CScheduler::Get ()->Yield ();
+			}
+		}
+
+		*m_pResult = nCount;
+		*m_pCoreMask = nCoreMask | 1 << ThisCore ();
+	}
+
+private:
+	static boolean IsPrime (unsigned n)
+	{
+		if (n < 2)
+		{
+			return FALSE;
+		}
+
+		for (unsigned d = 2; d * d <= n; d++)
+		{
+			if (n % d == 0)
+			{
+				return FALSE;
+			}
+		}
+
+		return TRUE;
+	}
+
+private:
+	unsigned m_nFrom;
+	unsigned m_nTo;
+	unsigned *m_pResult;
+	unsigned *m_pCoreMask;
+};
+
+class CCounterTask : public CTask	// increments a shared counter in a critical section
+{
+public:
+	CCounterTask (volatile unsigned *pCounter, CMutex *pMutex, CSemaphore *pSemaphore)
+	:	CTask (TASK_STACK_SIZE, TRUE),
+		m_pCounter (pCounter),
+		m_pMutex (pMutex),
+		m_pSemaphore (pSemaphore)
+	{
+		Start ();
+	}
+
+	void Run (void)
+	{
+		for (unsigned i = 0; i < COUNTER_ITERATIONS; i++)
+		{
+			if (m_pMutex != 0)
+			{
+				m_pMutex->Acquire ();
+			}
+			else
+			{
+				m_pSemaphore->Down ();
+			}
+
+			unsigned nValue = *m_pCounter;
+
+			// let other tasks try to enter the critical section in the meantime
+			if (i % 16 == 0)
+			{
+				CScheduler::Get ()->Yield ();
+			}
+
+			*m_pCounter = nValue + 1;
+
+			if (m_pMutex != 0)
+			{
+				m_pMutex->Release ();
+			}
+			else
+			{
+				m_pSemaphore->Up ();
+			}
+		}
+	}
+
+private:
+	volatile unsigned *m_pCounter;
+	CMutex *m_pMutex;
+	CSemaphore *m_pSemaphore;
+};
+
+CSchedulerCores::CSchedulerCores (CMemorySystem *pMemorySystem)
+#ifdef ARM_ALLOW_MULTI_CORE
+:	CMultiCoreSupport (pMemorySystem)
+#endif
+{
+}
+
+void CSchedulerCores::Run (unsigned nCore)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	if (nCore > 0)
+	{
+		CScheduler::Get ()->EnterSecondaryCore ();
+	}
+#endif
+}
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_SchedulerCores (CMemorySystem::Get ())
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_SchedulerCores.Initialize ();	// must be initialized at last
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+#ifndef ARM_ALLOW_MULTI_CORE
+	m_Logger.Write (FromKernel, LogWarning, "ARM_ALLOW_MULTI_CORE is not defined");
+#endif
+
+	m_Logger.Write (FromKernel, LogNotice, "Counting primes below %u with %u tasks",
+			PRIME_LIMIT, PRIME_TASKS);
+
+	unsigned nSingleMsecs = BenchmarkPrimes (1 << 0);
+	unsigned nAllMsecs = BenchmarkPrimes (ALL_CORES);
+
+	if (nAllMsecs > 0)
+	{
+		unsigned nSpeedup = nSingleMsecs * 100 / nAllMsecs;
+
+		m_Logger.Write (FromKernel, LogNotice, "Speedup with %u cores: %u.%02u",
+				SCHEDULER_CORES, nSpeedup / 100, nSpeedup % 100);
+	}
+
+	boolean bOK = TestMutex ();
+	bOK = TestSemaphore () && bOK;
+
+	m_Logger.Write (FromKernel, LogNotice, bOK ? "Test passed" : "Test failed");
+
+	m_Scheduler.Sleep (1);
+
+	return ShutdownHalt;
+}
+
+unsigned CKernel::BenchmarkPrimes (unsigned nAffinity)
+{
+	unsigned Result[PRIME_TASKS];
+	unsigned CoreMask[PRIME_TASKS];
+	CPrimeTask *pTask[PRIME_TASKS];
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	for (unsigned i = 0; i < PRIME_TASKS; i++)
+	{
+		Result[i] = 0;
+		CoreMask[i] = 0;
+
+		pTask[i] = new CPrimeTask (PRIME_LIMIT / PRIME_TASKS * i,
+					   PRIME_LIMIT / PRIME_TASKS * (i+1),
+					   nAffinity, &Result[i], &CoreMask[i]);
+		assert (pTask[i] != 0);
+	}
+
+	for (unsigned i = 0; i < PRIME_TASKS; i++)
+	{
+		pTask[i]->WaitForTermination ();
+	}
+
+	unsigned nMsecs = (CTimer::GetClockTicks () - nStartTicks) / (CLOCKHZ / 1000);
+
+	unsigned nCount = 0;
+	unsigned nCoresUsed = 0;
+	for (unsigned i = 0; i < PRIME_TASKS; i++)
+	{
+		nCount += Result[i];
+		nCoresUsed |= CoreMask[i];
+	}
+
+	m_Logger.Write (FromKernel, nCount == PRIME_COUNT ? LogNotice : LogError,
+			"Affinity 0x%X: %u primes in %u ms (ran on cores 0x%X)",
+			nAffinity, nCount, nMsecs, nCoresUsed);
+
+	return nMsecs;
+}
+
+boolean CKernel::TestMutex (void)
+{
+	CMutex Mutex;
+	volatile unsigned nCounter = 0;
+	CTask *pTask[COUNTER_TASKS];
+
+	for (unsigned i = 0; i < COUNTER_TASKS; i++)
+	{
+		pTask[i] = new CCounterTask (&nCounter, &Mutex, 0);
+		assert (pTask[i] != 0);
+	}
+
+	for (unsigned i = 0; i < COUNTER_TASKS; i++)
+	{
+		pTask[i]->WaitForTermination ();
+	}
+
+	boolean bOK = nCounter == COUNTER_TASKS * COUNTER_ITERATIONS;
+
+	m_Logger.Write (FromKernel, bOK ? LogNotice : LogError, "Mutex counter: %u (should be %u)",
+			nCounter, COUNTER_TASKS * COUNTER_ITERATIONS);
+
+	return bOK;
+}
+
+boolean CKernel::TestSemaphore (void)
+{
+	CSemaphore Semaphore (1);
+	volatile unsigned nCounter = 0;
+	CTask *pTask[COUNTER_TASKS];
+
+	for (unsigned i = 0; i < COUNTER_TASKS; i++)
+	{
+		pTask[i] = new CCounterTask (&nCounter, 0, &Semaphore);
+		assert (pTask[i] != 0);
+	}
+
+	for (unsigned i = 0; i < COUNTER_TASKS; i++)
+	{
+		pTask[i]->WaitForTermination ();
+	}
+
+	boolean bOK = nCounter == COUNTER_TASKS * COUNTER_ITERATIONS;
+
+	m_Logger.Write (FromKernel, bOK ? LogNotice : LogError, "Semaphore counter: %u (should be %u)",
+			nCounter, COUNTER_TASKS * COUNTER_ITERATIONS);
+
+	return bOK;
+}
@@ -0,0 +1,160 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/util.h>
+#include <assert.h>
+
+#define MEASURE_MS		3000
+#define WORK_LOOPS		100		// per work unit
+#define BUFFER_SIZE		8192		// characters
+
+static const char FromKernel[] = "kernel";
+
+static const unsigned Baudrates[] = {921600, 3000000};
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_nReferenceUnits (0)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Logger.Initialize (&m_Screen);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	// work units, which can be done without serial output
+	m_nReferenceUnits = RunWorkload (0, 0);
+	assert (m_nReferenceUnits > 0);
+
+	m_Logger.Write (FromKernel, LogNotice, "Reference: %u work units", m_nReferenceUnits);
+
+	for (unsigned i = 0; i < sizeof Baudrates / sizeof Baudrates[0]; i++)
+	{
+		Measure (Baudrates[i], FALSE);
+		Measure (Baudrates[i], TRUE);
+	}
+
+	return ShutdownHalt;
+}
+
+void CKernel::Measure (unsigned nBaudrate, boolean bUseDMA)
+{
+	CSerialDevice *pSerial = new CSerialDevice (&m_Interrupt, FALSE, 0, BUFFER_SIZE, bUseDMA);
+	assert (pSerial != 0);
+
+	if (!pSerial->Initialize (nBaudrate))
+	{
+		m_Logger.Write (FromKernel, LogPanic, "Cannot initialize serial device");
+	}
+
+	unsigned nBytesSent;
+	unsigned nUnits = RunWorkload (pSerial, &nBytesSent);
+
+	delete pSerial;
+
+	unsigned nLoad = 0;
+	if (nUnits < m_nReferenceUnits)
+	{
+		nLoad = (m_nReferenceUnits - nUnits) * 1000ULL / m_nReferenceUnits;
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "%7u Bd, %s: CPU load %u.%u%%, %u bytes/s",
+			nBaudrate, bUseDMA ? "DMA" : "IRQ", nLoad / 10, nLoad % 10,
+			(unsigned) (nBytesSent * 1000ULL / MEASURE_MS));
+}
+
+unsigned CKernel::RunWorkload (CSerialDevice *pSerial, unsigned *pBytesSent)
+{
+	static const char Telemetry[] =
+		"T 0123456789 ax=+0.012 ay=-0.981 az=+0.034 gx=+1.25 gy=-0.50 gz=+0.00\n";
+
+	unsigned nOffset = 0;
+	unsigned nBytesSent = 0;
+	unsigned nUnits = 0;
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	while (CTimer::GetClockTicks () - nStartTicks < MEASURE_MS * 1000)
+	{
+		// keep the TX buffer filled
+		if (pSerial != 0)
+		{
+			int nResult = pSerial->Write (Telemetry + nOffset, sizeof Telemetry-1 - nOffset);
+			if (nResult > 0)
+			{
+				nBytesSent += nResult;
+
+				nOffset += nResult;
+				if (nOffset == sizeof Telemetry-1)
+				{
+					nOffset = 0;
+				}
+			}
+		}
+
+		// do some work
+		for (volatile unsigned i = 0; i < WORK_LOOPS; i++)
+		{
+			// just count
+		}
+
+		nUnits++;
+	}
+
+	if (pBytesSent != 0)
+	{
+		*pBytesSent = nBytesSent;
+	}
+
+	return nUnits;
+}
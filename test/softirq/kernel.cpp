@@ -0,0 +1,180 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/softirq.h>
+#include <assert.h>
+
+#define LOAD_MICROS		500		// processing time per IRQ
+#define LOAD_PRIORITY		10		// of the IRQ thread
+#define MEASURE_SECONDS		5
+#define LATENCY_SAMPLE_RATE	25000		// IRQs per second
+
+static const char FromKernel[] = "kernel";
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_Latency (&m_Interrupt),
+	m_pIRQThread (0),
+	m_LoadMode (LoadNone),
+	m_bLoadActive (FALSE),
+	m_nLoadRuns (0)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	m_pIRQThread = new CIRQThread (ProcessLoad, this, LOAD_PRIORITY, "load");
+	assert (m_pIRQThread != 0);
+
+	for (unsigned i = LoadNone; i < LoadUnknown; i++)
+	{
+		Measure ((TLoadMode) i);
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "IRQ thread: %u wakeups, %u runs",
+			m_pIRQThread->GetWakeups (), m_pIRQThread->GetRuns ());
+
+	m_pIRQThread->Stop ();
+	m_pIRQThread = 0;
+
+	m_Logger.Write (FromKernel, LogNotice, "%u soft IRQs lost", CSoftIRQ::GetOverflows ());
+
+	m_Scheduler.Sleep (1);
+
+	return ShutdownHalt;
+}
+
+void CKernel::Measure (TLoadMode Mode)
+{
+	static const char *LoadModeName[LoadUnknown] =
+	{
+		"none",
+		"hard IRQ",
+		"soft IRQ",
+		"IRQ thread"
+	};
+
+	m_LoadMode = Mode;
+	m_nLoadRuns = 0;
+
+	m_bLoadActive = TRUE;
+	m_Timer.StartKernelTimer (1, TimerHandler, this);
+
+	m_Latency.Start (LATENCY_SAMPLE_RATE);
+
+	m_Scheduler.Sleep (MEASURE_SECONDS);
+
+	m_Latency.Stop ();
+
+	m_bLoadActive = FALSE;
+	m_Scheduler.MsSleep (100);		// let the last timer elapse
+
+	m_Logger.Write (FromKernel, LogNotice,
+			"Load %s (%u runs): IRQ latency Min %u Max %u Avg %u (us)",
+			LoadModeName[Mode], m_nLoadRuns,
+			m_Latency.GetMin (), m_Latency.GetMax (), m_Latency.GetAvg ());
+}
+
+void CKernel::TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CKernel *pThis = (CKernel *) pParam;
+	assert (pThis != 0);
+
+	switch (pThis->m_LoadMode)
+	{
+	case LoadHardIRQ:
+		ProcessLoad (pThis);
+		break;
+
+	case LoadSoftIRQ:
+		CSoftIRQ::Raise (ProcessLoad, pThis);
+		break;
+
+	case LoadThread:
+		assert (pThis->m_pIRQThread != 0);
+		pThis->m_pIRQThread->Wake ();
+		break;
+
+	default:
+		break;
+	}
+
+	if (pThis->m_bLoadActive)
+	{
+		pThis->m_Timer.StartKernelTimer (1, TimerHandler, pThis);
+	}
+}
+
+void CKernel::ProcessLoad (void *pParam)
+{
+	CKernel *pThis = (CKernel *) pParam;
+	assert (pThis != 0);
+
+	CTimer::SimpleusDelay (LOAD_MICROS);	// simulates driver processing
+
+	pThis->m_nLoadRuns++;
+}
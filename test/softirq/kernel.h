@@ -0,0 +1,90 @@
+//
+// kernel.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _kernel_h
+#define _kernel_h
+
+#include <circle/actled.h>
+#include <circle/koptions.h>
+#include <circle/devicenameservice.h>
+#include <circle/screen.h>
+#include <circle/serial.h>
+#include <circle/exceptionhandler.h>
+#include <circle/interrupt.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <circle/latencytester.h>
+#include <circle/sched/scheduler.h>
+#include <circle/sched/irqthread.h>
+#include <circle/types.h>
+
+enum TShutdownMode
+{
+	ShutdownNone,
+	ShutdownHalt,
+	ShutdownReboot
+};
+
+class CKernel
+{
+public:
+	CKernel (void);
+	~CKernel (void);
+
+	boolean Initialize (void);
+
+	TShutdownMode Run (void);
+
+private:
+	enum TLoadMode
+	{
+		LoadNone,
+		LoadHardIRQ,		// processing in the IRQ handler
+		LoadSoftIRQ,		// processing deferred with CSoftIRQ
+		LoadThread,		// processing in a CIRQThread
+		LoadUnknown
+	};
+
+	void Measure (TLoadMode Mode);
+
+	static void TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
+	static void ProcessLoad (void *pParam);
+
+private:
+	// do not change this order
+	CActLED			m_ActLED;
+	CKernelOptions		m_Options;
+	CDeviceNameService	m_DeviceNameService;
+	CScreenDevice		m_Screen;
+	CSerialDevice		m_Serial;
+	CExceptionHandler	m_ExceptionHandler;
+	CInterruptSystem	m_Interrupt;
+	CTimer			m_Timer;
+	CLogger			m_Logger;
+	CScheduler		m_Scheduler;
+	CLatencyTester		m_Latency;
+
+	CIRQThread	       *m_pIRQThread;
+
+	volatile TLoadMode m_LoadMode;
+	volatile boolean m_bLoadActive;
+	volatile unsigned m_nLoadRuns;
+};
+
+#endif
@@ -0,0 +1,408 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/util.h>
+#include <assert.h>
+
+#define PI		3.14159265358979323846
+
+#define PERIOD_FRAMES	48			// output period of the test signal
+#define SKIP_FRAMES	4800			// filter settling time
+#define BLOCK_FRAMES	256
+
+#define DRIFT_RATE	48000
+#define DRIFT_SECS	600			// simulated stream duration
+#define DRIFT_QUEUE	(DRIFT_RATE / 2)
+
+static const char FromKernel[] = "kernel";
+
+static const char *QualityName[] = {"low", "medium", "high"};
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	static const unsigned Rates[][2] =
+	{
+		{44100, 48000},
+		{48000, 44100},
+		{22050, 48000},
+		{96000, 48000},
+		{8000, 48000}
+	};
+
+	for (unsigned nQuality = SRCQualityLow; nQuality < SRCQualityUnknown; nQuality++)
+	{
+		for (unsigned i = 0; i < sizeof Rates / sizeof Rates[0]; i++)
+		{
+			TestConversion (Rates[i][0], Rates[i][1], (TSRCQuality) nQuality);
+		}
+	}
+
+	static const int Drift[] = {-500, -100, 0, 100, 500};
+	for (unsigned i = 0; i < sizeof Drift / sizeof Drift[0]; i++)
+	{
+		TestDrift (Drift[i], 48, FALSE);	// USB (1 ms chunks)
+		TestDrift (Drift[i], 48, TRUE);		// USB with feedback endpoint
+		TestDrift (Drift[i], 4096, FALSE);	// DMA based devices
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "Test completed");
+
+	return ShutdownHalt;
+}
+
+void CKernel::TestConversion (unsigned nInputRate, unsigned nOutputRate, TSRCQuality Quality)
+{
+	// one second of input, the output contains an integral number of periods
+	unsigned nInputFrames = nInputRate;
+	unsigned nOutputFrames = nOutputRate + PERIOD_FRAMES;
+
+	s32 *pInput = new s32[nInputFrames * 2];
+	s32 *pOutput = new s32[nOutputFrames * 2];
+	assert (pInput != 0);
+	assert (pOutput != 0);
+
+	GenerateSine (pInput, nInputFrames, 2.0 * PI * nOutputRate / PERIOD_FRAMES / nInputRate,
+		      0.5 * ((1 << 23) - 1));
+
+	CSampleRateConverter Converter (2);
+	if (!Converter.Setup (nInputRate, nOutputRate, Quality))
+	{
+		m_Logger.Write (FromKernel, LogPanic, "Cannot setup converter");
+	}
+
+	// convert in blocks, like a sound driver would do
+	unsigned nInputDone = 0;
+	unsigned nOutputDone = 0;
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	while (   nInputDone < nInputFrames
+	       && nOutputDone < nOutputFrames)
+	{
+		unsigned nFrames = nInputFrames - nInputDone;
+		if (nFrames > BLOCK_FRAMES)
+		{
+			nFrames = BLOCK_FRAMES;
+		}
+
+		unsigned nOutFrames = nOutputFrames - nOutputDone;
+		if (nOutFrames > BLOCK_FRAMES)
+		{
+			nOutFrames = BLOCK_FRAMES;
+		}
+
+		nOutputDone += Converter.Process (pInput + nInputDone*2, &nFrames,
+						  pOutput + nOutputDone*2, nOutFrames);
+		nInputDone += nFrames;
+	}
+
+	unsigned nTicks = CTimer::GetClockTicks () - nStartTicks;
+	if (nTicks == 0)
+	{
+		nTicks = 1;
+	}
+
+	// fit a sine wave of the expected frequency to the left channel
+	double SinTable[PERIOD_FRAMES], CosTable[PERIOD_FRAMES];
+	for (unsigned i = 0; i < PERIOD_FRAMES; i++)
+	{
+		SinTable[i] = Sine (2.0 * PI * i / PERIOD_FRAMES);
+		CosTable[i] = Sine (2.0 * PI * i / PERIOD_FRAMES + PI / 2.0);
+	}
+
+	assert (nOutputDone > SKIP_FRAMES + PERIOD_FRAMES);
+	unsigned nFitFrames = (nOutputDone - SKIP_FRAMES) / PERIOD_FRAMES * PERIOD_FRAMES;
+
+	double fSin = 0.0, fCos = 0.0;
+	for (unsigned i = SKIP_FRAMES; i < SKIP_FRAMES + nFitFrames; i++)
+	{
+		fSin += pOutput[i*2] * SinTable[i % PERIOD_FRAMES];
+		fCos += pOutput[i*2] * CosTable[i % PERIOD_FRAMES];
+	}
+	fSin *= 2.0 / nFitFrames;
+	fCos *= 2.0 / nFitFrames;
+
+	double fSignal = 0.0, fResidue = 0.0;
+	for (unsigned i = SKIP_FRAMES; i < SKIP_FRAMES + nFitFrames; i++)
+	{
+		double fFit =   fSin * SinTable[i % PERIOD_FRAMES]
+			      + fCos * CosTable[i % PERIOD_FRAMES];
+		double fError = pOutput[i*2] - fFit;
+
+		fSignal += fFit * fFit;
+		fResidue += fError * fError;
+	}
+
+	m_Logger.Write (FromKernel, LogNotice,
+			"%6u -> %6u Hz, %-6s: THD+N %.1f dB, %u frames/s, stereo load %.1f%%",
+			nInputRate, nOutputRate, QualityName[Quality],
+			Decibel (fResidue / fSignal),
+			(unsigned) ((u64) nInputDone * CLOCKHZ / nTicks),
+			100.0 * nTicks / CLOCKHZ * nInputRate / nInputDone);
+
+	delete [] pOutput;
+	delete [] pInput;
+}
+
+// The sound device is replaced by a stand-in device clock, which deviates by nDriftPPM from the
+// local clock. The producer writes 1 ms of samples per step through the converter into the
+// (simulated) queue, the device takes chunks out of it, when its clock says so.
+
+void CKernel::TestDrift (int nDriftPPM, unsigned nChunkFrames, boolean bFeedback)
+{
+	static const unsigned StepFrames = DRIFT_RATE / 1000;
+	static s32 Input[StepFrames * 2];		// silence, only the timing counts
+	static s32 Output[BLOCK_FRAMES * 2];
+
+	unsigned nTargetFrames = 3 * nChunkFrames;
+	if (nTargetFrames < DRIFT_RATE / 50)
+	{
+		nTargetFrames = DRIFT_RATE / 50;	// 20 ms
+	}
+
+	CSampleRateConverter Converter (2);
+	if (!Converter.Setup (DRIFT_RATE, DRIFT_RATE, SRCQualityLow))
+	{
+		m_Logger.Write (FromKernel, LogPanic, "Cannot setup converter");
+	}
+
+	CSoundRateController Controller;
+	Controller.Setup (DRIFT_RATE, nTargetFrames);
+
+	unsigned nDeviceRateMilliHz = (unsigned) ((s64) DRIFT_RATE * (1000000 + nDriftPPM) / 1000);
+
+	unsigned nLevel = nTargetFrames;
+	u64 ullDeviceAccu = 0;			// device clock in 1/1000 frames
+	int nRatioAdjust = 0;
+	unsigned nUnderruns = 0;
+	unsigned nLevelMin = DRIFT_QUEUE, nLevelMax = 0;
+	int nAdjustMin = SOUND_RATE_MAX_ADJUST_PPM, nAdjustMax = -SOUND_RATE_MAX_ADJUST_PPM;
+
+	for (unsigned nMsec = 0; nMsec < DRIFT_SECS * 1000; nMsec++)
+	{
+		// producer (Write())
+		int nAdjust = Controller.GetRatioAdjust ();
+		if (nAdjust != nRatioAdjust)
+		{
+			Converter.SetRatioAdjust (nAdjust);
+			nRatioAdjust = nAdjust;
+		}
+
+		unsigned nInputDone = 0;
+		while (nInputDone < StepFrames)
+		{
+			unsigned nFrames = StepFrames - nInputDone;
+			nLevel += Converter.Process (Input, &nFrames, Output, BLOCK_FRAMES);
+			nInputDone += nFrames;
+		}
+
+		if (nLevel > DRIFT_QUEUE)
+		{
+			nLevel = DRIFT_QUEUE;
+		}
+
+		// device (GetChunk())
+		ullDeviceAccu += nDeviceRateMilliHz / 1000;
+		while (ullDeviceAccu >= nChunkFrames * 1000)
+		{
+			ullDeviceAccu -= nChunkFrames * 1000;
+
+			if (bFeedback)
+			{
+				Controller.SetMeasuredRate (nDeviceRateMilliHz);
+			}
+
+			if (nLevel >= nChunkFrames)
+			{
+				Controller.Update (nLevel, nChunkFrames);
+				nLevel -= nChunkFrames;
+			}
+			else
+			{
+				Controller.Reset ();
+				nLevel = 0;
+				nUnderruns++;
+			}
+		}
+
+		// check the second half, when the controller has settled
+		if (nMsec >= DRIFT_SECS * 1000 / 2)
+		{
+			if (nLevel < nLevelMin)
+			{
+				nLevelMin = nLevel;
+			}
+
+			if (nLevel > nLevelMax)
+			{
+				nLevelMax = nLevel;
+			}
+
+			if (nAdjust < nAdjustMin)
+			{
+				nAdjustMin = nAdjust;
+			}
+
+			if (nAdjust > nAdjustMax)
+			{
+				nAdjustMax = nAdjust;
+			}
+		}
+	}
+
+	// the level is sampled after the chunk has been taken out, allow 2 ms deviation
+	unsigned nTolerance = 2 * StepFrames;
+	boolean bOK =    nUnderruns == 0
+		      && nLevelMin + nChunkFrames + nTolerance >= nTargetFrames
+		      && nLevelMax <= nTargetFrames + nTolerance
+		      && nAdjustMin - 50 <= -nDriftPPM && -nDriftPPM <= nAdjustMax + 50;
+
+	m_Logger.Write (FromKernel, bOK ? LogNotice : LogError,
+			"Drift %+4d ppm, chunk %4u%s: level %u-%u (target %u), "
+			"adjust %d..%d ppm, %u underruns: %s",
+			nDriftPPM, nChunkFrames, bFeedback ? " (feedback)" : "",
+			nLevelMin, nLevelMax, nTargetFrames, nAdjustMin, nAdjustMax, nUnderruns,
+			bOK ? "OK" : "FAILED");
+}
+
+void CKernel::GenerateSine (s32 *pBuffer, unsigned nFrames, double fStep, double fAmplitude)
+{
+	for (unsigned i = 0; i < nFrames; i++)
+	{
+		double fValue = fAmplitude * Sine (fStep * i);
+		s32 nValue = (s32) (fValue < 0.0 ? fValue - 0.5 : fValue + 0.5);
+
+		*pBuffer++ = nValue;
+		*pBuffer++ = -nValue;
+	}
+}
+
+double CKernel::Sine (double fX)
+{
+	// reduce to -PI/2..PI/2
+	fX -= (2.0 * PI) * (long) (fX / (2.0 * PI));
+	if (fX > PI)
+	{
+		fX -= 2.0 * PI;
+	}
+	if (fX > PI / 2.0)
+	{
+		fX = PI - fX;
+	}
+	else if (fX < -PI / 2.0)
+	{
+		fX = -PI - fX;
+	}
+
+	double fX2 = fX * fX;
+	double fTerm = fX;
+	double fResult = fX;
+	for (unsigned n = 3; n <= 21; n += 2)
+	{
+		fTerm *= -fX2 / (n * (n-1));
+		fResult += fTerm;
+	}
+
+	return fResult;
+}
+
+double CKernel::Decibel (double fRatio)
+{
+	assert (fRatio > 0.0);
+
+	// ln(x) = e * ln(2) + ln(m) with 1 <= m < 2
+	int nExponent = 0;
+	while (fRatio >= 2.0)
+	{
+		fRatio /= 2.0;
+		nExponent++;
+	}
+	while (fRatio < 1.0)
+	{
+		fRatio *= 2.0;
+		nExponent--;
+	}
+
+	// ln(m) = 2 * atanh ((m-1) / (m+1))
+	double fY = (fRatio - 1.0) / (fRatio + 1.0);
+	double fY2 = fY * fY;
+	double fTerm = fY;
+	double fLn = 0.0;
+	for (unsigned n = 1; n <= 31; n += 2)
+	{
+		fLn += fTerm / n;
+		fTerm *= fY2;
+	}
+	fLn = 2.0 * fLn + nExponent * 0.69314718055994531;
+
+	return 10.0 * fLn / 2.30258509299404568;
+}
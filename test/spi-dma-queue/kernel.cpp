@@ -0,0 +1,238 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/synchronize.h>
+#include <assert.h>
+
+#define ROUNDS			1000
+#define TRANSFER_SIZE		3		// bytes, like a MCP3008 conversion
+#define SLOT_SIZE		4		// buffers must be 4-byte aligned
+
+static const char FromKernel[] = "kernel";
+
+static const unsigned ClockSpeeds[] = {1000000, 8000000};
+
+static DMA_BUFFER (u8, TxBuffer, TRANSFERS * SLOT_SIZE);
+static DMA_BUFFER (u8, RxBuffer, TRANSFERS * SLOT_SIZE);
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_SPIMaster (&m_Interrupt),
+	m_bRunning (FALSE),
+	m_nNextTransfer (0),
+	m_nErrors (0)
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Logger.Initialize (&m_Screen);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_SPIMaster.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	m_Logger.Write (FromKernel, LogNotice, "GPIO9 (MISO) must be connected with GPIO10 (MOSI)");
+
+	for (unsigned i = 0; i < sizeof ClockSpeeds / sizeof ClockSpeeds[0]; i++)
+	{
+		Measure (ClockSpeeds[i], FALSE);
+		Measure (ClockSpeeds[i], TRUE);
+	}
+
+	if (m_nErrors == 0)
+	{
+		m_Logger.Write (FromKernel, LogNotice, "Test passed");
+	}
+	else
+	{
+		m_Logger.Write (FromKernel, LogError, "Test failed with %u error(s)", m_nErrors);
+	}
+
+	return ShutdownHalt;
+}
+
+void CKernel::Measure (unsigned nClockSpeed, boolean bQueued)
+{
+	m_SPIMaster.SetClock (nClockSpeed);
+
+	// the chip select alternates, the clock is the same for both modes
+	for (unsigned i = 0; i < TRANSFERS; i++)
+	{
+		TSPIDMATransfer *pTransfer = &m_Transfers[i];
+
+		pTransfer->nChipSelect = i & 1;
+		pTransfer->nClockSpeed = nClockSpeed;
+		pTransfer->CPOL = 0;
+		pTransfer->CPHA = 0;
+		pTransfer->pWriteBuffer = &TxBuffer[i * SLOT_SIZE];
+		pTransfer->pReadBuffer = &RxBuffer[i * SLOT_SIZE];
+		pTransfer->nCount = TRANSFER_SIZE;
+	}
+
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	for (unsigned nRound = 0; nRound < ROUNDS; nRound++)
+	{
+		PrepareData (nRound);
+
+		m_bRunning = TRUE;
+
+		if (bQueued)
+		{
+			m_SPIMaster.SetCompletionRoutine (QueueCompletionRoutine, this);
+
+			if (!m_SPIMaster.StartQueue (m_Transfers, TRANSFERS))
+			{
+				m_Logger.Write (FromKernel, LogPanic, "Cannot start queue");
+			}
+		}
+		else
+		{
+			// the next transfer is started from the completion routine
+			m_nNextTransfer = 0;
+
+			const TSPIDMATransfer *pTransfer = &m_Transfers[0];
+
+			m_SPIMaster.SetCompletionRoutine (SequentialCompletionRoutine, this);
+			m_SPIMaster.StartWriteRead (pTransfer->nChipSelect, pTransfer->pWriteBuffer,
+						    pTransfer->pReadBuffer, pTransfer->nCount);
+		}
+
+		while (m_bRunning)
+		{
+			// just wait
+		}
+
+		if (!CheckData ())
+		{
+			m_nErrors++;
+		}
+	}
+
+	unsigned nTicks = CTimer::GetClockTicks () - nStartTicks;
+	assert (nTicks > 0);
+
+	unsigned nTransfers = ROUNDS * TRANSFERS;
+	m_Logger.Write (FromKernel, LogNotice, "%5u KHz, %s: %u transfers/s, %u ns per transfer",
+			nClockSpeed / 1000, bQueued ? "queued    " : "sequential",
+			(unsigned) (nTransfers * 1000000ULL / nTicks),
+			(unsigned) (nTicks * 1000ULL / nTransfers));
+}
+
+void CKernel::PrepareData (unsigned nRound)
+{
+	for (unsigned i = 0; i < TRANSFERS * SLOT_SIZE; i++)
+	{
+		TxBuffer[i] = (u8) (nRound + i);
+		RxBuffer[i] = 0;
+	}
+}
+
+boolean CKernel::CheckData (void)
+{
+	for (unsigned i = 0; i < TRANSFERS; i++)
+	{
+		for (unsigned j = 0; j < TRANSFER_SIZE; j++)
+		{
+			if (RxBuffer[i * SLOT_SIZE + j] != TxBuffer[i * SLOT_SIZE + j])
+			{
+				return FALSE;
+			}
+		}
+	}
+
+	return TRUE;
+}
+
+void CKernel::SequentialCompletionRoutine (boolean bStatus, void *pParam)
+{
+	CKernel *pThis = (CKernel *) pParam;
+	assert (pThis != 0);
+
+	if (!bStatus)
+	{
+		pThis->m_nErrors++;
+	}
+
+	unsigned nNext = pThis->m_nNextTransfer + 1;
+	if (nNext >= TRANSFERS)
+	{
+		pThis->m_bRunning = FALSE;
+
+		return;
+	}
+
+	pThis->m_nNextTransfer = nNext;
+
+	const TSPIDMATransfer *pTransfer = &pThis->m_Transfers[nNext];
+
+	pThis->m_SPIMaster.SetCompletionRoutine (SequentialCompletionRoutine, pThis);
+	pThis->m_SPIMaster.StartWriteRead (pTransfer->nChipSelect, pTransfer->pWriteBuffer,
+					   pTransfer->pReadBuffer, pTransfer->nCount);
+}
+
+void CKernel::QueueCompletionRoutine (boolean bStatus, void *pParam)
+{
+	CKernel *pThis = (CKernel *) pParam;
+	assert (pThis != 0);
+
+	if (!bStatus)
+	{
+		pThis->m_nErrors++;
+	}
+
+	pThis->m_bRunning = FALSE;
+}
@@ -0,0 +1,213 @@
+//
+// lockbenchmark.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "lockbenchmark.h"
+#include <circle/lockstatistics.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <assert.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+#define DURATION_MSECS		1000
+#define WRITE_EVERY		8		// RW lock: each 8th access is a write
+
+static const char FromBenchmark[] = "lock";
+
+CLockBenchmark::CLockBenchmark (CMemorySystem *pMemorySystem)
+:	CMultiCoreSupport (pMemorySystem),
+	m_Phase (PhaseInit),
+	m_bRunning (FALSE),
+	m_nFinished (0),
+	m_nStartTicks (0),
+	m_SpinLock (IRQ_LEVEL, "test-spinlock"),
+	m_TicketSpinLock (IRQ_LEVEL, "test-ticket"),
+	m_RWSpinLock (IRQ_LEVEL, "test-rwlock"),
+	m_bOK (TRUE)
+{
+}
+
+CLockBenchmark::~CLockBenchmark (void)
+{
+}
+
+void CLockBenchmark::Run (unsigned nCore)
+{
+	if (nCore == 0)
+	{
+		Measure (PhaseSpinLock, "CSpinLock");
+		Measure (PhaseTicketSpinLock, "CTicketSpinLock");
+		Measure (PhaseRWSpinLock, "CRWSpinLock");
+
+		EnterPhase (PhaseDone);
+
+#ifdef LOCK_STATISTICS
+		CLockStatistics::Dump ();
+#endif
+
+		return;
+	}
+
+	for (unsigned Phase = PhaseSpinLock; Phase < PhaseDone; Phase++)
+	{
+		WaitForPhase ((TPhase) Phase);
+		Contend ((TPhase) Phase, nCore);
+	}
+
+	WaitForPhase (PhaseDone);
+}
+
+void CLockBenchmark::Measure (TPhase Phase, const char *pLockName)
+{
+	m_nCounter = 0;
+	m_nCounterCopy = 0;
+	m_bInconsistent = FALSE;
+	for (unsigned i = 0; i < CORES; i++)
+	{
+		m_nAcquisitions[i] = 0;
+	}
+	m_nFinished = 0;
+	m_bRunning = TRUE;
+	m_nStartTicks = CTimer::GetClockTicks ();
+
+	EnterPhase (Phase);
+
+	Contend (Phase, 0);
+
+	while (m_nFinished < CORES)
+	{
+		DataMemBarrier ();
+	}
+
+	unsigned nTicks = CTimer::GetClockTicks () - m_nStartTicks;
+
+	unsigned nTotal = 0;
+	unsigned nMin = m_nAcquisitions[0];
+	unsigned nMax = m_nAcquisitions[0];
+	for (unsigned i = 0; i < CORES; i++)
+	{
+		unsigned nAcquisitions = m_nAcquisitions[i];
+
+		nTotal += nAcquisitions;
+
+		if (nAcquisitions < nMin)
+		{
+			nMin = nAcquisitions;
+		}
+
+		if (nAcquisitions > nMax)
+		{
+			nMax = nAcquisitions;
+		}
+	}
+
+	// readers do not increment the counter
+	unsigned nExpected = Phase == PhaseRWSpinLock ? m_nCounterCopy : nTotal;
+	if (   m_nCounter != nExpected
+	    || m_bInconsistent)
+	{
+		CLogger::Get ()->Write (FromBenchmark, LogError, "%s: Counter %u (should be %u)%s",
+					pLockName, m_nCounter, nExpected,
+					m_bInconsistent ? ", inconsistent read" : "");
+
+		m_bOK = FALSE;
+	}
+
+	CLogger::Get ()->Write (FromBenchmark, LogNotice,
+				"%-16s %u acquisitions/s, per core %u..%u",
+				pLockName, (unsigned) ((u64) nTotal * CLOCKHZ / nTicks), nMin, nMax);
+}
+
+void CLockBenchmark::Contend (TPhase Phase, unsigned nCore)
+{
+	assert (nCore < CORES);
+
+	unsigned nAcquisitions = 0;
+
+	while (m_bRunning)
+	{
+		switch (Phase)
+		{
+		case PhaseSpinLock:
+			m_SpinLock.Acquire ();
+			m_nCounter++;
+			m_SpinLock.Release ();
+			break;
+
+		case PhaseTicketSpinLock:
+			m_TicketSpinLock.Acquire ();
+			m_nCounter++;
+			m_TicketSpinLock.Release ();
+			break;
+
+		case PhaseRWSpinLock:
+			if (nAcquisitions % WRITE_EVERY == nCore)
+			{
+				m_RWSpinLock.AcquireWrite ();
+				m_nCounter++;
+				m_nCounterCopy++;
+				m_RWSpinLock.ReleaseWrite ();
+			}
+			else
+			{
+				m_RWSpinLock.AcquireRead ();
+				if (m_nCounter != m_nCounterCopy)
+				{
+					m_bInconsistent = TRUE;
+				}
+				m_RWSpinLock.ReleaseRead ();
+			}
+			break;
+
+		default:
+			assert (0);
+			break;
+		}
+
+		nAcquisitions++;
+
+		if (   nCore == 0
+		    && nAcquisitions % 256 == 0
+		    && CTimer::GetClockTicks () - m_nStartTicks >= DURATION_MSECS * (CLOCKHZ / 1000))
+		{
+			m_bRunning = FALSE;
+		}
+	}
+
+	m_nAcquisitions[nCore] = nAcquisitions;
+
+	__atomic_add_fetch (&m_nFinished, 1, __ATOMIC_RELEASE);
+}
+
+void CLockBenchmark::EnterPhase (TPhase Phase)
+{
+	m_Phase = Phase;
+
+	DataSyncBarrier ();
+}
+
+void CLockBenchmark::WaitForPhase (TPhase Phase)
+{
+	while (m_Phase < Phase)
+	{
+		DataMemBarrier ();
+	}
+}
+
+#endif
@@ -0,0 +1,80 @@
+//
+// lockbenchmark.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2024  R. Stange <rsta2@o2online.de>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _lockbenchmark_h
+#define _lockbenchmark_h
+
+#include <circle/multicore.h>
+#include <circle/memory.h>
+#include <circle/spinlock.h>
+#include <circle/ticketspinlock.h>
+#include <circle/rwspinlock.h>
+#include <circle/types.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+class CLockBenchmark : public CMultiCoreSupport
+{
+public:
+	CLockBenchmark (CMemorySystem *pMemorySystem);
+	~CLockBenchmark (void);
+
+	void Run (unsigned nCore);
+
+	boolean GetResult (void) const		{ return m_bOK; }
+
+private:
+	enum TPhase
+	{
+		PhaseInit,
+		PhaseSpinLock,
+		PhaseTicketSpinLock,
+		PhaseRWSpinLock,
+		PhaseDone
+	};
+
+	void Measure (TPhase Phase, const char *pLockName);	// on core 0
+	void Contend (TPhase Phase, unsigned nCore);		// on all cores
+
+	void EnterPhase (TPhase Phase);		// on core 0
+	void WaitForPhase (TPhase Phase);	// on secondary cores
+
+private:
+	volatile TPhase m_Phase;
+	volatile boolean m_bRunning;
+	volatile unsigned m_nFinished;
+	unsigned m_nStartTicks;
+
+	CSpinLock m_SpinLock;
+	CTicketSpinLock m_TicketSpinLock;
+	CRWSpinLock m_RWSpinLock;
+
+	// protected by the lock of the current phase
+	volatile unsigned m_nCounter;
+	volatile unsigned m_nCounterCopy;		// must equal m_nCounter for readers
+
+	volatile unsigned m_nAcquisitions[CORES];
+	volatile boolean m_bInconsistent;
+
+	boolean m_bOK;
+};
+
+#endif
+
+#endif
@@ -77,10 +77,13 @@ class CWorkerTask : public CTask
 {
 public:
 	CWorkerTask(int id, int timeout, CSynchronizationEvent* pEvent)
+	:	CTask (TASK_STACK_SIZE, TRUE)
 	{
 		m_id = id;
 		m_timeout = timeout;
 		m_pEvent = pEvent;
+
+		Start ();
 	}
 
 	virtual void Run() override
@@ -103,11 +106,14 @@ class CCounterTask : public CTask
 {
 public:
 	CCounterTask(int id, int timeout, int* piCounter, CMutex* pMutex)
+	:	CTask (TASK_STACK_SIZE, TRUE)
 	{
 		m_id = id;
 		m_timeout = timeout;
 		m_piCounter = piCounter;
 		m_pMutex = pMutex;
+
+		Start ();
 	}
 
 	virtual void Run() override